@@ -0,0 +1,1026 @@
+#include "ezjson_canonical.h"
+#include "ezjson_document.h"
+#include "ezjson_parser.h"
+#include "ezjson_reader.h"
+#include "ezjson_tape.h"
+#include "ezjson_writer.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Micro-benchmarks for the parser, the callback reader and the writer.
+//
+// Usage: bench [-t seconds] [file.json ...]
+//
+// Without files, a synthetic corpus modelled after the usual JSON benchmark
+// documents is generated in memory: string-heavy (twitter.json),
+// object-heavy (citm_catalog.json), number-heavy (canada.json), deeply
+// nested, one large flat array and binary blobs in base64.
+
+struct BenchDocument
+{
+    const char *name;
+    char *data;
+    unsigned length;
+};
+
+struct BenchText
+{
+    char *data;
+    unsigned length;
+    unsigned capacity;
+};
+
+struct BenchInput
+{
+    const char *data;
+    unsigned length;
+    unsigned pos;
+};
+
+struct BenchCounters
+{
+    unsigned long allocations;
+    unsigned long bytes;
+};
+
+struct BenchResult
+{
+    double seconds;
+    unsigned long iterations;
+    unsigned long tokens;
+    unsigned long allocations;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Corpus generation
+
+static unsigned long benchSeed = 0x2545F491u;
+
+static unsigned benchRandom(unsigned range)
+{
+    benchSeed = benchSeed * 6364136223846793005ull + 1442695040888963407ull;
+    return (unsigned)((benchSeed >> 33) % range);
+}
+
+static void textAppend(struct BenchText *text, const char *data, unsigned count)
+{
+    if (text->length + count + 1 > text->capacity)
+    {
+        unsigned newCapacity = text->capacity ? text->capacity * 2 : 4096;
+        while (text->length + count + 1 > newCapacity)
+        {
+            newCapacity *= 2;
+        }
+        text->data     = (char *)realloc(text->data, newCapacity);
+        text->capacity = newCapacity;
+    }
+
+    memcpy(text->data + text->length, data, count);
+    text->length += count;
+    text->data[text->length] = '\0';
+}
+
+static void textPuts(struct BenchText *text, const char *str)
+{
+    textAppend(text, str, (unsigned)strlen(str));
+}
+
+static void textPrint(struct BenchText *text, const char *fmt, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, fmt);
+    int count = vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    textAppend(text, buffer, (unsigned)count);
+}
+
+static const char *benchWords[] = {
+    "lorem", "ipsum",   "dolor", "sit",    "amet",  "consectetur",
+    "json",  "stream",  "token", "parser", "fast",  "benchmark",
+    "hello", "world",   "quick", "brown",  "fox",   "jumps",
+    "over",  "the",     "lazy",  "dog",    "tweet", "retweet",
+    "user",  "timeline"};
+
+static void textWords(struct BenchText *text, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const char *word = benchWords[benchRandom(
+            sizeof(benchWords) / sizeof(benchWords[0]))];
+        if (i > 0)
+        {
+            textPuts(text, " ");
+        }
+        textPuts(text, word);
+    }
+}
+
+static void generateTwitter(struct BenchText *text)
+{
+    textPuts(text, "{\"statuses\":[");
+    for (unsigned i = 0; i < 400; ++i)
+    {
+        if (i > 0)
+        {
+            textPuts(text, ",");
+        }
+        textPrint(
+            text,
+            "{\"created_at\":\"Sun Aug 31 00:29:%02u +0000 2014\","
+            "\"id\":%u,\"text\":\"",
+            i % 60,
+            505874924095815681u % 1000000000u + i);
+        textWords(text, 12 + benchRandom(12));
+        textPuts(text, "\",\"source\":\"web\",\"truncated\":false,");
+        textPuts(text, "\"user\":{\"name\":\"");
+        textWords(text, 2);
+        textPuts(text, "\",\"screen_name\":\"");
+        textWords(text, 1);
+        textPrint(
+            text,
+            "\",\"followers_count\":%u,\"verified\":%s,"
+            "\"description\":\"",
+            benchRandom(100000),
+            benchRandom(2) ? "true" : "false");
+        textWords(text, 8 + benchRandom(8));
+        textPuts(text, "\"},\"in_reply_to\":null,\"entities\":{");
+        textPuts(text, "\"hashtags\":[\"");
+        textWords(text, 1);
+        textPuts(text, "\"],\"urls\":[]}}");
+    }
+    textPuts(text, "]}");
+}
+
+static void generateCatalog(struct BenchText *text)
+{
+    textPuts(text, "{\"events\":{");
+    for (unsigned i = 0; i < 600; ++i)
+    {
+        if (i > 0)
+        {
+            textPuts(text, ",");
+        }
+        textPrint(
+            text,
+            "\"%u\":{\"id\":%u,\"logo\":null,\"name\":\"",
+            138586341u + i,
+            138586341u + i);
+        textWords(text, 3);
+        textPuts(text, "\",\"subTopicIds\":[");
+        for (unsigned j = 0; j < 4; ++j)
+        {
+            textPrint(text, "%s%u", j ? "," : "", 337184269u + benchRandom(50));
+        }
+        textPuts(text, "],\"topicIds\":[");
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            textPrint(text, "%s%u", j ? "," : "", 107888604u + benchRandom(50));
+        }
+        textPuts(text, "]}");
+    }
+    textPuts(text, "},\"performances\":[");
+    for (unsigned i = 0; i < 600; ++i)
+    {
+        textPrint(
+            text,
+            "%s{\"eventId\":%u,\"prices\":[{\"amount\":%u,\"audienceSubCategoryId\""
+            ":337100890,\"seatCategoryId\":%u}],\"start\":%u000,"
+            "\"venueCode\":\"PLEYEL_PLEYEL\"}",
+            i ? "," : "",
+            138586341u + i,
+            benchRandom(1000) * 10,
+            338937295u + benchRandom(20),
+            1372354200u + i);
+    }
+    textPuts(text, "]}");
+}
+
+static void generateCanada(struct BenchText *text)
+{
+    textPuts(text, "{\"type\":\"FeatureCollection\",\"features\":[");
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        textPrint(
+            text,
+            "%s{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},"
+            "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[",
+            i ? "," : "");
+        for (unsigned j = 0; j < 4000; ++j)
+        {
+            textPrint(
+                text,
+                "%s[%.14f,%.14f]",
+                j ? "," : "",
+                -65.613616999999977 + benchRandom(100000) / 7919.0,
+                43.420273000000009 + benchRandom(100000) / 7919.0);
+        }
+        textPuts(text, "]]}}");
+    }
+    textPuts(text, "]}");
+}
+
+static void generateNested(struct BenchText *text)
+{
+    textPuts(text, "[");
+    for (unsigned i = 0; i < 200; ++i)
+    {
+        for (unsigned depth = 0; depth < 64; ++depth)
+        {
+            textPuts(text, (depth % 2) ? "[" : "{\"k\":");
+        }
+        textPrint(text, "%u", i);
+        for (unsigned depth = 64; depth > 0; --depth)
+        {
+            textPuts(text, ((depth - 1) % 2) ? "]" : "}");
+        }
+        textPuts(text, i + 1 < 200 ? "," : "]");
+    }
+}
+
+static void generateLargeArray(struct BenchText *text)
+{
+    textPuts(text, "[");
+    for (unsigned i = 0; i < 200000; ++i)
+    {
+        textPrint(text, "%s%u", i ? "," : "", benchRandom(1000000));
+    }
+    textPuts(text, "]");
+}
+
+static void textSink(void *userdata, const char *data, unsigned count)
+{
+    textAppend((struct BenchText *)userdata, data, count);
+}
+
+static void generateBlobs(struct BenchText *text)
+{
+    static unsigned char blob[6000];
+    struct EzJSONWriter writer;
+
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.userdata = text;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &textSink;
+    EzJSONWriteArrayBegin(&writer);
+    for (unsigned i = 0; i < 200; ++i)
+    {
+        const unsigned length = 1000 + benchRandom(5000);
+        for (unsigned j = 0; j < length; ++j)
+        {
+            blob[j] = (unsigned char)benchRandom(256);
+        }
+        EzJSONWriteObjectBegin(&writer);
+        EzJSONWriteKey(&writer, "id", 2);
+        EzJSONWriteNumberL(&writer, (int)i);
+        EzJSONWriteKey(&writer, "blob", 4);
+        EzJSONWriteBase64(&writer, blob, length);
+        EzJSONWriteObjectEnd(&writer);
+    }
+    EzJSONWriteArrayEnd(&writer);
+    EzJSONWriterDestroy(&writer);
+}
+
+static int loadFile(const char *path, struct BenchDocument *doc)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return -1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    doc->name   = path;
+    doc->data   = (char *)malloc((size_t)size + 1);
+    doc->length = (unsigned)fread(doc->data, 1, (size_t)size, file);
+    doc->data[doc->length] = '\0';
+
+    fclose(file);
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Parser plumbing
+
+static int benchGetChar(void *userdata, char *c)
+{
+    struct BenchInput *input = (struct BenchInput *)userdata;
+
+    if (input->pos >= input->length)
+    {
+        return -1;
+    }
+
+    *c = input->data[input->pos++];
+    return 0;
+}
+
+static struct BenchCounters benchCounters;
+
+static char *benchAlloc(void *userdata, unsigned size)
+{
+    benchCounters.allocations++;
+    return (char *)malloc(size);
+}
+
+static void benchFree(void *userdata, void *ptr, unsigned size)
+{
+    free(ptr);
+}
+
+static void benchSink(void *userdata, const char *data, unsigned count)
+{
+    benchCounters.bytes += count;
+}
+
+static void parserBegin(
+    struct EzJSONParser *parser,
+    struct BenchInput *input,
+    const struct BenchDocument *doc)
+{
+    input->data   = doc->data;
+    input->length = doc->length;
+    input->pos    = 0;
+
+    memset(parser, 0, sizeof(*parser));
+    parser->settings.userdata        = input;
+    parser->settings.get_next_char   = &benchGetChar;
+    parser->settings.allocate_memory = &benchAlloc;
+    parser->settings.free_memory     = &benchFree;
+    EzJSONParserInit(parser);
+}
+
+// Same as parserBegin, but the parser reads the document straight from memory
+static void parserBeginMemory(
+    struct EzJSONParser *parser,
+    const struct BenchDocument *doc,
+    unsigned flags)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->settings.input           = doc->data;
+    parser->settings.input_length    = doc->length;
+    parser->settings.flags           = flags;
+    parser->settings.allocate_memory = &benchAlloc;
+    parser->settings.free_memory     = &benchFree;
+    EzJSONParserInit(parser);
+}
+
+static double now()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Benchmarks. Each returns the number of tokens processed for one document.
+
+static unsigned long benchParser(const struct BenchDocument *doc)
+{
+    struct EzJSONParser parser;
+    struct BenchInput input;
+    unsigned long tokens = 0;
+
+    parserBegin(&parser, &input, doc);
+    for (EzJSONParserNext(&parser); EzJSONParserToken(&parser);
+         EzJSONParserNext(&parser))
+    {
+        tokens++;
+    }
+
+    if (EzJSONParserHasError(&parser))
+    {
+        tokens = 0;
+    }
+    EzJSONParserDestroy(&parser);
+
+    return tokens;
+}
+
+static unsigned long benchParserMemory(const struct BenchDocument *doc)
+{
+    struct EzJSONParser parser;
+    unsigned long tokens = 0;
+
+    parserBeginMemory(&parser, doc, 0);
+    for (EzJSONParserNext(&parser); EzJSONParserToken(&parser);
+         EzJSONParserNext(&parser))
+    {
+        tokens++;
+    }
+
+    if (EzJSONParserHasError(&parser))
+    {
+        tokens = 0;
+    }
+    EzJSONParserDestroy(&parser);
+
+    return tokens;
+}
+
+static unsigned long
+benchParserFlags(const struct BenchDocument *doc, unsigned flags)
+{
+    struct EzJSONParser parser;
+    unsigned long tokens = 0;
+
+    parserBeginMemory(&parser, doc, flags);
+    for (EzJSONParserNext(&parser); EzJSONParserToken(&parser);
+         EzJSONParserNext(&parser))
+    {
+        tokens++;
+    }
+
+    if (EzJSONParserHasError(&parser))
+    {
+        tokens = 0;
+    }
+    EzJSONParserDestroy(&parser);
+
+    return tokens;
+}
+
+static unsigned long benchParserNoSeparators(const struct BenchDocument *doc)
+{
+    return benchParserFlags(doc, EZJ_PARSE_SKIP_SEPARATORS);
+}
+
+// Cost of interning every key, with the prediction hitting on records
+static unsigned long benchParserIntern(const struct BenchDocument *doc)
+{
+    return benchParserFlags(
+        doc, EZJ_PARSE_SKIP_SEPARATORS | EZJ_PARSE_INTERN_KEYS);
+}
+
+static unsigned long benchParserBatch(const struct BenchDocument *doc)
+{
+    struct EzJSONParser parser;
+    struct EzJSONToken batch[256];
+    unsigned long tokens = 0;
+    unsigned count;
+
+    parserBeginMemory(&parser, doc, EZJ_PARSE_SKIP_SEPARATORS);
+    do
+    {
+        count = EzJSONParserNextBatch(&parser, batch, 256);
+        tokens += count;
+    } while (count == 256);
+
+    if (EzJSONParserHasError(&parser))
+    {
+        tokens = 0;
+    }
+    EzJSONParserDestroy(&parser);
+
+    return tokens;
+}
+
+// Memory input, with arrays of numbers read through
+// EzJSONParserReadNumberArray
+static unsigned long benchParserArrays(const struct BenchDocument *doc)
+{
+    struct EzJSONParser parser;
+    unsigned long tokens = 0;
+    double values[1024];
+    unsigned count;
+
+    parserBeginMemory(&parser, doc, 0);
+    for (EzJSONParserNext(&parser); EzJSONParserToken(&parser);
+         EzJSONParserNext(&parser))
+    {
+        tokens++;
+        if (EzJSONParserToken(&parser)->type != EZJ_TOKEN_ARR_BEGIN)
+        {
+            continue;
+        }
+
+        int result;
+        do
+        {
+            result = EzJSONParserReadNumberArray(&parser, values, 1024, &count);
+            tokens += count;
+        } while (result == 1 && count == 1024);
+    }
+
+    if (EzJSONParserHasError(&parser))
+    {
+        tokens = 0;
+    }
+    EzJSONParserDestroy(&parser);
+
+    return tokens;
+}
+
+// Memory input, with the values of "blob" members decoded through
+// EzJSONParserReadBase64 rather than returned as text
+static unsigned long benchParserBase64(const struct BenchDocument *doc)
+{
+    static unsigned char bytes[4096];
+    struct EzJSONParser parser;
+    unsigned long tokens = 0;
+    unsigned count;
+
+    parserBeginMemory(&parser, doc, 0);
+    for (EzJSONParserNext(&parser); EzJSONParserToken(&parser);
+         EzJSONParserNext(&parser))
+    {
+        const struct EzJSONToken *token = EzJSONParserToken(&parser);
+        tokens++;
+        if (token->type != EZJ_TOKEN_OBJ_KEY || token->data_text_length != 4
+            || memcmp(token->data_text, "blob", 4) != 0)
+        {
+            continue;
+        }
+
+        int result;
+        while ((result = EzJSONParserReadBase64(
+                    &parser, bytes, sizeof(bytes), &count))
+               == 1)
+        {
+        }
+        tokens += result == 0;
+    }
+
+    if (EzJSONParserHasError(&parser))
+    {
+        tokens = 0;
+    }
+    EzJSONParserDestroy(&parser);
+
+    return tokens;
+}
+
+// On-demand access touching the first two levels only. Everything deeper is
+// passed over by the bracket counting skip.
+static unsigned long benchDocument(const struct BenchDocument *doc)
+{
+    struct EzJSONDocument document;
+    struct EzJSONIterator outer;
+    struct EzJSONIterator inner;
+    struct EzJSONValue value;
+    struct EzJSONValue member;
+    unsigned long tokens = 0;
+    int result;
+
+    memset(&document, 0, sizeof(document));
+    document.settings.allocate_memory = &benchAlloc;
+    document.settings.free_memory     = &benchFree;
+    EzJSONDocumentInit(&document, doc->data, doc->length);
+
+    if (EzJSONIteratorInit(EzJSONDocumentRoot(&document), &outer) == 0)
+    {
+        while ((result = EzJSONIteratorNext(&outer, NULL, &value)) == 1)
+        {
+            tokens++;
+            if (EzJSONIteratorInit(value, &inner) != 0)
+            {
+                continue;
+            }
+            while ((result = EzJSONIteratorNext(&inner, NULL, &member)) == 1)
+            {
+                tokens++;
+            }
+            if (result < 0)
+            {
+                break;
+            }
+        }
+        if (result < 0)
+        {
+            tokens = 0;
+        }
+    }
+
+    EzJSONDocumentDestroy(&document);
+    return tokens;
+}
+
+static void nop0(void *userdata)
+{
+    ++*(unsigned long *)userdata;
+}
+
+static void nopText(void *userdata, const char *data, unsigned length)
+{
+    ++*(unsigned long *)userdata;
+}
+
+static void nopNumber(void *userdata, EzJSONNumber val)
+{
+    ++*(unsigned long *)userdata;
+}
+
+static void nopBool(void *userdata, EzJSONBool val)
+{
+    ++*(unsigned long *)userdata;
+}
+
+static unsigned long benchReader(const struct BenchDocument *doc)
+{
+    struct EzJSONParser parser;
+    struct BenchInput input;
+    unsigned long tokens = 0;
+
+    struct EzJSONReader reader;
+    reader.onObjectBegin = &nop0;
+    reader.onObjectEnd   = &nop0;
+    reader.onArrayBegin  = &nop0;
+    reader.onArrayEnd    = &nop0;
+    reader.onKey         = &nopText;
+    reader.onNull        = &nop0;
+    reader.onNumber      = &nopNumber;
+    reader.onBool        = &nopBool;
+    reader.onString      = &nopText;
+    reader.onError       = &nop0;
+    reader.userdata      = &tokens;
+
+    parserBegin(&parser, &input, doc);
+    EzJSONRead(&reader, &parser);
+    EzJSONParserDestroy(&parser);
+
+    return tokens;
+}
+
+// The writer benchmark replays a recorded token stream, so that parsing cost
+// is not included in the measurement.
+struct RecordedToken
+{
+    struct EzJSONToken token;
+    unsigned textOffset;
+};
+
+struct Recording
+{
+    struct RecordedToken *tokens;
+    unsigned count;
+    struct BenchText text;
+    struct BenchText tape; // The document as a tape, for the replay benchmark
+};
+
+static void tapeSink(void *userdata, const char *data, unsigned count)
+{
+    textAppend((struct BenchText *)userdata, data, count);
+}
+
+static void record(const struct BenchDocument *doc, struct Recording *rec)
+{
+    struct EzJSONParser parser;
+    struct BenchInput input;
+    unsigned capacity = 0;
+
+    memset(rec, 0, sizeof(*rec));
+    parserBegin(&parser, &input, doc);
+    for (EzJSONParserNext(&parser); EzJSONParserToken(&parser);
+         EzJSONParserNext(&parser))
+    {
+        const struct EzJSONToken *token = EzJSONParserToken(&parser);
+        if (token->type == EZJ_TOKEN_SEQ_SEP || token->type == EZJ_TOKEN_KV_SEP)
+        {
+            continue;
+        }
+
+        if (rec->count == capacity)
+        {
+            capacity    = capacity ? capacity * 2 : 1024;
+            rec->tokens = (struct RecordedToken *)realloc(
+                rec->tokens, capacity * sizeof(struct RecordedToken));
+        }
+
+        struct RecordedToken *out = &rec->tokens[rec->count++];
+        out->token                = *token;
+        if (token->type == EZJ_TOKEN_STRING || token->type == EZJ_TOKEN_OBJ_KEY)
+        {
+            out->textOffset = rec->text.length;
+            textAppend(&rec->text, token->data_text, token->data_text_length);
+        }
+    }
+    EzJSONParserDestroy(&parser);
+
+    parserBeginMemory(&parser, doc, 0);
+    EzJSONTapeWrite(&parser, &tapeSink, &rec->tape);
+    EzJSONParserDestroy(&parser);
+}
+
+// Replay of a tape: no text is scanned, the cost of a warm cache start
+static unsigned long benchTape(const struct Recording *rec)
+{
+    struct EzJSONTape tape;
+    unsigned long tokens = 0;
+
+    EzJSONTapeInit(&tape, rec->tape.data, rec->tape.length);
+    for (EzJSONTapeNext(&tape); EzJSONTapeToken(&tape); EzJSONTapeNext(&tape))
+    {
+        tokens++;
+    }
+
+    return tape.error == EZ_TE_OK ? tokens : 0;
+}
+
+// Cache key of a document: canonical form hashed as it is produced
+static unsigned long
+benchCanonical(const struct BenchDocument *doc, const struct Recording *rec)
+{
+    struct EzJSONParser parser;
+    struct EzJSONHash hash;
+
+    parserBeginMemory(&parser, doc, EZJ_PARSE_SKIP_SEPARATORS);
+    EzJSONHashInit(&hash, 0);
+    const enum EzJSONCanonicalError error =
+        EzJSONCanonicalWrite(&parser, &EzJSONHashUpdate, &hash);
+    EzJSONParserDestroy(&parser);
+
+    return error == EZ_CN_OK ? rec->count : 0;
+}
+
+static unsigned long benchWriter(const struct Recording *rec, int checked)
+{
+    struct EzJSONWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.userdata        = NULL;
+    writer.settings.allocate_memory = &benchAlloc;
+    writer.settings.free_memory     = &benchFree;
+    writer.settings.checked         = (EzJSONBool)checked;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &benchSink;
+
+    for (unsigned i = 0; i < rec->count; ++i)
+    {
+        const struct EzJSONToken *token = &rec->tokens[i].token;
+        const char *text = rec->text.data + rec->tokens[i].textOffset;
+
+        switch (token->type)
+        {
+        case EZJ_TOKEN_OBJ_BEGIN:
+            EzJSONWriteObjectBegin(&writer);
+            break;
+        case EZJ_TOKEN_OBJ_END:
+            EzJSONWriteObjectEnd(&writer);
+            break;
+        case EZJ_TOKEN_ARR_BEGIN:
+            EzJSONWriteArrayBegin(&writer);
+            break;
+        case EZJ_TOKEN_ARR_END:
+            EzJSONWriteArrayEnd(&writer);
+            break;
+        case EZJ_TOKEN_OBJ_KEY:
+            EzJSONWriteKey(&writer, text, token->data_text_length);
+            break;
+        case EZJ_TOKEN_STRING:
+            EzJSONWriteString(&writer, text, token->data_text_length);
+            break;
+        case EZJ_TOKEN_NUMBER:
+            if (token->data_number == (EzJSONNumber)(int)token->data_number)
+            {
+                EzJSONWriteNumberL(&writer, (int)token->data_number);
+            }
+            else
+            {
+                EzJSONWriteNumber(&writer, token->data_number);
+            }
+            break;
+        case EZJ_TOKEN_BOOL:
+            EzJSONWriteBool(&writer, token->data_bool);
+            break;
+        case EZJ_TOKEN_NULL:
+            EzJSONWriteNull(&writer);
+            break;
+        default:
+            break;
+        }
+    }
+
+    EzJSONWriterDestroy(&writer);
+    return rec->count;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Driver
+
+enum BenchKind
+{
+    BENCH_PARSER,
+    BENCH_PARSER_MEMORY,
+    BENCH_PARSER_NO_SEPARATORS,
+    BENCH_PARSER_INTERN,
+    BENCH_PARSER_BATCH,
+    BENCH_PARSER_ARRAYS,
+    BENCH_PARSER_BASE64,
+    BENCH_DOCUMENT,
+    BENCH_TAPE,
+    BENCH_CANONICAL,
+    BENCH_READER,
+    BENCH_WRITER,
+    BENCH_WRITER_CHECKED,
+};
+
+static const char *benchKindNames[] = {
+    "parser",
+    "parser(memory)",
+    "parser(nosep)",
+    "parser(intern)",
+    "parser(batch)",
+    "parser(arrays)",
+    "parser(base64)",
+    "document",
+    "tape",
+    "canonical(hash)",
+    "reader",
+    "writer",
+    "writer(checked)",
+};
+
+static unsigned long runOnce(
+    enum BenchKind kind,
+    const struct BenchDocument *doc,
+    const struct Recording *rec)
+{
+    switch (kind)
+    {
+    case BENCH_PARSER:
+        return benchParser(doc);
+    case BENCH_PARSER_MEMORY:
+        return benchParserMemory(doc);
+    case BENCH_PARSER_NO_SEPARATORS:
+        return benchParserNoSeparators(doc);
+    case BENCH_PARSER_INTERN:
+        return benchParserIntern(doc);
+    case BENCH_PARSER_BATCH:
+        return benchParserBatch(doc);
+    case BENCH_PARSER_ARRAYS:
+        return benchParserArrays(doc);
+    case BENCH_PARSER_BASE64:
+        return benchParserBase64(doc);
+    case BENCH_DOCUMENT:
+        return benchDocument(doc);
+    case BENCH_TAPE:
+        return benchTape(rec);
+    case BENCH_CANONICAL:
+        return benchCanonical(doc, rec);
+    case BENCH_READER:
+        return benchReader(doc);
+    case BENCH_WRITER:
+        return benchWriter(rec, 0);
+    case BENCH_WRITER_CHECKED:
+        return benchWriter(rec, 1);
+    }
+    return 0;
+}
+
+static struct BenchResult run(
+    enum BenchKind kind,
+    const struct BenchDocument *doc,
+    const struct Recording *rec,
+    double minSeconds)
+{
+    struct BenchResult result;
+    memset(&result, 0, sizeof(result));
+
+    // Warm up caches and branch predictors
+    runOnce(kind, doc, rec);
+
+    benchCounters.allocations = 0;
+    const double start        = now();
+    do
+    {
+        result.tokens += runOnce(kind, doc, rec);
+        result.iterations++;
+        result.seconds = now() - start;
+    } while (result.seconds < minSeconds || result.iterations < 3);
+
+    result.allocations = benchCounters.allocations;
+    return result;
+}
+
+static void report(
+    enum BenchKind kind,
+    const struct BenchDocument *doc,
+    const struct BenchResult *result)
+{
+    const double docs = (double)result->iterations;
+    const double mb   = (double)doc->length * docs / (1024.0 * 1024.0);
+
+    printf(
+        "%-16s %-14s %10.1f MB/s %8.2f ns/token %8.1f allocs/doc\n",
+        doc->name,
+        benchKindNames[kind],
+        mb / result->seconds,
+        result->tokens ? result->seconds * 1e9 / (double)result->tokens : 0.0,
+        (double)result->allocations / docs);
+}
+
+// Per document parser counters, only available with EZJSON_STATS
+static void reportStats(const struct BenchDocument *doc)
+{
+    struct EzJSONParser parser;
+    struct BenchInput input;
+    struct EzJSONStats stats;
+
+    parserBegin(&parser, &input, doc);
+    while (EzJSONParserNext(&parser), EzJSONParserToken(&parser))
+    {
+    }
+
+    if (EzJSONParserGetStats(&parser, &stats))
+    {
+        printf(
+            "  %lu tokens, %lu string bytes, %lu buffer growths, "
+            "%lu stack growths, max depth %u\n",
+            stats.tokens,
+            stats.stringBytes,
+            stats.bufferGrowths,
+            stats.stackGrowths,
+            stats.maxDepth);
+    }
+    EzJSONParserDestroy(&parser);
+}
+
+int main(int argc, char **argv)
+{
+    struct BenchDocument docs[16];
+    unsigned docCount = 0;
+    double minSeconds = 0.5;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            minSeconds = atof(argv[++i]);
+        }
+        else if (docCount < sizeof(docs) / sizeof(docs[0]))
+        {
+            if (loadFile(argv[i], &docs[docCount]) != 0)
+            {
+                fprintf(stderr, "Could not read %s\n", argv[i]);
+                return 1;
+            }
+            docCount++;
+        }
+    }
+
+    if (docCount == 0)
+    {
+        void (*generators[])(struct BenchText *) = {
+            &generateTwitter,
+            &generateCatalog,
+            &generateCanada,
+            &generateNested,
+            &generateLargeArray,
+            &generateBlobs,
+        };
+        const char *names[] = {
+            "twitter",
+            "citm_catalog",
+            "canada",
+            "nested",
+            "large_array",
+            "blobs",
+        };
+
+        for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+        {
+            struct BenchText text;
+            memset(&text, 0, sizeof(text));
+            generators[i](&text);
+
+            docs[docCount].name   = names[i];
+            docs[docCount].data   = text.data;
+            docs[docCount].length = text.length;
+            docCount++;
+        }
+    }
+
+    for (unsigned i = 0; i < docCount; ++i)
+    {
+        struct Recording rec;
+        record(&docs[i], &rec);
+
+        if (benchParser(&docs[i]) == 0)
+        {
+            fprintf(stderr, "%s: parse error\n", docs[i].name);
+            return 1;
+        }
+
+        printf("%s: %u bytes\n", docs[i].name, docs[i].length);
+        reportStats(&docs[i]);
+        for (int kind = BENCH_PARSER; kind <= BENCH_WRITER_CHECKED; ++kind)
+        {
+            struct BenchResult result =
+                run((enum BenchKind)kind, &docs[i], &rec, minSeconds);
+            report((enum BenchKind)kind, &docs[i], &result);
+        }
+
+        free(rec.tokens);
+        free(rec.text.data);
+        free(rec.tape.data);
+        free(docs[i].data);
+    }
+
+    return 0;
+}
@@ -0,0 +1,950 @@
+#include "ezjson_parser.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Generates C structs with parse and write functions from a JSON schema.
+//
+// Usage: bindgen schema.json output
+//
+// Writes output.h and output.c. The schema is an object of types, each an
+// object mapping field names to type names:
+//
+//   {
+//       "Point": { "x": "number", "y": "number" },
+//       "User": {
+//           "id": "int",
+//           "name": "string:32",
+//           "active": "bool",
+//           "home": "Point",
+//           "scores": "number[16]"
+//       }
+//   }
+//
+// Field types are bool, int, number, string (NUL terminated, 64 bytes
+// including the terminator unless given as string:N) or a type defined
+// earlier in the schema. A [N] suffix makes a fixed capacity array with a
+// <field>_count member.
+//
+// For every type T the output declares struct T and
+//
+//   int TParse(struct T *, struct EzJSONParser *);
+//   void TWrite(const struct T *, struct EzJSONWriter *);
+//
+// Keys are dispatched with a switch on the key hash computed by the parser,
+// values are stored straight into the struct and nothing is allocated.
+
+#define MAX_NAME 64
+#define MAX_FIELDS 128
+#define MAX_TYPES 64
+#define DEFAULT_STRING_SIZE 64
+
+// Room for the longest field expression, out->NAME[out->NAME_count]
+#define MAX_EXPRESSION (2 * MAX_NAME + 32)
+
+enum FieldKind
+{
+    KIND_BOOL,
+    KIND_INT,
+    KIND_NUMBER,
+    KIND_STRING,
+    KIND_STRUCT,
+};
+
+struct Field
+{
+    char name[MAX_NAME];
+    enum FieldKind kind;
+    unsigned stringSize; // KIND_STRING, including the terminator
+    unsigned type;       // KIND_STRUCT, index into types
+    unsigned capacity;   // Array capacity, 0 for a single value
+    uint32_t hash;
+};
+
+struct Type
+{
+    char name[MAX_NAME];
+    struct Field fields[MAX_FIELDS];
+    unsigned fieldCount;
+};
+
+static struct Type types[MAX_TYPES];
+static unsigned typeCount;
+
+// Helpers referenced by the generated code, only emitted when used
+static int usesKind[KIND_STRUCT + 1];
+
+static const char *schemaPath;
+
+static int schemaError(const char *message, const char *detail)
+{
+    fprintf(stderr, "%s: %s%s\n", schemaPath, message, detail);
+    return -1;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Schema
+
+static int readFile(const char *path, char **data, unsigned long *length)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return -1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    *data   = (char *)malloc((size_t)size + 1);
+    *length = (unsigned long)fread(*data, 1, (size_t)size, file);
+
+    fclose(file);
+    return 0;
+}
+
+static struct EzJSONToken *nextToken(struct EzJSONParser *parser)
+{
+    struct EzJSONToken *token;
+    do
+    {
+        EzJSONParserNext(parser);
+        token = EzJSONParserToken(parser);
+    } while (token
+             && (token->type == EZJ_TOKEN_SEQ_SEP
+                 || token->type == EZJ_TOKEN_KV_SEP));
+    return token;
+}
+
+static int copyName(char *out, const char *text, unsigned length)
+{
+    if (length == 0 || length >= MAX_NAME
+        || !(isalpha((unsigned char)text[0]) || text[0] == '_'))
+    {
+        return -1;
+    }
+
+    for (unsigned i = 0; i < length; ++i)
+    {
+        if (!(isalnum((unsigned char)text[i]) || text[i] == '_'))
+        {
+            return -1;
+        }
+    }
+
+    memcpy(out, text, length);
+    out[length] = '\0';
+    return 0;
+}
+
+static int findType(const char *name, unsigned length)
+{
+    for (unsigned i = 0; i < typeCount; ++i)
+    {
+        if (strlen(types[i].name) == length
+            && memcmp(types[i].name, name, length) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int
+parseFieldType(struct Field *field, const char *spec, unsigned length)
+{
+    char text[MAX_NAME];
+    if (length >= MAX_NAME)
+    {
+        return -1;
+    }
+    memcpy(text, spec, length);
+    text[length] = '\0';
+
+    field->capacity = 0;
+    char *bracket   = strchr(text, '[');
+    if (bracket)
+    {
+        char *end;
+        unsigned long capacity = strtoul(bracket + 1, &end, 10);
+        if (capacity == 0 || capacity > 65535 || *end != ']' || end[1] != '\0')
+        {
+            return -1;
+        }
+        field->capacity = (unsigned)capacity;
+        *bracket        = '\0';
+    }
+
+    field->stringSize = DEFAULT_STRING_SIZE;
+    if (strncmp(text, "string:", 7) == 0)
+    {
+        char *end;
+        unsigned long size = strtoul(text + 7, &end, 10);
+        if (size < 2 || size > 65535 || *end != '\0')
+        {
+            return -1;
+        }
+        field->kind       = KIND_STRING;
+        field->stringSize = (unsigned)size;
+    }
+    else if (strcmp(text, "string") == 0)
+    {
+        field->kind = KIND_STRING;
+    }
+    else if (strcmp(text, "bool") == 0)
+    {
+        field->kind = KIND_BOOL;
+    }
+    else if (strcmp(text, "int") == 0)
+    {
+        field->kind = KIND_INT;
+    }
+    else if (strcmp(text, "number") == 0)
+    {
+        field->kind = KIND_NUMBER;
+    }
+    else
+    {
+        const int type = findType(text, (unsigned)strlen(text));
+        if (type < 0)
+        {
+            return -1;
+        }
+        field->kind = KIND_STRUCT;
+        field->type = (unsigned)type;
+    }
+
+    usesKind[field->kind] = 1;
+    return 0;
+}
+
+static int parseType(struct EzJSONParser *parser, struct Type *type)
+{
+    struct EzJSONToken *token = nextToken(parser);
+    if (!token || token->type != EZJ_TOKEN_OBJ_BEGIN)
+    {
+        return schemaError("expected an object of fields for ", type->name);
+    }
+
+    while ((token = nextToken(parser)) && token->type == EZJ_TOKEN_OBJ_KEY)
+    {
+        if (type->fieldCount == MAX_FIELDS)
+        {
+            return schemaError("too many fields in ", type->name);
+        }
+
+        struct Field *field = &type->fields[type->fieldCount++];
+        if (copyName(field->name, token->data_text, token->data_text_length)
+            != 0)
+        {
+            return schemaError(
+                "field names must be C identifiers in ", type->name);
+        }
+        field->hash = token->data_key_hash;
+
+        for (unsigned i = 0; i + 1 < type->fieldCount; ++i)
+        {
+            if (strcmp(type->fields[i].name, field->name) == 0)
+            {
+                return schemaError("duplicate field ", field->name);
+            }
+        }
+
+        token = nextToken(parser);
+        if (!token || token->type != EZJ_TOKEN_STRING
+            || parseFieldType(field, token->data_text, token->data_text_length)
+                   != 0)
+        {
+            return schemaError(
+                "invalid or unknown type for field ", field->name);
+        }
+    }
+
+    return token ? 0 : -1;
+}
+
+static int parseSchema(const char *data, unsigned long length)
+{
+    struct EzJSONParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = data;
+    parser.settings.input_length = length;
+    EzJSONParserInit(&parser);
+
+    int result                = -1;
+    struct EzJSONToken *token = nextToken(&parser);
+    if (!token || token->type != EZJ_TOKEN_OBJ_BEGIN)
+    {
+        schemaError("expected an object of types", "");
+        goto done;
+    }
+
+    while ((token = nextToken(&parser)) && token->type == EZJ_TOKEN_OBJ_KEY)
+    {
+        if (typeCount == MAX_TYPES)
+        {
+            schemaError("too many types", "");
+            goto done;
+        }
+
+        struct Type *type = &types[typeCount];
+        if (copyName(type->name, token->data_text, token->data_text_length)
+            != 0)
+        {
+            schemaError("type names must be C identifiers", "");
+            goto done;
+        }
+        if (findType(type->name, (unsigned)strlen(type->name)) >= 0)
+        {
+            schemaError("duplicate type ", type->name);
+            goto done;
+        }
+
+        if (parseType(&parser, type) != 0)
+        {
+            goto done;
+        }
+        typeCount++;
+    }
+
+    result = token && typeCount > 0 ? 0 : -1;
+
+done:
+    if (EzJSONParserHasError(&parser))
+    {
+        const struct EzJSONError *error = EzJSONParserError(&parser);
+        fprintf(
+            stderr,
+            "%s:%u:%u: %s\n",
+            schemaPath,
+            error->line,
+            error->column,
+            EzJSONErrorKindName(error->kind));
+    }
+    EzJSONParserDestroy(&parser);
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Header
+
+static const char *cType(const struct Field *field)
+{
+    switch (field->kind)
+    {
+    case KIND_BOOL:
+        return "EzJSONBool";
+    case KIND_INT:
+        return "int";
+    case KIND_NUMBER:
+        return "EzJSONNumber";
+    case KIND_STRING:
+        return "char";
+    case KIND_STRUCT:
+        return types[field->type].name;
+    }
+    return "";
+}
+
+static void emitHeader(FILE *out, const char *guard)
+{
+    fprintf(
+        out,
+        "// Generated by ezjson_bindgen from %s, do not edit\n\n",
+        schemaPath);
+    fprintf(out, "#ifndef %s\n#define %s\n\n", guard, guard);
+    fprintf(
+        out,
+        "#include \"ezjson_parser.h\"\n"
+        "#include \"ezjson_writer.h\"\n"
+        "\n"
+        "#ifdef __cplusplus\n"
+        "extern \"C\"\n"
+        "{\n"
+        "#endif // __cplusplus\n");
+
+    for (unsigned t = 0; t < typeCount; ++t)
+    {
+        const struct Type *type = &types[t];
+
+        fprintf(out, "\n    struct %s\n    {\n", type->name);
+        for (unsigned f = 0; f < type->fieldCount; ++f)
+        {
+            const struct Field *field = &type->fields[f];
+
+            fprintf(
+                out,
+                "        %s%s %s",
+                field->kind == KIND_STRUCT ? "struct " : "",
+                cType(field),
+                field->name);
+            if (field->capacity)
+            {
+                fprintf(out, "[%u]", field->capacity);
+            }
+            if (field->kind == KIND_STRING)
+            {
+                fprintf(out, "[%u]", field->stringSize);
+            }
+            fprintf(out, ";\n");
+            if (field->capacity)
+            {
+                fprintf(out, "        unsigned %s_count;\n", field->name);
+            }
+        }
+        fprintf(out, "    };\n");
+
+        fprintf(
+            out,
+            "\n"
+            "    /// Parse the next value as a %s. Fields missing from the "
+            "input are left\n"
+            "    /// unchanged and unknown keys are skipped. Returns 0 on "
+            "success, -1 on\n"
+            "    /// malformed input or a value that does not fit the "
+            "schema.\n"
+            "    int %sParse(struct %s *, struct EzJSONParser *);\n"
+            "    void %sWrite(const struct %s *, struct EzJSONWriter *);\n",
+            type->name,
+            type->name,
+            type->name,
+            type->name,
+            type->name);
+    }
+
+    fprintf(out, "\n#ifdef __cplusplus\n}\n#endif // __cplusplus\n\n#endif\n");
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Source
+
+static void emitHelpers(FILE *out)
+{
+    fprintf(
+        out,
+        "static struct EzJSONToken *nextValue(struct EzJSONParser *parser)\n"
+        "{\n"
+        "    struct EzJSONToken *token;\n"
+        "    do\n"
+        "    {\n"
+        "        EzJSONParserNext(parser);\n"
+        "        token = EzJSONParserToken(parser);\n"
+        "    } while (token\n"
+        "             && (token->type == EZJ_TOKEN_SEQ_SEP\n"
+        "                 || token->type == EZJ_TOKEN_KV_SEP));\n"
+        "    return token;\n"
+        "}\n"
+        "\n"
+        "// Skip the value starting with token, including nested values\n"
+        "static int skipValue(\n"
+        "    struct EzJSONParser *parser, struct EzJSONToken *token)\n"
+        "{\n"
+        "    unsigned depth = 0;\n"
+        "    for (; token; token = nextValue(parser))\n"
+        "    {\n"
+        "        switch (token->type)\n"
+        "        {\n"
+        "        case EZJ_TOKEN_OBJ_BEGIN:\n"
+        "        case EZJ_TOKEN_ARR_BEGIN:\n"
+        "            depth++;\n"
+        "            break;\n"
+        "        case EZJ_TOKEN_OBJ_END:\n"
+        "        case EZJ_TOKEN_ARR_END:\n"
+        "            depth--;\n"
+        "            break;\n"
+        "        default:\n"
+        "            break;\n"
+        "        }\n"
+        "\n"
+        "        if (depth == 0)\n"
+        "        {\n"
+        "            return 0;\n"
+        "        }\n"
+        "    }\n"
+        "    return -1;\n"
+        "}\n");
+
+    if (usesKind[KIND_BOOL])
+    {
+        fprintf(
+            out,
+            "\n"
+            "static int readBool(struct EzJSONToken *token, EzJSONBool *out)\n"
+            "{\n"
+            "    if (!token || token->type != EZJ_TOKEN_BOOL)\n"
+            "    {\n"
+            "        return -1;\n"
+            "    }\n"
+            "    *out = token->data_bool;\n"
+            "    return 0;\n"
+            "}\n");
+    }
+
+    if (usesKind[KIND_INT])
+    {
+        fprintf(
+            out,
+            "\n"
+            "// Read from the number text, data_number may have lost digits\n"
+            "static int readInt(\n"
+            "    struct EzJSONParser *parser, struct EzJSONToken *token, int "
+            "*out)\n"
+            "{\n"
+            "    int64_t value;\n"
+            "    if (!token || token->type != EZJ_TOKEN_NUMBER\n"
+            "        || EzJSONParserNumberI64(parser, &value) != 0\n"
+            "        || value < INT_MIN || value > INT_MAX)\n"
+            "    {\n"
+            "        return -1;\n"
+            "    }\n"
+            "    *out = (int)value;\n"
+            "    return 0;\n"
+            "}\n");
+    }
+
+    if (usesKind[KIND_NUMBER])
+    {
+        fprintf(
+            out,
+            "\n"
+            "static int readNumber(struct EzJSONToken *token, EzJSONNumber "
+            "*out)\n"
+            "{\n"
+            "    if (!token || token->type != EZJ_TOKEN_NUMBER)\n"
+            "    {\n"
+            "        return -1;\n"
+            "    }\n"
+            "    *out = token->data_number;\n"
+            "    return 0;\n"
+            "}\n");
+    }
+
+    if (usesKind[KIND_STRING])
+    {
+        fprintf(
+            out,
+            "\n"
+            "static int readString(\n"
+            "    struct EzJSONToken *token, char *out, unsigned size)\n"
+            "{\n"
+            "    if (!token || token->type != EZJ_TOKEN_STRING\n"
+            "        || token->data_text_length >= size)\n"
+            "    {\n"
+            "        return -1;\n"
+            "    }\n"
+            "    memcpy(out, token->data_text, token->data_text_length);\n"
+            "    out[token->data_text_length] = '\\0';\n"
+            "    return 0;\n"
+            "}\n");
+    }
+}
+
+// Emit a statement reading token into target, returning -1 on mismatch
+static void emitRead(
+    FILE *out,
+    const char *indent,
+    const struct Field *field,
+    const char *target)
+{
+    switch (field->kind)
+    {
+    case KIND_BOOL:
+        fprintf(out, "%sif (readBool(token, &%s) != 0)\n", indent, target);
+        break;
+    case KIND_INT:
+        fprintf(
+            out, "%sif (readInt(parser, token, &%s) != 0)\n", indent, target);
+        break;
+    case KIND_NUMBER:
+        fprintf(out, "%sif (readNumber(token, &%s) != 0)\n", indent, target);
+        break;
+    case KIND_STRING:
+        fprintf(
+            out,
+            "%sif (readString(token, %s, %uu) != 0)\n",
+            indent,
+            target,
+            field->stringSize);
+        break;
+    case KIND_STRUCT:
+        fprintf(
+            out,
+            "%sif (!token || token->type != EZJ_TOKEN_OBJ_BEGIN\n"
+            "%s    || parse%sBody(&%s, parser) != 0)\n",
+            indent,
+            indent,
+            types[field->type].name,
+            target);
+        break;
+    }
+    fprintf(out, "%s{\n%s    return -1;\n%s}\n", indent, indent, indent);
+}
+
+static int compareHash(const void *a, const void *b)
+{
+    const struct Field *fa = *(const struct Field *const *)a;
+    const struct Field *fb = *(const struct Field *const *)b;
+    return fa->hash < fb->hash ? -1 : fa->hash > fb->hash;
+}
+
+// Returns non-zero if snprintf cut its output short
+static int truncated(int length, size_t size)
+{
+    return length < 0 || (size_t)length >= size;
+}
+
+static int emitParse(FILE *out, const struct Type *type)
+{
+    const struct Field *sorted[MAX_FIELDS];
+    for (unsigned f = 0; f < type->fieldCount; ++f)
+    {
+        sorted[f] = &type->fields[f];
+    }
+    qsort(sorted, type->fieldCount, sizeof(sorted[0]), &compareHash);
+
+    fprintf(
+        out,
+        "\n"
+        "static int parse%sBody(struct %s *out, struct EzJSONParser *parser)\n"
+        "{\n"
+        "    struct EzJSONToken *token;\n"
+        "    while ((token = nextValue(parser)) && token->type == "
+        "EZJ_TOKEN_OBJ_KEY)\n"
+        "    {\n"
+        "        int field = -1;\n"
+        "        switch (token->data_key_hash)\n"
+        "        {\n",
+        type->name,
+        type->name);
+
+    // Keys sharing a hash share a case
+    for (unsigned f = 0; f < type->fieldCount; ++f)
+    {
+        const struct Field *field = sorted[f];
+        if (f == 0 || sorted[f - 1]->hash != field->hash)
+        {
+            fprintf(out, "        case 0x%08xu:\n", (unsigned)field->hash);
+        }
+
+        const unsigned length = (unsigned)strlen(field->name);
+        fprintf(
+            out,
+            "            if (token->data_text_length == %u\n"
+            "                && memcmp(token->data_text, \"%s\", %u) == 0)\n"
+            "            {\n"
+            "                field = %u;\n"
+            "            }\n",
+            length,
+            field->name,
+            length,
+            (unsigned)(field - type->fields));
+
+        if (f + 1 == type->fieldCount || sorted[f + 1]->hash != field->hash)
+        {
+            fprintf(out, "            break;\n");
+        }
+    }
+
+    fprintf(
+        out,
+        "        }\n"
+        "\n"
+        "        token = nextValue(parser);\n"
+        "        switch (field)\n"
+        "        {\n");
+
+    for (unsigned f = 0; f < type->fieldCount; ++f)
+    {
+        const struct Field *field = &type->fields[f];
+        char target[MAX_EXPRESSION];
+
+        fprintf(out, "        case %u:\n", f);
+        if (field->capacity)
+        {
+            fprintf(
+                out,
+                "            if (!token\n"
+                "                || token->type != EZJ_TOKEN_ARR_BEGIN)\n"
+                "            {\n"
+                "                return -1;\n"
+                "            }\n"
+                "            out->%s_count = 0;\n"
+                "            while ((token = nextValue(parser))\n"
+                "                   && token->type != EZJ_TOKEN_ARR_END)\n"
+                "            {\n"
+                "                if (out->%s_count == %uu)\n"
+                "                {\n"
+                "                    return -1;\n"
+                "                }\n",
+                field->name,
+                field->name,
+                field->capacity);
+            if (truncated(
+                    snprintf(
+                        target,
+                        sizeof(target),
+                        "out->%s[out->%s_count]",
+                        field->name,
+                        field->name),
+                    sizeof(target)))
+            {
+                return schemaError("field name too long: ", field->name);
+            }
+            emitRead(out, "                ", field, target);
+            fprintf(
+                out,
+                "                out->%s_count++;\n"
+                "            }\n"
+                "            if (!token)\n"
+                "            {\n"
+                "                return -1;\n"
+                "            }\n",
+                field->name);
+        }
+        else
+        {
+            if (truncated(
+                    snprintf(target, sizeof(target), "out->%s", field->name),
+                    sizeof(target)))
+            {
+                return schemaError("field name too long: ", field->name);
+            }
+            emitRead(out, "            ", field, target);
+        }
+        fprintf(out, "            break;\n");
+    }
+
+    fprintf(
+        out,
+        "        default:\n"
+        "            if (skipValue(parser, token) != 0)\n"
+        "            {\n"
+        "                return -1;\n"
+        "            }\n"
+        "            break;\n"
+        "        }\n"
+        "    }\n"
+        "\n"
+        "    return token && token->type == EZJ_TOKEN_OBJ_END ? 0 : -1;\n"
+        "}\n"
+        "\n"
+        "int %sParse(struct %s *out, struct EzJSONParser *parser)\n"
+        "{\n"
+        "    struct EzJSONToken *token = nextValue(parser);\n"
+        "    if (!token || token->type != EZJ_TOKEN_OBJ_BEGIN)\n"
+        "    {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    return parse%sBody(out, parser);\n"
+        "}\n",
+        type->name,
+        type->name,
+        type->name);
+    return 0;
+}
+
+static void emitWriteValue(
+    FILE *out,
+    const char *indent,
+    const struct Field *field,
+    const char *source)
+{
+    switch (field->kind)
+    {
+    case KIND_BOOL:
+        fprintf(out, "%sEzJSONWriteBool(writer, %s);\n", indent, source);
+        break;
+    case KIND_INT:
+        fprintf(out, "%sEzJSONWriteNumberL(writer, %s);\n", indent, source);
+        break;
+    case KIND_NUMBER:
+        fprintf(out, "%sEzJSONWriteNumber(writer, %s);\n", indent, source);
+        break;
+    case KIND_STRING:
+        fprintf(
+            out,
+            "%sEzJSONWriteEscapedString(writer, %s, (unsigned)strlen(%s));\n",
+            indent,
+            source,
+            source);
+        break;
+    case KIND_STRUCT:
+        fprintf(
+            out,
+            "%s%sWrite(&%s, writer);\n",
+            indent,
+            types[field->type].name,
+            source);
+        break;
+    }
+}
+
+static int emitWrite(FILE *out, const struct Type *type)
+{
+    fprintf(
+        out,
+        "\n"
+        "void %sWrite(const struct %s *in, struct EzJSONWriter *writer)\n"
+        "{\n"
+        "    EzJSONWriteObjectBegin(writer);\n",
+        type->name,
+        type->name);
+
+    for (unsigned f = 0; f < type->fieldCount; ++f)
+    {
+        const struct Field *field = &type->fields[f];
+        char source[MAX_EXPRESSION];
+
+        fprintf(
+            out,
+            "    EzJSONWriteKey(writer, \"%s\", %uu);\n",
+            field->name,
+            (unsigned)strlen(field->name));
+
+        if (field->capacity)
+        {
+            fprintf(
+                out,
+                "    EzJSONWriteArrayBegin(writer);\n"
+                "    for (unsigned i = 0; i < in->%s_count; ++i)\n"
+                "    {\n",
+                field->name);
+            if (truncated(
+                    snprintf(source, sizeof(source), "in->%s[i]", field->name),
+                    sizeof(source)))
+            {
+                return schemaError("field name too long: ", field->name);
+            }
+            emitWriteValue(out, "        ", field, source);
+            fprintf(out, "    }\n    EzJSONWriteArrayEnd(writer);\n");
+        }
+        else
+        {
+            if (truncated(
+                    snprintf(source, sizeof(source), "in->%s", field->name),
+                    sizeof(source)))
+            {
+                return schemaError("field name too long: ", field->name);
+            }
+            emitWriteValue(out, "    ", field, source);
+        }
+    }
+
+    fprintf(out, "    EzJSONWriteObjectEnd(writer);\n}\n");
+    return 0;
+}
+
+// Returns non-zero if the code cannot be generated
+static int emitSource(FILE *out, const char *header)
+{
+    fprintf(
+        out,
+        "// Generated by ezjson_bindgen from %s, do not edit\n\n",
+        schemaPath);
+    fprintf(
+        out,
+        "#include \"%s\"\n\n#include <limits.h>\n#include <string.h>\n\n",
+        header);
+
+    emitHelpers(out);
+    for (unsigned t = 0; t < typeCount; ++t)
+    {
+        if (emitParse(out, &types[t]) != 0 || emitWrite(out, &types[t]) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s schema.json output\n", argv[0]);
+        return 2;
+    }
+
+    schemaPath = argv[1];
+
+    char *data;
+    unsigned long length;
+    if (readFile(schemaPath, &data, &length) != 0)
+    {
+        fprintf(stderr, "%s: cannot read file\n", schemaPath);
+        return 1;
+    }
+
+    const int parsed = parseSchema(data, length);
+    free(data);
+    if (parsed != 0)
+    {
+        return 1;
+    }
+
+    // Output paths, and an include guard from the file name
+    const size_t baseLength = strlen(argv[2]);
+    char *headerPath        = (char *)malloc(baseLength + 3);
+    char *sourcePath        = (char *)malloc(baseLength + 3);
+    snprintf(headerPath, baseLength + 3, "%s.h", argv[2]);
+    snprintf(sourcePath, baseLength + 3, "%s.c", argv[2]);
+
+    const char *headerName = headerPath;
+    for (const char *c = headerPath; *c; ++c)
+    {
+        if (*c == '/' || *c == '\\')
+        {
+            headerName = c + 1;
+        }
+    }
+
+    char guard[256];
+    unsigned guardLength = 0;
+    guardLength += (unsigned)snprintf(guard, sizeof(guard), "__");
+    for (const char *c = headerName; *c && guardLength + 16 < sizeof(guard);
+         ++c)
+    {
+        guard[guardLength++] =
+            isalnum((unsigned char)*c) ? (char)toupper((unsigned char)*c) : '_';
+    }
+    snprintf(guard + guardLength, sizeof(guard) - guardLength, "_INCLUDED__");
+
+    int result       = 0;
+    FILE *headerFile = fopen(headerPath, "w");
+    FILE *sourceFile = fopen(sourcePath, "w");
+    if (!headerFile || !sourceFile)
+    {
+        fprintf(stderr, "%s: cannot write output\n", argv[2]);
+        result = 1;
+    }
+    else
+    {
+        emitHeader(headerFile, guard);
+        result = emitSource(sourceFile, headerName) != 0;
+    }
+
+    if (headerFile)
+    {
+        fclose(headerFile);
+    }
+    if (sourceFile)
+    {
+        fclose(sourceFile);
+    }
+    if (result != 0 && headerFile && sourceFile)
+    {
+        // Leave no partial output behind
+        remove(headerPath);
+        remove(sourcePath);
+    }
+    free(headerPath);
+    free(sourcePath);
+
+    return result;
+}
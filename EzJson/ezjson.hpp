@@ -0,0 +1,333 @@
+#ifndef __EZJSON_HPP_INCLUDED__
+#define __EZJSON_HPP_INCLUDED__
+
+// Header-only C++ interface. Requires C++11.
+//
+// ezjson::read() is the counterpart of EzJSONRead with the callbacks resolved
+// at compile time: the handler is any object with some of these members
+//
+//   void onObjectBegin();
+//   void onObjectEnd();
+//   void onArrayBegin();
+//   void onArrayEnd();
+//   void onKey(const char *, unsigned);
+//   void onNull();
+//   void onNumber(EzJSONNumber);
+//   void onBool(bool);
+//   void onString(const char *, unsigned);
+//   void onError(const EzJSONError &);
+//
+// Missing members are detected and compiled out, so the token loop carries no
+// null checks and the handler can be inlined into it.
+
+#include "ezjson_parser.h"
+#include "ezjson_writer.h"
+
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace ezjson
+{
+namespace detail
+{
+template <typename...> struct voider
+{
+    using type = void;
+};
+
+template <typename... T> using void_t = typename voider<T...>::type;
+
+// has_<name><H> is true when H has a member <name> callable with the probe
+// arguments. invoke_<name> calls it, or does nothing when it is missing.
+#define EZJSON_HANDLER_MEMBER(name, probe)                                     \
+    template <typename H, typename = void>                                     \
+    struct has_##name : std::false_type                                        \
+    {                                                                          \
+    };                                                                         \
+    template <typename H>                                                      \
+    struct has_##name<H, void_t<decltype(std::declval<H &>().name probe)>>     \
+        : std::true_type                                                       \
+    {                                                                          \
+    };                                                                         \
+    template <typename H, typename... A>                                       \
+    inline void invoke_##name(std::true_type, H &h, A &&...a)                  \
+    {                                                                          \
+        h.name(std::forward<A>(a)...);                                         \
+    }                                                                          \
+    template <typename H, typename... A>                                       \
+    inline void invoke_##name(std::false_type, H &, A &&...)                   \
+    {                                                                          \
+    }
+
+EZJSON_HANDLER_MEMBER(onObjectBegin, ())
+EZJSON_HANDLER_MEMBER(onObjectEnd, ())
+EZJSON_HANDLER_MEMBER(onArrayBegin, ())
+EZJSON_HANDLER_MEMBER(onArrayEnd, ())
+EZJSON_HANDLER_MEMBER(onKey, (std::declval<const char *>(), 0u))
+EZJSON_HANDLER_MEMBER(onNull, ())
+EZJSON_HANDLER_MEMBER(onNumber, (std::declval<EzJSONNumber>()))
+EZJSON_HANDLER_MEMBER(onBool, (true))
+EZJSON_HANDLER_MEMBER(onString, (std::declval<const char *>(), 0u))
+EZJSON_HANDLER_MEMBER(onError, (std::declval<const EzJSONError &>()))
+
+#undef EZJSON_HANDLER_MEMBER
+
+struct ParserDeleter
+{
+    void operator()(EzJSONParser *parser) const
+    {
+        EzJSONParserDestroy(parser);
+        delete parser;
+    }
+};
+
+struct WriterDeleter
+{
+    void operator()(EzJSONWriter *writer) const
+    {
+        EzJSONWriterDestroy(writer);
+        delete writer;
+    }
+};
+} // namespace detail
+
+/// Owns an EzJSONParser. The C struct lives on the heap because it points
+/// into itself (inline buffer and stack), so moving a Parser only moves the
+/// pointer.
+class Parser
+{
+public:
+    explicit Parser(const EzJSONParserSettings &settings)
+        : m_parser(new EzJSONParser())
+    {
+        m_parser->settings = settings;
+        EzJSONParserInit(m_parser.get());
+    }
+
+    /// Parse a document from memory. data must outlive the parser.
+    Parser(const char *data, unsigned long length, unsigned flags = 0)
+        : Parser(memorySettings(data, length, flags))
+    {
+    }
+
+    Parser(Parser &&)            = default;
+    Parser &operator=(Parser &&) = default;
+
+    /// Step to the next token and return it, null at the end or on error
+    const EzJSONToken *next()
+    {
+        EzJSONParserNext(m_parser.get());
+        return EzJSONParserToken(m_parser.get());
+    }
+
+    const EzJSONToken *token() const
+    {
+        return EzJSONParserToken(m_parser.get());
+    }
+
+    bool hasError() const
+    {
+        return EzJSONParserHasError(m_parser.get()) != 0;
+    }
+
+    const EzJSONError &error() const
+    {
+        return *EzJSONParserError(m_parser.get());
+    }
+
+    EzJSONParser *get() const
+    {
+        return m_parser.get();
+    }
+
+private:
+    static EzJSONParserSettings
+    memorySettings(const char *data, unsigned long length, unsigned flags)
+    {
+        EzJSONParserSettings settings;
+        std::memset(&settings, 0, sizeof(settings));
+        settings.input        = data;
+        settings.input_length = length;
+        settings.flags        = flags;
+        return settings;
+    }
+
+    std::unique_ptr<EzJSONParser, detail::ParserDeleter> m_parser;
+};
+
+/// Owns an EzJSONWriter. Output goes to a sink, any object callable as
+/// sink(const char *data, unsigned count), which must outlive the writer.
+class Writer
+{
+public:
+    template <typename Sink>
+    explicit Writer(Sink &sink, bool checked = false, unsigned maxDepth = 0)
+        : m_writer(new EzJSONWriter())
+    {
+        m_writer->settings.userdata  = &sink;
+        m_writer->settings.checked   = checked;
+        m_writer->settings.max_depth = maxDepth;
+        EzJSONWriterInit(m_writer.get());
+        m_writer->writeBuffer = [](void *userdata, const char *data,
+                                   unsigned count)
+        { (*static_cast<Sink *>(userdata))(data, count); };
+    }
+
+    Writer(Writer &&)            = default;
+    Writer &operator=(Writer &&) = default;
+
+    void objectBegin()
+    {
+        EzJSONWriteObjectBegin(m_writer.get());
+    }
+
+    void objectEnd()
+    {
+        EzJSONWriteObjectEnd(m_writer.get());
+    }
+
+    void arrayBegin()
+    {
+        EzJSONWriteArrayBegin(m_writer.get());
+    }
+
+    void arrayEnd()
+    {
+        EzJSONWriteArrayEnd(m_writer.get());
+    }
+
+    void key(const char *str, unsigned count)
+    {
+        EzJSONWriteKey(m_writer.get(), str, count);
+    }
+
+    void string(const char *str, unsigned count)
+    {
+        EzJSONWriteString(m_writer.get(), str, count);
+    }
+
+    void boolean(bool val)
+    {
+        EzJSONWriteBool(m_writer.get(), val);
+    }
+
+    void null()
+    {
+        EzJSONWriteNull(m_writer.get());
+    }
+
+    void number(EzJSONNumber val)
+    {
+        EzJSONWriteNumber(m_writer.get(), val);
+    }
+
+    void number(int val)
+    {
+        EzJSONWriteNumberL(m_writer.get(), val);
+    }
+
+    void enablePrettyPrinting(bool enabled)
+    {
+        EzJSONEnablePrettyPrinting(m_writer.get(), enabled);
+    }
+
+    /// Checked mode only, EZ_WE_OK until the first error
+    EzJSONWriteError error() const
+    {
+        return m_writer->error;
+    }
+
+    EzJSONWriter *get() const
+    {
+        return m_writer.get();
+    }
+
+private:
+    std::unique_ptr<EzJSONWriter, detail::WriterDeleter> m_writer;
+};
+
+/// Parse until the end of the document or the first error, passing every
+/// token to handler. Returns false on error, after calling handler.onError.
+template <typename Handler> bool read(EzJSONParser *parser, Handler &handler)
+{
+    const EzJSONToken *token;
+    while (EzJSONParserNext(parser), token = EzJSONParserToken(parser))
+    {
+        switch (token->type)
+        {
+        case EZJ_TOKEN_OBJ_BEGIN:
+            detail::invoke_onObjectBegin(
+                detail::has_onObjectBegin<Handler>(), handler);
+            break;
+
+        case EZJ_TOKEN_OBJ_END:
+            detail::invoke_onObjectEnd(
+                detail::has_onObjectEnd<Handler>(), handler);
+            break;
+
+        case EZJ_TOKEN_ARR_BEGIN:
+            detail::invoke_onArrayBegin(
+                detail::has_onArrayBegin<Handler>(), handler);
+            break;
+
+        case EZJ_TOKEN_ARR_END:
+            detail::invoke_onArrayEnd(
+                detail::has_onArrayEnd<Handler>(), handler);
+            break;
+
+        case EZJ_TOKEN_OBJ_KEY:
+            detail::invoke_onKey(
+                detail::has_onKey<Handler>(),
+                handler,
+                token->data_text,
+                token->data_text_length);
+            break;
+
+        case EZJ_TOKEN_NULL:
+            detail::invoke_onNull(detail::has_onNull<Handler>(), handler);
+            break;
+
+        case EZJ_TOKEN_BOOL:
+            detail::invoke_onBool(
+                detail::has_onBool<Handler>(), handler, token->data_bool != 0);
+            break;
+
+        case EZJ_TOKEN_NUMBER:
+            detail::invoke_onNumber(
+                detail::has_onNumber<Handler>(), handler, token->data_number);
+            break;
+
+        case EZJ_TOKEN_STRING:
+            detail::invoke_onString(
+                detail::has_onString<Handler>(),
+                handler,
+                token->data_text,
+                token->data_text_length);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (EzJSONParserHasError(parser))
+    {
+        detail::invoke_onError(
+            detail::has_onError<Handler>(),
+            handler,
+            *EzJSONParserError(parser));
+        return false;
+    }
+
+    return true;
+}
+
+template <typename Handler> bool read(Parser &parser, Handler &handler)
+{
+    return read(parser.get(), handler);
+}
+} // namespace ezjson
+
+#endif //!__EZJSON_HPP_INCLUDED__
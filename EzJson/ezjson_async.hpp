@@ -0,0 +1,183 @@
+#ifndef __EZJSON_ASYNC_HPP_INCLUDED__
+#define __EZJSON_ASYNC_HPP_INCLUDED__
+
+// Coroutine interface to the parser. Requires C++20.
+//
+// An AsyncParser is fed input as it arrives, from a socket callback or an
+// event loop, and a coroutine reads tokens with co_await parser.next().
+// When the input runs out in the middle of the document the coroutine is
+// suspended, and the next feed() resumes it from the I/O side:
+//
+//   Task handle(ezjson::AsyncParser &parser)
+//   {
+//       while (const EzJSONToken *token = co_await parser.next())
+//       {
+//           ...
+//       }
+//       if (parser.hasError()) ...
+//   }
+//
+//   // Whenever bytes arrive for this body
+//   parser.feed(data, size);
+//   // When the body is complete
+//   parser.finish();
+//
+// Any coroutine type works, next() returns a plain awaiter. Suspending
+// stores the coroutine handle in the parser and allocates nothing, so one
+// thread can drive many bodies at once, each with its own parser.
+//
+// Fed bytes may be reused once feed() returns with the coroutine waiting
+// again, see waiting(). The parser copies the part of a token that was cut
+// off by the end of the input, everything else is read in place.
+
+#include "ezjson.hpp"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+namespace ezjson
+{
+class AsyncParser
+{
+public:
+    /// settings.input and the callbacks are ignored, EZJ_PARSE_FEED is
+    /// added to the flags
+    explicit AsyncParser(EzJSONParserSettings settings)
+        : m_parser(feedSettings(settings))
+    {
+    }
+
+    explicit AsyncParser(unsigned flags = 0, unsigned maxDepth = 0)
+        : AsyncParser(flagSettings(flags, maxDepth))
+    {
+    }
+
+    // The waiting coroutine refers to the parser, it must not move
+    AsyncParser(const AsyncParser &)            = delete;
+    AsyncParser &operator=(const AsyncParser &) = delete;
+
+    class NextAwaiter
+    {
+    public:
+        explicit NextAwaiter(AsyncParser &parser) : m_parser(parser)
+        {
+        }
+
+        /// Completes at once while the input lasts
+        bool await_ready()
+        {
+            return m_parser.step();
+        }
+
+        void await_suspend(std::coroutine_handle<> waiting)
+        {
+            m_parser.m_waiting = waiting;
+        }
+
+        /// The token, null at the end of the document or on error
+        const EzJSONToken *await_resume() const
+        {
+            return m_parser.token();
+        }
+
+    private:
+        AsyncParser &m_parser;
+    };
+
+    /// Step to the next token, suspending until enough input is fed
+    NextAwaiter next()
+    {
+        return NextAwaiter(*this);
+    }
+
+    /// Pass the next part of the input. A coroutine waiting in next() is
+    /// resumed once a token is complete, on this thread and before feed
+    /// returns. Returns false if the parser still holds unread input, when
+    /// the coroutine is suspended on something else.
+    bool feed(const char *data, std::size_t length)
+    {
+        if (EzJSONParserFeed(m_parser.get(), data, length) != 0)
+        {
+            return false;
+        }
+        resume();
+        return true;
+    }
+
+    /// The input is complete, a waiting coroutine sees the end of the
+    /// document or an error
+    void finish()
+    {
+        EzJSONParserFeedEnd(m_parser.get());
+        resume();
+    }
+
+    /// A coroutine is suspended in next() until more input is fed
+    bool waiting() const
+    {
+        return static_cast<bool>(m_waiting);
+    }
+
+    const EzJSONToken *token() const
+    {
+        return m_parser.token();
+    }
+
+    bool hasError() const
+    {
+        return m_parser.hasError();
+    }
+
+    const EzJSONError &error() const
+    {
+        return m_parser.error();
+    }
+
+    EzJSONParser *get() const
+    {
+        return m_parser.get();
+    }
+
+private:
+    static EzJSONParserSettings feedSettings(EzJSONParserSettings settings)
+    {
+        settings.input          = nullptr;
+        settings.input_length   = 0;
+        settings.get_next_char  = nullptr;
+        settings.get_next_block = nullptr;
+        settings.flags |= EZJ_PARSE_FEED;
+        return settings;
+    }
+
+    static EzJSONParserSettings flagSettings(unsigned flags, unsigned maxDepth)
+    {
+        EzJSONParserSettings settings;
+        std::memset(&settings, 0, sizeof(settings));
+        settings.flags     = flags;
+        settings.max_depth = maxDepth;
+        return settings;
+    }
+
+    // Returns false when the input ran out before the next token
+    bool step()
+    {
+        EzJSONParserNext(m_parser.get());
+        return !EzJSONParserNeedsInput(m_parser.get());
+    }
+
+    void resume()
+    {
+        if (m_waiting && step())
+        {
+            std::exchange(m_waiting, nullptr).resume();
+        }
+    }
+
+    Parser m_parser;
+    std::coroutine_handle<> m_waiting;
+};
+} // namespace ezjson
+
+#endif //!__EZJSON_ASYNC_HPP_INCLUDED__
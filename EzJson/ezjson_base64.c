@@ -0,0 +1,295 @@
+#include "ezjson_internal.h"
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define EZJSON_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define EZJSON_AVX2 1
+#include <immintrin.h>
+#endif
+
+static const char base64Digits[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Value of each character, or BASE64_INVALID. The scalar decoder looks
+// values up rather than testing ranges, which branch unpredictably on
+// binary payloads.
+static const unsigned char base64Values[256] = {
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 62, 64, 64, 64, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 64, 64, 64, 64, 64, 64,
+    64,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 64, 64, 64, 64, 64,
+    64, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+};
+
+// Vector kernels after Muła and Lemire, "Faster Base64 Encoding and Decoding
+// Using AVX2 Instructions". Each 128-bit lane turns 12 bytes into 16
+// characters or back, the AVX2 versions run two lanes at once.
+
+#if defined(EZJSON_SSSE3)
+// Spread 12 bytes into the 6-bit indices of 16 characters
+static __m128i base64_lane_indices(__m128i in)
+{
+    in = _mm_shuffle_epi8(
+        in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+// Turn indices into characters by adding an offset per range, looked up
+// after reducing A..Z to 13, a..z to 0, digits to 1..10, '+' to 11 and '/'
+// to 12
+static __m128i base64_lane_characters(__m128i indices)
+{
+    const __m128i shift = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    const __m128i range = _mm_or_si128(
+        _mm_subs_epu8(indices, _mm_set1_epi8(51)),
+        _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(shift, range), indices);
+}
+#endif
+
+#if defined(EZJSON_AVX2)
+// The same on two lanes
+static __m256i base64_avx2_indices(__m256i in)
+{
+    in = _mm256_shuffle_epi8(
+        in,
+        _mm256_setr_epi8(
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4,
+            3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t1, t3);
+}
+
+static __m256i base64_avx2_characters(__m256i indices)
+{
+    const __m256i shift = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    const __m256i range = _mm256_or_si256(
+        _mm256_subs_epu8(indices, _mm256_set1_epi8(51)),
+        _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(_mm256_shuffle_epi8(shift, range), indices);
+}
+#endif
+
+void base64_encode(const unsigned char *in, unsigned long groups, char *out)
+{
+    unsigned long i = 0;
+
+#if defined(EZJSON_SSSE3)
+    // Loads read 16 bytes for the 12 they use, and the AVX2 loop reads from
+    // 12 bytes further on, so both stop short of the end
+#if defined(EZJSON_AVX2)
+    for (; groups - i >= 10; i += 8)
+    {
+        const __m256i block = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128((const __m128i *)(in + i * 3))),
+            _mm_loadu_si128((const __m128i *)(in + i * 3 + 12)),
+            1);
+        _mm256_storeu_si256(
+            (__m256i *)(out + i * 4),
+            base64_avx2_characters(base64_avx2_indices(block)));
+    }
+#endif
+    for (; groups - i >= 6; i += 4)
+    {
+        const __m128i block = _mm_loadu_si128((const __m128i *)(in + i * 3));
+        _mm_storeu_si128(
+            (__m128i *)(out + i * 4),
+            base64_lane_characters(base64_lane_indices(block)));
+    }
+#endif
+
+    for (; i < groups; ++i)
+    {
+        const unsigned char *src = in + i * 3;
+        const uint32_t bits =
+            ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+        char *dst = out + i * 4;
+        dst[0]    = base64Digits[bits >> 18];
+        dst[1]    = base64Digits[(bits >> 12) & 63];
+        dst[2]    = base64Digits[(bits >> 6) & 63];
+        dst[3]    = base64Digits[bits & 63];
+    }
+}
+
+void base64_encode_tail(const unsigned char *in, unsigned count, char *out)
+{
+    const uint32_t bits =
+        ((uint32_t)in[0] << 16) | (count > 1 ? (uint32_t)in[1] << 8 : 0);
+    out[0] = base64Digits[bits >> 18];
+    out[1] = base64Digits[(bits >> 12) & 63];
+    out[2] = count > 1 ? base64Digits[(bits >> 6) & 63] : '=';
+    out[3] = '=';
+}
+
+#if defined(EZJSON_SSSE3)
+// Values of 16 characters. invalid is set if any is outside the alphabet:
+// characters are classified by their nibbles, the low nibble lookup sets a
+// bit for every high nibble it is invalid with.
+static __m128i base64_lane_values(__m128i in, int *invalid)
+{
+    const __m128i loTable = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13,
+        0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i hiTable = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i rollTable = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask = _mm_set1_epi8(0x2F);
+
+    const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask);
+    const __m128i loNibbles = _mm_and_si128(in, mask);
+    const __m128i classes   = _mm_and_si128(
+        _mm_shuffle_epi8(loTable, loNibbles),
+        _mm_shuffle_epi8(hiTable, hiNibbles));
+    *invalid =
+        _mm_movemask_epi8(_mm_cmpeq_epi8(classes, _mm_setzero_si128()))
+        != 0xFFFF;
+
+    // '/' shares its high nibble with '+', and needs its own offset
+    const __m128i roll = _mm_shuffle_epi8(
+        rollTable, _mm_add_epi8(_mm_cmpeq_epi8(in, mask), hiNibbles));
+    return _mm_add_epi8(in, roll);
+}
+
+// Pack the 6-bit values of 16 characters into 12 bytes, at the front
+static __m128i base64_lane_pack(__m128i values)
+{
+    const __m128i pairs =
+        _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(
+        words,
+        _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+#endif
+
+#if defined(EZJSON_AVX2)
+static __m256i base64_avx2_values(__m256i in, int *invalid)
+{
+    const __m256i loTable = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13,
+        0x1A, 0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i hiTable = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+        0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i rollTable = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19,
+        4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask = _mm256_set1_epi8(0x2F);
+
+    const __m256i hiNibbles =
+        _mm256_and_si256(_mm256_srli_epi32(in, 4), mask);
+    const __m256i loNibbles = _mm256_and_si256(in, mask);
+    *invalid                = !_mm256_testz_si256(
+        _mm256_shuffle_epi8(loTable, loNibbles),
+        _mm256_shuffle_epi8(hiTable, hiNibbles));
+
+    const __m256i roll = _mm256_shuffle_epi8(
+        rollTable, _mm256_add_epi8(_mm256_cmpeq_epi8(in, mask), hiNibbles));
+    return _mm256_add_epi8(in, roll);
+}
+
+// Pack each lane to 12 bytes, then the two lanes to the front
+static __m256i base64_avx2_pack(__m256i values)
+{
+    const __m256i pairs =
+        _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    const __m256i words =
+        _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    const __m256i lanes = _mm256_shuffle_epi8(
+        words,
+        _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0,
+            6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    return _mm256_permutevar8x32_epi32(
+        lanes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+}
+#endif
+
+unsigned long
+base64_decode(const char *in, unsigned long groups, unsigned char *out)
+{
+    unsigned long i = 0;
+
+#if defined(EZJSON_SSSE3)
+    // Stores write 16 bytes for the 12 they produce, so the loops stop
+    // while out still has room for them
+#if defined(EZJSON_AVX2)
+    for (; groups - i >= 11; i += 8)
+    {
+        int invalid;
+        const __m256i values = base64_avx2_values(
+            _mm256_loadu_si256((const __m256i *)(in + i * 4)), &invalid);
+        if (invalid)
+        {
+            break;
+        }
+        _mm256_storeu_si256(
+            (__m256i *)(out + i * 3), base64_avx2_pack(values));
+    }
+#endif
+    for (; groups - i >= 6; i += 4)
+    {
+        int invalid;
+        const __m128i values = base64_lane_values(
+            _mm_loadu_si128((const __m128i *)(in + i * 4)), &invalid);
+        if (invalid)
+        {
+            break;
+        }
+        _mm_storeu_si128((__m128i *)(out + i * 3), base64_lane_pack(values));
+    }
+#endif
+
+    for (; i < groups; ++i)
+    {
+        const char *src  = in + i * 4;
+        const unsigned a = base64Values[(unsigned char)src[0]];
+        const unsigned b = base64Values[(unsigned char)src[1]];
+        const unsigned c = base64Values[(unsigned char)src[2]];
+        const unsigned d = base64Values[(unsigned char)src[3]];
+        if ((a | b | c | d) & BASE64_INVALID)
+        {
+            break;
+        }
+        const uint32_t bits = (a << 18) | (b << 12) | (c << 6) | d;
+        unsigned char *dst  = out + i * 3;
+        dst[0]              = (unsigned char)(bits >> 16);
+        dst[1]              = (unsigned char)(bits >> 8);
+        dst[2]              = (unsigned char)bits;
+    }
+    return i;
+}
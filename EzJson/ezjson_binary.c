@@ -0,0 +1,1369 @@
+#include "ezjson_binary.h"
+#include "ezjson_internal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////
+// Container stack, shared by the reader and the writer
+
+static void frameStackInit(struct EzJSONBinaryStack *stack)
+{
+    stack->frames   = stack->inlineFrames;
+    stack->capacity = EZJSON_BINARY_INLINE_DEPTH;
+    stack->depth    = 0;
+}
+
+static void frameStackDestroy(
+    struct EzJSONBinaryStack *stack, void *userdata, EzJSONFree dealloc)
+{
+    if (stack->frames != stack->inlineFrames)
+    {
+        const unsigned bytes =
+            stack->capacity * (unsigned)sizeof(struct EzJSONBinaryFrame);
+        if (dealloc)
+        {
+            dealloc(userdata, stack->frames, bytes);
+        }
+        else
+        {
+            free(stack->frames);
+        }
+    }
+    frameStackInit(stack);
+}
+
+// Returns the new top frame, or null if the stack could not be grown
+static struct EzJSONBinaryFrame *frameStackPush(
+    struct EzJSONBinaryStack *stack,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc)
+{
+    if (stack->depth == stack->capacity)
+    {
+        const unsigned newCapacity = stack->capacity * 2;
+        const unsigned newBytes =
+            newCapacity * (unsigned)sizeof(struct EzJSONBinaryFrame);
+        struct EzJSONBinaryFrame *newFrames =
+            alloc ? (struct EzJSONBinaryFrame *)alloc(userdata, newBytes)
+                  : (struct EzJSONBinaryFrame *)malloc(newBytes);
+        if (!newFrames)
+        {
+            return NULL;
+        }
+
+        memcpy(
+            newFrames,
+            stack->frames,
+            stack->depth * sizeof(struct EzJSONBinaryFrame));
+        const unsigned depth = stack->depth;
+        frameStackDestroy(stack, userdata, dealloc);
+        stack->frames   = newFrames;
+        stack->capacity = newCapacity;
+        stack->depth    = depth;
+    }
+
+    struct EzJSONBinaryFrame *frame = &stack->frames[stack->depth++];
+    memset(frame, 0, sizeof(*frame));
+    return frame;
+}
+
+static struct EzJSONBinaryFrame *frameStackTop(struct EzJSONBinaryStack *stack)
+{
+    return stack->depth > 0 ? &stack->frames[stack->depth - 1] : NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Writer
+
+static void flush(struct EzJSONBinaryWriter *writer)
+{
+    if (writer->bufferPos > 0)
+    {
+        writer->writeBuffer(
+            writer->settings.userdata, writer->buffer, writer->bufferPos);
+        writer->flushed += writer->bufferPos;
+        writer->bufferPos = 0;
+    }
+}
+
+// Make room for count contiguous bytes, count <= EZJSON_WRITE_BUFFER_SIZE
+static unsigned char *reserve(struct EzJSONBinaryWriter *writer, unsigned count)
+{
+    if (EZJSON_WRITE_BUFFER_SIZE - writer->bufferPos < count)
+    {
+        flush(writer);
+    }
+    return (unsigned char *)writer->buffer + writer->bufferPos;
+}
+
+static void
+put(struct EzJSONBinaryWriter *writer, const char *data, unsigned count)
+{
+    while (count > 0)
+    {
+        if (writer->bufferPos == EZJSON_WRITE_BUFFER_SIZE)
+        {
+            flush(writer);
+        }
+
+        unsigned chunk = EZJSON_WRITE_BUFFER_SIZE - writer->bufferPos;
+        if (chunk > count)
+        {
+            chunk = count;
+        }
+        memcpy(writer->buffer + writer->bufferPos, data, chunk);
+        writer->bufferPos += chunk;
+        data += chunk;
+        count -= chunk;
+    }
+}
+
+static void storeBig(unsigned char *out, uint64_t value, unsigned size)
+{
+    for (unsigned i = 0; i < size; ++i)
+    {
+        out[i] = (unsigned char)(value >> (8 * (size - 1 - i)));
+    }
+}
+
+// A type byte followed by a big endian value of size bytes
+static void putHead(
+    struct EzJSONBinaryWriter *writer,
+    unsigned type,
+    uint64_t value,
+    unsigned size)
+{
+    unsigned char *out = reserve(writer, 1 + size);
+    out[0]             = (unsigned char)type;
+    storeBig(out + 1, value, size);
+    writer->bufferPos += 1 + size;
+}
+
+// CBOR item head, the argument in the shortest form
+static void
+putCborHead(struct EzJSONBinaryWriter *writer, unsigned major, uint64_t value)
+{
+    if (value < 24)
+    {
+        putHead(writer, (major << 5) | (unsigned)value, 0, 0);
+    }
+    else if (value <= 0xFF)
+    {
+        putHead(writer, (major << 5) | 24, value, 1);
+    }
+    else if (value <= 0xFFFF)
+    {
+        putHead(writer, (major << 5) | 25, value, 2);
+    }
+    else if (value <= 0xFFFFFFFFu)
+    {
+        putHead(writer, (major << 5) | 26, value, 4);
+    }
+    else
+    {
+        putHead(writer, (major << 5) | 27, value, 8);
+    }
+}
+
+static void
+failWrite(struct EzJSONBinaryWriter *writer, enum EzJSONBinaryError error)
+{
+    if (writer->error == EZ_BE_OK)
+    {
+        writer->error = error;
+    }
+}
+
+// Count a new item in the open container. Returns non-zero if the writer
+// failed before, or a key is written where a value belongs or the reverse.
+static int beginItem(struct EzJSONBinaryWriter *writer, int isKey)
+{
+    struct EzJSONBinaryFrame *frame = frameStackTop(&writer->stack);
+
+    if (writer->error != EZ_BE_OK)
+    {
+        return -1;
+    }
+
+    if (!frame)
+    {
+        if (isKey)
+        {
+            failWrite(writer, EZ_BE_INVALID);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (isKey != (frame->object && frame->key))
+    {
+        failWrite(writer, EZ_BE_INVALID);
+        return -1;
+    }
+
+    if (frame->object)
+    {
+        frame->key = (char)!isKey;
+    }
+    if (!frame->object || isKey)
+    {
+        frame->count++;
+    }
+    return 0;
+}
+
+// The top level value is complete once nothing is open
+static void endItem(struct EzJSONBinaryWriter *writer)
+{
+    if (writer->stack.depth == 0)
+    {
+        flush(writer);
+    }
+}
+
+static void beginContainer(struct EzJSONBinaryWriter *writer, int object)
+{
+    if (beginItem(writer, 0) != 0)
+    {
+        return;
+    }
+
+    struct EzJSONBinaryFrame *frame = frameStackPush(
+        &writer->stack,
+        writer->settings.userdata,
+        writer->settings.allocate_memory,
+        writer->settings.free_memory);
+    if (!frame)
+    {
+        failWrite(writer, EZ_BE_NO_MEMORY);
+        return;
+    }
+    frame->object = (char)object;
+    frame->key    = (char)object;
+
+    if (writer->settings.format == EZJ_BINARY_CBOR)
+    {
+        putHead(writer, object ? 0xBF : 0x9F, 0, 0);
+    }
+    else
+    {
+        // map32 or array32, the count follows at the end
+        reserve(writer, 5);
+        frame->header = writer->flushed + writer->bufferPos;
+        putHead(writer, object ? 0xDF : 0xDD, 0, 4);
+    }
+}
+
+// Store the count of a MessagePack container, in the shortest header when it
+// is still buffered
+static void finishMsgPack(
+    struct EzJSONBinaryWriter *writer, const struct EzJSONBinaryFrame *frame)
+{
+    if (frame->header < writer->flushed)
+    {
+        unsigned char count[4];
+        if (!writer->patchBuffer)
+        {
+            failWrite(writer, EZ_BE_NOT_PATCHABLE);
+            return;
+        }
+        storeBig(count, frame->count, 4);
+        writer->patchBuffer(
+            writer->settings.userdata,
+            frame->header + 1,
+            (const char *)count,
+            4);
+        return;
+    }
+
+    unsigned char *head =
+        (unsigned char *)writer->buffer + (frame->header - writer->flushed);
+    unsigned size = 5;
+
+    if (frame->count < 16)
+    {
+        head[0] = (unsigned char)((frame->object ? 0x80 : 0x90) | frame->count);
+        size    = 1;
+    }
+    else if (frame->count <= 0xFFFF)
+    {
+        head[0] = frame->object ? 0xDE : 0xDC;
+        storeBig(head + 1, frame->count, 2);
+        size = 3;
+    }
+    else
+    {
+        storeBig(head + 1, frame->count, 4);
+    }
+
+    if (size < 5)
+    {
+        const unsigned char *body = head + 5;
+        const unsigned bodyLength = (unsigned)(
+            (unsigned char *)writer->buffer + writer->bufferPos - body);
+        memmove(head + size, body, bodyLength);
+        writer->bufferPos -= 5 - size;
+    }
+}
+
+static void endContainer(struct EzJSONBinaryWriter *writer, int object)
+{
+    const struct EzJSONBinaryFrame *frame = frameStackTop(&writer->stack);
+
+    if (writer->error != EZ_BE_OK)
+    {
+        return;
+    }
+    if (!frame || frame->object != object || (object && !frame->key))
+    {
+        failWrite(writer, EZ_BE_INVALID);
+        return;
+    }
+
+    writer->stack.depth--;
+    if (writer->settings.format == EZJ_BINARY_CBOR)
+    {
+        putHead(writer, 0xFF, 0, 0);
+    }
+    else
+    {
+        finishMsgPack(writer, frame);
+    }
+    endItem(writer);
+}
+
+static void putText(
+    struct EzJSONBinaryWriter *writer, const char *str, unsigned count)
+{
+    if (writer->settings.format == EZJ_BINARY_CBOR)
+    {
+        putCborHead(writer, 3, count);
+    }
+    else if (count < 32)
+    {
+        putHead(writer, 0xA0 | count, 0, 0);
+    }
+    else if (count <= 0xFF)
+    {
+        putHead(writer, 0xD9, count, 1);
+    }
+    else if (count <= 0xFFFF)
+    {
+        putHead(writer, 0xDA, count, 2);
+    }
+    else
+    {
+        putHead(writer, 0xDB, count, 4);
+    }
+    put(writer, str, count);
+}
+
+static void putUnsigned(struct EzJSONBinaryWriter *writer, uint64_t val)
+{
+    if (writer->settings.format == EZJ_BINARY_CBOR)
+    {
+        putCborHead(writer, 0, val);
+    }
+    else if (val < 128)
+    {
+        putHead(writer, (unsigned)val, 0, 0);
+    }
+    else if (val <= 0xFF)
+    {
+        putHead(writer, 0xCC, val, 1);
+    }
+    else if (val <= 0xFFFF)
+    {
+        putHead(writer, 0xCD, val, 2);
+    }
+    else if (val <= 0xFFFFFFFFu)
+    {
+        putHead(writer, 0xCE, val, 4);
+    }
+    else
+    {
+        putHead(writer, 0xCF, val, 8);
+    }
+}
+
+static void putInteger(struct EzJSONBinaryWriter *writer, int64_t val)
+{
+    if (val >= 0)
+    {
+        putUnsigned(writer, (uint64_t)val);
+    }
+    else if (writer->settings.format == EZJ_BINARY_CBOR)
+    {
+        putCborHead(writer, 1, (uint64_t)(-1 - val));
+    }
+    else if (val >= -32)
+    {
+        putHead(writer, (unsigned)(val & 0xFF), 0, 0);
+    }
+    else if (val >= INT8_MIN)
+    {
+        putHead(writer, 0xD0, (uint64_t)val & 0xFF, 1);
+    }
+    else if (val >= INT16_MIN)
+    {
+        putHead(writer, 0xD1, (uint64_t)val & 0xFFFF, 2);
+    }
+    else if (val >= INT32_MIN)
+    {
+        putHead(writer, 0xD2, (uint64_t)val & 0xFFFFFFFFu, 4);
+    }
+    else
+    {
+        putHead(writer, 0xD3, (uint64_t)val, 8);
+    }
+}
+
+void EzJSONBinaryWriterInit(struct EzJSONBinaryWriter *writer)
+{
+    writer->writeBuffer = NULL;
+    writer->patchBuffer = NULL;
+    writer->error       = EZ_BE_OK;
+    writer->bufferPos   = 0;
+    writer->flushed     = 0;
+    frameStackInit(&writer->stack);
+}
+
+void EzJSONBinaryWriterDestroy(struct EzJSONBinaryWriter *writer)
+{
+    frameStackDestroy(
+        &writer->stack,
+        writer->settings.userdata,
+        writer->settings.free_memory);
+}
+
+void EzJSONBinaryWriteObjectBegin(struct EzJSONBinaryWriter *writer)
+{
+    beginContainer(writer, 1);
+}
+
+void EzJSONBinaryWriteObjectEnd(struct EzJSONBinaryWriter *writer)
+{
+    endContainer(writer, 1);
+}
+
+void EzJSONBinaryWriteArrayBegin(struct EzJSONBinaryWriter *writer)
+{
+    beginContainer(writer, 0);
+}
+
+void EzJSONBinaryWriteArrayEnd(struct EzJSONBinaryWriter *writer)
+{
+    endContainer(writer, 0);
+}
+
+void EzJSONBinaryWriteKey(
+    struct EzJSONBinaryWriter *writer, const char *str, unsigned count)
+{
+    if (beginItem(writer, 1) == 0)
+    {
+        putText(writer, str, count);
+    }
+}
+
+void EzJSONBinaryWriteString(
+    struct EzJSONBinaryWriter *writer, const char *str, unsigned count)
+{
+    if (beginItem(writer, 0) == 0)
+    {
+        putText(writer, str, count);
+        endItem(writer);
+    }
+}
+
+void EzJSONBinaryWriteBool(struct EzJSONBinaryWriter *writer, EzJSONBool val)
+{
+    if (beginItem(writer, 0) == 0)
+    {
+        if (writer->settings.format == EZJ_BINARY_CBOR)
+        {
+            putHead(writer, val ? 0xF5 : 0xF4, 0, 0);
+        }
+        else
+        {
+            putHead(writer, val ? 0xC3 : 0xC2, 0, 0);
+        }
+        endItem(writer);
+    }
+}
+
+void EzJSONBinaryWriteNull(struct EzJSONBinaryWriter *writer)
+{
+    if (beginItem(writer, 0) == 0)
+    {
+        putHead(
+            writer,
+            writer->settings.format == EZJ_BINARY_CBOR ? 0xF6 : 0xC0,
+            0,
+            0);
+        endItem(writer);
+    }
+}
+
+void EzJSONBinaryWriteNumber(struct EzJSONBinaryWriter *writer, double val)
+{
+    // -2^63 <= val < 2^63 and integral
+    if (val >= -9223372036854775808.0 && val < 9223372036854775808.0
+        && (double)(int64_t)val == val)
+    {
+        EzJSONBinaryWriteNumberI64(writer, (int64_t)val);
+        return;
+    }
+
+    if (beginItem(writer, 0) != 0)
+    {
+        return;
+    }
+
+    const int cbor = writer->settings.format == EZJ_BINARY_CBOR;
+    const float single = (float)val;
+    if ((double)single == val || val != val)
+    {
+        uint32_t bits;
+        memcpy(&bits, &single, sizeof(bits));
+        putHead(writer, cbor ? 0xFA : 0xCA, bits, 4);
+    }
+    else
+    {
+        uint64_t bits;
+        memcpy(&bits, &val, sizeof(bits));
+        putHead(writer, cbor ? 0xFB : 0xCB, bits, 8);
+    }
+    endItem(writer);
+}
+
+void EzJSONBinaryWriteNumberI64(struct EzJSONBinaryWriter *writer, int64_t val)
+{
+    if (beginItem(writer, 0) == 0)
+    {
+        putInteger(writer, val);
+        endItem(writer);
+    }
+}
+
+void EzJSONBinaryWriteNumberU64(
+    struct EzJSONBinaryWriter *writer, uint64_t val)
+{
+    if (beginItem(writer, 0) == 0)
+    {
+        putUnsigned(writer, val);
+        endItem(writer);
+    }
+}
+
+void EzJSONBinaryWriteToken(
+    struct EzJSONBinaryWriter *writer, const struct EzJSONToken *token)
+{
+    switch (token->type)
+    {
+    case EZJ_TOKEN_OBJ_BEGIN:
+        EzJSONBinaryWriteObjectBegin(writer);
+        break;
+    case EZJ_TOKEN_OBJ_END:
+        EzJSONBinaryWriteObjectEnd(writer);
+        break;
+    case EZJ_TOKEN_ARR_BEGIN:
+        EzJSONBinaryWriteArrayBegin(writer);
+        break;
+    case EZJ_TOKEN_ARR_END:
+        EzJSONBinaryWriteArrayEnd(writer);
+        break;
+    case EZJ_TOKEN_OBJ_KEY:
+        EzJSONBinaryWriteKey(writer, token->data_text, token->data_text_length);
+        break;
+    case EZJ_TOKEN_STRING:
+        EzJSONBinaryWriteString(
+            writer, token->data_text, token->data_text_length);
+        break;
+    case EZJ_TOKEN_NUMBER:
+        EzJSONBinaryWriteNumber(writer, (double)token->data_number);
+        break;
+    case EZJ_TOKEN_BOOL:
+        EzJSONBinaryWriteBool(writer, token->data_bool);
+        break;
+    case EZJ_TOKEN_NULL:
+        EzJSONBinaryWriteNull(writer);
+        break;
+    default:
+        break;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Reader
+
+static int
+failRead(struct EzJSONBinaryReader *reader, enum EzJSONBinaryError error)
+{
+    reader->error    = error;
+    reader->hasToken = 0;
+    return -1;
+}
+
+// Grow the string buffer to hold size bytes, keeping its contents
+static int reserveBuffer(struct EzJSONBinaryReader *reader, unsigned size)
+{
+    if (size <= reader->bufferSize)
+    {
+        return 0;
+    }
+
+    unsigned newSize = reader->bufferSize;
+    while (newSize < size)
+    {
+        newSize = newSize * 2 > newSize ? newSize * 2 : size;
+    }
+
+    char *newBuffer = reader->settings.allocate_memory
+                          ? reader->settings.allocate_memory(
+                                reader->settings.userdata, newSize)
+                          : (char *)malloc(newSize);
+    if (!newBuffer)
+    {
+        return failRead(reader, EZ_BE_NO_MEMORY);
+    }
+    memcpy(newBuffer, reader->buffer, reader->bufferSize);
+
+    if (reader->buffer != reader->inlineBuffer)
+    {
+        if (reader->settings.free_memory)
+        {
+            reader->settings.free_memory(
+                reader->settings.userdata, reader->buffer, reader->bufferSize);
+        }
+        else
+        {
+            free(reader->buffer);
+        }
+    }
+
+    reader->buffer     = newBuffer;
+    reader->bufferSize = newSize;
+    return 0;
+}
+
+static int readRaw(struct EzJSONBinaryReader *reader, char *out, unsigned count)
+{
+    if (reader->settings.input)
+    {
+        if ((unsigned long)(reader->inputEnd - reader->input) < count)
+        {
+            return failRead(reader, EZ_BE_UNEXPECTED_EOF);
+        }
+        memcpy(out, reader->input, count);
+        reader->input += count;
+    }
+    else
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (reader->settings.get_next_char(
+                    reader->settings.userdata, out + i)
+                != 0)
+            {
+                return failRead(reader, EZ_BE_UNEXPECTED_EOF);
+            }
+        }
+    }
+
+    reader->offset += count;
+    return 0;
+}
+
+static int readByte(struct EzJSONBinaryReader *reader, unsigned *out)
+{
+    unsigned char byte;
+    if (readRaw(reader, (char *)&byte, 1) != 0)
+    {
+        return -1;
+    }
+    *out = byte;
+    return 0;
+}
+
+// Big endian unsigned value of size bytes
+static int
+readBig(struct EzJSONBinaryReader *reader, unsigned size, uint64_t *out)
+{
+    unsigned char bytes[8];
+    if (readRaw(reader, (char *)bytes, size) != 0)
+    {
+        return -1;
+    }
+
+    *out = 0;
+    for (unsigned i = 0; i < size; ++i)
+    {
+        *out = (*out << 8) | bytes[i];
+    }
+    return 0;
+}
+
+// Read length bytes of text into the token. From memory the token points
+// into the input, otherwise into the buffer.
+static int readText(struct EzJSONBinaryReader *reader, uint64_t length)
+{
+    if (length > 0xFFFFFFFFu)
+    {
+        return failRead(reader, EZ_BE_NO_MEMORY);
+    }
+
+    if (reader->settings.input)
+    {
+        if ((uint64_t)(reader->inputEnd - reader->input) < length)
+        {
+            return failRead(reader, EZ_BE_UNEXPECTED_EOF);
+        }
+        reader->token.data_text = reader->input;
+        reader->input += length;
+        reader->offset += length;
+    }
+    else
+    {
+        if (reserveBuffer(reader, (unsigned)length) != 0
+            || readRaw(reader, reader->buffer, (unsigned)length) != 0)
+        {
+            return -1;
+        }
+        reader->token.data_text = reader->buffer;
+    }
+
+    reader->token.data_text_length = (unsigned)length;
+    return 0;
+}
+
+static void setInteger(struct EzJSONBinaryReader *reader, int64_t value)
+{
+    reader->token.type        = EZJ_TOKEN_NUMBER;
+    reader->token.data_number = (EzJSONNumber)value;
+    reader->number            = (double)value;
+    reader->integer           = value;
+    reader->isInteger         = 1;
+}
+
+static void setReal(struct EzJSONBinaryReader *reader, double value)
+{
+    reader->token.type        = EZJ_TOKEN_NUMBER;
+    reader->token.data_number = (EzJSONNumber)value;
+    reader->number            = value;
+    reader->isInteger         = 0;
+}
+
+static void setUnsigned(struct EzJSONBinaryReader *reader, uint64_t value)
+{
+    if (value <= (uint64_t)INT64_MAX)
+    {
+        setInteger(reader, (int64_t)value);
+    }
+    else
+    {
+        setReal(reader, (double)value);
+    }
+}
+
+static void
+setFloat(struct EzJSONBinaryReader *reader, uint64_t bits, unsigned size)
+{
+    if (size == 4)
+    {
+        const uint32_t bits32 = (uint32_t)bits;
+        float value;
+        memcpy(&value, &bits32, sizeof(value));
+        setReal(reader, value);
+    }
+    else
+    {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        setReal(reader, value);
+    }
+}
+
+static int beginFrame(
+    struct EzJSONBinaryReader *reader,
+    int object,
+    uint64_t count,
+    int indefinite)
+{
+    if (reader->settings.max_depth != 0
+        && reader->stack.depth == reader->settings.max_depth)
+    {
+        return failRead(reader, EZ_BE_DEPTH_EXCEEDED);
+    }
+    if (object && count > UINT64_MAX / 2)
+    {
+        return failRead(reader, EZ_BE_INVALID);
+    }
+
+    struct EzJSONBinaryFrame *frame = frameStackPush(
+        &reader->stack,
+        reader->settings.userdata,
+        reader->settings.allocate_memory,
+        reader->settings.free_memory);
+    if (!frame)
+    {
+        return failRead(reader, EZ_BE_NO_MEMORY);
+    }
+
+    frame->object     = (char)object;
+    frame->key        = (char)object;
+    frame->indefinite = (char)indefinite;
+    frame->remaining  = object ? count * 2 : count;
+
+    reader->token.type = object ? EZJ_TOKEN_OBJ_BEGIN : EZJ_TOKEN_ARR_BEGIN;
+    return 0;
+}
+
+static int readMsgPack(struct EzJSONBinaryReader *reader, unsigned initial)
+{
+    uint64_t value;
+
+    if (initial < 0x80)
+    {
+        setInteger(reader, initial);
+        return 0;
+    }
+    if (initial >= 0xE0)
+    {
+        setInteger(reader, (int64_t)initial - 0x100);
+        return 0;
+    }
+    if (initial < 0x90)
+    {
+        return beginFrame(reader, 1, initial & 0x0F, 0);
+    }
+    if (initial < 0xA0)
+    {
+        return beginFrame(reader, 0, initial & 0x0F, 0);
+    }
+    if (initial < 0xC0)
+    {
+        reader->token.type = EZJ_TOKEN_STRING;
+        return readText(reader, initial & 0x1F);
+    }
+
+    switch (initial)
+    {
+    case 0xC0:
+        reader->token.type = EZJ_TOKEN_NULL;
+        return 0;
+    case 0xC2:
+    case 0xC3:
+        reader->token.type      = EZJ_TOKEN_BOOL;
+        reader->token.data_bool = initial == 0xC3;
+        return 0;
+
+    case 0xCA:
+    case 0xCB:
+    {
+        const unsigned size = initial == 0xCA ? 4 : 8;
+        if (readBig(reader, size, &value) != 0)
+        {
+            return -1;
+        }
+        setFloat(reader, value, size);
+        return 0;
+    }
+
+    case 0xCC:
+    case 0xCD:
+    case 0xCE:
+    case 0xCF:
+        if (readBig(reader, 1u << (initial - 0xCC), &value) != 0)
+        {
+            return -1;
+        }
+        setUnsigned(reader, value);
+        return 0;
+
+    case 0xD0:
+    case 0xD1:
+    case 0xD2:
+    case 0xD3:
+    {
+        const unsigned size = 1u << (initial - 0xD0);
+        if (readBig(reader, size, &value) != 0)
+        {
+            return -1;
+        }
+        // Sign extend
+        const unsigned shift = 64 - 8 * size;
+        setInteger(reader, (int64_t)(value << shift) >> shift);
+        return 0;
+    }
+
+    case 0xD9:
+    case 0xDA:
+    case 0xDB:
+        if (readBig(reader, 1u << (initial - 0xD9), &value) != 0)
+        {
+            return -1;
+        }
+        reader->token.type = EZJ_TOKEN_STRING;
+        return readText(reader, value);
+
+    case 0xDC:
+    case 0xDD:
+    case 0xDE:
+    case 0xDF:
+        if (readBig(reader, (initial & 1) ? 4 : 2, &value) != 0)
+        {
+            return -1;
+        }
+        return beginFrame(reader, initial >= 0xDE, value, 0);
+
+    case 0xC1:
+        return failRead(reader, EZ_BE_INVALID);
+
+    default:
+        // Binary and extension types
+        return failRead(reader, EZ_BE_UNSUPPORTED);
+    }
+}
+
+static double halfToDouble(unsigned half)
+{
+    const unsigned exponent = (half >> 10) & 0x1F;
+    const unsigned mantissa = half & 0x3FF;
+    double value;
+
+    if (exponent == 0)
+    {
+        value = ldexp(mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        value = ldexp(mantissa + 1024, (int)exponent - 25);
+    }
+    else
+    {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+// CBOR text string of indefinite length, chunks up to a break joined in the
+// buffer
+static int readCborChunks(struct EzJSONBinaryReader *reader)
+{
+    unsigned at = 0;
+    unsigned initial;
+    uint64_t length;
+
+    reader->token.type             = EZJ_TOKEN_STRING;
+    reader->token.data_text        = reader->buffer;
+    reader->token.data_text_length = 0;
+    for (;;)
+    {
+        if (readByte(reader, &initial) != 0)
+        {
+            return -1;
+        }
+        if (initial == 0xFF)
+        {
+            return 0;
+        }
+        if ((initial >> 5) != 3 || (initial & 0x1F) > 27)
+        {
+            return failRead(reader, EZ_BE_INVALID);
+        }
+
+        length = initial & 0x1F;
+        if (length > 23 && readBig(reader, 1u << (length - 24), &length) != 0)
+        {
+            return -1;
+        }
+        if (length > 0xFFFFFFFFu - at)
+        {
+            return failRead(reader, EZ_BE_NO_MEMORY);
+        }
+        if (reserveBuffer(reader, at + (unsigned)length) != 0
+            || readRaw(reader, reader->buffer + at, (unsigned)length) != 0)
+        {
+            return -1;
+        }
+        at += (unsigned)length;
+        reader->token.data_text        = reader->buffer;
+        reader->token.data_text_length = at;
+    }
+}
+
+static int readCbor(struct EzJSONBinaryReader *reader, unsigned initial)
+{
+    for (;;)
+    {
+        const unsigned major = initial >> 5;
+        const unsigned info  = initial & 0x1F;
+        uint64_t argument    = info;
+
+        if (info >= 28 && (info != 31 || major < 2 || major >= 6))
+        {
+            // Reserved, or a break where an item belongs
+            return failRead(reader, EZ_BE_INVALID);
+        }
+        if (info >= 24 && info <= 27 && major != 7
+            && readBig(reader, 1u << (info - 24), &argument) != 0)
+        {
+            return -1;
+        }
+
+        switch (major)
+        {
+        case 0:
+            setUnsigned(reader, argument);
+            return 0;
+
+        case 1:
+            if (argument <= (uint64_t)INT64_MAX)
+            {
+                setInteger(reader, -1 - (int64_t)argument);
+            }
+            else
+            {
+                setReal(reader, -1.0 - (double)argument);
+            }
+            return 0;
+
+        case 2:
+            return failRead(reader, EZ_BE_UNSUPPORTED);
+
+        case 3:
+            if (info == 31)
+            {
+                return readCborChunks(reader);
+            }
+            reader->token.type = EZJ_TOKEN_STRING;
+            return readText(reader, argument);
+
+        case 4:
+        case 5:
+            return beginFrame(reader, major == 5, argument, info == 31);
+
+        case 6:
+            // Tags carry no meaning in JSON, read the tagged item
+            if (readByte(reader, &initial) != 0)
+            {
+                return -1;
+            }
+            continue;
+
+        default:
+            break;
+        }
+
+        // Major type 7: simple values and floats
+        switch (info)
+        {
+        case 20:
+        case 21:
+            reader->token.type      = EZJ_TOKEN_BOOL;
+            reader->token.data_bool = info == 21;
+            return 0;
+        case 22:
+        case 23:
+            reader->token.type = EZJ_TOKEN_NULL;
+            return 0;
+        case 25:
+            if (readBig(reader, 2, &argument) != 0)
+            {
+                return -1;
+            }
+            setReal(reader, halfToDouble((unsigned)argument));
+            return 0;
+        case 26:
+        case 27:
+        {
+            const unsigned size = info == 26 ? 4 : 8;
+            if (readBig(reader, size, &argument) != 0)
+            {
+                return -1;
+            }
+            setFloat(reader, argument, size);
+            return 0;
+        }
+        default:
+            return failRead(reader, EZ_BE_UNSUPPORTED);
+        }
+    }
+}
+
+static void endFrame(struct EzJSONBinaryReader *reader)
+{
+    const struct EzJSONBinaryFrame *frame = frameStackTop(&reader->stack);
+
+    reader->token.type = frame->object ? EZJ_TOKEN_OBJ_END : EZJ_TOKEN_ARR_END;
+    reader->hasToken   = 1;
+    reader->stack.depth--;
+    reader->done = reader->stack.depth == 0;
+}
+
+// Keys must be strings, integers are converted to their decimal text
+static int readKey(struct EzJSONBinaryReader *reader)
+{
+    if (reader->token.type == EZJ_TOKEN_NUMBER)
+    {
+        if (!reader->isInteger)
+        {
+            return failRead(reader, EZ_BE_UNSUPPORTED);
+        }
+        reader->token.data_text        = reader->buffer;
+        reader->token.data_text_length = (unsigned)snprintf(
+            reader->buffer,
+            reader->bufferSize,
+            "%lld",
+            (long long)reader->integer);
+    }
+    else if (reader->token.type != EZJ_TOKEN_STRING)
+    {
+        return failRead(reader, EZ_BE_UNSUPPORTED);
+    }
+
+    reader->token.type          = EZJ_TOKEN_OBJ_KEY;
+    reader->token.data_key_hash = key_hash(
+        KEY_HASH_SEED,
+        reader->token.data_text,
+        reader->token.data_text_length);
+    return 0;
+}
+
+void EzJSONBinaryReaderInit(struct EzJSONBinaryReader *reader)
+{
+    reader->input      = reader->settings.input;
+    reader->inputEnd   = NULL;
+    reader->buffer     = reader->inlineBuffer;
+    reader->bufferSize = EZJSON_PARSER_INLINE_BUFFER;
+    reader->hasToken   = 0;
+    reader->done       = 0;
+    reader->number     = 0;
+    reader->integer    = 0;
+    reader->isInteger  = 0;
+    reader->error      = EZ_BE_OK;
+    reader->offset     = 0;
+    frameStackInit(&reader->stack);
+
+    if (reader->settings.input)
+    {
+        reader->inputEnd =
+            reader->settings.input + reader->settings.input_length;
+    }
+}
+
+void EzJSONBinaryReaderDestroy(struct EzJSONBinaryReader *reader)
+{
+    if (reader->buffer != reader->inlineBuffer)
+    {
+        if (reader->settings.free_memory)
+        {
+            reader->settings.free_memory(
+                reader->settings.userdata, reader->buffer, reader->bufferSize);
+        }
+        else
+        {
+            free(reader->buffer);
+        }
+        reader->buffer     = reader->inlineBuffer;
+        reader->bufferSize = EZJSON_PARSER_INLINE_BUFFER;
+    }
+    frameStackDestroy(
+        &reader->stack,
+        reader->settings.userdata,
+        reader->settings.free_memory);
+}
+
+void EzJSONBinaryReaderNext(struct EzJSONBinaryReader *reader)
+{
+    struct EzJSONBinaryFrame *frame = frameStackTop(&reader->stack);
+    unsigned initial;
+    int isKey = 0;
+
+    reader->hasToken = 0;
+    if (reader->error != EZ_BE_OK || reader->done)
+    {
+        return;
+    }
+
+    if (frame && !frame->indefinite && frame->remaining == 0)
+    {
+        endFrame(reader);
+        return;
+    }
+
+    if (readByte(reader, &initial) != 0)
+    {
+        return;
+    }
+
+    if (frame)
+    {
+        if (frame->indefinite && initial == 0xFF)
+        {
+            if (frame->object && !frame->key)
+            {
+                failRead(reader, EZ_BE_INVALID); // Key without a value
+                return;
+            }
+            endFrame(reader);
+            return;
+        }
+
+        isKey = frame->object && frame->key;
+        if (frame->object)
+        {
+            frame->key = (char)!isKey;
+        }
+        if (!frame->indefinite)
+        {
+            frame->remaining--;
+        }
+    }
+
+    const int result = reader->settings.format == EZJ_BINARY_CBOR
+                           ? readCbor(reader, initial)
+                           : readMsgPack(reader, initial);
+    if (result != 0 || (isKey && readKey(reader) != 0))
+    {
+        return;
+    }
+
+    reader->hasToken = 1;
+    reader->done     = reader->stack.depth == 0;
+}
+
+struct EzJSONToken *EzJSONBinaryReaderToken(struct EzJSONBinaryReader *reader)
+{
+    return reader->hasToken ? &reader->token : NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Transcoding
+
+int EzJSONToBinary(
+    struct EzJSONParser *parser, struct EzJSONBinaryWriter *writer)
+{
+    const struct EzJSONToken *token;
+    int64_t integer;
+    uint64_t large;
+    double real;
+
+    while (EzJSONParserNext(parser), token = EzJSONParserToken(parser))
+    {
+        if (token->type != EZJ_TOKEN_NUMBER)
+        {
+            EzJSONBinaryWriteToken(writer, token);
+        }
+        else if (EzJSONParserNumberI64(parser, &integer) == 0)
+        {
+            EzJSONBinaryWriteNumberI64(writer, integer);
+        }
+        else if (EzJSONParserNumberU64(parser, &large) == 0)
+        {
+            EzJSONBinaryWriteNumberU64(writer, large);
+        }
+        else
+        {
+            EzJSONParserNumberDouble(parser, &real);
+            EzJSONBinaryWriteNumber(writer, real);
+        }
+
+        if (writer->error != EZ_BE_OK)
+        {
+            return -1;
+        }
+    }
+
+    return EzJSONParserHasError(parser) ? -1 : 0;
+}
+
+int EzJSONFromBinary(
+    struct EzJSONBinaryReader *reader, struct EzJSONWriter *writer)
+{
+    const struct EzJSONToken *token;
+
+    while (EzJSONBinaryReaderNext(reader),
+           token = EzJSONBinaryReaderToken(reader))
+    {
+        switch (token->type)
+        {
+        case EZJ_TOKEN_OBJ_BEGIN:
+            EzJSONWriteObjectBegin(writer);
+            break;
+        case EZJ_TOKEN_OBJ_END:
+            EzJSONWriteObjectEnd(writer);
+            break;
+        case EZJ_TOKEN_ARR_BEGIN:
+            EzJSONWriteArrayBegin(writer);
+            break;
+        case EZJ_TOKEN_ARR_END:
+            EzJSONWriteArrayEnd(writer);
+            break;
+        case EZJ_TOKEN_OBJ_KEY:
+            EzJSONWriteEscapedKey(
+                writer, token->data_text, token->data_text_length);
+            break;
+        case EZJ_TOKEN_STRING:
+            EzJSONWriteEscapedString(
+                writer, token->data_text, token->data_text_length);
+            break;
+        case EZJ_TOKEN_NUMBER:
+            if (reader->isInteger)
+            {
+                EzJSONWriteNumberI64(writer, reader->integer);
+            }
+            else if (isfinite(reader->number))
+            {
+                EzJSONWriteNumberD(writer, reader->number);
+            }
+            else
+            {
+                EzJSONWriteNull(writer);
+            }
+            break;
+        case EZJ_TOKEN_BOOL:
+            EzJSONWriteBool(writer, token->data_bool);
+            break;
+        case EZJ_TOKEN_NULL:
+            EzJSONWriteNull(writer);
+            break;
+        default:
+            break;
+        }
+
+        if (writer->error != EZ_WE_OK)
+        {
+            return -1;
+        }
+    }
+
+    return reader->error != EZ_BE_OK ? -1 : 0;
+}
+
+const char *EzJSONBinaryErrorName(enum EzJSONBinaryError error)
+{
+    switch (error)
+    {
+    case EZ_BE_OK:
+        return "no error";
+    case EZ_BE_UNEXPECTED_EOF:
+        return "unexpected end of input";
+    case EZ_BE_INVALID:
+        return "malformed input";
+    case EZ_BE_UNSUPPORTED:
+        return "value has no JSON equivalent";
+    case EZ_BE_DEPTH_EXCEEDED:
+        return "maximum depth exceeded";
+    case EZ_BE_NO_MEMORY:
+        return "out of memory";
+    case EZ_BE_NOT_PATCHABLE:
+        return "container count cannot be updated";
+    default:
+        return "";
+    }
+}
@@ -0,0 +1,195 @@
+#ifndef __EZJSON_BINARY_H_INCLUDED__
+#define __EZJSON_BINARY_H_INCLUDED__
+
+#include "ezjson_common.h"
+#include "ezjson_parser.h"
+#include "ezjson_writer.h"
+
+// Inline container stack depth of the binary reader and writer
+#ifndef EZJSON_BINARY_INLINE_DEPTH
+#define EZJSON_BINARY_INLINE_DEPTH 16
+#endif // !EZJSON_BINARY_INLINE_DEPTH
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    // MessagePack and CBOR, read as a stream of EzJSONTokens and written
+    // from one, so JSON can be converted in either direction in one pass
+    // with memory bounded by the nesting depth.
+    //
+    // Only the JSON data model is supported. Byte strings, MessagePack
+    // extensions and CBOR simple values other than false, true, null and
+    // undefined (read as null) are rejected. CBOR tags are ignored. Integer
+    // map keys are read as their decimal text.
+
+    enum EzJSONBinaryFormat
+    {
+        EZJ_BINARY_MSGPACK,
+        EZJ_BINARY_CBOR,
+    };
+
+    enum EzJSONBinaryError
+    {
+        EZ_BE_OK,
+        EZ_BE_UNEXPECTED_EOF, // Input ended inside a value
+        EZ_BE_INVALID,        // Reserved or malformed byte. Writer: end of a
+                              // container that is not open, or a key outside
+                              // of an object.
+        EZ_BE_UNSUPPORTED,    // Value without a JSON equivalent
+        EZ_BE_DEPTH_EXCEEDED, // Nesting deeper than settings.max_depth
+        EZ_BE_NO_MEMORY,
+        EZ_BE_NOT_PATCHABLE, // MessagePack writer: a container count had to
+                             // be updated after its header was flushed, and
+                             // patchBuffer is not set
+    };
+
+    // An open container. The writer uses header and count for MessagePack,
+    // the reader remaining and indefinite.
+    struct EzJSONBinaryFrame
+    {
+        uint64_t remaining;   // Reader: items left, keys and values apart
+        unsigned long header; // Writer: offset of the container header
+        uint32_t count;       // Writer: elements or members so far
+        char object;          // Map rather than array
+        char key;             // Object only, the next item is a key
+        char indefinite;      // Reader, CBOR: ends with a break byte
+    };
+
+    struct EzJSONBinaryStack
+    {
+        struct EzJSONBinaryFrame inlineFrames[EZJSON_BINARY_INLINE_DEPTH];
+        struct EzJSONBinaryFrame *frames;
+        unsigned capacity;
+        unsigned depth;
+    };
+
+    struct EzJSONBinaryReaderSettings
+    {
+        void *userdata; // Optional, passed to all callbacks
+        enum EzJSONBinaryFormat format;
+        EzJSONGetChar get_next_char; // Mandatory unless input is set
+        const char *input;           // Optional, read this buffer instead of
+                                     // calling get_next_char. Strings then
+                                     // point into it. Must outlive the reader
+        unsigned long input_length;  // Size of input in bytes
+        EzJSONAlloc allocate_memory; // Optional, uses malloc() if not set
+        EzJSONFree free_memory;      // Optional, uses free() if not set
+        unsigned max_depth;          // Optional, 0 for unlimited
+    };
+
+    struct EzJSONBinaryReader
+    {
+        struct EzJSONBinaryReaderSettings settings;
+
+        const char *input; // Unread part of settings.input
+        const char *inputEnd;
+
+        char inlineBuffer[EZJSON_PARSER_INLINE_BUFFER];
+        char *buffer; // Strings read through get_next_char
+        unsigned bufferSize;
+
+        struct EzJSONBinaryStack stack;
+
+        struct EzJSONToken token;
+        char hasToken;
+        char done;
+
+        // Full precision value of the current EZJ_TOKEN_NUMBER token
+        double number;
+        int64_t integer; // Set when isInteger
+        char isInteger;
+
+        enum EzJSONBinaryError error;
+        unsigned long offset; // Bytes consumed so far
+    };
+
+    struct EzJSONBinaryWriterSettings
+    {
+        void *userdata;
+        enum EzJSONBinaryFormat format;
+        EzJSONAlloc allocate_memory; // Optional, uses malloc() if not set
+        EzJSONFree free_memory;      // Optional, uses free() if not set
+    };
+
+    struct EzJSONBinaryWriter
+    {
+        struct EzJSONBinaryWriterSettings settings;
+
+        void (*writeBuffer)(void *, const char *, unsigned);
+
+        // MessagePack only. Containers start with a 32-bit count that is
+        // filled in when they end, and shrunk to the shortest form if the
+        // header is still buffered. Otherwise the count is written through
+        // patchBuffer(userdata, offset, data, count), offset counting from
+        // the first byte ever written.
+        void (*patchBuffer)(void *, unsigned long, const char *, unsigned);
+
+        enum EzJSONBinaryError error;
+
+        char buffer[EZJSON_WRITE_BUFFER_SIZE];
+        unsigned bufferPos;
+        unsigned long flushed; // Bytes passed to writeBuffer so far
+
+        struct EzJSONBinaryStack stack;
+    };
+
+    /// Initialize a reader. settings must be set before calling.
+    void EzJSONBinaryReaderInit(struct EzJSONBinaryReader *);
+    void EzJSONBinaryReaderDestroy(struct EzJSONBinaryReader *);
+
+    /// Step to the next token, as EzJSONParserNext with
+    /// EZJ_PARSE_SKIP_SEPARATORS. Reads one top level value.
+    void EzJSONBinaryReaderNext(struct EzJSONBinaryReader *);
+
+    /// The current token, null on error, at the end, or before the first call
+    /// to EzJSONBinaryReaderNext
+    struct EzJSONToken *EzJSONBinaryReaderToken(struct EzJSONBinaryReader *);
+
+    /// Initialize a writer. settings must be set before calling, writeBuffer
+    /// and patchBuffer after. Output is flushed when the top level value is
+    /// complete, and whenever the buffer fills.
+    void EzJSONBinaryWriterInit(struct EzJSONBinaryWriter *);
+    void EzJSONBinaryWriterDestroy(struct EzJSONBinaryWriter *);
+
+    void EzJSONBinaryWriteObjectBegin(struct EzJSONBinaryWriter *);
+    void EzJSONBinaryWriteObjectEnd(struct EzJSONBinaryWriter *);
+    void EzJSONBinaryWriteArrayBegin(struct EzJSONBinaryWriter *);
+    void EzJSONBinaryWriteArrayEnd(struct EzJSONBinaryWriter *);
+    void EzJSONBinaryWriteKey(
+        struct EzJSONBinaryWriter *, const char *str, unsigned count);
+    void EzJSONBinaryWriteString(
+        struct EzJSONBinaryWriter *, const char *str, unsigned count);
+    void EzJSONBinaryWriteBool(struct EzJSONBinaryWriter *, EzJSONBool val);
+    void EzJSONBinaryWriteNull(struct EzJSONBinaryWriter *);
+
+    /// Integral values are written as integers, others as 32-bit floats when
+    /// that is exact and as 64-bit floats otherwise
+    void EzJSONBinaryWriteNumber(struct EzJSONBinaryWriter *, double val);
+    void EzJSONBinaryWriteNumberI64(struct EzJSONBinaryWriter *, int64_t val);
+    void EzJSONBinaryWriteNumberU64(struct EzJSONBinaryWriter *, uint64_t val);
+
+    /// Write a parser or reader token. Separators are ignored.
+    void EzJSONBinaryWriteToken(
+        struct EzJSONBinaryWriter *, const struct EzJSONToken *);
+
+    /// Convert the JSON document read by parser. Numbers keep the precision of
+    /// the input rather than that of EzJSONNumber. Returns 0 on success and
+    /// -1 on a parse error (see EzJSONParserError) or a write error
+    /// (writer->error).
+    int EzJSONToBinary(struct EzJSONParser *, struct EzJSONBinaryWriter *);
+
+    /// Convert the value read by reader to JSON. Strings are escaped, NaN and
+    /// infinities become null. Returns 0 on success and -1 on a read error
+    /// (reader->error) or, in checked mode, a write error (writer->error).
+    int EzJSONFromBinary(struct EzJSONBinaryReader *, struct EzJSONWriter *);
+
+    /// Human readable description of an error
+    const char *EzJSONBinaryErrorName(enum EzJSONBinaryError);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //!__EZJSON_BINARY_H_INCLUDED__
@@ -0,0 +1,873 @@
+#include "ezjson_canonical.h"
+#include "ezjson_internal.h"
+#include "ezjson_writer.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+#define ARENA_INITIAL_SIZE 4096u
+#define STACK_INITIAL_SIZE 16u
+
+// Space for one formatted number
+#define NUMBER_SPACE 32u
+
+// A member of an open object. Offsets are into the arena, which holds the
+// decoded key followed by the member's canonical text, "key":value.
+struct Member
+{
+    unsigned long key;
+    unsigned keyLength;
+    unsigned long start;
+    unsigned long end;
+};
+
+struct Level
+{
+    unsigned long start; // Arena length when the container opened
+    unsigned members;    // Index of the first member, objects only
+    char object;
+    char first; // No element written yet, arrays only
+};
+
+struct Canonical
+{
+    struct EzJSONParser *parser;
+    void (*writeBuffer)(void *, const char *, unsigned);
+    void *userdata;
+
+    char buffer[EZJSON_WRITE_BUFFER_SIZE];
+    unsigned bufferPos;
+
+    // Text of everything inside an open object
+    char *arena;
+    unsigned long arenaLength;
+    unsigned long arenaCapacity;
+    unsigned objects; // Open objects. Output goes to the arena while set.
+
+    struct Level *levels;
+    unsigned levelCount;
+    unsigned levelCapacity;
+
+    struct Member *members;
+    unsigned memberCount;
+    unsigned memberCapacity;
+
+    enum EzJSONCanonicalError error;
+};
+
+static void *allocate(struct Canonical *c, unsigned long size)
+{
+    const struct EzJSONParserSettings *settings = &c->parser->settings;
+    if (size > UINT_MAX)
+    {
+        return NULL;
+    }
+    if (settings->allocate_memory)
+    {
+        return settings->allocate_memory(settings->userdata, (unsigned)size);
+    }
+    return malloc(size);
+}
+
+static void release(struct Canonical *c, void *ptr, unsigned long size)
+{
+    const struct EzJSONParserSettings *settings = &c->parser->settings;
+    if (!ptr)
+    {
+        return;
+    }
+    if (settings->free_memory)
+    {
+        settings->free_memory(settings->userdata, ptr, (unsigned)size);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+// Grow an array of size bytes per element to hold at least count elements.
+// Returns -1 and sets the error if memory ran out.
+static int reserve(
+    struct Canonical *c,
+    void **array,
+    unsigned long *capacity,
+    unsigned long count,
+    unsigned long size,
+    unsigned long initial)
+{
+    if (count <= *capacity)
+    {
+        return 0;
+    }
+
+    unsigned long grown = *capacity ? *capacity : initial;
+    while (grown < count)
+    {
+        grown *= 2u;
+    }
+
+    void *bigger = allocate(c, grown * size);
+    if (!bigger)
+    {
+        c->error = EZ_CN_NO_MEMORY;
+        return -1;
+    }
+    if (*array)
+    {
+        memcpy(bigger, *array, *capacity * size);
+        release(c, *array, *capacity * size);
+    }
+    *array    = bigger;
+    *capacity = grown;
+    return 0;
+}
+
+static int reserveArena(struct Canonical *c, unsigned long extra)
+{
+    return reserve(
+        c,
+        (void **)&c->arena,
+        &c->arenaCapacity,
+        c->arenaLength + extra,
+        1u,
+        ARENA_INITIAL_SIZE);
+}
+
+static int reserveStack(
+    struct Canonical *c,
+    void **array,
+    unsigned *capacity,
+    unsigned count,
+    unsigned long size)
+{
+    unsigned long wide = *capacity;
+    if (reserve(c, array, &wide, count, size, STACK_INITIAL_SIZE) != 0)
+    {
+        return -1;
+    }
+    *capacity = (unsigned)wide;
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Output
+
+static void flushOutput(struct Canonical *c)
+{
+    if (c->bufferPos > 0)
+    {
+        c->writeBuffer(c->userdata, c->buffer, c->bufferPos);
+        c->bufferPos = 0;
+    }
+}
+
+static void
+writeOutput(struct Canonical *c, const char *data, unsigned long count)
+{
+    if (count > EZJSON_WRITE_BUFFER_SIZE - c->bufferPos)
+    {
+        flushOutput(c);
+    }
+    if (count > EZJSON_WRITE_BUFFER_SIZE)
+    {
+        while (count > 0)
+        {
+            const unsigned chunk = count > 0x40000000ul ? 0x40000000u
+                                                        : (unsigned)count;
+            c->writeBuffer(c->userdata, data, chunk);
+            data += chunk;
+            count -= chunk;
+        }
+        return;
+    }
+
+    memcpy(c->buffer + c->bufferPos, data, count);
+    c->bufferPos += (unsigned)count;
+}
+
+// Append to the arena inside objects, otherwise to the output
+static void put(struct Canonical *c, const char *data, unsigned long count)
+{
+    if (c->objects == 0)
+    {
+        writeOutput(c, data, count);
+        return;
+    }
+
+    if (reserveArena(c, count) != 0)
+    {
+        return;
+    }
+    memcpy(c->arena + c->arenaLength, data, count);
+    c->arenaLength += count;
+}
+
+static void putEscaped(struct Canonical *c, const char *str, unsigned count)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *end         = str + count;
+
+    put(c, "\"", 1u);
+    for (;;)
+    {
+        const char *stop = scan_string(str, end);
+        put(c, str, (unsigned long)(stop - str));
+        if (stop == end)
+        {
+            break;
+        }
+
+        switch (*stop)
+        {
+        case '"':
+            put(c, "\\\"", 2u);
+            break;
+        case '\\':
+            put(c, "\\\\", 2u);
+            break;
+        case '\n':
+            put(c, "\\n", 2u);
+            break;
+        case '\r':
+            put(c, "\\r", 2u);
+            break;
+        case '\t':
+            put(c, "\\t", 2u);
+            break;
+        case '\b':
+            put(c, "\\b", 2u);
+            break;
+        case '\f':
+            put(c, "\\f", 2u);
+            break;
+        default:
+        {
+            const unsigned char ch = (unsigned char)*stop;
+            const char escape[6]   = {
+                '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF]};
+            put(c, escape, 6u);
+            break;
+        }
+        }
+        str = stop + 1;
+    }
+    put(c, "\"", 1u);
+}
+
+static unsigned formatInt64(char *out, int64_t value)
+{
+    char digits[20];
+    unsigned count     = 0;
+    unsigned length    = 0;
+    uint64_t magnitude = value < 0 ? 0u - (uint64_t)value : (uint64_t)value;
+
+    do
+    {
+        digits[count++] = (char)('0' + magnitude % 10u);
+        magnitude /= 10u;
+    } while (magnitude > 0);
+
+    if (value < 0)
+    {
+        out[length++] = '-';
+    }
+    while (count > 0)
+    {
+        out[length++] = digits[--count];
+    }
+    return length;
+}
+
+// Fewest digits that read back the same value. Below 15 digits %.15g already
+// drops the trailing zeros. Leading zeros of the exponent are dropped.
+static unsigned formatDouble(char *out, double value)
+{
+    int length = 0;
+    for (int precision = 15; precision <= 17; ++precision)
+    {
+        length = snprintf(out, NUMBER_SPACE, "%.*g", precision, value);
+        if (strtod(out, NULL) == value)
+        {
+            break;
+        }
+    }
+
+    char *exponent = strchr(out, 'e');
+    if (exponent)
+    {
+        char *digits = exponent + 2; // After the sign
+        char *first  = digits;
+        while (*first == '0' && first[1] != '\0')
+        {
+            first++;
+        }
+        memmove(digits, first, strlen(first) + 1);
+        length = (int)strlen(out);
+    }
+    return (unsigned)length;
+}
+
+// A decimal without exponent and with at most 15 significant digits is
+// already the shortest text for its value once trailing zeros are dropped,
+// and matches what formatDouble writes unless that uses an exponent.
+// Returns the length of that prefix of text, or 0 if the number must be
+// converted.
+static unsigned plainDecimal(const char *text, unsigned length)
+{
+    const char *end   = text + length;
+    const char *point = memchr(text, '.', length);
+    const char *p     = text + (*text == '-');
+    unsigned long significant;
+
+    if (!point || memchr(text, 'e', length) || memchr(text, 'E', length))
+    {
+        return 0;
+    }
+    while (end[-1] == '0')
+    {
+        end--;
+    }
+    if (end - 1 == point)
+    {
+        return 0; // Integral
+    }
+
+    if (*p == '0')
+    {
+        // %g switches to an exponent below 1e-4
+        for (p = point + 1; *p == '0'; ++p)
+        {
+        }
+        if (p - point > 4)
+        {
+            return 0;
+        }
+        significant = (unsigned long)(end - p);
+    }
+    else
+    {
+        significant = (unsigned long)(end - p) - 1u;
+    }
+    return significant <= 15u ? (unsigned)(end - text) : 0u;
+}
+
+// The value of a number as an int64, dropping zero fraction digits and
+// scaling by a positive exponent. Returns zero if it is not an integer or
+// does not fit.
+static int integerValue(struct NumberParts parts, int64_t *out)
+{
+    if (parts.truncated)
+    {
+        return 0; // The dropped digits are unknown
+    }
+    if (parts.mantissa == 0)
+    {
+        parts.exponent = 0;
+    }
+    while (parts.exponent < 0 && parts.mantissa % 10u == 0)
+    {
+        parts.mantissa /= 10u;
+        parts.exponent++;
+    }
+    if (parts.exponent < 0)
+    {
+        return 0;
+    }
+    for (; parts.exponent > 0; parts.exponent--)
+    {
+        if (parts.mantissa > UINT64_MAX / 10u)
+        {
+            return 0;
+        }
+        parts.mantissa *= 10u;
+    }
+
+    parts.integer = 1;
+    return number_to_int64(&parts, out);
+}
+
+// Integers are written as integers whatever their spelling, 1.0 and 1e2 as
+// 1 and 100, and -0 as 0
+static int putNumber(struct Canonical *c)
+{
+    char text[NUMBER_SPACE];
+    struct NumberParts parts;
+    int64_t integer;
+    double value;
+    unsigned length;
+
+    const char *source = EzJSONParserNumberText(c->parser, &length);
+    const char *end    = source + length;
+    if ((length = plainDecimal(source, length)) > 0)
+    {
+        put(c, source, length);
+        return 0;
+    }
+
+    if (number_scan(source, end, &parts) == end
+        && integerValue(parts, &integer))
+    {
+        length = formatInt64(text, integer);
+    }
+    else
+    {
+        EzJSONParserNumberDouble(c->parser, &value);
+        if (value - value != 0.0)
+        {
+            c->error = EZ_CN_NUMBER_RANGE;
+            return -1;
+        }
+
+        if (value > -9007199254740992.0 && value < 9007199254740992.0
+            && (double)(int64_t)value == value)
+        {
+            length = formatInt64(text, (int64_t)value);
+        }
+        else
+        {
+            length = formatDouble(text, value);
+        }
+    }
+
+    put(c, text, length);
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Structure
+
+static struct Level *top(struct Canonical *c)
+{
+    return c->levelCount > 0 ? &c->levels[c->levelCount - 1] : NULL;
+}
+
+// Separate array elements
+static void beginValue(struct Canonical *c)
+{
+    struct Level *level = top(c);
+    if (level && !level->object)
+    {
+        if (!level->first)
+        {
+            put(c, ",", 1u);
+        }
+        level->first = 0;
+    }
+}
+
+static int pushLevel(struct Canonical *c, char object)
+{
+    if (reserveStack(
+            c,
+            (void **)&c->levels,
+            &c->levelCapacity,
+            c->levelCount + 1u,
+            sizeof(struct Level))
+        != 0)
+    {
+        return -1;
+    }
+
+    struct Level *level = &c->levels[c->levelCount++];
+    level->start        = c->arenaLength;
+    level->members      = c->memberCount;
+    level->object       = object;
+    level->first        = 1;
+    return 0;
+}
+
+// The text of the last member of the object ends here
+static void endMember(struct Canonical *c)
+{
+    if (c->memberCount > top(c)->members)
+    {
+        c->members[c->memberCount - 1].end = c->arenaLength;
+    }
+}
+
+static int putKey(struct Canonical *c, const struct EzJSONToken *token)
+{
+    endMember(c);
+    if (reserveStack(
+            c,
+            (void **)&c->members,
+            &c->memberCapacity,
+            c->memberCount + 1u,
+            sizeof(struct Member))
+        != 0)
+    {
+        return -1;
+    }
+
+    struct Member *member = &c->members[c->memberCount++];
+    member->key           = c->arenaLength;
+    member->keyLength     = token->data_text_length;
+    put(c, token->data_text, token->data_text_length);
+    member->start = c->arenaLength;
+    putEscaped(c, token->data_text, token->data_text_length);
+    put(c, ":", 1u);
+    return 0;
+}
+
+static int compareKeys(
+    const char *arena, const struct Member *a, const struct Member *b)
+{
+    const unsigned length =
+        a->keyLength < b->keyLength ? a->keyLength : b->keyLength;
+    const int order = memcmp(arena + a->key, arena + b->key, length);
+    if (order != 0)
+    {
+        return order;
+    }
+    return (a->keyLength > b->keyLength) - (a->keyLength < b->keyLength);
+}
+
+// Stable merge sort of count members, using scratch for as many
+static void sortMembers(
+    const char *arena,
+    struct Member *members,
+    struct Member *scratch,
+    unsigned count)
+{
+    if (count < 2)
+    {
+        return;
+    }
+
+    const unsigned half = count / 2;
+    sortMembers(arena, members, scratch, half);
+    sortMembers(arena, members + half, scratch, count - half);
+
+    unsigned left  = 0;
+    unsigned right = half;
+    unsigned out   = 0;
+    while (left < half && right < count)
+    {
+        if (compareKeys(arena, &members[right], &members[left]) < 0)
+        {
+            scratch[out++] = members[right++];
+        }
+        else
+        {
+            scratch[out++] = members[left++];
+        }
+    }
+    while (left < half)
+    {
+        scratch[out++] = members[left++];
+    }
+    memcpy(members, scratch, right * sizeof(struct Member));
+}
+
+// Sort the members of the closing object and replace its arena text with
+// the canonical object, or write that out at the top level
+static int endObject(struct Canonical *c)
+{
+    endMember(c);
+
+    const struct Level level = c->levels[--c->levelCount];
+    const unsigned count     = c->memberCount - level.members;
+    unsigned long size       = 2u + (count > 0 ? count - 1u : 0u);
+    for (unsigned i = level.members; i < c->memberCount; ++i)
+    {
+        size += c->members[i].end - c->members[i].start;
+    }
+
+    // Members and their text are moved to fresh space past the end
+    if (reserveStack(
+            c,
+            (void **)&c->members,
+            &c->memberCapacity,
+            c->memberCount + count,
+            sizeof(struct Member))
+            != 0
+        || reserveArena(c, size) != 0)
+    {
+        return -1;
+    }
+
+    struct Member *members = c->members + level.members;
+    sortMembers(c->arena, members, members + count, count);
+
+    char *out = c->arena + c->arenaLength;
+    *out++    = '{';
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const unsigned long length = members[i].end - members[i].start;
+        if (i > 0)
+        {
+            *out++ = ',';
+        }
+        memcpy(out, c->arena + members[i].start, length);
+        out += length;
+    }
+    *out = '}';
+
+    const char *text = c->arena + c->arenaLength;
+    c->memberCount   = level.members;
+    c->arenaLength   = level.start;
+    if (--c->objects == 0)
+    {
+        writeOutput(c, text, size);
+    }
+    else
+    {
+        memmove(c->arena + c->arenaLength, text, size);
+        c->arenaLength += size;
+    }
+    return 0;
+}
+
+static int putToken(struct Canonical *c, const struct EzJSONToken *token)
+{
+    switch (token->type)
+    {
+    case EZJ_TOKEN_OBJ_BEGIN:
+        beginValue(c);
+        c->objects++;
+        return pushLevel(c, 1);
+    case EZJ_TOKEN_OBJ_END:
+        return endObject(c);
+    case EZJ_TOKEN_ARR_BEGIN:
+        beginValue(c);
+        put(c, "[", 1u);
+        return pushLevel(c, 0);
+    case EZJ_TOKEN_ARR_END:
+        c->levelCount--;
+        put(c, "]", 1u);
+        return 0;
+    case EZJ_TOKEN_OBJ_KEY:
+        return putKey(c, token);
+    case EZJ_TOKEN_STRING:
+        beginValue(c);
+        putEscaped(c, token->data_text, token->data_text_length);
+        return 0;
+    case EZJ_TOKEN_NUMBER:
+        beginValue(c);
+        return putNumber(c);
+    case EZJ_TOKEN_BOOL:
+        beginValue(c);
+        if (token->data_bool)
+        {
+            put(c, "true", 4u);
+        }
+        else
+        {
+            put(c, "false", 5u);
+        }
+        return 0;
+    case EZJ_TOKEN_NULL:
+        beginValue(c);
+        put(c, "null", 4u);
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Interface
+
+enum EzJSONCanonicalError EzJSONCanonicalWrite(
+    struct EzJSONParser *parser,
+    void (*writeBuffer)(void *, const char *, unsigned),
+    void *userdata)
+{
+    struct Canonical c;
+    const struct EzJSONToken *token;
+
+    c.parser         = parser;
+    c.writeBuffer    = writeBuffer;
+    c.userdata       = userdata;
+    c.bufferPos      = 0;
+    c.arena          = NULL;
+    c.arenaLength    = 0;
+    c.arenaCapacity  = 0;
+    c.objects        = 0;
+    c.levels         = NULL;
+    c.levelCount     = 0;
+    c.levelCapacity  = 0;
+    c.members        = NULL;
+    c.memberCount    = 0;
+    c.memberCapacity = 0;
+    c.error          = EZ_CN_OK;
+
+    while (c.error == EZ_CN_OK
+           && (EzJSONParserNext(parser), token = EzJSONParserToken(parser)))
+    {
+        putToken(&c, token);
+    }
+    if (c.error == EZ_CN_OK && EzJSONParserHasError(parser))
+    {
+        c.error = EZ_CN_PARSE;
+    }
+    flushOutput(&c);
+
+    release(&c, c.arena, c.arenaCapacity);
+    release(&c, c.levels, c.levelCapacity * sizeof(struct Level));
+    release(&c, c.members, c.memberCapacity * sizeof(struct Member));
+    return c.error;
+}
+
+const char *EzJSONCanonicalErrorName(enum EzJSONCanonicalError error)
+{
+    switch (error)
+    {
+    case EZ_CN_OK:
+        return "no error";
+    case EZ_CN_PARSE:
+        return "parse error";
+    case EZ_CN_NO_MEMORY:
+        return "out of memory";
+    case EZ_CN_NUMBER_RANGE:
+        return "number out of range";
+    }
+    return "unknown error";
+}
+
+//////////////////////////////////////////////////////////////////////////
+// XXH64
+
+#define XXH_PRIME1 0x9E3779B185EBCA87ull
+#define XXH_PRIME2 0xC2B2AE3D27D4EB4Full
+#define XXH_PRIME3 0x165667B19E3779F9ull
+#define XXH_PRIME4 0x85EBCA77C2B2AE63ull
+#define XXH_PRIME5 0x27D4EB2F165667C5ull
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// Little endian, whatever the machine
+static uint64_t read64(const unsigned char *p)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static uint32_t read32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16
+           | (uint32_t)p[3] << 24;
+}
+
+static uint64_t xxhRound(uint64_t lane, uint64_t input)
+{
+    lane += input * XXH_PRIME2;
+    lane = rotl64(lane, 31);
+    return lane * XXH_PRIME1;
+}
+
+static uint64_t xxhMerge(uint64_t hash, uint64_t lane)
+{
+    hash ^= xxhRound(0, lane);
+    return hash * XXH_PRIME1 + XXH_PRIME4;
+}
+
+static void xxhStripe(struct EzJSONHash *hash, const unsigned char *p)
+{
+    hash->lanes[0] = xxhRound(hash->lanes[0], read64(p));
+    hash->lanes[1] = xxhRound(hash->lanes[1], read64(p + 8));
+    hash->lanes[2] = xxhRound(hash->lanes[2], read64(p + 16));
+    hash->lanes[3] = xxhRound(hash->lanes[3], read64(p + 24));
+}
+
+void EzJSONHashInit(struct EzJSONHash *hash, uint64_t seed)
+{
+    hash->lanes[0]      = seed + XXH_PRIME1 + XXH_PRIME2;
+    hash->lanes[1]      = seed + XXH_PRIME2;
+    hash->lanes[2]      = seed;
+    hash->lanes[3]      = seed - XXH_PRIME1;
+    hash->seed          = seed;
+    hash->total         = 0;
+    hash->pendingLength = 0;
+}
+
+void EzJSONHashUpdate(void *userdata, const char *data, unsigned count)
+{
+    struct EzJSONHash *hash = (struct EzJSONHash *)userdata;
+    const unsigned char *p  = (const unsigned char *)data;
+    const unsigned char *end = p + count;
+
+    hash->total += count;
+
+    if (hash->pendingLength > 0)
+    {
+        const unsigned missing = 32u - hash->pendingLength;
+        if (count < missing)
+        {
+            memcpy(hash->pending + hash->pendingLength, p, count);
+            hash->pendingLength += count;
+            return;
+        }
+        memcpy(hash->pending + hash->pendingLength, p, missing);
+        xxhStripe(hash, hash->pending);
+        p += missing;
+        hash->pendingLength = 0;
+    }
+
+    while (end - p >= 32)
+    {
+        xxhStripe(hash, p);
+        p += 32;
+    }
+
+    memcpy(hash->pending, p, (size_t)(end - p));
+    hash->pendingLength = (unsigned)(end - p);
+}
+
+uint64_t EzJSONHashDigest(const struct EzJSONHash *hash)
+{
+    const unsigned char *p   = hash->pending;
+    const unsigned char *end = p + hash->pendingLength;
+    uint64_t h;
+
+    if (hash->total >= 32)
+    {
+        h = rotl64(hash->lanes[0], 1) + rotl64(hash->lanes[1], 7)
+            + rotl64(hash->lanes[2], 12) + rotl64(hash->lanes[3], 18);
+        h = xxhMerge(h, hash->lanes[0]);
+        h = xxhMerge(h, hash->lanes[1]);
+        h = xxhMerge(h, hash->lanes[2]);
+        h = xxhMerge(h, hash->lanes[3]);
+    }
+    else
+    {
+        h = hash->seed + XXH_PRIME5;
+    }
+    h += hash->total;
+
+    for (; end - p >= 8; p += 8)
+    {
+        h ^= xxhRound(0, read64(p));
+        h = rotl64(h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+    if (end - p >= 4)
+    {
+        h ^= (uint64_t)read32(p) * XXH_PRIME1;
+        h = rotl64(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        h ^= *p * XXH_PRIME5;
+        h = rotl64(h, 11) * XXH_PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,75 @@
+#ifndef __EZJSON_CANONICAL_H_INCLUDED__
+#define __EZJSON_CANONICAL_H_INCLUDED__
+
+#include "ezjson_common.h"
+#include "ezjson_parser.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    // Canonical form of a document, for hashing and comparing documents
+    // that differ only in formatting, member order or number spelling:
+    //  - no whitespace
+    //  - object members sorted by key, bytewise on the UTF-8 text
+    //  - strings escaped only where JSON requires it: quotes, backslashes
+    //    and control characters, with the short escapes where they exist
+    //  - integers that fit an int64 as plain digits, including those
+    //    written with a fraction or exponent, and other numbers with the
+    //    fewest digits that read back the same double
+    //
+    // This follows RFC 8785 except that keys sort by UTF-8 rather than
+    // UTF-16, which differs only for characters above U+FFFF, and that
+    // large and small numbers use printf's exponent format.
+    //
+    // Members of open objects are kept in a growing buffer until the
+    // object closes, so memory use is bounded by the largest object rather
+    // than the document.
+    //
+    // There is no canonical mode in EzJSONWriter. Documents built with the
+    // writer are canonicalized by parsing its output from memory, e.g. a
+    // buffer filled by writeBuffer, into EzJSONCanonicalWrite.
+
+    enum EzJSONCanonicalError
+    {
+        EZ_CN_OK,
+        EZ_CN_PARSE,        // See EzJSONParserError
+        EZ_CN_NO_MEMORY,    // Allocation through the parser settings failed
+        EZ_CN_NUMBER_RANGE, // A number is too large for a double
+    };
+
+    /// Write the canonical form of the document read by parser. Output is
+    /// passed to writeBuffer in chunks of at most EZJSON_WRITE_BUFFER_SIZE
+    /// bytes, except for large objects which are passed whole. On error the
+    /// output is incomplete.
+    enum EzJSONCanonicalError EzJSONCanonicalWrite(
+        struct EzJSONParser *,
+        void (*writeBuffer)(void *, const char *, unsigned),
+        void *userdata);
+
+    /// Human readable description of an error
+    const char *EzJSONCanonicalErrorName(enum EzJSONCanonicalError);
+
+    /// Streaming XXH64, e.g. to hash canonical output without keeping it:
+    /// pass EzJSONHashUpdate as writeBuffer with the hash as userdata.
+    struct EzJSONHash
+    {
+        uint64_t lanes[4];
+        uint64_t seed;
+        uint64_t total; // Bytes hashed
+        unsigned char pending[32];
+        unsigned pendingLength;
+    };
+
+    void EzJSONHashInit(struct EzJSONHash *, uint64_t seed);
+    void EzJSONHashUpdate(void *hash, const char *data, unsigned count);
+
+    /// Hash of everything passed so far. More data may follow.
+    uint64_t EzJSONHashDigest(const struct EzJSONHash *);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //!__EZJSON_CANONICAL_H_INCLUDED__
@@ -1,6 +1,8 @@
 #ifndef __EZJSON_UTIL_H_INCLUDED__
 #define __EZJSON_UTIL_H_INCLUDED__
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -18,16 +20,81 @@ typedef float EzJSONNumber;
 typedef char EzJSONBool;
 #endif // !EZJSON_BOOL
 
+// Inline nesting stack size in chunks, each chunk holds 64 levels
+#ifndef EZJSON_INLINE_STACK_SIZE
 #define EZJSON_INLINE_STACK_SIZE 8
+#endif // !EZJSON_INLINE_STACK_SIZE
 
-    typedef char EzJSONStackChunk;
+    typedef uint64_t EzJSONStackChunk;
 
     struct EzJSONBitStack
     {
         EzJSONStackChunk inlineData[EZJSON_INLINE_STACK_SIZE];
         EzJSONStackChunk *data;
-        unsigned size;
-        unsigned top;
+        unsigned size;     // In chunks
+        unsigned top;      // In bits
+        unsigned maxDepth; // 0 for unlimited
+    };
+
+// Object nesting depth up to which EZJ_PARSE_INTERN_KEYS predicts keys
+#ifndef EZJSON_KEY_PREDICT_DEPTH
+#define EZJSON_KEY_PREDICT_DEPTH 16
+#endif // !EZJSON_KEY_PREDICT_DEPTH
+
+    struct EzJSONInternedKey;
+    struct EzJSONKeyChunk;
+
+    // Interned object keys of a parser, see EZJ_PARSE_INTERN_KEYS
+    struct EzJSONKeyPool
+    {
+        struct EzJSONInternedKey *keys; // Indexed by id
+        unsigned count;
+        unsigned capacity;
+        uint32_t *table; // Open addressing, id + 1 per slot, 0 when empty
+        unsigned tableSize;
+        struct EzJSONKeyChunk *chunks; // Key text, never moved
+        unsigned chunkUsed;            // Bytes used in the first chunk
+
+        // Per depth, the first key of the last object and the previous key
+        // of the current one. The next key is predicted from them.
+        uint32_t first[EZJSON_KEY_PREDICT_DEPTH];
+        uint32_t last[EZJSON_KEY_PREDICT_DEPTH];
+    };
+
+    struct EzJSONSeenKey;
+    struct EzJSONKeySetFrame;
+
+    // Keys of the open objects of a parser, to find duplicates. Each array
+    // is a stack: the keys, hash table and text of an object sit above those
+    // of the objects around it and are dropped when it ends, so the memory
+    // is reused from one object to the next.
+    struct EzJSONKeySet
+    {
+        struct EzJSONSeenKey *keys;
+        unsigned keyCount;
+        unsigned keyCapacity;
+        uint32_t *slots; // Hash tables, key index + 1 per slot, 0 when empty
+        unsigned slotCount;
+        unsigned slotCapacity;
+        char *text;
+        unsigned textLength;
+        unsigned textCapacity;
+        struct EzJSONKeySetFrame *frames; // One per open object
+        unsigned depth;
+        unsigned frameCapacity;
+    };
+
+    // Instrumentation counters, only maintained when the library is compiled
+    // with EZJSON_STATS. Counters accumulate from Init until reset.
+    struct EzJSONStats
+    {
+        unsigned long bytes;         // Bytes read (parser) or flushed (writer)
+        unsigned long tokens;        // Tokens returned or values written
+        unsigned long stringBytes;   // Bytes copied for strings and keys
+        unsigned long bufferGrowths; // Parser value buffer reallocations
+        unsigned long stackGrowths;  // Nesting stack reallocations
+        unsigned long flushes;       // Writer output buffer flushes
+        unsigned maxDepth;           // Deepest nesting seen
     };
 
     // Optional allocator overrides
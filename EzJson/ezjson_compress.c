@@ -0,0 +1,546 @@
+#include "ezjson_compress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Block buffers go through the configured allocator. zlib and zstd keep
+// their own state, allocated with malloc.
+
+static char *allocBlocks(void *userdata, EzJSONAlloc alloc, unsigned count)
+{
+    const unsigned size = count * EZJSON_COMPRESS_BLOCK;
+    return alloc ? alloc(userdata, size) : (char *)malloc(size);
+}
+
+static void freeBlocks(
+    void *userdata, EzJSONFree dealloc, char *blocks, unsigned count)
+{
+    if (!blocks)
+    {
+        return;
+    }
+    if (dealloc)
+    {
+        dealloc(userdata, blocks, count * EZJSON_COMPRESS_BLOCK);
+    }
+    else
+    {
+        free(blocks);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Decompression
+
+static unsigned readFile(void *userdata, char *out, unsigned capacity)
+{
+    return (unsigned)fread(out, 1, capacity, (FILE *)userdata);
+}
+
+// Returns 0, the end of the input for the parser
+static unsigned
+failDecompress(struct EzJSONDecompressor *dec, enum EzJSONCompressError error)
+{
+    if (dec->error == EZ_CE_OK)
+    {
+        dec->error = error;
+    }
+    return 0;
+}
+
+static char *outBlock(struct EzJSONDecompressor *dec)
+{
+    return dec->in + EZJSON_COMPRESS_BLOCK;
+}
+
+// Refill the compressed block once it has been consumed
+static void fillInput(struct EzJSONDecompressor *dec)
+{
+    const unsigned count = dec->settings.read(
+        dec->settings.userdata, dec->in, EZJSON_COMPRESS_BLOCK);
+    dec->inPos     = 0;
+    dec->inLength  = count;
+    dec->inputDone = count == 0;
+}
+
+// Read enough to recognise the format from its magic bytes
+static int detect(struct EzJSONDecompressor *dec)
+{
+    static const unsigned char gzipMagic[] = {0x1F, 0x8B};
+    static const unsigned char zstdMagic[] = {0x28, 0xB5, 0x2F, 0xFD};
+
+    while (dec->inLength < sizeof(zstdMagic) && !dec->inputDone)
+    {
+        const unsigned count = dec->settings.read(
+            dec->settings.userdata,
+            dec->in + dec->inLength,
+            EZJSON_COMPRESS_BLOCK - dec->inLength);
+        dec->inLength += count;
+        dec->inputDone = count == 0;
+    }
+
+    if (dec->inLength >= sizeof(gzipMagic)
+        && memcmp(dec->in, gzipMagic, sizeof(gzipMagic)) == 0)
+    {
+        dec->format = EZJ_COMPRESS_GZIP;
+#if defined(EZJSON_ZLIB)
+        memset(&dec->zlib, 0, sizeof(dec->zlib));
+        // 15 window bits, +16 for a gzip wrapper
+        if (inflateInit2(&dec->zlib, 15 + 16) != Z_OK)
+        {
+            failDecompress(dec, EZ_CE_NO_MEMORY);
+            return -1;
+        }
+        dec->zlibInit      = 1;
+        dec->zlib.next_in  = (Bytef *)dec->in;
+        dec->zlib.avail_in = dec->inLength;
+        dec->inPos         = dec->inLength;
+        return 0;
+#endif
+    }
+    else if (
+        dec->inLength >= sizeof(zstdMagic)
+        && memcmp(dec->in, zstdMagic, sizeof(zstdMagic)) == 0)
+    {
+        dec->format = EZJ_COMPRESS_ZSTD;
+#if defined(EZJSON_ZSTD)
+        dec->zstd = ZSTD_createDStream();
+        if (!dec->zstd || ZSTD_isError(ZSTD_initDStream(dec->zstd)))
+        {
+            failDecompress(dec, EZ_CE_NO_MEMORY);
+            return -1;
+        }
+        return 0;
+#endif
+    }
+    else
+    {
+        dec->format = EZJ_COMPRESS_NONE;
+        return 0;
+    }
+
+    failDecompress(dec, EZ_CE_UNSUPPORTED);
+    return -1;
+}
+
+static unsigned nextPlain(struct EzJSONDecompressor *dec, const char **block)
+{
+    if (dec->inPos == dec->inLength && !dec->inputDone)
+    {
+        fillInput(dec);
+    }
+
+    const unsigned count = dec->inLength - dec->inPos;
+    *block               = dec->in + dec->inPos;
+    dec->inPos           = dec->inLength;
+    return count;
+}
+
+#if defined(EZJSON_ZLIB)
+static unsigned nextGzip(struct EzJSONDecompressor *dec, const char **block)
+{
+    z_stream *zlib = &dec->zlib;
+
+    for (;;)
+    {
+        if (zlib->avail_in == 0 && !dec->inputDone)
+        {
+            fillInput(dec);
+            zlib->next_in  = (Bytef *)dec->in;
+            zlib->avail_in = dec->inLength;
+            dec->inPos     = dec->inLength;
+        }
+        if (zlib->avail_in == 0 && dec->inputDone)
+        {
+            return dec->streamDone ? 0 : failDecompress(dec, EZ_CE_TRUNCATED);
+        }
+
+        zlib->next_out  = (Bytef *)outBlock(dec);
+        zlib->avail_out = EZJSON_COMPRESS_BLOCK;
+
+        const int result = inflate(zlib, Z_NO_FLUSH);
+        if (result == Z_STREAM_END)
+        {
+            // Concatenated members, as written by parallel compressors,
+            // are read as one stream
+            dec->streamDone = 1;
+            inflateReset(zlib);
+        }
+        else if (result == Z_OK)
+        {
+            dec->streamDone = 0;
+        }
+        else if (result != Z_BUF_ERROR)
+        {
+            return failDecompress(
+                dec, result == Z_MEM_ERROR ? EZ_CE_NO_MEMORY : EZ_CE_CORRUPT);
+        }
+
+        const unsigned count = EZJSON_COMPRESS_BLOCK - zlib->avail_out;
+        if (count > 0)
+        {
+            *block = outBlock(dec);
+            return count;
+        }
+    }
+}
+#endif
+
+#if defined(EZJSON_ZSTD)
+static unsigned nextZstd(struct EzJSONDecompressor *dec, const char **block)
+{
+    for (;;)
+    {
+        if (dec->inPos == dec->inLength && !dec->inputDone)
+        {
+            fillInput(dec);
+        }
+        if (dec->inPos == dec->inLength && dec->inputDone && dec->streamDone)
+        {
+            return 0;
+        }
+
+        ZSTD_inBuffer input   = {dec->in, dec->inLength, dec->inPos};
+        ZSTD_outBuffer output = {outBlock(dec), EZJSON_COMPRESS_BLOCK, 0};
+
+        const size_t result = ZSTD_decompressStream(dec->zstd, &output, &input);
+        if (ZSTD_isError(result))
+        {
+            return failDecompress(dec, EZ_CE_CORRUPT);
+        }
+        dec->inPos      = (unsigned)input.pos;
+        dec->streamDone = result == 0;
+
+        if (output.pos > 0)
+        {
+            *block = outBlock(dec);
+            return (unsigned)output.pos;
+        }
+        if (dec->inPos == dec->inLength && dec->inputDone)
+        {
+            return dec->streamDone ? 0 : failDecompress(dec, EZ_CE_TRUNCATED);
+        }
+    }
+}
+#endif
+
+int EzJSONDecompressorInit(struct EzJSONDecompressor *dec)
+{
+    if (!dec->settings.read)
+    {
+        dec->settings.read = &readFile;
+    }
+
+    dec->format     = EZJ_COMPRESS_NONE;
+    dec->error      = EZ_CE_OK;
+    dec->inPos      = 0;
+    dec->inLength   = 0;
+    dec->started    = 0;
+    dec->inputDone  = 0;
+    dec->streamDone = 0;
+#if defined(EZJSON_ZLIB)
+    dec->zlibInit = 0;
+#endif
+#if defined(EZJSON_ZSTD)
+    dec->zstd = NULL;
+#endif
+
+    dec->in = allocBlocks(
+        dec->settings.userdata, dec->settings.allocate_memory, 2);
+    if (!dec->in)
+    {
+        failDecompress(dec, EZ_CE_NO_MEMORY);
+        return -1;
+    }
+    return 0;
+}
+
+void EzJSONDecompressorDestroy(struct EzJSONDecompressor *dec)
+{
+#if defined(EZJSON_ZLIB)
+    if (dec->zlibInit)
+    {
+        inflateEnd(&dec->zlib);
+        dec->zlibInit = 0;
+    }
+#endif
+#if defined(EZJSON_ZSTD)
+    ZSTD_freeDStream(dec->zstd);
+    dec->zstd = NULL;
+#endif
+
+    freeBlocks(dec->settings.userdata, dec->settings.free_memory, dec->in, 2);
+    dec->in = NULL;
+}
+
+unsigned EzJSONDecompressorNextBlock(void *decompressor, const char **block)
+{
+    struct EzJSONDecompressor *dec =
+        (struct EzJSONDecompressor *)decompressor;
+
+    if (dec->error != EZ_CE_OK)
+    {
+        return 0;
+    }
+    if (!dec->started)
+    {
+        dec->started = 1;
+        if (detect(dec) != 0)
+        {
+            return 0;
+        }
+    }
+
+    switch (dec->format)
+    {
+    case EZJ_COMPRESS_NONE:
+        return nextPlain(dec, block);
+#if defined(EZJSON_ZLIB)
+    case EZJ_COMPRESS_GZIP:
+        return nextGzip(dec, block);
+#endif
+#if defined(EZJSON_ZSTD)
+    case EZJ_COMPRESS_ZSTD:
+        return nextZstd(dec, block);
+#endif
+    default:
+        return failDecompress(dec, EZ_CE_UNSUPPORTED);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Compression
+
+static void writeFile(void *userdata, const char *data, unsigned count)
+{
+    fwrite(data, 1, count, (FILE *)userdata);
+}
+
+static int
+failCompress(struct EzJSONCompressor *comp, enum EzJSONCompressError error)
+{
+    if (comp->error == EZ_CE_OK)
+    {
+        comp->error = error;
+    }
+    return -1;
+}
+
+#if defined(EZJSON_ZLIB)
+// Run deflate over the pending input until it has all been consumed, or
+// with Z_FINISH until the stream is complete
+static int deflateBlocks(struct EzJSONCompressor *comp, int flush)
+{
+    int result;
+
+    do
+    {
+        comp->zlib.next_out  = (Bytef *)comp->out;
+        comp->zlib.avail_out = EZJSON_COMPRESS_BLOCK;
+        result               = deflate(&comp->zlib, flush);
+        if (result == Z_STREAM_ERROR)
+        {
+            return failCompress(comp, EZ_CE_CORRUPT);
+        }
+
+        const unsigned count = EZJSON_COMPRESS_BLOCK - comp->zlib.avail_out;
+        if (count > 0)
+        {
+            comp->settings.write(comp->settings.userdata, comp->out, count);
+        }
+    } while (comp->zlib.avail_out == 0
+             || (flush == Z_FINISH && result != Z_STREAM_END));
+
+    return 0;
+}
+#endif
+
+#if defined(EZJSON_ZSTD)
+// Compress input, with ZSTD_e_end until the frame is complete
+static int zstdBlocks(
+    struct EzJSONCompressor *comp,
+    const char *data,
+    unsigned count,
+    ZSTD_EndDirective mode)
+{
+    ZSTD_inBuffer input = {data, count, 0};
+    size_t remaining;
+
+    do
+    {
+        ZSTD_outBuffer output = {comp->out, EZJSON_COMPRESS_BLOCK, 0};
+        remaining = ZSTD_compressStream2(comp->zstd, &output, &input, mode);
+        if (ZSTD_isError(remaining))
+        {
+            return failCompress(comp, EZ_CE_CORRUPT);
+        }
+
+        if (output.pos > 0)
+        {
+            comp->settings.write(
+                comp->settings.userdata, comp->out, (unsigned)output.pos);
+        }
+    } while (input.pos < input.size || (mode == ZSTD_e_end && remaining != 0));
+
+    return 0;
+}
+#endif
+
+int EzJSONCompressorInit(struct EzJSONCompressor *comp)
+{
+    if (!comp->settings.write)
+    {
+        comp->settings.write = &writeFile;
+    }
+
+    comp->error = EZ_CE_OK;
+    comp->out   = NULL;
+#if defined(EZJSON_ZLIB)
+    comp->zlibInit = 0;
+#endif
+#if defined(EZJSON_ZSTD)
+    comp->zstd = NULL;
+#endif
+
+    switch (comp->settings.format)
+    {
+    case EZJ_COMPRESS_NONE:
+        return 0;
+#if defined(EZJSON_ZLIB)
+    case EZJ_COMPRESS_GZIP:
+        memset(&comp->zlib, 0, sizeof(comp->zlib));
+        if (deflateInit2(
+                &comp->zlib,
+                comp->settings.level ? comp->settings.level
+                                     : Z_DEFAULT_COMPRESSION,
+                Z_DEFLATED,
+                15 + 16,
+                8,
+                Z_DEFAULT_STRATEGY)
+            != Z_OK)
+        {
+            return failCompress(comp, EZ_CE_NO_MEMORY);
+        }
+        comp->zlibInit = 1;
+        break;
+#endif
+#if defined(EZJSON_ZSTD)
+    case EZJ_COMPRESS_ZSTD:
+        comp->zstd = ZSTD_createCStream();
+        if (!comp->zstd
+            || ZSTD_isError(ZSTD_CCtx_setParameter(
+                comp->zstd,
+                ZSTD_c_compressionLevel,
+                comp->settings.level ? comp->settings.level
+                                     : ZSTD_CLEVEL_DEFAULT)))
+        {
+            return failCompress(comp, EZ_CE_NO_MEMORY);
+        }
+        break;
+#endif
+    default:
+        return failCompress(comp, EZ_CE_UNSUPPORTED);
+    }
+
+    comp->out = allocBlocks(
+        comp->settings.userdata, comp->settings.allocate_memory, 1);
+    if (!comp->out)
+    {
+        return failCompress(comp, EZ_CE_NO_MEMORY);
+    }
+    return 0;
+}
+
+void EzJSONCompressorWrite(void *compressor, const char *data, unsigned count)
+{
+    struct EzJSONCompressor *comp = (struct EzJSONCompressor *)compressor;
+
+    if (comp->error != EZ_CE_OK)
+    {
+        return;
+    }
+
+    switch (comp->settings.format)
+    {
+    case EZJ_COMPRESS_NONE:
+        comp->settings.write(comp->settings.userdata, data, count);
+        break;
+#if defined(EZJSON_ZLIB)
+    case EZJ_COMPRESS_GZIP:
+        comp->zlib.next_in  = (Bytef *)data;
+        comp->zlib.avail_in = count;
+        deflateBlocks(comp, Z_NO_FLUSH);
+        break;
+#endif
+#if defined(EZJSON_ZSTD)
+    case EZJ_COMPRESS_ZSTD:
+        zstdBlocks(comp, data, count, ZSTD_e_continue);
+        break;
+#endif
+    default:
+        failCompress(comp, EZ_CE_UNSUPPORTED);
+        break;
+    }
+}
+
+int EzJSONCompressorFinish(struct EzJSONCompressor *comp)
+{
+    if (comp->error != EZ_CE_OK)
+    {
+        return -1;
+    }
+
+    switch (comp->settings.format)
+    {
+#if defined(EZJSON_ZLIB)
+    case EZJ_COMPRESS_GZIP:
+        comp->zlib.next_in  = NULL;
+        comp->zlib.avail_in = 0;
+        return deflateBlocks(comp, Z_FINISH);
+#endif
+#if defined(EZJSON_ZSTD)
+    case EZJ_COMPRESS_ZSTD:
+        return zstdBlocks(comp, NULL, 0, ZSTD_e_end);
+#endif
+    default:
+        return 0;
+    }
+}
+
+void EzJSONCompressorDestroy(struct EzJSONCompressor *comp)
+{
+#if defined(EZJSON_ZLIB)
+    if (comp->zlibInit)
+    {
+        deflateEnd(&comp->zlib);
+        comp->zlibInit = 0;
+    }
+#endif
+#if defined(EZJSON_ZSTD)
+    ZSTD_freeCStream(comp->zstd);
+    comp->zstd = NULL;
+#endif
+
+    freeBlocks(
+        comp->settings.userdata, comp->settings.free_memory, comp->out, 1);
+    comp->out = NULL;
+}
+
+const char *EzJSONCompressErrorName(enum EzJSONCompressError error)
+{
+    switch (error)
+    {
+    case EZ_CE_OK:
+        return "no error";
+    case EZ_CE_UNSUPPORTED:
+        return "compression format not available";
+    case EZ_CE_CORRUPT:
+        return "corrupt compressed data";
+    case EZ_CE_TRUNCATED:
+        return "compressed data is truncated";
+    case EZ_CE_NO_MEMORY:
+        return "out of memory";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,145 @@
+#ifndef __EZJSON_COMPRESS_H_INCLUDED__
+#define __EZJSON_COMPRESS_H_INCLUDED__
+
+#include "ezjson_common.h"
+
+#if defined(EZJSON_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(EZJSON_ZSTD)
+#include <zstd.h>
+#endif
+
+// Size of the compressed and decompressed blocks, allocated once per stream
+#ifndef EZJSON_COMPRESS_BLOCK
+#define EZJSON_COMPRESS_BLOCK 65536
+#endif // !EZJSON_COMPRESS_BLOCK
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    // Streaming gzip and zstd, for reading compressed documents without a
+    // temporary file and writing them compressed. A decompressor feeds the
+    // parser through get_next_block, a compressor takes the place of the
+    // writer's writeBuffer. Memory use is two blocks per stream whatever the
+    // document size.
+    //
+    // Each format is only available when the library is built with its
+    // library (EZJSON_ZLIB, EZJSON_ZSTD). Others fail with
+    // EZ_CE_UNSUPPORTED.
+
+    enum EzJSONCompression
+    {
+        EZJ_COMPRESS_NONE, // Plain text, passed through
+        EZJ_COMPRESS_GZIP,
+        EZJ_COMPRESS_ZSTD,
+    };
+
+    enum EzJSONCompressError
+    {
+        EZ_CE_OK,
+        EZ_CE_UNSUPPORTED, // Format not compiled in
+        EZ_CE_CORRUPT,     // Malformed compressed data
+        EZ_CE_TRUNCATED,   // Input ended inside a compressed stream
+        EZ_CE_NO_MEMORY,
+    };
+
+    // Reads up to capacity compressed bytes. Return the number read, 0 on
+    // error or EOF
+    typedef unsigned (*EzJSONReadBytes)(void *, char *out, unsigned capacity);
+
+    struct EzJSONDecompressorSettings
+    {
+        void *userdata;              // Optional, passed to all callbacks
+        EzJSONReadBytes read;        // Optional, reads userdata as a FILE * if
+                                     // not set
+        EzJSONAlloc allocate_memory; // Optional, uses malloc() if not set
+        EzJSONFree free_memory;      // Optional, uses free() if not set
+    };
+
+    struct EzJSONDecompressor
+    {
+        struct EzJSONDecompressorSettings settings;
+
+        enum EzJSONCompression format; // Detected from the first bytes
+        enum EzJSONCompressError error;
+
+        char *in; // Compressed block, followed by the decompressed one
+        unsigned inPos;
+        unsigned inLength;
+        char started;
+        char inputDone;  // read returned 0
+        char streamDone; // End of the last compressed stream seen
+
+#if defined(EZJSON_ZLIB)
+        z_stream zlib;
+        char zlibInit;
+#endif
+#if defined(EZJSON_ZSTD)
+        ZSTD_DStream *zstd;
+#endif
+    };
+
+    /// Initialize a decompressor. settings must be set before calling.
+    /// Returns -1 if memory ran out.
+    int EzJSONDecompressorInit(struct EzJSONDecompressor *);
+    void EzJSONDecompressorDestroy(struct EzJSONDecompressor *);
+
+    /// Decompress the next block, an EzJSONGetBlock for the parser settings
+    /// with the decompressor as userdata. The format is detected on the first
+    /// call. Returns 0 at the end, and on error with error set.
+    unsigned
+    EzJSONDecompressorNextBlock(void *decompressor, const char **block);
+
+    // Writes count compressed bytes
+    typedef void (*EzJSONWriteBytes)(void *, const char *, unsigned count);
+
+    struct EzJSONCompressorSettings
+    {
+        void *userdata; // Optional, passed to all callbacks
+        enum EzJSONCompression format;
+        int level;                   // Optional, 0 for the format's default
+        EzJSONWriteBytes write;      // Optional, writes to userdata as a
+                                     // FILE * if not set
+        EzJSONAlloc allocate_memory; // Optional, uses malloc() if not set
+        EzJSONFree free_memory;      // Optional, uses free() if not set
+    };
+
+    struct EzJSONCompressor
+    {
+        struct EzJSONCompressorSettings settings;
+
+        enum EzJSONCompressError error;
+        char *out; // Compressed block
+
+#if defined(EZJSON_ZLIB)
+        z_stream zlib;
+        char zlibInit;
+#endif
+#if defined(EZJSON_ZSTD)
+        ZSTD_CStream *zstd;
+#endif
+    };
+
+    /// Initialize a compressor. settings must be set before calling. Returns
+    /// -1 if the format is not available or memory ran out.
+    int EzJSONCompressorInit(struct EzJSONCompressor *);
+
+    /// Compress count bytes, a writeBuffer for EzJSONWriter with the
+    /// compressor as the writer's userdata
+    void EzJSONCompressorWrite(void *compressor, const char *data, unsigned);
+
+    /// Complete the stream. Returns -1 if compression failed at any point.
+    int EzJSONCompressorFinish(struct EzJSONCompressor *);
+    void EzJSONCompressorDestroy(struct EzJSONCompressor *);
+
+    /// Human readable description of an error
+    const char *EzJSONCompressErrorName(enum EzJSONCompressError);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //!__EZJSON_COMPRESS_H_INCLUDED__
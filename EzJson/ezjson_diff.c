@@ -0,0 +1,745 @@
+#include "ezjson_diff.h"
+#include "ezjson_document.h"
+#include "ezjson_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+#define BUFFER_INITIAL_SIZE 256u
+
+struct Diff
+{
+    struct EzJSONParser *from; // Old document, at the top level
+    struct EzJSONParser *to;
+    struct EzJSONWriter *writer;
+
+    // JSON Pointer of the current value, escaped
+    char *path;
+    unsigned long pathLength;
+    unsigned long pathCapacity;
+
+    enum EzJSONDiffError error;
+};
+
+// Growing byte buffer, e.g. the text of a buffered object
+struct Buffer
+{
+    struct Diff *diff;
+    char *data;
+    unsigned long length;
+    unsigned long capacity;
+};
+
+static void *allocate(struct Diff *diff, unsigned long size)
+{
+    const struct EzJSONParserSettings *settings = &diff->from->settings;
+    if (size > 0xFFFFFFFFul)
+    {
+        return NULL;
+    }
+    if (settings->allocate_memory)
+    {
+        return settings->allocate_memory(settings->userdata, (unsigned)size);
+    }
+    return malloc(size);
+}
+
+static void release(struct Diff *diff, void *ptr, unsigned long size)
+{
+    const struct EzJSONParserSettings *settings = &diff->from->settings;
+    if (!ptr)
+    {
+        return;
+    }
+    if (settings->free_memory)
+    {
+        settings->free_memory(settings->userdata, ptr, (unsigned)size);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+static int fail(struct Diff *diff, enum EzJSONDiffError error)
+{
+    if (diff->error == EZ_DE_OK)
+    {
+        diff->error = error;
+    }
+    return -1;
+}
+
+static int reserve(
+    struct Diff *diff,
+    char **data,
+    unsigned long *capacity,
+    unsigned long needed)
+{
+    if (needed <= *capacity)
+    {
+        return 0;
+    }
+
+    unsigned long grown = *capacity ? *capacity : BUFFER_INITIAL_SIZE;
+    while (grown < needed)
+    {
+        grown *= 2u;
+    }
+
+    char *bigger = allocate(diff, grown);
+    if (!bigger)
+    {
+        return fail(diff, EZ_DE_NO_MEMORY);
+    }
+    if (*data)
+    {
+        memcpy(bigger, *data, *capacity);
+        release(diff, *data, *capacity);
+    }
+    *data     = bigger;
+    *capacity = grown;
+    return 0;
+}
+
+// writeBuffer of the writer filling a Buffer
+static void bufferWrite(void *userdata, const char *data, unsigned count)
+{
+    struct Buffer *buffer = (struct Buffer *)userdata;
+    if (reserve(
+            buffer->diff,
+            &buffer->data,
+            &buffer->capacity,
+            buffer->length + count)
+        == 0)
+    {
+        memcpy(buffer->data + buffer->length, data, count);
+        buffer->length += count;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Path
+
+// Append a key, with '~' and '/' escaped as "~0" and "~1". Returns the
+// previous length, to restore with popPath.
+static unsigned long
+pushKey(struct Diff *diff, const char *key, unsigned length)
+{
+    const unsigned long previous = diff->pathLength;
+    if (reserve(
+            diff,
+            &diff->path,
+            &diff->pathCapacity,
+            previous + 1u + 2u * (unsigned long)length)
+        != 0)
+    {
+        return previous;
+    }
+
+    char *out = diff->path + previous;
+    *out++    = '/';
+    for (unsigned i = 0; i < length; ++i)
+    {
+        if (key[i] == '~' || key[i] == '/')
+        {
+            *out++ = '~';
+            *out++ = key[i] == '~' ? '0' : '1';
+        }
+        else
+        {
+            *out++ = key[i];
+        }
+    }
+    diff->pathLength = (unsigned long)(out - diff->path);
+    return previous;
+}
+
+static unsigned long pushIndex(struct Diff *diff, unsigned long index)
+{
+    char text[24];
+    const int length = snprintf(text, sizeof(text), "%lu", index);
+    return pushKey(diff, text, (unsigned)length);
+}
+
+static void popPath(struct Diff *diff, unsigned long previous)
+{
+    diff->pathLength = previous;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Reading
+
+static int inMemory(const struct EzJSONParser *parser)
+{
+    return !parser->settings.get_next_block && !parser->settings.get_next_char;
+}
+
+static int failParser(struct Diff *diff, const struct EzJSONParser *parser)
+{
+    return fail(diff, parser == diff->to ? EZ_DE_TO : EZ_DE_FROM);
+}
+
+// Next token, separators skipped. Null on error, including an early end of
+// the input.
+static struct EzJSONToken *next(struct Diff *diff, struct EzJSONParser *parser)
+{
+    struct EzJSONToken *token = token_next(parser);
+    if (!token)
+    {
+        failParser(diff, parser);
+    }
+    return token;
+}
+
+// Read past the value starting with token
+static int skipValue(
+    struct Diff *diff,
+    struct EzJSONParser *parser,
+    const struct EzJSONToken *token)
+{
+    if (token_skip_value(parser, token) != 0)
+    {
+        return failParser(diff, parser);
+    }
+    return 0;
+}
+
+// Write the value starting with token to writer
+static int copyValue(
+    struct Diff *diff,
+    struct EzJSONParser *parser,
+    const struct EzJSONToken *token,
+    struct EzJSONWriter *writer)
+{
+    if (token_copy_value(parser, token, writer) != 0)
+    {
+        return failParser(diff, parser);
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Comparing
+
+static int equalNumbers(struct EzJSONParser *from, struct EzJSONParser *to)
+{
+    unsigned fromLength;
+    unsigned toLength;
+    const char *fromText = EzJSONParserNumberText(from, &fromLength);
+    const char *toText   = EzJSONParserNumberText(to, &toLength);
+    int64_t fromInteger;
+    int64_t toInteger;
+    double fromValue;
+    double toValue;
+
+    if (fromLength == toLength && memcmp(fromText, toText, fromLength) == 0)
+    {
+        return 1;
+    }
+    if (EzJSONParserNumberI64(from, &fromInteger) == 0
+        && EzJSONParserNumberI64(to, &toInteger) == 0)
+    {
+        return fromInteger == toInteger;
+    }
+
+    EzJSONParserNumberDouble(from, &fromValue);
+    EzJSONParserNumberDouble(to, &toValue);
+    return fromValue == toValue;
+}
+
+// Scalars of the same type
+static int equalScalars(
+    struct EzJSONParser *from,
+    const struct EzJSONToken *a,
+    struct EzJSONParser *to,
+    const struct EzJSONToken *b)
+{
+    switch (a->type)
+    {
+    case EZJ_TOKEN_STRING:
+        return a->data_text_length == b->data_text_length
+               && memcmp(a->data_text, b->data_text, a->data_text_length)
+                      == 0;
+    case EZJ_TOKEN_NUMBER:
+        return equalNumbers(from, to);
+    case EZJ_TOKEN_BOOL:
+        return (a->data_bool != 0) == (b->data_bool != 0);
+    default:
+        return 1;
+    }
+}
+
+// Length of the common prefix of a and b, at most length
+static unsigned long
+commonPrefix(const char *a, const char *b, unsigned long length)
+{
+    unsigned long n = 0;
+    while (length - n >= 64u && memcmp(a + n, b + n, 64u) == 0)
+    {
+        n += 64u;
+    }
+    while (n < length && a[n] == b[n])
+    {
+        n++;
+    }
+    return n;
+}
+
+// Whether the containers both parsers have just opened have the same text.
+// Only the common prefix is scanned for the end of the old container, so
+// the cost is bounded by the distance to the first difference.
+static int sameText(struct EzJSONParser *from, struct EzJSONParser *to)
+{
+    if (!inMemory(from) || !inMemory(to))
+    {
+        return 0;
+    }
+
+    const char *a              = from->input - 1;
+    const char *b              = to->input - 1;
+    const unsigned long aSpace = (unsigned long)(from->inputEnd - a);
+    const unsigned long bSpace = (unsigned long)(to->inputEnd - b);
+    const unsigned long common =
+        commonPrefix(a, b, aSpace < bSpace ? aSpace : bSpace);
+    return scan_container(a + 1, a + common) != NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Patch
+
+static void beginOp(struct Diff *diff, const char *op)
+{
+    EzJSONWriteObjectBegin(diff->writer);
+    EzJSONWriteKey(diff->writer, "op", 2u);
+    EzJSONWriteString(diff->writer, op, (unsigned)strlen(op));
+    EzJSONWriteKey(diff->writer, "path", 4u);
+    EzJSONWriteEscapedString(
+        diff->writer, diff->path, (unsigned)diff->pathLength);
+}
+
+// An add or replace operation with the value starting with token of to
+static int writeOp(
+    struct Diff *diff, const char *op, const struct EzJSONToken *token)
+{
+    beginOp(diff, op);
+    EzJSONWriteKey(diff->writer, "value", 5u);
+    if (copyValue(diff, diff->to, token, diff->writer) != 0)
+    {
+        return -1;
+    }
+    EzJSONWriteObjectEnd(diff->writer);
+    return 0;
+}
+
+static void writeRemove(struct Diff *diff)
+{
+    beginOp(diff, "remove");
+    EzJSONWriteObjectEnd(diff->writer);
+}
+
+static int diffValue(
+    struct Diff *diff,
+    struct EzJSONParser *from,
+    const struct EzJSONToken *a,
+    const struct EzJSONToken *b);
+
+static int diffArray(struct Diff *diff, struct EzJSONParser *from)
+{
+    const struct EzJSONToken *a;
+    const struct EzJSONToken *b;
+    unsigned long index = 0;
+    unsigned long previous;
+
+    for (;; ++index)
+    {
+        if (!(a = next(diff, from)) || !(b = next(diff, diff->to)))
+        {
+            return -1;
+        }
+        if (token_is_end(a) && token_is_end(b))
+        {
+            return 0;
+        }
+
+        previous = pushIndex(diff, index);
+        if (token_is_end(a))
+        {
+            // Elements added at the end
+            for (;;)
+            {
+                if (writeOp(diff, "add", b) != 0 || !(b = next(diff, diff->to)))
+                {
+                    return -1;
+                }
+                popPath(diff, previous);
+                if (token_is_end(b))
+                {
+                    return 0;
+                }
+                previous = pushIndex(diff, ++index);
+            }
+        }
+        if (token_is_end(b))
+        {
+            // Elements removed from the end, each one moves the next to the
+            // same index
+            while (!token_is_end(a))
+            {
+                writeRemove(diff);
+                if (skipValue(diff, from, a) != 0 || !(a = next(diff, from)))
+                {
+                    return -1;
+                }
+            }
+            popPath(diff, previous);
+            return 0;
+        }
+
+        if (diffValue(diff, from, a, b) != 0)
+        {
+            return -1;
+        }
+        popPath(diff, previous);
+    }
+}
+
+// Decode the key of a buffered member into space, or allocated memory if it
+// does not fit. Returns null if memory ran out.
+static char *decodeKey(
+    struct Diff *diff, struct EzJSONValue key, char *space, unsigned *length)
+{
+    if (EzJSONValueGetString(key, space, KEY_SPACE, length) == 0)
+    {
+        return space;
+    }
+
+    char *text = allocate(diff, *length + 1u);
+    if (!text)
+    {
+        fail(diff, EZ_DE_NO_MEMORY);
+        return NULL;
+    }
+    EzJSONValueGetString(key, text, *length + 1u, length);
+    return text;
+}
+
+// Compare the buffered old value with the value starting with token of to,
+// reading the old one through a parser of its own
+static int diffBuffered(
+    struct Diff *diff, struct EzJSONValue value, const struct EzJSONToken *b)
+{
+    struct EzJSONParser parser;
+    const struct EzJSONToken *a;
+    const char *text;
+    unsigned long length;
+
+    EzJSONValueGetRaw(value, &text, &length);
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.userdata        = diff->from->settings.userdata;
+    parser.settings.allocate_memory = diff->from->settings.allocate_memory;
+    parser.settings.free_memory     = diff->from->settings.free_memory;
+    parser.settings.flags           = EZJ_PARSE_SKIP_SEPARATORS;
+    parser.settings.input           = text;
+    parser.settings.input_length    = length;
+    EzJSONParserInit(&parser);
+
+    int result = -1;
+    if ((a = next(diff, &parser)))
+    {
+        result = diffValue(diff, &parser, a, b);
+    }
+    EzJSONParserDestroy(&parser);
+    return result;
+}
+
+// Members from the first key mismatch on. The rest of the old object is
+// buffered, a starting with its current key, and the new members looked up
+// in it. Old members no new one matched are removed at the end.
+static int diffKeyed(
+    struct Diff *diff,
+    struct EzJSONParser *from,
+    const struct EzJSONToken *a,
+    const struct EzJSONToken *b)
+{
+    struct Buffer text = {diff, NULL, 0, 0};
+    struct Buffer seen = {diff, NULL, 0, 0}; // Offsets of matched values
+    struct EzJSONWriter writer;
+    struct EzJSONDocument document;
+    struct EzJSONIterator it;
+    struct EzJSONValue key;
+    struct EzJSONValue value;
+    struct EzJSONValue found;
+    unsigned long previous;
+    int result = -1;
+
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.userdata = &text;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &bufferWrite;
+    EzJSONWriteObjectBegin(&writer);
+    while (a->type == EZJ_TOKEN_OBJ_KEY)
+    {
+        token_write(from, a, &writer);
+        if (!(a = next(diff, from)) || copyValue(diff, from, a, &writer) != 0
+            || !(a = next(diff, from)))
+        {
+            EzJSONWriterDestroy(&writer);
+            release(diff, text.data, text.capacity);
+            return -1;
+        }
+    }
+    EzJSONWriteObjectEnd(&writer);
+    EzJSONWriterDestroy(&writer);
+
+    memset(&document, 0, sizeof(document));
+    document.settings.userdata        = diff->from->settings.userdata;
+    document.settings.allocate_memory = diff->from->settings.allocate_memory;
+    document.settings.free_memory     = diff->from->settings.free_memory;
+    EzJSONDocumentInit(&document, text.data, text.length);
+    const struct EzJSONValue object = EzJSONDocumentRoot(&document);
+    if (diff->error != EZ_DE_OK)
+    {
+        goto done;
+    }
+
+    while (b->type == EZJ_TOKEN_OBJ_KEY)
+    {
+        const int match =
+            EzJSONValueFind(object, b->data_text, b->data_text_length, &found);
+        previous = pushKey(diff, b->data_text, b->data_text_length);
+        if (!(b = next(diff, diff->to)))
+        {
+            goto done;
+        }
+
+        if (match != 0)
+        {
+            if (writeOp(diff, "add", b) != 0)
+            {
+                goto done;
+            }
+        }
+        else
+        {
+            bufferWrite(
+                &seen, (const char *)&found.offset, sizeof(found.offset));
+            if (diffBuffered(diff, found, b) != 0)
+            {
+                goto done;
+            }
+        }
+        popPath(diff, previous);
+
+        if (!(b = next(diff, diff->to)))
+        {
+            goto done;
+        }
+    }
+
+    EzJSONIteratorInit(object, &it);
+    while (EzJSONIteratorNext(&it, &key, &value) == 1)
+    {
+        const unsigned long *offsets = (const unsigned long *)seen.data;
+        const unsigned long matched  = seen.length / sizeof(unsigned long);
+        unsigned long i              = 0;
+        while (i < matched && offsets[i] != value.offset)
+        {
+            i++;
+        }
+        if (i < matched)
+        {
+            continue;
+        }
+
+        // Only the first of duplicate keys was looked up
+        char space[KEY_SPACE];
+        unsigned length;
+        char *name = decodeKey(diff, key, space, &length);
+        if (!name)
+        {
+            goto done;
+        }
+        if (EzJSONValueFind(object, name, length, &found) == 0
+            && found.offset == value.offset)
+        {
+            previous = pushKey(diff, name, length);
+            writeRemove(diff);
+            popPath(diff, previous);
+        }
+        if (name != space)
+        {
+            release(diff, name, length + 1u);
+        }
+    }
+    result = diff->error == EZ_DE_OK ? 0 : -1;
+
+done:
+    EzJSONDocumentDestroy(&document);
+    release(diff, seen.data, seen.capacity);
+    release(diff, text.data, text.capacity);
+    return result;
+}
+
+static int diffObject(struct Diff *diff, struct EzJSONParser *from)
+{
+    const struct EzJSONToken *a;
+    const struct EzJSONToken *b;
+    unsigned long previous;
+
+    for (;;)
+    {
+        if (!(a = next(diff, from)) || !(b = next(diff, diff->to)))
+        {
+            return -1;
+        }
+        if (token_is_end(a) && token_is_end(b))
+        {
+            return 0;
+        }
+
+        if (token_is_end(a))
+        {
+            // Members added at the end
+            while (!token_is_end(b))
+            {
+                previous = pushKey(diff, b->data_text, b->data_text_length);
+                if (!(b = next(diff, diff->to)) || writeOp(diff, "add", b) != 0
+                    || !(b = next(diff, diff->to)))
+                {
+                    return -1;
+                }
+                popPath(diff, previous);
+            }
+            return 0;
+        }
+        if (token_is_end(b))
+        {
+            while (!token_is_end(a))
+            {
+                previous = pushKey(diff, a->data_text, a->data_text_length);
+                writeRemove(diff);
+                popPath(diff, previous);
+                if (!(a = next(diff, from)) || skipValue(diff, from, a) != 0
+                    || !(a = next(diff, from)))
+                {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+
+        if (a->data_text_length != b->data_text_length
+            || memcmp(a->data_text, b->data_text, a->data_text_length) != 0)
+        {
+            return diffKeyed(diff, from, a, b);
+        }
+
+        previous = pushKey(diff, b->data_text, b->data_text_length);
+        if (!(a = next(diff, from)) || !(b = next(diff, diff->to))
+            || diffValue(diff, from, a, b) != 0)
+        {
+            return -1;
+        }
+        popPath(diff, previous);
+    }
+}
+
+// Compare the values starting with a in from and b in to
+static int diffValue(
+    struct Diff *diff,
+    struct EzJSONParser *from,
+    const struct EzJSONToken *a,
+    const struct EzJSONToken *b)
+{
+    if (a->type == b->type && token_is_begin(a))
+    {
+        // The text is left unchecked, the parsers only count brackets
+        if (sameText(from, diff->to))
+        {
+            if (EzJSONParserSkip(from) != 0)
+            {
+                return fail(diff, EZ_DE_FROM);
+            }
+            if (EzJSONParserSkip(diff->to) != 0)
+            {
+                return fail(diff, EZ_DE_TO);
+            }
+            return 0;
+        }
+        return a->type == EZJ_TOKEN_OBJ_BEGIN ? diffObject(diff, from)
+                                              : diffArray(diff, from);
+    }
+
+    if (a->type == b->type && equalScalars(from, a, diff->to, b))
+    {
+        return 0;
+    }
+
+    if (skipValue(diff, from, a) != 0)
+    {
+        return -1;
+    }
+    return writeOp(diff, "replace", b);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Interface
+
+enum EzJSONDiffError EzJSONDiff(
+    struct EzJSONParser *from,
+    struct EzJSONParser *to,
+    struct EzJSONWriter *writer)
+{
+    struct Diff diff;
+    const struct EzJSONToken *a;
+    const struct EzJSONToken *b;
+
+    diff.from         = from;
+    diff.to           = to;
+    diff.writer       = writer;
+    diff.path         = NULL;
+    diff.pathLength   = 0;
+    diff.pathCapacity = 0;
+    diff.error        = EZ_DE_OK;
+
+    EzJSONWriteArrayBegin(writer);
+    if ((a = next(&diff, from)) && (b = next(&diff, to))
+        && diffValue(&diff, from, a, b) == 0)
+    {
+        // Nothing may follow either document
+        EzJSONParserNext(from);
+        EzJSONParserNext(to);
+        if (EzJSONParserHasError(from))
+        {
+            fail(&diff, EZ_DE_FROM);
+        }
+        if (EzJSONParserHasError(to))
+        {
+            fail(&diff, EZ_DE_TO);
+        }
+    }
+    EzJSONWriteArrayEnd(writer);
+
+    release(&diff, diff.path, diff.pathCapacity);
+    return diff.error;
+}
+
+const char *EzJSONDiffErrorName(enum EzJSONDiffError error)
+{
+    switch (error)
+    {
+    case EZ_DE_OK:
+        return "no error";
+    case EZ_DE_FROM:
+        return "old document is malformed";
+    case EZ_DE_TO:
+        return "new document is malformed";
+    case EZ_DE_NO_MEMORY:
+        return "out of memory";
+    }
+    return "unknown error";
+}
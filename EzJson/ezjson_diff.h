@@ -0,0 +1,54 @@
+#ifndef __EZJSON_DIFF_H_INCLUDED__
+#define __EZJSON_DIFF_H_INCLUDED__
+
+#include "ezjson_common.h"
+#include "ezjson_parser.h"
+#include "ezjson_writer.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    // Structural diff of two documents, written as a JSON Patch (RFC 6902)
+    // that turns the first into the second. Both are read in lockstep and
+    // the patch is written as differences are found, so neither document
+    // is held in memory. Arrays are compared element by element. Object
+    // members are compared in order while their keys match. From the first
+    // mismatch on, the rest of the old object is buffered and looked up by
+    // key, so reordered members do not show up as changes.
+    //
+    // When both inputs are in memory, containers whose text is identical
+    // are recognised by comparing bytes and skipped without reading their
+    // tokens. Values taken from the new document are copied as raw bytes
+    // when it is in memory. Those copies are not validated.
+    //
+    // Numbers are compared by value, strings after decoding escapes. The
+    // patch uses replace, add and remove operations only, and removes
+    // trailing array elements one by one at the same index.
+
+    enum EzJSONDiffError
+    {
+        EZ_DE_OK,
+        EZ_DE_FROM,      // The old document failed to parse
+        EZ_DE_TO,        // The new document failed to parse
+        EZ_DE_NO_MEMORY, // Allocation through from's settings failed
+    };
+
+    /// Write the patch from the document read by from to the one read by
+    /// to, as an array of operations. Neither parser may have been stepped
+    /// yet. Memory is allocated through from's settings. On error the
+    /// output is incomplete.
+    enum EzJSONDiffError EzJSONDiff(
+        struct EzJSONParser *from,
+        struct EzJSONParser *to,
+        struct EzJSONWriter *writer);
+
+    /// Human readable description of an error
+    const char *EzJSONDiffErrorName(enum EzJSONDiffError);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //!__EZJSON_DIFF_H_INCLUDED__
@@ -0,0 +1,853 @@
+#include "ezjson_document.h"
+#include "ezjson_internal.h"
+#include "ezjson_parser.h"
+
+#include <memory.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+#define KEY_CACHE_INITIAL_SIZE 64u
+
+// Length of the per object progress entries, which are not keys
+#define KEY_PROGRESS 0xFFFFFFFFu
+
+// Numbers shorter than this are converted without allocating
+#define NUMBER_SPACE 64u
+
+struct EzJSONKeyCacheEntry
+{
+    unsigned long object; // Offset of the object's '{'
+    unsigned long key;    // Offset of the key's '"'. Progress: 1 when the
+                          // whole object was scanned.
+    unsigned long value;  // Offset of the value, 0 when the slot is empty.
+                          // Progress: offset after the last member visited.
+    uint32_t hash;        // EzJSONKeyHash of the decoded key
+    unsigned length;      // Decoded key length, or KEY_PROGRESS
+    int escaped;          // The key must be decoded to compare it
+};
+
+static void *allocate(struct EzJSONDocument *document, unsigned size)
+{
+    if (document->settings.allocate_memory)
+    {
+        return document->settings.allocate_memory(
+            document->settings.userdata, size);
+    }
+    return malloc(size);
+}
+
+static void release(struct EzJSONDocument *document, void *ptr, unsigned size)
+{
+    if (document->settings.free_memory)
+    {
+        document->settings.free_memory(document->settings.userdata, ptr, size);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Scanning
+
+static int isWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Characters that may follow a scalar
+static int isDelimiter(char c)
+{
+    return c == ',' || c == ']' || c == '}' || c == ':' || isWhitespace(c);
+}
+
+static unsigned long
+skipWhitespace(const struct EzJSONDocument *document, unsigned long pos)
+{
+    while (pos < document->inputLength && isWhitespace(document->input[pos]))
+    {
+        pos++;
+    }
+    return pos;
+}
+
+// The skip functions take the offset of the first byte of a value and return
+// the offset after it, or 0 if it is malformed.
+
+static unsigned long skipString(
+    const struct EzJSONDocument *document, unsigned long pos, int *escaped)
+{
+    const char *data = document->input;
+    const char *end  = data + document->inputLength;
+    const char *p    = data + pos + 1;
+
+    for (;;)
+    {
+        p = scan_string_end(p, end);
+        if (p == end)
+        {
+            return 0;
+        }
+
+        if (*p == '"')
+        {
+            return (unsigned long)(p + 1 - data);
+        }
+        if (end - p < 2)
+        {
+            return 0; // Escape cut off
+        }
+
+        *escaped = 1;
+        p += 2;
+    }
+}
+
+// Bracket counting. Strings are skipped so brackets inside them do not count,
+// everything else between brackets is passed over unchecked.
+static unsigned long
+skipContainer(const struct EzJSONDocument *document, unsigned long pos)
+{
+    const char *data    = document->input;
+    const char *end     = data + document->inputLength;
+    const char *p       = data + pos + 1;
+    unsigned long depth = 1;
+
+    for (;;)
+    {
+        p = scan_structural(p, end);
+        if (p == end)
+        {
+            return 0;
+        }
+
+        switch (*p)
+        {
+        case '"':
+        {
+            int escaped              = 0;
+            const unsigned long next =
+                skipString(document, (unsigned long)(p - data), &escaped);
+            if (next == 0)
+            {
+                return 0;
+            }
+            p = data + next;
+            continue;
+        }
+
+        case '[':
+        case '{':
+            depth++;
+            break;
+
+        default:
+            if (--depth == 0)
+            {
+                return (unsigned long)(p + 1 - data);
+            }
+            break;
+        }
+        p++;
+    }
+}
+
+static unsigned long
+skipValue(const struct EzJSONDocument *document, unsigned long pos)
+{
+    int escaped = 0;
+
+    if (pos >= document->inputLength)
+    {
+        return 0;
+    }
+
+    switch (document->input[pos])
+    {
+    case '"':
+        return skipString(document, pos, &escaped);
+
+    case '[':
+    case '{':
+        return skipContainer(document, pos);
+
+    default:
+    {
+        const unsigned long start = pos;
+        while (pos < document->inputLength
+               && !isDelimiter(document->input[pos]))
+        {
+            pos++;
+        }
+        return pos > start ? pos : 0;
+    }
+    }
+}
+
+struct Member
+{
+    unsigned long key;    // Offset of the key's '"'
+    unsigned long keyEnd; // Offset after the key's closing '"'
+    unsigned long value;  // Offset of the value
+    int escaped;
+};
+
+// Read the member starting at pos, after '{' or ','. Returns the offset after
+// its value, or 0 if it is malformed.
+static unsigned long readMember(
+    const struct EzJSONDocument *document,
+    unsigned long pos,
+    struct Member *member)
+{
+    if (pos >= document->inputLength || document->input[pos] != '"')
+    {
+        return 0;
+    }
+
+    member->key     = pos;
+    member->escaped = 0;
+    member->keyEnd  = skipString(document, pos, &member->escaped);
+    if (member->keyEnd == 0)
+    {
+        return 0;
+    }
+
+    pos = skipWhitespace(document, member->keyEnd);
+    if (pos >= document->inputLength || document->input[pos] != ':')
+    {
+        return 0;
+    }
+
+    member->value = skipWhitespace(document, pos + 1);
+    return skipValue(document, member->value);
+}
+
+// Step over whitespace and the ',' before the next element of a container.
+// Returns the offset of the element, or of the closing bracket, and 0 if the
+// container is malformed.
+static unsigned long nextElement(
+    const struct EzJSONDocument *document,
+    unsigned long pos,
+    char close,
+    int first)
+{
+    pos = skipWhitespace(document, pos);
+    if (pos >= document->inputLength)
+    {
+        return 0;
+    }
+
+    if (document->input[pos] == close || first)
+    {
+        return pos;
+    }
+    if (document->input[pos] != ',')
+    {
+        return 0;
+    }
+
+    pos = skipWhitespace(document, pos + 1);
+    if (pos >= document->inputLength || document->input[pos] == close)
+    {
+        return 0; // Trailing separator
+    }
+    return pos;
+}
+
+// Decode the string at pos with a parser over just that string. The text
+// stays valid until the parser is destroyed, which the caller must do.
+static const struct EzJSONToken *decodeString(
+    struct EzJSONDocument *document,
+    unsigned long pos,
+    unsigned long end,
+    struct EzJSONParser *parser)
+{
+    memset(&parser->settings, 0, sizeof(parser->settings));
+    parser->settings.userdata        = document->settings.userdata;
+    parser->settings.allocate_memory = document->settings.allocate_memory;
+    parser->settings.free_memory     = document->settings.free_memory;
+    parser->settings.input           = document->input + pos;
+    parser->settings.input_length    = end - pos;
+    EzJSONParserInit(parser);
+
+    EzJSONParserNext(parser);
+    const struct EzJSONToken *token = EzJSONParserToken(parser);
+    return token && token->type == EZJ_TOKEN_STRING ? token : NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Key cache
+
+static uint32_t
+cacheSlot(struct EzJSONDocument *document, unsigned long object, uint32_t hash)
+{
+    const uint32_t mixed = (uint32_t)object * 0x9E3779B1u ^ hash;
+    return mixed & (document->keyCapacity - 1);
+}
+
+static int keyEquals(
+    struct EzJSONDocument *document,
+    const struct EzJSONKeyCacheEntry *entry,
+    const char *key,
+    unsigned length)
+{
+    if (!entry->escaped)
+    {
+        return memcmp(document->input + entry->key + 1, key, length) == 0;
+    }
+
+    struct EzJSONParser parser;
+    int escaped             = 0;
+    const unsigned long end = skipString(document, entry->key, &escaped);
+    const struct EzJSONToken *token =
+        decodeString(document, entry->key, end, &parser);
+    const int equal = token && token->data_text_length == length
+                      && memcmp(token->data_text, key, length) == 0;
+    EzJSONParserDestroy(&parser);
+    return equal;
+}
+
+static struct EzJSONKeyCacheEntry *cacheFind(
+    struct EzJSONDocument *document,
+    unsigned long object,
+    uint32_t hash,
+    const char *key,
+    unsigned length)
+{
+    if (document->keyCapacity == 0)
+    {
+        return NULL;
+    }
+
+    uint32_t slot = cacheSlot(document, object, hash);
+    for (;;)
+    {
+        struct EzJSONKeyCacheEntry *entry = &document->keys[slot];
+        if (entry->value == 0)
+        {
+            return NULL;
+        }
+        if (entry->object == object && entry->hash == hash
+            && entry->length == length
+            && (length == KEY_PROGRESS
+                || keyEquals(document, entry, key, length)))
+        {
+            return entry;
+        }
+        slot = (slot + 1) & (document->keyCapacity - 1);
+    }
+}
+
+static void cachePlace(
+    struct EzJSONDocument *document, const struct EzJSONKeyCacheEntry *entry)
+{
+    uint32_t slot = cacheSlot(document, entry->object, entry->hash);
+    while (document->keys[slot].value != 0)
+    {
+        slot = (slot + 1) & (document->keyCapacity - 1);
+    }
+    document->keys[slot] = *entry;
+    document->keyCount++;
+}
+
+// Returns non-zero if the table could not be grown. Entries are appended to
+// their probe sequence, so the first of several equal keys is found first.
+static int
+cacheInsert(struct EzJSONDocument *document, struct EzJSONKeyCacheEntry *entry)
+{
+    if ((document->keyCount + 1) * 2 > document->keyCapacity)
+    {
+        const unsigned oldCapacity = document->keyCapacity;
+        struct EzJSONKeyCacheEntry *oldKeys = document->keys;
+        const unsigned newCapacity =
+            oldCapacity ? oldCapacity * 2 : KEY_CACHE_INITIAL_SIZE;
+        const unsigned newBytes =
+            newCapacity * (unsigned)sizeof(struct EzJSONKeyCacheEntry);
+
+        struct EzJSONKeyCacheEntry *newKeys = allocate(document, newBytes);
+        if (!newKeys)
+        {
+            return -1;
+        }
+        memset(newKeys, 0, newBytes);
+
+        document->keys        = newKeys;
+        document->keyCapacity = newCapacity;
+        document->keyCount    = 0;
+        for (unsigned i = 0; i < oldCapacity; ++i)
+        {
+            if (oldKeys[i].value != 0)
+            {
+                cachePlace(document, &oldKeys[i]);
+            }
+        }
+
+        if (oldKeys)
+        {
+            release(
+                document,
+                oldKeys,
+                oldCapacity * (unsigned)sizeof(struct EzJSONKeyCacheEntry));
+        }
+    }
+
+    cachePlace(document, entry);
+    return 0;
+}
+
+static void setProgress(
+    struct EzJSONDocument *document,
+    unsigned long object,
+    unsigned long pos,
+    int complete)
+{
+    struct EzJSONKeyCacheEntry *progress =
+        cacheFind(document, object, 0, NULL, KEY_PROGRESS);
+    if (progress)
+    {
+        progress->key   = (unsigned long)complete;
+        progress->value = pos;
+        return;
+    }
+
+    struct EzJSONKeyCacheEntry entry;
+    entry.object  = object;
+    entry.key     = (unsigned long)complete;
+    entry.value   = pos;
+    entry.hash    = 0;
+    entry.length  = KEY_PROGRESS;
+    entry.escaped = 0;
+    cacheInsert(document, &entry);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void EzJSONDocumentInit(
+    struct EzJSONDocument *document, const char *input, unsigned long length)
+{
+    document->input       = input;
+    document->inputLength = length;
+    document->keys        = NULL;
+    document->keyCapacity = 0;
+    document->keyCount    = 0;
+}
+
+void EzJSONDocumentDestroy(struct EzJSONDocument *document)
+{
+    if (document->keys)
+    {
+        release(
+            document,
+            document->keys,
+            document->keyCapacity
+                * (unsigned)sizeof(struct EzJSONKeyCacheEntry));
+    }
+    document->keys        = NULL;
+    document->keyCapacity = 0;
+    document->keyCount    = 0;
+}
+
+struct EzJSONValue EzJSONDocumentRoot(struct EzJSONDocument *document)
+{
+    struct EzJSONValue root;
+    root.document = document;
+    root.offset   = skipWhitespace(document, 0);
+    return root;
+}
+
+enum EzJSONValueType EzJSONValueGetType(struct EzJSONValue value)
+{
+    if (value.offset >= value.document->inputLength)
+    {
+        return EZJ_VALUE_INVALID;
+    }
+
+    switch (value.document->input[value.offset])
+    {
+    case '{':
+        return EZJ_VALUE_OBJECT;
+    case '[':
+        return EZJ_VALUE_ARRAY;
+    case '"':
+        return EZJ_VALUE_STRING;
+    case 't':
+    case 'f':
+        return EZJ_VALUE_BOOL;
+    case 'n':
+        return EZJ_VALUE_NULL;
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        return EZJ_VALUE_NUMBER;
+    default:
+        return EZJ_VALUE_INVALID;
+    }
+}
+
+int EzJSONValueFind(
+    struct EzJSONValue object,
+    const char *key,
+    unsigned length,
+    struct EzJSONValue *out)
+{
+    struct EzJSONDocument *document = object.document;
+
+    if (EzJSONValueGetType(object) != EZJ_VALUE_OBJECT)
+    {
+        return -1;
+    }
+
+    const uint32_t hash = key_hash(KEY_HASH_SEED, key, length);
+    const struct EzJSONKeyCacheEntry *cached =
+        cacheFind(document, object.offset, hash, key, length);
+    if (cached)
+    {
+        out->document = document;
+        out->offset   = cached->value;
+        return 0;
+    }
+
+    // Continue where the last lookup in this object stopped
+    const struct EzJSONKeyCacheEntry *progress =
+        cacheFind(document, object.offset, 0, NULL, KEY_PROGRESS);
+    if (progress && progress->key)
+    {
+        return 1;
+    }
+
+    unsigned long pos = progress ? progress->value : object.offset + 1;
+    int first         = !progress;
+
+    for (;;)
+    {
+        pos = nextElement(document, pos, '}', first);
+        if (pos == 0)
+        {
+            return -1;
+        }
+        if (document->input[pos] == '}')
+        {
+            setProgress(document, object.offset, pos, 1);
+            return 1;
+        }
+        first = 0;
+
+        struct Member member;
+        const unsigned long end = readMember(document, pos, &member);
+        if (end == 0)
+        {
+            return -1;
+        }
+
+        struct EzJSONKeyCacheEntry entry;
+        entry.object  = object.offset;
+        entry.key     = member.key;
+        entry.value   = member.value;
+        entry.escaped = member.escaped;
+
+        int match;
+        if (!member.escaped)
+        {
+            const char *text = document->input + member.key + 1;
+            entry.length     = (unsigned)(member.keyEnd - member.key - 2);
+            entry.hash       = key_hash(KEY_HASH_SEED, text, entry.length);
+            match = entry.hash == hash && entry.length == length
+                    && memcmp(text, key, length) == 0;
+        }
+        else
+        {
+            struct EzJSONParser parser;
+            const struct EzJSONToken *token =
+                decodeString(document, member.key, member.keyEnd, &parser);
+            if (!token)
+            {
+                EzJSONParserDestroy(&parser);
+                return -1;
+            }
+            entry.length = token->data_text_length;
+            entry.hash   = key_hash(
+                KEY_HASH_SEED, token->data_text, token->data_text_length);
+            match = entry.hash == hash && entry.length == length
+                    && memcmp(token->data_text, key, length) == 0;
+            EzJSONParserDestroy(&parser);
+        }
+
+        // A member is only skipped by later lookups once it is cached
+        if (cacheInsert(document, &entry) == 0)
+        {
+            setProgress(document, object.offset, end, 0);
+        }
+
+        if (match)
+        {
+            out->document = document;
+            out->offset   = member.value;
+            return 0;
+        }
+        pos = end;
+    }
+}
+
+int EzJSONValueAt(
+    struct EzJSONValue array, unsigned index, struct EzJSONValue *out)
+{
+    struct EzJSONIterator it;
+
+    if (EzJSONValueGetType(array) != EZJ_VALUE_ARRAY
+        || EzJSONIteratorInit(array, &it) != 0)
+    {
+        return -1;
+    }
+
+    for (unsigned i = 0;; ++i)
+    {
+        const int result = EzJSONIteratorNext(&it, NULL, out);
+        if (result <= 0)
+        {
+            return result == 0 ? 1 : -1;
+        }
+        if (i == index)
+        {
+            return 0;
+        }
+    }
+}
+
+// Scan the number at the value and check that nothing follows it
+static const char *
+scanValueNumber(struct EzJSONValue value, struct NumberParts *parts)
+{
+    const struct EzJSONDocument *document = value.document;
+    const char *end = document->input + document->inputLength;
+
+    if (EzJSONValueGetType(value) != EZJ_VALUE_NUMBER)
+    {
+        return NULL;
+    }
+
+    const char *p = number_scan(document->input + value.offset, end, parts);
+    if (!p || (p < end && !isDelimiter(*p)))
+    {
+        return NULL;
+    }
+    return p;
+}
+
+int EzJSONValueGetNumber(struct EzJSONValue value, double *out)
+{
+    struct NumberParts parts;
+    const char *end = scanValueNumber(value, &parts);
+
+    if (!end)
+    {
+        return -1;
+    }
+    if (number_fast_double(&parts, out))
+    {
+        return 0;
+    }
+
+    // strtod needs terminated text, which the input is not
+    const char *text      = value.document->input + value.offset;
+    const unsigned length = (unsigned)(end - text);
+    char space[NUMBER_SPACE];
+    char *copy = space;
+
+    if (length >= NUMBER_SPACE)
+    {
+        copy = allocate(value.document, length + 1);
+        if (!copy)
+        {
+            return -1;
+        }
+    }
+
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    *out         = strtod(copy, NULL);
+
+    if (copy != space)
+    {
+        release(value.document, copy, length + 1);
+    }
+    return 0;
+}
+
+int EzJSONValueGetInt64(struct EzJSONValue value, int64_t *out)
+{
+    struct NumberParts parts;
+
+    if (!scanValueNumber(value, &parts) || !number_to_int64(&parts, out))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int EzJSONValueGetBool(struct EzJSONValue value, EzJSONBool *out)
+{
+    const struct EzJSONDocument *document = value.document;
+    const unsigned long end = skipValue(document, value.offset);
+
+    if (EzJSONValueGetType(value) != EZJ_VALUE_BOOL)
+    {
+        return -1;
+    }
+
+    const char *text = document->input + value.offset;
+    if (end - value.offset == 4 && memcmp(text, "true", 4) == 0)
+    {
+        *out = 1;
+        return 0;
+    }
+    if (end - value.offset == 5 && memcmp(text, "false", 5) == 0)
+    {
+        *out = 0;
+        return 0;
+    }
+    return -1;
+}
+
+int EzJSONValueGetString(
+    struct EzJSONValue value, char *out, unsigned capacity, unsigned *length)
+{
+    struct EzJSONDocument *document = value.document;
+    int escaped                     = 0;
+
+    if (EzJSONValueGetType(value) != EZJ_VALUE_STRING)
+    {
+        return -1;
+    }
+
+    const unsigned long end = skipString(document, value.offset, &escaped);
+    if (end == 0)
+    {
+        return -1;
+    }
+
+    // Without escapes the text is used as it is
+    if (!escaped)
+    {
+        *length = (unsigned)(end - value.offset - 2);
+        if (*length >= capacity)
+        {
+            return 1;
+        }
+        memcpy(out, document->input + value.offset + 1, *length);
+        out[*length] = '\0';
+        return 0;
+    }
+
+    struct EzJSONParser parser;
+    const struct EzJSONToken *token =
+        decodeString(document, value.offset, end, &parser);
+    int result = -1;
+    if (token)
+    {
+        *length = token->data_text_length;
+        result  = 1;
+        if (*length < capacity)
+        {
+            memcpy(out, token->data_text, *length);
+            out[*length] = '\0';
+            result       = 0;
+        }
+    }
+    EzJSONParserDestroy(&parser);
+    return result;
+}
+
+int EzJSONValueGetRaw(
+    struct EzJSONValue value, const char **text, unsigned long *length)
+{
+    const unsigned long end = skipValue(value.document, value.offset);
+
+    if (end == 0)
+    {
+        return -1;
+    }
+
+    *text   = value.document->input + value.offset;
+    *length = end - value.offset;
+    return 0;
+}
+
+int EzJSONIteratorInit(struct EzJSONValue value, struct EzJSONIterator *it)
+{
+    switch (EzJSONValueGetType(value))
+    {
+    case EZJ_VALUE_OBJECT:
+        it->close = '}';
+        break;
+    case EZJ_VALUE_ARRAY:
+        it->close = ']';
+        break;
+    default:
+        return -1;
+    }
+
+    it->document = value.document;
+    it->offset   = value.offset + 1;
+    it->first    = 1;
+    return 0;
+}
+
+int EzJSONIteratorNext(
+    struct EzJSONIterator *it,
+    struct EzJSONValue *key,
+    struct EzJSONValue *value)
+{
+    const unsigned long pos =
+        nextElement(it->document, it->offset, it->close, it->first);
+    unsigned long end;
+
+    if (pos == 0)
+    {
+        return -1;
+    }
+    if (it->document->input[pos] == it->close)
+    {
+        it->offset = pos;
+        it->first  = 1; // Stay at the end on further calls
+        return 0;
+    }
+
+    struct Member member;
+    if (it->close == '}')
+    {
+        end = readMember(it->document, pos, &member);
+    }
+    else
+    {
+        end          = skipValue(it->document, pos);
+        member.value = pos;
+    }
+
+    // The outputs are left untouched on error
+    if (end == 0)
+    {
+        return -1;
+    }
+
+    if (key && it->close == '}')
+    {
+        key->document = it->document;
+        key->offset   = member.key;
+    }
+    value->document = it->document;
+    value->offset   = member.value;
+    it->offset      = end;
+    it->first       = 0;
+    return 1;
+}
@@ -0,0 +1,132 @@
+#ifndef __EZJSON_DOCUMENT_H_INCLUDED__
+#define __EZJSON_DOCUMENT_H_INCLUDED__
+
+#include "ezjson_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    // On-demand access to a document held in memory. Nothing is parsed up
+    // front: values are handles holding an offset into the input, and are
+    // only parsed when read. Lookups skip the subtrees they pass over with a
+    // bracket counting scan and remember where every key they passed starts,
+    // so later lookups in the same object do not scan it again.
+    //
+    // Skipped subtrees are not validated, only values that are read are.
+    // A malformed document may therefore work until the broken part is
+    // reached.
+
+    enum EzJSONValueType
+    {
+        EZJ_VALUE_INVALID, // Not the start of a value, or past the end
+        EZJ_VALUE_OBJECT,
+        EZJ_VALUE_ARRAY,
+        EZJ_VALUE_STRING,
+        EZJ_VALUE_NUMBER,
+        EZJ_VALUE_BOOL,
+        EZJ_VALUE_NULL,
+    };
+
+    struct EzJSONDocumentSettings
+    {
+        void *userdata;              // Optional, passed to the allocator
+        EzJSONAlloc allocate_memory; // Optional, uses malloc() if not set
+        EzJSONFree free_memory;      // Optional, uses free() if not set
+    };
+
+    struct EzJSONKeyCacheEntry;
+
+    struct EzJSONDocument
+    {
+        struct EzJSONDocumentSettings settings;
+
+        const char *input; // Must outlive the document
+        unsigned long inputLength;
+
+        // Positions of visited keys and scan progress per object, an open
+        // addressing table allocated on the first lookup
+        struct EzJSONKeyCacheEntry *keys;
+        unsigned keyCapacity;
+        unsigned keyCount;
+    };
+
+    /// Handle to a value, valid as long as its document
+    struct EzJSONValue
+    {
+        struct EzJSONDocument *document;
+        unsigned long offset; // First byte of the value
+    };
+
+    /// Position inside an array or object, see EzJSONIteratorNext
+    struct EzJSONIterator
+    {
+        struct EzJSONDocument *document;
+        unsigned long offset; // After '[', '{' or the previous element
+        char close;           // ']' or '}'
+        char first;
+    };
+
+    /// Set up a document over length bytes of input. Settings must be filled
+    /// in before, and are kept as they are.
+    void EzJSONDocumentInit(
+        struct EzJSONDocument *, const char *input, unsigned long length);
+
+    /// Free the key cache
+    void EzJSONDocumentDestroy(struct EzJSONDocument *);
+
+    /// The top level value
+    struct EzJSONValue EzJSONDocumentRoot(struct EzJSONDocument *);
+
+    /// Type of the value, from its first byte
+    enum EzJSONValueType EzJSONValueGetType(struct EzJSONValue);
+
+    /// Find key in an object. Returns 0 and sets out when found, 1 if the
+    /// object has no such key, -1 if value is not an object or is malformed.
+    /// With duplicate keys the first one wins.
+    int EzJSONValueFind(
+        struct EzJSONValue object,
+        const char *key,
+        unsigned length,
+        struct EzJSONValue *out);
+
+    /// Element index of an array. Returns 0 and sets out when found, 1 if the
+    /// array is shorter, -1 if value is not an array or is malformed.
+    int EzJSONValueAt(
+        struct EzJSONValue array, unsigned index, struct EzJSONValue *out);
+
+    /// Read a value. Return 0 on success and -1 if the value has a different
+    /// type or is malformed.
+    int EzJSONValueGetNumber(struct EzJSONValue, double *out);
+    int EzJSONValueGetInt64(struct EzJSONValue, int64_t *out);
+    int EzJSONValueGetBool(struct EzJSONValue, EzJSONBool *out);
+
+    /// Decode a string, escapes included, into out and terminate it. length is
+    /// set to the decoded length, without the terminator, even when it does
+    /// not fit: returns 1 in that case and out holds nothing useful.
+    int EzJSONValueGetString(
+        struct EzJSONValue, char *out, unsigned capacity, unsigned *length);
+
+    /// The JSON text of a value, e.g. to hand a subtree to EzJSONParser.
+    /// Returns -1 if the value is malformed.
+    int EzJSONValueGetRaw(
+        struct EzJSONValue, const char **text, unsigned long *length);
+
+    /// Start iterating the elements of an array or the members of an object.
+    /// Returns -1 if value is neither.
+    int EzJSONIteratorInit(struct EzJSONValue, struct EzJSONIterator *);
+
+    /// Step to the next element. Sets key (objects only, may be null) and
+    /// value, and returns 1. Returns 0 after the last element and -1 if the
+    /// container is malformed, leaving key and value untouched.
+    int EzJSONIteratorNext(
+        struct EzJSONIterator *,
+        struct EzJSONValue *key,
+        struct EzJSONValue *value);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //!__EZJSON_DOCUMENT_H_INCLUDED__
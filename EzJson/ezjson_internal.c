@@ -1,16 +1,16 @@
 #include "ezjson_internal.h"
+#include "ezjson_parser.h"
+#include "ezjson_writer.h"
 
 #include <memory.h>
 #include <stdlib.h>
 
-unsigned STACK_BIT_ARRAY  = 0;
-unsigned STACK_BIT_OBJECT = 1;
-
-void stack_init(struct EzJSONBitStack *stack)
+void stack_init(struct EzJSONBitStack *stack, unsigned maxDepth)
 {
-    stack->data = stack->inlineData;
-    stack->size = EZJSON_INLINE_STACK_SIZE;
-    stack->top  = 0;
+    stack->data     = stack->inlineData;
+    stack->size     = EZJSON_INLINE_STACK_SIZE;
+    stack->top      = 0;
+    stack->maxDepth = maxDepth;
 }
 
 void stack_destroy(
@@ -20,100 +20,709 @@ void stack_destroy(
     {
         if (dealloc)
         {
-            dealloc(userdata, stack->data, stack->size);
+            dealloc(
+                userdata,
+                stack->data,
+                stack->size * (unsigned)sizeof(EzJSONStackChunk));
         }
         else
         {
             free(stack->data);
         }
+        stack->data = stack->inlineData;
+        stack->size = EZJSON_INLINE_STACK_SIZE;
     }
 }
 
-int stack_full(struct EzJSONBitStack *stack)
+int stack_grow(
+    struct EzJSONBitStack *stack,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc)
 {
-    return stack->top == stack->size * sizeof(EzJSONStackChunk);
+    const unsigned newSize = (stack->size > 0) ? stack->size * 2 : 1;
+    const unsigned newBytes = newSize * (unsigned)sizeof(EzJSONStackChunk);
+    EzJSONStackChunk *newData = NULL;
+
+    if (alloc)
+    {
+        newData = (EzJSONStackChunk *)alloc(userdata, newBytes);
+    }
+    else
+    {
+        newData = (EzJSONStackChunk *)malloc(newBytes);
+    }
+
+    if (!newData)
+    {
+        return -1;
+    }
+
+    memcpy(newData, stack->data, stack->size * sizeof(EzJSONStackChunk));
+
+    stack_destroy(stack, userdata, dealloc);
+
+    stack->data = newData;
+    stack->size = newSize;
+    return 0;
 }
 
-int stack_empty(struct EzJSONBitStack *stack)
+// Key pool
+
+static void *poolAlloc(void *userdata, EzJSONAlloc alloc, unsigned size)
 {
-    return stack->top == 0;
+    return alloc ? (void *)alloc(userdata, size) : malloc(size);
 }
 
-int stack_top(struct EzJSONBitStack *stack)
+static void
+poolFree(void *userdata, EzJSONFree dealloc, void *ptr, unsigned size)
 {
-    const unsigned iChunk = (stack->top - 1) / sizeof(EzJSONStackChunk);
-    const unsigned iBit   = (stack->top - 1) % sizeof(EzJSONStackChunk);
+    if (!ptr)
+    {
+        return;
+    }
+    if (dealloc)
+    {
+        dealloc(userdata, ptr, size);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
 
-    return (stack->data[iChunk] & (1 << iBit)) != 0;
+void key_pool_init(struct EzJSONKeyPool *pool)
+{
+    pool->keys      = NULL;
+    pool->count     = 0;
+    pool->capacity  = 0;
+    pool->table     = NULL;
+    pool->tableSize = 0;
+    pool->chunks    = NULL;
+    pool->chunkUsed = 0;
+    for (unsigned i = 0; i < EZJSON_KEY_PREDICT_DEPTH; ++i)
+    {
+        pool->first[i] = KEY_NONE;
+        pool->last[i]  = KEY_NONE;
+    }
 }
 
-void stack_grow(
-    struct EzJSONBitStack *stack,
+void key_pool_destroy(
+    struct EzJSONKeyPool *pool, void *userdata, EzJSONFree dealloc)
+{
+    while (pool->chunks)
+    {
+        struct EzJSONKeyChunk *next = pool->chunks->next;
+        poolFree(
+            userdata,
+            dealloc,
+            pool->chunks,
+            (unsigned)sizeof(struct EzJSONKeyChunk) + pool->chunks->size);
+        pool->chunks = next;
+    }
+    poolFree(
+        userdata,
+        dealloc,
+        pool->keys,
+        pool->capacity * (unsigned)sizeof(struct EzJSONInternedKey));
+    poolFree(
+        userdata,
+        dealloc,
+        pool->table,
+        pool->tableSize * (unsigned)sizeof(uint32_t));
+    key_pool_init(pool);
+}
+
+// Copy text into the current chunk, starting a new one when it is full.
+// Keys larger than a chunk get one of their own.
+static const char *storeText(
+    struct EzJSONKeyPool *pool,
+    const char *text,
+    unsigned length,
+    void *userdata,
+    EzJSONAlloc alloc)
+{
+    if (!pool->chunks || pool->chunks->size - pool->chunkUsed < length + 1)
+    {
+        const unsigned size =
+            length + 1 > KEY_CHUNK_SIZE ? length + 1 : KEY_CHUNK_SIZE;
+        struct EzJSONKeyChunk *chunk = (struct EzJSONKeyChunk *)poolAlloc(
+            userdata, alloc, (unsigned)sizeof(struct EzJSONKeyChunk) + size);
+        if (!chunk)
+        {
+            return NULL;
+        }
+        chunk->next     = pool->chunks;
+        chunk->size     = size;
+        pool->chunks    = chunk;
+        pool->chunkUsed = 0;
+    }
+
+    char *out = (char *)(pool->chunks + 1) + pool->chunkUsed;
+    memcpy(out, text, length);
+    out[length] = '\0';
+    pool->chunkUsed += length + 1;
+    return out;
+}
+
+// Double the table and reinsert every key. Returns non-zero if memory ran
+// out.
+static int growTable(
+    struct EzJSONKeyPool *pool,
     void *userdata,
     EzJSONAlloc alloc,
     EzJSONFree dealloc)
 {
-    const unsigned newSize    = (stack->size > 0) ? stack->size * 2 : 1;
-    EzJSONStackChunk *newData = NULL;
+    const unsigned newSize  = pool->tableSize ? pool->tableSize * 2 : 64;
+    const unsigned newBytes = newSize * (unsigned)sizeof(uint32_t);
+    uint32_t *newTable      = (uint32_t *)poolAlloc(userdata, alloc, newBytes);
+    if (!newTable)
+    {
+        return -1;
+    }
 
-    if (alloc)
+    memset(newTable, 0, newBytes);
+    for (uint32_t id = 0; id < pool->count; ++id)
+    {
+        unsigned slot = pool->keys[id].hash & (newSize - 1);
+        while (newTable[slot] != 0)
+        {
+            slot = (slot + 1) & (newSize - 1);
+        }
+        newTable[slot] = id + 1;
+    }
+
+    poolFree(
+        userdata,
+        dealloc,
+        pool->table,
+        pool->tableSize * (unsigned)sizeof(uint32_t));
+    pool->table     = newTable;
+    pool->tableSize = newSize;
+    return 0;
+}
+
+static int growKeys(
+    struct EzJSONKeyPool *pool,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc)
+{
+    const unsigned newCapacity = pool->capacity ? pool->capacity * 2 : 32;
+    struct EzJSONInternedKey *newKeys = (struct EzJSONInternedKey *)poolAlloc(
+        userdata,
+        alloc,
+        newCapacity * (unsigned)sizeof(struct EzJSONInternedKey));
+    if (!newKeys)
     {
-        newData = alloc(userdata, newSize);
+        return -1;
     }
-    else
+
+    if (pool->count > 0)
     {
-        newData = malloc(newSize);
+        memcpy(
+            newKeys,
+            pool->keys,
+            pool->count * sizeof(struct EzJSONInternedKey));
     }
+    poolFree(
+        userdata,
+        dealloc,
+        pool->keys,
+        pool->capacity * (unsigned)sizeof(struct EzJSONInternedKey));
+    pool->keys     = newKeys;
+    pool->capacity = newCapacity;
+    return 0;
+}
 
-    memcpy(newData, stack->data, stack->size);
+static int keyMatches(
+    const struct EzJSONInternedKey *key,
+    const char *text,
+    unsigned length,
+    uint32_t hash)
+{
+    return key->hash == hash && key->length == length
+           && memcmp(key->text, text, length) == 0;
+}
 
-    if (stack->data != stack->inlineData)
+static uint32_t findOrAdd(
+    struct EzJSONKeyPool *pool,
+    const char *text,
+    unsigned length,
+    uint32_t hash,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc)
+{
+    unsigned slot = 0;
+
+    if (pool->tableSize > 0)
     {
-        if (dealloc)
+        slot = hash & (pool->tableSize - 1);
+        while (pool->table[slot] != 0)
         {
-            dealloc(userdata, stack->data, stack->size);
+            const uint32_t id = pool->table[slot] - 1;
+            if (keyMatches(&pool->keys[id], text, length, hash))
+            {
+                return id;
+            }
+            slot = (slot + 1) & (pool->tableSize - 1);
         }
-        else
+    }
+
+    // New key. The table is kept at most half full.
+    if ((pool->count + 1) * 2 > pool->tableSize)
+    {
+        if (growTable(pool, userdata, alloc, dealloc) != 0)
         {
-            free(stack->data);
+            return KEY_NONE;
         }
+        slot = hash & (pool->tableSize - 1);
+        while (pool->table[slot] != 0)
+        {
+            slot = (slot + 1) & (pool->tableSize - 1);
+        }
+    }
+    if (pool->count == pool->capacity
+        && growKeys(pool, userdata, alloc, dealloc) != 0)
+    {
+        return KEY_NONE;
     }
 
-    stack->data = newData;
-    stack->size = newSize;
+    const char *stored = storeText(pool, text, length, userdata, alloc);
+    if (!stored)
+    {
+        return KEY_NONE;
+    }
+
+    const uint32_t id     = pool->count++;
+    pool->keys[id].text   = stored;
+    pool->keys[id].length = length;
+    pool->keys[id].hash   = hash;
+    pool->keys[id].next   = KEY_NONE;
+    pool->table[slot]     = id + 1;
+    return id;
 }
 
-void stack_push(
-    struct EzJSONBitStack *stack,
-    int bit,
+uint32_t key_pool_intern(
+    struct EzJSONKeyPool *pool,
+    unsigned depth,
+    const char *text,
+    unsigned length,
+    uint32_t hash,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc)
+{
+    if (depth >= EZJSON_KEY_PREDICT_DEPTH)
+    {
+        return findOrAdd(pool, text, length, hash, userdata, alloc, dealloc);
+    }
+
+    // Objects of one kind repeat their keys in the same order, so the key
+    // that followed the previous one last time is checked first
+    const uint32_t previous = pool->last[depth];
+    const uint32_t predicted =
+        previous == KEY_NONE ? pool->first[depth] : pool->keys[previous].next;
+
+    uint32_t id;
+    if (predicted != KEY_NONE
+        && keyMatches(&pool->keys[predicted], text, length, hash))
+    {
+        id = predicted;
+    }
+    else
+    {
+        id = findOrAdd(pool, text, length, hash, userdata, alloc, dealloc);
+        if (id == KEY_NONE)
+        {
+            return KEY_NONE;
+        }
+    }
+
+    if (previous == KEY_NONE)
+    {
+        pool->first[depth] = id;
+    }
+    else
+    {
+        pool->keys[previous].next = id;
+    }
+    pool->last[depth] = id;
+    return id;
+}
+
+// Key set
+
+void key_set_init(struct EzJSONKeySet *set)
+{
+    memset(set, 0, sizeof(*set));
+}
+
+void key_set_destroy(
+    struct EzJSONKeySet *set, void *userdata, EzJSONFree dealloc)
+{
+    poolFree(
+        userdata,
+        dealloc,
+        set->keys,
+        set->keyCapacity * (unsigned)sizeof(struct EzJSONSeenKey));
+    poolFree(
+        userdata,
+        dealloc,
+        set->slots,
+        set->slotCapacity * (unsigned)sizeof(uint32_t));
+    poolFree(userdata, dealloc, set->text, set->textCapacity);
+    poolFree(
+        userdata,
+        dealloc,
+        set->frames,
+        set->frameCapacity * (unsigned)sizeof(struct EzJSONKeySetFrame));
+    key_set_init(set);
+}
+
+// Grow one of the stacks of a key set to hold needed elements, keeping the
+// used ones. Returns the stack, or null if memory ran out.
+static void *growSetStack(
+    void *data,
+    unsigned *capacity,
+    unsigned used,
+    unsigned needed,
+    unsigned elementSize,
     void *userdata,
     EzJSONAlloc alloc,
     EzJSONFree dealloc)
 {
-    if (stack_full(stack))
+    if (needed <= *capacity)
     {
-        stack_grow(stack, userdata, alloc, dealloc);
+        return data;
     }
 
-    const unsigned iChunk = stack->top / sizeof(EzJSONStackChunk);
-    const unsigned iBit   = stack->top % sizeof(EzJSONStackChunk);
+    unsigned newCapacity = *capacity ? *capacity * 2 : 64;
+    while (newCapacity < needed)
+    {
+        newCapacity *= 2;
+    }
+    void *newData = poolAlloc(userdata, alloc, newCapacity * elementSize);
+    if (!newData)
+    {
+        return NULL;
+    }
+
+    if (used > 0)
+    {
+        memcpy(newData, data, used * elementSize);
+    }
+    poolFree(userdata, dealloc, data, *capacity * elementSize);
+    *capacity = newCapacity;
+    return newData;
+}
+
+int key_set_begin_object(
+    struct EzJSONKeySet *set,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc)
+{
+    struct EzJSONKeySetFrame *frames = (struct EzJSONKeySetFrame *)growSetStack(
+        set->frames,
+        &set->frameCapacity,
+        set->depth,
+        set->depth + 1,
+        (unsigned)sizeof(struct EzJSONKeySetFrame),
+        userdata,
+        alloc,
+        dealloc);
+    if (!frames)
+    {
+        return -1;
+    }
+
+    set->frames                  = frames;
+    frames[set->depth].firstKey  = set->keyCount;
+    frames[set->depth].firstSlot = set->slotCount;
+    frames[set->depth].tableSize = 0;
+    frames[set->depth].firstText = set->textLength;
+    set->depth++;
+    return 0;
+}
+
+static int seenKeyMatches(
+    const struct EzJSONKeySet *set,
+    const struct EzJSONSeenKey *key,
+    const char *text,
+    unsigned length,
+    uint32_t hash)
+{
+    // Empty keys may leave the set without any text
+    return key->hash == hash && key->length == length
+           && (length == 0
+               || memcmp(set->text + key->text, text, length) == 0);
+}
+
+static void insertSlot(
+    struct EzJSONKeySet *set,
+    const struct EzJSONKeySetFrame *frame,
+    unsigned index)
+{
+    uint32_t *table     = set->slots + frame->firstSlot;
+    const unsigned mask = frame->tableSize - 1;
+    unsigned slot       = set->keys[index].hash & mask;
+    while (table[slot] != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    table[slot] = index + 1;
+}
+
+// Give the innermost object a table twice the size of its current one, or a
+// first one, and insert its keys. Its table is on top of the slot stack.
+static int rebuildTable(
+    struct EzJSONKeySet *set,
+    struct EzJSONKeySetFrame *frame,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc)
+{
+    const unsigned size = frame->tableSize ? frame->tableSize * 2 : 32;
+    uint32_t *slots     = (uint32_t *)growSetStack(
+        set->slots,
+        &set->slotCapacity,
+        frame->firstSlot,
+        frame->firstSlot + size,
+        (unsigned)sizeof(uint32_t),
+        userdata,
+        alloc,
+        dealloc);
+    if (!slots)
+    {
+        return -1;
+    }
+
+    set->slots       = slots;
+    set->slotCount   = frame->firstSlot + size;
+    frame->tableSize = size;
+    memset(slots + frame->firstSlot, 0, size * sizeof(uint32_t));
+    for (unsigned i = frame->firstKey; i < set->keyCount; ++i)
+    {
+        insertSlot(set, frame, i);
+    }
+    return 0;
+}
+
+int key_set_add(
+    struct EzJSONKeySet *set,
+    const char *text,
+    unsigned length,
+    uint32_t hash,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc)
+{
+    struct EzJSONKeySetFrame *frame = &set->frames[set->depth - 1];
 
-    if (bit)
+    if (frame->tableSize == 0)
     {
-        stack->data[iChunk] |= (1 << iBit);
+        for (unsigned i = frame->firstKey; i < set->keyCount; ++i)
+        {
+            if (seenKeyMatches(set, &set->keys[i], text, length, hash))
+            {
+                return 1;
+            }
+        }
     }
     else
     {
-        stack->data[iChunk] &= ~(1 << iBit);
+        const uint32_t *table = set->slots + frame->firstSlot;
+        const unsigned mask   = frame->tableSize - 1;
+        for (unsigned slot = hash & mask; table[slot] != 0;
+             slot          = (slot + 1) & mask)
+        {
+            if (seenKeyMatches(
+                    set, &set->keys[table[slot] - 1], text, length, hash))
+            {
+                return 1;
+            }
+        }
+    }
+
+    // New key
+    struct EzJSONSeenKey *keys = (struct EzJSONSeenKey *)growSetStack(
+        set->keys,
+        &set->keyCapacity,
+        set->keyCount,
+        set->keyCount + 1,
+        (unsigned)sizeof(struct EzJSONSeenKey),
+        userdata,
+        alloc,
+        dealloc);
+    if (!keys)
+    {
+        return -1;
+    }
+    set->keys = keys;
+
+    if (length > 0)
+    {
+        char *stored = (char *)growSetStack(
+            set->text,
+            &set->textCapacity,
+            set->textLength,
+            set->textLength + length,
+            1,
+            userdata,
+            alloc,
+            dealloc);
+        if (!stored)
+        {
+            return -1;
+        }
+        set->text = stored;
+        memcpy(stored + set->textLength, text, length);
     }
 
-    stack->top++;
+    const unsigned index = set->keyCount++;
+    keys[index].hash     = hash;
+    keys[index].text     = set->textLength;
+    keys[index].length   = length;
+    set->textLength += length;
+
+    // Tables are kept at most half full
+    const unsigned count = set->keyCount - frame->firstKey;
+    if (frame->tableSize == 0 ? count > KEY_SET_LINEAR
+                              : count * 2 > frame->tableSize)
+    {
+        return rebuildTable(set, frame, userdata, alloc, dealloc);
+    }
+    if (frame->tableSize > 0)
+    {
+        insertSlot(set, frame, index);
+    }
+    return 0;
 }
 
-void stack_pop(struct EzJSONBitStack *stack)
+// Token streams
+
+int token_is_begin(const struct EzJSONToken *token)
 {
-    if (!stack_empty(stack))
+    return token->type == EZJ_TOKEN_OBJ_BEGIN
+           || token->type == EZJ_TOKEN_ARR_BEGIN;
+}
+
+int token_is_end(const struct EzJSONToken *token)
+{
+    return token->type == EZJ_TOKEN_OBJ_END
+           || token->type == EZJ_TOKEN_ARR_END;
+}
+
+struct EzJSONToken *token_next(struct EzJSONParser *parser)
+{
+    struct EzJSONToken *token;
+    do
     {
-        stack->top--;
+        EzJSONParserNext(parser);
+        token = EzJSONParserToken(parser);
+    } while (token
+             && (token->type == EZJ_TOKEN_SEQ_SEP
+                 || token->type == EZJ_TOKEN_KV_SEP));
+    return token;
+}
+
+int token_skip_value(
+    struct EzJSONParser *parser, const struct EzJSONToken *token)
+{
+    unsigned depth = token_is_begin(token) ? 1u : 0u;
+
+    while (depth > 0)
+    {
+        if (!(token = token_next(parser)))
+        {
+            return -1;
+        }
+        depth += token_is_begin(token);
+        depth -= token_is_end(token);
+    }
+    return 0;
+}
+
+void token_write(
+    struct EzJSONParser *parser,
+    const struct EzJSONToken *token,
+    struct EzJSONWriter *writer)
+{
+    const char *text;
+    unsigned length;
+
+    switch (token->type)
+    {
+    case EZJ_TOKEN_OBJ_BEGIN:
+        EzJSONWriteObjectBegin(writer);
+        break;
+    case EZJ_TOKEN_OBJ_END:
+        EzJSONWriteObjectEnd(writer);
+        break;
+    case EZJ_TOKEN_ARR_BEGIN:
+        EzJSONWriteArrayBegin(writer);
+        break;
+    case EZJ_TOKEN_ARR_END:
+        EzJSONWriteArrayEnd(writer);
+        break;
+    case EZJ_TOKEN_OBJ_KEY:
+        EzJSONWriteEscapedKey(
+            writer, token->data_text, token->data_text_length);
+        break;
+    case EZJ_TOKEN_STRING:
+        EzJSONWriteEscapedString(
+            writer, token->data_text, token->data_text_length);
+        break;
+    case EZJ_TOKEN_NUMBER:
+        text = EzJSONParserNumberText(parser, &length);
+        EzJSONWriteRaw(writer, text, length);
+        break;
+    case EZJ_TOKEN_BOOL:
+        EzJSONWriteBool(writer, token->data_bool);
+        break;
+    case EZJ_TOKEN_NULL:
+        EzJSONWriteNull(writer);
+        break;
+    default:
+        break;
+    }
+}
+
+int token_copy_value(
+    struct EzJSONParser *parser,
+    const struct EzJSONToken *token,
+    struct EzJSONWriter *writer)
+{
+    // In memory the window is the whole document. The parser has just
+    // consumed the opening bracket, and will have consumed the closing one
+    // after skipping.
+    if (!parser->settings.get_next_block && !parser->settings.get_next_char
+        && !(parser->settings.flags & EZJ_PARSE_FEED) && token_is_begin(token))
+    {
+        const char *start = parser->input - 1;
+        if (token_skip_value(parser, token) != 0)
+        {
+            return -1;
+        }
+        EzJSONWriteRaw(writer, start, (unsigned long)(parser->input - start));
+        return 0;
+    }
+
+    unsigned depth = 0;
+    for (;;)
+    {
+        token_write(parser, token, writer);
+        depth += token_is_begin(token);
+        depth -= token_is_end(token);
+        if (depth == 0)
+        {
+            return 0;
+        }
+        if (!(token = token_next(parser)))
+        {
+            return -1;
+        }
     }
 }
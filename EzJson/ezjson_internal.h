@@ -2,27 +2,476 @@
 
 #include "ezjson_common.h"
 
-extern unsigned STACK_BIT_ARRAY;
-extern unsigned STACK_BIT_OBJECT;
+#include <stddef.h>
 
-void stack_init(struct EzJSONBitStack *stack);
-void stack_destroy(
-    struct EzJSONBitStack *stack, void *userdata, EzJSONFree dealloc);
+#if defined(EZJSON_STATS)
+#define EZJSON_STAT(stmt) stmt
+#else
+#define EZJSON_STAT(stmt)
+#endif
+
+#define STACK_CHUNK_BITS 64u
 
-int stack_full(struct EzJSONBitStack *stack);
-int stack_empty(struct EzJSONBitStack *stack);
+enum
+{
+    STACK_BIT_ARRAY  = 0,
+    STACK_BIT_OBJECT = 1,
+};
 
-int stack_top(struct EzJSONBitStack *stack);
+void stack_init(struct EzJSONBitStack *stack, unsigned maxDepth);
+void stack_destroy(
+    struct EzJSONBitStack *stack, void *userdata, EzJSONFree dealloc);
 
-void stack_grow(
+// Returns non-zero if the stack could not be grown
+int stack_grow(
     struct EzJSONBitStack *stack,
     void *userdata,
     EzJSONAlloc alloc,
     EzJSONFree dealloc);
-void stack_push(
+
+// The remaining operations run for every container token and are kept inline
+
+static inline int stack_full(struct EzJSONBitStack *stack)
+{
+    return stack->top == stack->size * STACK_CHUNK_BITS;
+}
+
+static inline int stack_empty(struct EzJSONBitStack *stack)
+{
+    return stack->top == 0;
+}
+
+static inline unsigned stack_depth(struct EzJSONBitStack *stack)
+{
+    return stack->top;
+}
+
+static inline int stack_top(struct EzJSONBitStack *stack)
+{
+    const unsigned iChunk = (stack->top - 1) / STACK_CHUNK_BITS;
+    const unsigned iBit   = (stack->top - 1) % STACK_CHUNK_BITS;
+
+    return (int)((stack->data[iChunk] >> iBit) & 1u);
+}
+
+// Returns non-zero if the maximum depth is exceeded or memory ran out
+static inline int stack_push(
     struct EzJSONBitStack *stack,
     int bit,
     void *userdata,
     EzJSONAlloc alloc,
+    EzJSONFree dealloc)
+{
+    if (stack->top == stack->maxDepth && stack->maxDepth != 0)
+    {
+        return -1;
+    }
+
+    if (stack_full(stack) && stack_grow(stack, userdata, alloc, dealloc) != 0)
+    {
+        return -1;
+    }
+
+    const unsigned iChunk        = stack->top / STACK_CHUNK_BITS;
+    const EzJSONStackChunk mask  = (EzJSONStackChunk)1u
+                                  << (stack->top % STACK_CHUNK_BITS);
+
+    if (bit)
+    {
+        stack->data[iChunk] |= mask;
+    }
+    else
+    {
+        stack->data[iChunk] &= ~mask;
+    }
+
+    stack->top++;
+    return 0;
+}
+
+static inline void stack_pop(struct EzJSONBitStack *stack)
+{
+    if (!stack_empty(stack))
+    {
+        stack->top--;
+    }
+}
+
+// Key interning, see EzJSONKeyPool
+
+#define KEY_NONE 0xFFFFFFFFu
+#define KEY_CHUNK_SIZE 4096u
+
+struct EzJSONInternedKey
+{
+    const char *text; // Terminated, stable until the pool is destroyed
+    unsigned length;
+    uint32_t hash;
+    uint32_t next; // Key that followed this one the last time, or KEY_NONE
+};
+
+// Header of a block of key text, followed by the text
+struct EzJSONKeyChunk
+{
+    struct EzJSONKeyChunk *next;
+    unsigned size;
+};
+
+void key_pool_init(struct EzJSONKeyPool *pool);
+void key_pool_destroy(
+    struct EzJSONKeyPool *pool, void *userdata, EzJSONFree dealloc);
+
+// Returns the id of a key read at the given object depth, adding it if it is
+// new, or KEY_NONE if memory ran out. hash is key_hash of the text.
+uint32_t key_pool_intern(
+    struct EzJSONKeyPool *pool,
+    unsigned depth,
+    const char *text,
+    unsigned length,
+    uint32_t hash,
+    void *userdata,
+    EzJSONAlloc alloc,
     EzJSONFree dealloc);
-void stack_pop(struct EzJSONBitStack *stack);
\ No newline at end of file
+
+// Restart the prediction for a new object at depth
+static inline void
+key_pool_begin_object(struct EzJSONKeyPool *pool, unsigned depth)
+{
+    if (depth < EZJSON_KEY_PREDICT_DEPTH)
+    {
+        pool->last[depth] = KEY_NONE;
+    }
+}
+
+// Duplicate key detection, see EzJSONKeySet
+
+// Objects with up to this many keys are searched without a hash table
+#define KEY_SET_LINEAR 8u
+
+struct EzJSONSeenKey
+{
+    uint32_t hash;
+    unsigned text; // Offset in the set's text
+    unsigned length;
+};
+
+struct EzJSONKeySetFrame
+{
+    unsigned firstKey;
+    unsigned firstSlot;
+    unsigned tableSize; // 0 while the object is searched linearly
+    unsigned firstText;
+};
+
+void key_set_init(struct EzJSONKeySet *set);
+void key_set_destroy(
+    struct EzJSONKeySet *set, void *userdata, EzJSONFree dealloc);
+
+// Returns non-zero if memory ran out
+int key_set_begin_object(
+    struct EzJSONKeySet *set,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc);
+
+static inline void key_set_end_object(struct EzJSONKeySet *set)
+{
+    const struct EzJSONKeySetFrame *frame = &set->frames[--set->depth];
+    set->keyCount   = frame->firstKey;
+    set->slotCount  = frame->firstSlot;
+    set->textLength = frame->firstText;
+}
+
+// Add a key to the innermost open object. Returns 1 if the object already
+// had it, 0 if it is new and -1 if memory ran out. hash is key_hash of the
+// text.
+int key_set_add(
+    struct EzJSONKeySet *set,
+    const char *text,
+    unsigned length,
+    uint32_t hash,
+    void *userdata,
+    EzJSONAlloc alloc,
+    EzJSONFree dealloc);
+
+// Token streams, shared by the merge and diff modules
+
+struct EzJSONParser;
+struct EzJSONToken;
+struct EzJSONWriter;
+
+// Keys up to this length are decoded without allocating
+#define KEY_SPACE 256u
+
+// Whether token opens or closes an array or object
+int token_is_begin(const struct EzJSONToken *token);
+int token_is_end(const struct EzJSONToken *token);
+
+// Next token, separators skipped. Null on error, including an early end of
+// the input.
+struct EzJSONToken *token_next(struct EzJSONParser *parser);
+
+// Read past the value starting with token, checking every token. Returns
+// non-zero on a parse error.
+int token_skip_value(
+    struct EzJSONParser *parser, const struct EzJSONToken *token);
+
+// Write token as it was read, numbers with their original text
+void token_write(
+    struct EzJSONParser *parser,
+    const struct EzJSONToken *token,
+    struct EzJSONWriter *writer);
+
+// Write the value starting with token. Containers read from memory are
+// checked token by token, then their text is copied as it is. Returns
+// non-zero on a parse error.
+int token_copy_value(
+    struct EzJSONParser *parser,
+    const struct EzJSONToken *token,
+    struct EzJSONWriter *writer);
+
+// Element types of the typed number array functions
+enum NumberArrayType
+{
+    NUMBERS_DOUBLE,
+    NUMBERS_FLOAT,
+    NUMBERS_INT64,
+};
+
+// Number scanning shared by the typed arrays and the on-demand document. Kept
+// inline, it runs once per array element.
+
+struct NumberParts
+{
+    uint64_t mantissa;
+    int exponent; // Power of ten applied to the mantissa
+    int negative;
+    int integer;   // No fraction or exponent
+    int truncated; // More digits than the mantissa holds
+};
+
+static inline void number_add_digit(struct NumberParts *parts, char c)
+{
+    // Up to UINT64_MAX, 18446744073709551615
+    if (parts->mantissa < 1844674407370955161ull
+        || (parts->mantissa == 1844674407370955161ull && c <= '5'))
+    {
+        parts->mantissa = parts->mantissa * 10u + (uint64_t)(c - '0');
+    }
+    else
+    {
+        parts->truncated = 1;
+    }
+}
+
+// Scan the number starting at p. Returns its end, or NULL if it is malformed.
+// When the end is the end of the input the number may continue past it.
+static inline const char *
+number_scan(const char *p, const char *end, struct NumberParts *parts)
+{
+    parts->mantissa  = 0;
+    parts->exponent  = 0;
+    parts->negative  = 0;
+    parts->integer   = 1;
+    parts->truncated = 0;
+
+    if (p < end && *p == '-')
+    {
+        parts->negative = 1;
+        p++;
+    }
+
+    if (p < end && *p == '0')
+    {
+        p++;
+    }
+    else if (p < end && *p >= '1' && *p <= '9')
+    {
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            number_add_digit(parts, *p++);
+        }
+    }
+    else
+    {
+        return NULL;
+    }
+
+    if (p < end && *p == '.')
+    {
+        const char *digits = ++p;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            number_add_digit(parts, *p++);
+            parts->exponent--;
+        }
+        if (p == digits)
+        {
+            return NULL;
+        }
+        parts->integer = 0;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        int negative = 0;
+        int exponent = 0;
+
+        if (++p < end && (*p == '+' || *p == '-'))
+        {
+            negative = *p++ == '-';
+        }
+
+        const char *digits = p;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (exponent < 100000)
+            {
+                exponent = exponent * 10 + (*p - '0');
+            }
+            p++;
+        }
+        if (p == digits)
+        {
+            return NULL;
+        }
+
+        parts->exponent += negative ? -exponent : exponent;
+        parts->integer = 0;
+    }
+
+    return p;
+}
+
+// Mantissas up to 2^53 scaled by an exactly representable power of ten are
+// correctly rounded by a single multiply or divide. Returns zero, leaving
+// *out untouched, when the number needs strtod.
+static inline int
+number_fast_double(const struct NumberParts *parts, double *out)
+{
+    static const double powersOf10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    if (parts->truncated || parts->mantissa > (1ull << 53)
+        || parts->exponent < -22 || parts->exponent > 22)
+    {
+        return 0;
+    }
+
+    double value = (double)parts->mantissa;
+    if (parts->exponent < 0)
+    {
+        value /= powersOf10[-parts->exponent];
+    }
+    else
+    {
+        value *= powersOf10[parts->exponent];
+    }
+    *out = parts->negative ? -value : value;
+    return 1;
+}
+
+// Returns zero if the number is not an integer or does not fit
+static inline int
+number_to_int64(const struct NumberParts *parts, int64_t *out)
+{
+    if (!parts->integer || parts->truncated
+        || parts->mantissa > (uint64_t)INT64_MAX + parts->negative)
+    {
+        return 0;
+    }
+
+    *out = parts->negative ? (int64_t)(0u - parts->mantissa)
+                           : (int64_t)parts->mantissa;
+    return 1;
+}
+
+static inline int
+number_to_uint64(const struct NumberParts *parts, uint64_t *out)
+{
+    if (!parts->integer || parts->truncated
+        || (parts->negative && parts->mantissa != 0))
+    {
+        return 0;
+    }
+
+    *out = parts->mantissa;
+    return 1;
+}
+
+// Object key hash, 32-bit FNV-1a. Must match ezjson::keyHash in
+// ezjson_keys.hpp, which builds lookup tables from it at compile time.
+#define KEY_HASH_SEED 2166136261u
+
+static inline uint32_t
+key_hash(uint32_t hash, const char *data, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Base64 with the standard alphabet, see ezjson_base64.c
+
+// Set in the value of a character outside the alphabet
+#define BASE64_INVALID 64u
+
+static inline unsigned base64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return (unsigned)(c - 'A');
+    if (c >= 'a' && c <= 'z')
+        return (unsigned)(c - 'a') + 26;
+    if (c >= '0' && c <= '9')
+        return (unsigned)(c - '0') + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return BASE64_INVALID;
+}
+
+// Encode groups of 3 bytes into 4 characters each
+void base64_encode(const unsigned char *in, unsigned long groups, char *out);
+
+// Encode the last 1 or 2 bytes into 4 characters, padded with '='
+void base64_encode_tail(const unsigned char *in, unsigned count, char *out);
+
+// Decode up to groups of 4 characters into 3 bytes each. Stops before the
+// first group with a character outside the alphabet, '=' included. Returns
+// the number of groups decoded.
+unsigned long
+base64_decode(const char *in, unsigned long groups, unsigned char *out);
+
+// UTF-8 helpers, see ezjson_utf8.c
+
+#define UTF8_ACCEPT 0u
+#define UTF8_REJECT 8u
+
+// Validate count bytes continuing from *state, which is UTF8_ACCEPT on a
+// sequence boundary. Returns the index of the first invalid byte, or count if
+// all bytes are valid. *state is updated, and is UTF8_REJECT on error.
+unsigned utf8_validate(unsigned *state, const char *data, unsigned count);
+
+// Encode a code point, writing up to 4 bytes. Returns the number written.
+unsigned utf8_encode(uint32_t codepoint, char *out);
+
+// Find the first '"', '\\' or control character in [data, end)
+const char *scan_string(const char *data, const char *end);
+
+// Find the first '"' or '\\' in [data, end). Skipping a string needs no
+// more: raw control characters are read as they are.
+const char *scan_string_end(const char *data, const char *end);
+
+// Find the first '"', '[', ']', '{' or '}' in [data, end)
+const char *scan_structural(const char *data, const char *end);
+
+// Find the end of the array or object whose opening bracket is just before
+// data, counting brackets outside strings. Nothing else is checked. Returns
+// the position after the closing bracket, or NULL if it is not in
+// [data, end).
+const char *scan_container(const char *data, const char *end);
@@ -0,0 +1,181 @@
+#ifndef __EZJSON_KEYS_HPP_INCLUDED__
+#define __EZJSON_KEYS_HPP_INCLUDED__
+
+// Compile-time perfect hashing of a fixed key set. Requires C++14.
+//
+//   enum Field { ID, NAME, TAGS };
+//   constexpr auto fields = ezjson::makeKeySet("id", "name", "tags");
+//
+//   switch (fields.find(*token)) // token is an EZJ_TOKEN_OBJ_KEY
+//   {
+//   case ID: ...
+//   case -1: unknown key
+//   }
+//
+// The parser hashes keys while reading them (data_key_hash), so find() costs
+// a multiply, a shift, one table load and a single compare against the
+// candidate key.
+
+#include "ezjson_parser.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace ezjson
+{
+/// Same as EzJSONKeyHash, usable in constant expressions
+constexpr uint32_t keyHash(const char *key, unsigned length)
+{
+    uint32_t hash = 2166136261u;
+    for (unsigned i = 0; i < length; ++i)
+    {
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+namespace detail
+{
+constexpr unsigned keyLength(const char *key)
+{
+    unsigned length = 0;
+    while (key[length])
+    {
+        ++length;
+    }
+    return length;
+}
+
+// Smallest table, in bits, holding at least twice the number of keys
+constexpr unsigned keyTableBits(unsigned count)
+{
+    unsigned bits = 1;
+    while ((1u << bits) < 2 * count)
+    {
+        ++bits;
+    }
+    return bits;
+}
+} // namespace detail
+
+/// N keys mapped to indices 0..N-1 in the order given. The table maps
+/// (hash * multiplier) >> shift to a key, and construction searches for a
+/// multiplier without collisions, growing the table up to 16 times if needed.
+/// Construction fails to compile when no such multiplier is found.
+template <unsigned N> class KeySet
+{
+    static_assert(N > 0 && N < 256, "KeySet holds 1 to 255 keys");
+
+public:
+    static constexpr unsigned MaxBits = detail::keyTableBits(N) + 4;
+
+    constexpr explicit KeySet(const char *const (&keys)[N])
+    {
+        for (unsigned i = 0; i < N; ++i)
+        {
+            m_keys[i]    = keys[i];
+            m_lengths[i] = detail::keyLength(keys[i]);
+            m_hashes[i]  = keyHash(keys[i], m_lengths[i]);
+            for (unsigned j = 0; j < i; ++j)
+            {
+                if (m_hashes[i] == m_hashes[j])
+                {
+                    throw "duplicate key or hash collision";
+                }
+            }
+        }
+
+        for (unsigned bits = detail::keyTableBits(N); bits <= MaxBits; ++bits)
+        {
+            uint32_t multiplier = 0x9E3779B1u;
+            for (unsigned attempt = 0; attempt < 4096; ++attempt)
+            {
+                if (place(multiplier | 1u, bits))
+                {
+                    return;
+                }
+                multiplier = multiplier * 1664525u + 1013904223u;
+            }
+        }
+
+        throw "no perfect hash found";
+    }
+
+    /// Index of the key, or -1 if it is not in the set
+    int find(uint32_t hash, const char *key, unsigned length) const
+    {
+        const uint32_t slot = (uint32_t)(hash * m_multiplier) >> m_shift;
+        const int index     = (int)m_slots[slot] - 1;
+        if (index < 0 || m_hashes[index] != hash || m_lengths[index] != length
+            || std::memcmp(m_keys[index], key, length) != 0)
+        {
+            return -1;
+        }
+        return index;
+    }
+
+    /// Look up an EZJ_TOKEN_OBJ_KEY token using the hash computed by the
+    /// parser
+    int find(const EzJSONToken &token) const
+    {
+        return find(
+            token.data_key_hash, token.data_text, token.data_text_length);
+    }
+
+    int find(const char *key, unsigned length) const
+    {
+        return find(EzJSONKeyHash(key, length), key, length);
+    }
+
+    constexpr const char *key(unsigned index) const
+    {
+        return m_keys[index];
+    }
+
+    constexpr unsigned size() const
+    {
+        return N;
+    }
+
+private:
+    constexpr bool place(uint32_t multiplier, unsigned bits)
+    {
+        for (unsigned slot = 0; slot < (1u << bits); ++slot)
+        {
+            m_slots[slot] = 0;
+        }
+
+        for (unsigned i = 0; i < N; ++i)
+        {
+            const uint32_t slot =
+                (uint32_t)(m_hashes[i] * multiplier) >> (32 - bits);
+            if (m_slots[slot] != 0)
+            {
+                return false;
+            }
+            m_slots[slot] = (uint8_t)(i + 1);
+        }
+
+        m_multiplier = multiplier;
+        m_shift      = 32 - bits;
+        return true;
+    }
+
+    const char *m_keys[N]          = {};
+    unsigned m_lengths[N]          = {};
+    uint32_t m_hashes[N]           = {};
+    uint32_t m_multiplier          = 0;
+    unsigned m_shift               = 0;
+    uint8_t m_slots[1u << MaxBits] = {}; // Key index + 1, 0 when empty
+};
+
+/// Build a KeySet from string literals
+template <typename... Keys>
+constexpr KeySet<sizeof...(Keys)> makeKeySet(const Keys &...keys)
+{
+    const char *const list[] = {keys...};
+    return KeySet<sizeof...(Keys)>(list);
+}
+} // namespace ezjson
+
+#endif //!__EZJSON_KEYS_HPP_INCLUDED__
@@ -0,0 +1,413 @@
+#include "ezjson_merge.h"
+#include "ezjson_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+#define SEEN_INITIAL_SIZE 16u
+
+struct Merge
+{
+    struct EzJSONParser *source;
+    struct EzJSONWriter *writer;
+    struct EzJSONDocument *patch;
+
+    // Patch members matched by a source key, as offsets of their values. A
+    // stack with one section per object being merged.
+    unsigned long *seen;
+    unsigned seenCount;
+    unsigned seenCapacity;
+
+    enum EzJSONMergeError error;
+};
+
+static void *allocate(struct Merge *merge, unsigned size)
+{
+    const struct EzJSONDocumentSettings *settings = &merge->patch->settings;
+    if (settings->allocate_memory)
+    {
+        return settings->allocate_memory(settings->userdata, size);
+    }
+    return malloc(size);
+}
+
+static void release(struct Merge *merge, void *ptr, unsigned size)
+{
+    const struct EzJSONDocumentSettings *settings = &merge->patch->settings;
+    if (settings->free_memory)
+    {
+        settings->free_memory(settings->userdata, ptr, size);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+static int fail(struct Merge *merge, enum EzJSONMergeError error)
+{
+    if (merge->error == EZ_ME_OK)
+    {
+        merge->error = error;
+    }
+    return -1;
+}
+
+static int pushSeen(struct Merge *merge, unsigned long offset)
+{
+    if (merge->seenCount == merge->seenCapacity)
+    {
+        const unsigned capacity = merge->seenCapacity
+                                      ? merge->seenCapacity * 2u
+                                      : SEEN_INITIAL_SIZE;
+        unsigned long *seen =
+            allocate(merge, capacity * (unsigned)sizeof(unsigned long));
+        if (!seen)
+        {
+            return fail(merge, EZ_ME_NO_MEMORY);
+        }
+
+        if (merge->seen)
+        {
+            memcpy(
+                seen, merge->seen, merge->seenCount * sizeof(unsigned long));
+            release(
+                merge,
+                merge->seen,
+                merge->seenCapacity * (unsigned)sizeof(unsigned long));
+        }
+        merge->seen         = seen;
+        merge->seenCapacity = capacity;
+    }
+
+    merge->seen[merge->seenCount++] = offset;
+    return 0;
+}
+
+static int wasSeen(struct Merge *merge, unsigned base, unsigned long offset)
+{
+    for (unsigned i = base; i < merge->seenCount; ++i)
+    {
+        if (merge->seen[i] == offset)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Source
+
+// Next token of the source, separators skipped. Null on error, including
+// an early end of the input.
+static struct EzJSONToken *next(struct Merge *merge)
+{
+    struct EzJSONToken *token = token_next(merge->source);
+    if (!token)
+    {
+        fail(merge, EZ_ME_SOURCE);
+    }
+    return token;
+}
+
+// Read past the value starting with token
+static int skipValue(struct Merge *merge, const struct EzJSONToken *token)
+{
+    if (token_skip_value(merge->source, token) != 0)
+    {
+        return fail(merge, EZ_ME_SOURCE);
+    }
+    return 0;
+}
+
+// Pass the value starting with token through unchanged
+static int copyValue(struct Merge *merge, const struct EzJSONToken *token)
+{
+    if (token_copy_value(merge->source, token, merge->writer) != 0)
+    {
+        return fail(merge, EZ_ME_SOURCE);
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Patch
+
+// Whether member is the first one with its key, the one EzJSONValueFind
+// returns and that source members are merged with
+static int isFirstMember(
+    struct Merge *merge,
+    struct EzJSONValue object,
+    struct EzJSONValue key,
+    struct EzJSONValue member)
+{
+    char space[KEY_SPACE];
+    char *text = space;
+    unsigned length;
+    struct EzJSONValue found;
+
+    int result = EzJSONValueGetString(key, text, KEY_SPACE, &length);
+    if (result == 1)
+    {
+        if (!(text = allocate(merge, length + 1u)))
+        {
+            return fail(merge, EZ_ME_NO_MEMORY);
+        }
+        result = EzJSONValueGetString(key, text, length + 1u, &length);
+    }
+
+    if (result == 0)
+    {
+        result = EzJSONValueFind(object, text, length, &found);
+    }
+    if (text != space)
+    {
+        release(merge, text, length + 1u);
+    }
+
+    if (result != 0)
+    {
+        return fail(merge, EZ_ME_PATCH);
+    }
+    return found.offset == member.offset;
+}
+
+// Write a patch value as the result of merging it with no source value:
+// objects lose their null members, at every level
+static int writePatch(struct Merge *merge, struct EzJSONValue value)
+{
+    struct EzJSONIterator it;
+    struct EzJSONValue key;
+    struct EzJSONValue member;
+    const char *text;
+    unsigned long length;
+    int step;
+
+    if (EzJSONValueGetType(value) != EZJ_VALUE_OBJECT)
+    {
+        if (EzJSONValueGetRaw(value, &text, &length) != 0)
+        {
+            return fail(merge, EZ_ME_PATCH);
+        }
+        EzJSONWriteRaw(merge->writer, text, length);
+        return 0;
+    }
+
+    EzJSONIteratorInit(value, &it);
+    EzJSONWriteObjectBegin(merge->writer);
+    while ((step = EzJSONIteratorNext(&it, &key, &member)) == 1)
+    {
+        if (EzJSONValueGetType(member) == EZJ_VALUE_NULL)
+        {
+            continue;
+        }
+
+        const int first = isFirstMember(merge, value, key, member);
+        if (first < 0)
+        {
+            return -1;
+        }
+        if (!first)
+        {
+            continue;
+        }
+
+        // The key is written as it appears in the patch, without quotes
+        EzJSONValueGetRaw(key, &text, &length);
+        EzJSONWriteKey(merge->writer, text + 1, (unsigned)(length - 2));
+        if (writePatch(merge, member) != 0)
+        {
+            return -1;
+        }
+    }
+    if (step < 0)
+    {
+        return fail(merge, EZ_ME_PATCH);
+    }
+    EzJSONWriteObjectEnd(merge->writer);
+    return 0;
+}
+
+static int mergeValue(
+    struct Merge *merge,
+    const struct EzJSONToken *token,
+    struct EzJSONValue patch);
+
+// The source value is an object and so is the patch. Source members are
+// written in their order, those the patch adds follow.
+static int mergeObject(struct Merge *merge, struct EzJSONValue patch)
+{
+    const unsigned base = merge->seenCount;
+    struct EzJSONToken *token;
+    struct EzJSONIterator it;
+    struct EzJSONValue key;
+    struct EzJSONValue member;
+    const char *text;
+    unsigned long length;
+    int step;
+
+    EzJSONWriteObjectBegin(merge->writer);
+    for (;;)
+    {
+        if (!(token = next(merge)))
+        {
+            return -1;
+        }
+        if (token->type == EZJ_TOKEN_OBJ_END)
+        {
+            break;
+        }
+
+        // The key text only lasts until the next token
+        const int found = EzJSONValueFind(
+            patch, token->data_text, token->data_text_length, &member);
+        if (found < 0)
+        {
+            return fail(merge, EZ_ME_PATCH);
+        }
+        if (found == 1)
+        {
+            token_write(merge->source, token, merge->writer);
+            if (!(token = next(merge)) || copyValue(merge, token) != 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        if (pushSeen(merge, member.offset) != 0)
+        {
+            return -1;
+        }
+        if (EzJSONValueGetType(member) == EZJ_VALUE_NULL)
+        {
+            // Removed
+            if (!(token = next(merge)) || skipValue(merge, token) != 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        token_write(merge->source, token, merge->writer);
+        if (!(token = next(merge)) || mergeValue(merge, token, member) != 0)
+        {
+            return -1;
+        }
+    }
+
+    EzJSONIteratorInit(patch, &it);
+    while ((step = EzJSONIteratorNext(&it, &key, &member)) == 1)
+    {
+        if (EzJSONValueGetType(member) == EZJ_VALUE_NULL
+            || wasSeen(merge, base, member.offset))
+        {
+            continue;
+        }
+
+        const int first = isFirstMember(merge, patch, key, member);
+        if (first < 0)
+        {
+            return -1;
+        }
+        if (!first)
+        {
+            continue;
+        }
+
+        EzJSONValueGetRaw(key, &text, &length);
+        EzJSONWriteKey(merge->writer, text + 1, (unsigned)(length - 2));
+        if (writePatch(merge, member) != 0)
+        {
+            return -1;
+        }
+    }
+    if (step < 0)
+    {
+        return fail(merge, EZ_ME_PATCH);
+    }
+
+    merge->seenCount = base;
+    EzJSONWriteObjectEnd(merge->writer);
+    return 0;
+}
+
+// Merge patch into the source value starting with token. Anything but an
+// object replaces the source value, and so does an object when the source
+// value is not one.
+static int mergeValue(
+    struct Merge *merge,
+    const struct EzJSONToken *token,
+    struct EzJSONValue patch)
+{
+    if (EzJSONValueGetType(patch) == EZJ_VALUE_OBJECT
+        && token->type == EZJ_TOKEN_OBJ_BEGIN)
+    {
+        return mergeObject(merge, patch);
+    }
+
+    if (skipValue(merge, token) != 0)
+    {
+        return -1;
+    }
+    return writePatch(merge, patch);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Interface
+
+enum EzJSONMergeError EzJSONMergePatch(
+    struct EzJSONParser *source,
+    struct EzJSONValue patch,
+    struct EzJSONWriter *writer)
+{
+    struct Merge merge;
+    const struct EzJSONToken *token;
+
+    merge.source       = source;
+    merge.writer       = writer;
+    merge.patch        = patch.document;
+    merge.seen         = NULL;
+    merge.seenCount    = 0;
+    merge.seenCapacity = 0;
+    merge.error        = EZ_ME_OK;
+
+    if ((token = next(&merge)) && mergeValue(&merge, token, patch) == 0)
+    {
+        // Nothing may follow the document
+        EzJSONParserNext(source);
+        if (EzJSONParserHasError(source))
+        {
+            fail(&merge, EZ_ME_SOURCE);
+        }
+    }
+
+    EzJSONWriterFlush(writer);
+    if (merge.seen)
+    {
+        release(
+            &merge,
+            merge.seen,
+            merge.seenCapacity * (unsigned)sizeof(unsigned long));
+    }
+    return merge.error;
+}
+
+const char *EzJSONMergeErrorName(enum EzJSONMergeError error)
+{
+    switch (error)
+    {
+    case EZ_ME_OK:
+        return "no error";
+    case EZ_ME_SOURCE:
+        return "source document is malformed";
+    case EZ_ME_PATCH:
+        return "patch document is malformed";
+    case EZ_ME_NO_MEMORY:
+        return "out of memory";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,49 @@
+#ifndef __EZJSON_MERGE_H_INCLUDED__
+#define __EZJSON_MERGE_H_INCLUDED__
+
+#include "ezjson_common.h"
+#include "ezjson_document.h"
+#include "ezjson_parser.h"
+#include "ezjson_writer.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    // JSON Merge Patch (RFC 7386) applied while streaming. The source is
+    // read token by token and the result written as it goes, so only the
+    // patch has to be held in memory. Members the patch does not touch are
+    // passed through unchanged: containers are copied as raw bytes when the
+    // source parser reads from memory, and written token by token
+    // otherwise. Numbers keep their original text.
+    //
+    // Copied containers and values taken from the patch keep their
+    // formatting, pretty printing only applies to the parts the merge
+    // writes itself.
+
+    enum EzJSONMergeError
+    {
+        EZ_ME_OK,
+        EZ_ME_SOURCE,    // The source failed to parse, see EzJSONParserError
+        EZ_ME_PATCH,     // The patch is malformed
+        EZ_ME_NO_MEMORY, // Allocation through the patch document failed
+    };
+
+    /// Write the source document read by parser, which must not have been
+    /// stepped yet, with patch merged into it. Memory is allocated through
+    /// the settings of the patch's document. On error the output is
+    /// incomplete.
+    enum EzJSONMergeError EzJSONMergePatch(
+        struct EzJSONParser *source,
+        struct EzJSONValue patch,
+        struct EzJSONWriter *writer);
+
+    /// Human readable description of an error
+    const char *EzJSONMergeErrorName(enum EzJSONMergeError);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //!__EZJSON_MERGE_H_INCLUDED__
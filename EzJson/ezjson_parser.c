@@ -16,28 +16,18 @@
         return -1;                                                             \
     }
 
-enum EzJSONParserState
-{
-    EZ_PS_ERROR = 0,
-
-    EZ_PS_EXPECT_VALUE   = (1 << 0),
-    EZ_PS_EXPECT_SEQ_SEP = (1 << 1),
-    EZ_PS_EXPECT_KV_SEP  = (1 << 2),
-    EZ_PS_EXPECT_OBJ_END = (1 << 3),
-    EZ_PS_EXPECT_ARR_END = (1 << 4),
-    EZ_PS_EXPECT_OBJ_KEY = (1 << 5),
-    EZ_PS_EXPECT_EOF     = (1 << 6),
-
-};
+#define DUPLICATE_KEY_FLAGS                                                    \
+    (EZJ_PARSE_MARK_DUPLICATE_KEYS | EZJ_PARSE_REJECT_DUPLICATE_KEYS           \
+     | EZJ_PARSE_FIRST_KEY_WINS)
 
 // Internal
-void setTokenSimple(struct EzJSONParser *parser, enum EzJSONTokenType type)
+static void setTokenSimple(struct EzJSONParser *parser, enum EzJSONTokenType type)
 {
     parser->hasToken   = 1;
     parser->token.type = type;
 }
 
-void setTokenNumber(
+static void setTokenNumber(
     struct EzJSONParser *parser, enum EzJSONTokenType type, EzJSONNumber data)
 {
     parser->hasToken          = 1;
@@ -45,7 +35,7 @@ void setTokenNumber(
     parser->token.data_number = data;
 }
 
-void setTokenBool(
+static void setTokenBool(
     struct EzJSONParser *parser, enum EzJSONTokenType type, EzJSONBool data)
 {
     parser->hasToken        = 1;
@@ -53,7 +43,7 @@ void setTokenBool(
     parser->token.data_bool = data;
 }
 
-void setTokenText(
+static void setTokenText(
     struct EzJSONParser *parser,
     enum EzJSONTokenType type,
     char *data,
@@ -65,12 +55,25 @@ void setTokenText(
     parser->token.data_text_length = len;
 }
 
-void resetValue(struct EzJSONParser *parser)
+// The value being read occupies [bufferBase, bufferPos) of the buffer.
+// bufferBase is 0 except in EzJSONParserNextBatch, which keeps the text of
+// earlier tokens in front of it.
+static void resetValue(struct EzJSONParser *parser)
+{
+    parser->bufferPos = parser->bufferBase;
+}
+
+static char *valueText(struct EzJSONParser *parser)
+{
+    return parser->buffer + parser->bufferBase;
+}
+
+static unsigned valueLength(struct EzJSONParser *parser)
 {
-    parser->bufferPos = 0;
+    return parser->bufferPos - parser->bufferBase;
 }
 
-void freeBuffer(struct EzJSONParser *parser)
+static void freeBuffer(struct EzJSONParser *parser)
 {
     if (parser->bufferSize != EZJSON_PARSER_INLINE_BUFFER)
     {
@@ -88,7 +91,7 @@ void freeBuffer(struct EzJSONParser *parser)
     }
 }
 
-void growBuffer(struct EzJSONParser *parser)
+static void growBuffer(struct EzJSONParser *parser)
 {
     const unsigned newSize = parser->bufferSize * 2u;
     char *tmp;
@@ -104,274 +107,565 @@ void growBuffer(struct EzJSONParser *parser)
     memcpy(tmp, parser->buffer, parser->bufferSize);
     freeBuffer(parser);
 
-    parser->buffer = tmp;
-    parser->bufferSize *= newSize;
+    parser->buffer     = tmp;
+    parser->bufferSize = newSize;
+    EZJSON_STAT(parser->stats.bufferGrowths++);
 }
 
-void writeBuffer(struct EzJSONParser *parser, char c)
+static void writeBuffer(struct EzJSONParser *parser, char c)
 {
     if (parser->bufferPos >= parser->bufferSize)
         growBuffer(parser);
     parser->buffer[parser->bufferPos++] = c;
 }
 
-int peek(struct EzJSONParser *parser)
+static void appendBuffer(
+    struct EzJSONParser *parser, const char *data, unsigned count)
 {
-    if (parser->hasPeeked)
+    while (parser->bufferSize - parser->bufferPos < count)
+        growBuffer(parser);
+    memcpy(parser->buffer + parser->bufferPos, data, count);
+    parser->bufferPos += count;
+}
+
+static int fail(struct EzJSONParser *parser, enum EzJSONErrorKind kind)
+{
+    // Only the first failure is reported, later ones are consequences of it
+    if (parser->error.kind == EZ_PE_NONE)
     {
-        return 0;
+        parser->error.kind     = kind;
+        parser->error.offset   = parser->offset;
+        parser->error.line     = parser->line;
+        parser->error.column   = (unsigned)(parser->offset - parser->lineStart) + 1;
+        parser->error.expected = parser->state;
+    }
+
+    return -1;
+}
+
+// The parser reads from the window [input, inputEnd). With a memory buffer
+// the window is the whole document, otherwise it is refilled a block at a
+// time from get_next_block or one character at a time from get_next_char.
+// With EZJ_PARSE_FEED it moves on from the carry to the fed data.
+static int refill(struct EzJSONParser *parser)
+{
+    if (parser->settings.flags & EZJ_PARSE_FEED)
+    {
+        struct EzJSONParserFeed *feed = &parser->feed;
+        if (feed->pending)
+        {
+            parser->input       = feed->pending;
+            parser->inputEnd    = feed->pending + feed->pendingLength;
+            feed->chunk         = feed->pending;
+            feed->chunkLength   = feed->pendingLength;
+            feed->pending       = NULL;
+            feed->windowIsCarry = 0;
+            return 0;
+        }
+
+        feed->starved = !feed->ended;
+        return -1;
     }
 
-    parser->hasPeeked = parser->settings.get_next_char(
-                            parser->settings.userdata, &parser->peeked)
-                        == 0;
+    if (parser->settings.get_next_block)
+    {
+        const char *block = NULL;
+        const unsigned size =
+            parser->settings.get_next_block(parser->settings.userdata, &block);
+        if (size == 0)
+        {
+            return -1;
+        }
+
+        parser->input    = block;
+        parser->inputEnd = block + size;
+        return 0;
+    }
 
-    parser->peeked &= 0xff;
+    if (parser->settings.get_next_char
+        && parser->settings.get_next_char(
+               parser->settings.userdata, &parser->inputChar)
+               == 0)
+    {
+        parser->input    = &parser->inputChar;
+        parser->inputEnd = parser->input + 1;
+        return 0;
+    }
 
-    return parser->hasPeeked ? 0 : -1;
+    return -1;
 }
 
-int read(struct EzJSONParser *parser, char *c)
+static int peek(struct EzJSONParser *parser)
 {
-    int result = 0;
     if (parser->hasPeeked)
     {
-        *c                = parser->peeked;
-        parser->hasPeeked = 0;
+        return 0;
     }
-    else
+
+    if (parser->input == parser->inputEnd && refill(parser) != 0)
     {
-        result = parser->settings.get_next_char(parser->settings.userdata, c);
+        return -1;
     }
 
-    if (*c == '\n')
+    parser->peeked    = *parser->input;
+    parser->hasPeeked = 1;
+    return 0;
+}
+
+// Consume count characters of the window that contain no line breaks
+static void advance(struct EzJSONParser *parser, unsigned count)
+{
+    parser->hasPeeked = 0;
+    parser->input += count;
+    parser->offset += count;
+    EZJSON_STAT(parser->stats.bytes += count);
+}
+
+// Consume the peeked character
+static void consume(struct EzJSONParser *parser)
+{
+    parser->hasPeeked = 0;
+    parser->input++;
+    parser->offset++;
+    EZJSON_STAT(parser->stats.bytes++);
+
+    if (parser->peeked == '\n')
     {
         parser->line++;
-        parser->pos;
+        parser->lineStart = parser->offset;
     }
+}
 
-    return result;
+// Peek a character that may legally be missing at the end of the input.
+// Returns '\0' at EOF.
+static char peekOptional(struct EzJSONParser *parser)
+{
+    return peek(parser) == 0 ? parser->peeked : '\0';
 }
 
-int skip(struct EzJSONParser *parser, char c)
+static int skip(struct EzJSONParser *parser, char c)
 {
-    char tmp;
-    if (read(parser, &tmp) != 0)
+    if (peek(parser) != 0)
     {
-        return -1;
+        return fail(parser, EZ_PE_UNEXPECTED_EOF);
     }
 
-    if (tmp != c)
+    if (parser->peeked != c)
     {
-        return -1;
+        return fail(parser, EZ_PE_UNEXPECTED_CHAR);
     }
 
+    consume(parser);
     return 0;
 }
 
-void skipWhitespace(struct EzJSONParser *parser)
+static void skipWhitespace(struct EzJSONParser *parser)
 {
-    char tmp;
     while (peek(parser) == 0
            && (parser->peeked == ' ' || parser->peeked == '\t'
                || parser->peeked == '\n' || parser->peeked == '\r'))
     {
-        read(parser, &tmp);
+        consume(parser);
     }
 }
 
-int readNull(struct EzJSONParser *parser)
+static int readLiteral(struct EzJSONParser *parser, const char *literal)
 {
-    CHECKED(skip(parser, 'n'));
-    CHECKED(skip(parser, 'u'));
-    CHECKED(skip(parser, 'l'));
-    CHECKED(skip(parser, 'l'));
+    for (; *literal; ++literal)
+    {
+        if (peek(parser) != 0)
+        {
+            return fail(parser, EZ_PE_UNEXPECTED_EOF);
+        }
+
+        if (parser->peeked != *literal)
+        {
+            return fail(parser, EZ_PE_INVALID_LITERAL);
+        }
+
+        consume(parser);
+    }
 
     return 0;
 }
 
-int readBool(struct EzJSONParser *parser, EzJSONBool *out)
+static int readNull(struct EzJSONParser *parser)
+{
+    return readLiteral(parser, "null");
+}
+
+static int readBool(struct EzJSONParser *parser, EzJSONBool *out)
 {
     CHECKED(peek(parser));
 
     if (parser->peeked == 'f')
     {
-        CHECKED(skip(parser, 'f'));
-        CHECKED(skip(parser, 'a'));
-        CHECKED(skip(parser, 'l'));
-        CHECKED(skip(parser, 's'));
-        CHECKED(skip(parser, 'e'));
-
+        CHECKED(readLiteral(parser, "false"));
         *out = 0;
     }
     else
     {
-        CHECKED(skip(parser, 't'));
-        CHECKED(skip(parser, 'r'));
-        CHECKED(skip(parser, 'u'));
-        CHECKED(skip(parser, 'e'));
-
+        CHECKED(readLiteral(parser, "true"));
         *out = 1;
     }
 
     return 0;
 }
 
-int readNumber(struct EzJSONParser *parser, EzJSONNumber *out)
+// Copy the peeked character to the value buffer and consume it
+static char acceptNumberChar(struct EzJSONParser *parser)
+{
+    writeBuffer(parser, parser->peeked);
+    consume(parser);
+    return peekOptional(parser);
+}
+
+static int readNumber(struct EzJSONParser *parser, EzJSONNumber *out)
 {
     resetValue(parser);
-    CHECKED(peek(parser));
+    char c = peekOptional(parser);
 
     // Sign
-    if (parser->peeked == '-')
+    if (c == '-')
     {
-        writeBuffer(parser, '-');
-        skip(parser, '-');
-        CHECKED(peek(parser));
+        c = acceptNumberChar(parser);
     }
 
     // Integer part
-    if (parser->peeked == '0')
+    if (c == '0')
     {
-        writeBuffer(parser, '0');
-        skip(parser, '0');
-        CHECKED(peek(parser));
+        c = acceptNumberChar(parser);
     }
-    else if (parser->peeked >= '1' && parser->peeked <= '9')
+    else if (c >= '1' && c <= '9')
     {
-        while (parser->peeked >= '0' && parser->peeked <= '9')
+        while (c >= '0' && c <= '9')
         {
-            writeBuffer(parser, parser->peeked);
-            skip(parser, parser->peeked);
-            CHECKED(peek(parser));
+            c = acceptNumberChar(parser);
         }
     }
     else
     {
         // Integer part is not optional
-        return -1;
+        return fail(parser, EZ_PE_INVALID_NUMBER);
     }
 
     // Fraction part
-    if (parser->peeked == '.')
+    if (c == '.')
     {
-        writeBuffer(parser, '.');
-        skip(parser, '.');
-        CHECKED(peek(parser));
+        c = acceptNumberChar(parser);
 
-        if (parser->peeked < '0' || parser->peeked > '9')
+        if (c < '0' || c > '9')
         {
             // If decimal point is present, at least one decimal digit
-            return -1;
+            return fail(parser, EZ_PE_INVALID_NUMBER);
         }
 
-        while (parser->peeked >= '0' && parser->peeked <= '9')
+        while (c >= '0' && c <= '9')
         {
-            writeBuffer(parser, (char)parser->peeked);
-            skip(parser, (char)parser->peeked);
-            CHECKED(peek(parser));
+            c = acceptNumberChar(parser);
         }
     }
 
     // Exponent part
-    if (parser->peeked == 'e' || parser->peeked == 'E')
+    if (c == 'e' || c == 'E')
     {
-        writeBuffer(parser, 'e');
-        skip(parser, (char)parser->peeked);
-        CHECKED(peek(parser));
+        c = acceptNumberChar(parser);
 
-        if (parser->peeked == '+' || parser->peeked == '-')
+        if (c == '+' || c == '-')
         {
-            writeBuffer(parser, (char)parser->peeked);
-            skip(parser, (char)parser->peeked);
-            CHECKED(peek(parser));
+            c = acceptNumberChar(parser);
         }
 
-        if (parser->peeked < '0' || parser->peeked > '9')
+        if (c < '0' || c > '9')
         {
             // If exponent E is present, at least one exponent digit
-            return -1;
+            return fail(parser, EZ_PE_INVALID_NUMBER);
         }
 
-        while (parser->peeked >= '0' && parser->peeked <= '9')
+        while (c >= '0' && c <= '9')
         {
-            writeBuffer(parser, (char)parser->peeked);
-            skip(parser, (char)parser->peeked);
-            CHECKED(peek(parser));
+            c = acceptNumberChar(parser);
         }
     }
 
     writeBuffer(parser, '\x00');
-    sscanf_s(parser->buffer, "%f", out);
+    *out = (EzJSONNumber)strtod(valueText(parser), NULL);
+
+    // The terminator is not part of the value
+    parser->bufferPos--;
 
     return 0;
 }
 
-int readString(struct EzJSONParser *parser)
+static int readHex4(struct EzJSONParser *parser, uint32_t *out)
 {
-    resetValue(parser);
-    CHECKED(skip(parser, '"'));
+    uint32_t value = 0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (peek(parser) != 0)
+        {
+            return fail(parser, EZ_PE_UNEXPECTED_EOF);
+        }
+
+        const char c = parser->peeked;
+        if (c >= '0' && c <= '9')
+            value = (value << 4) | (uint32_t)(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            value = (value << 4) | (uint32_t)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            value = (value << 4) | (uint32_t)(c - 'A' + 10);
+        else
+            return fail(parser, EZ_PE_INVALID_STRING);
+
+        consume(parser);
+    }
+
+    *out = value;
+    return 0;
+}
+
+// Decode \uXXXX, with the 'u' already consumed. Surrogate pairs must be
+// written as two consecutive escapes.
+static int readUnicodeEscape(struct EzJSONParser *parser)
+{
+    uint32_t codepoint;
+    CHECKED(readHex4(parser, &codepoint));
+
+    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+    {
+        // Low surrogate without a high surrogate
+        return fail(parser, EZ_PE_INVALID_STRING);
+    }
+
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+    {
+        uint32_t low;
+        CHECKED(skip(parser, '\\'));
+        CHECKED(skip(parser, 'u'));
+        CHECKED(readHex4(parser, &low));
+
+        if (low < 0xDC00 || low > 0xDFFF)
+        {
+            return fail(parser, EZ_PE_INVALID_STRING);
+        }
+
+        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+    }
+
+    char utf8[4];
+    appendBuffer(parser, utf8, utf8_encode(codepoint, utf8));
+    return 0;
+}
+
+static int readEscape(struct EzJSONParser *parser)
+{
+    if (peek(parser) != 0)
+    {
+        return fail(parser, EZ_PE_UNEXPECTED_EOF);
+    }
+
+    char c;
+    switch ((char)parser->peeked)
+    {
+    case '\\':
+    case '"':
+    case '/':
+        c = parser->peeked;
+        break;
+    case 'n':
+        c = '\n';
+        break;
+    case 'r':
+        c = '\r';
+        break;
+    case 'b':
+        c = '\b';
+        break;
+    case 'f':
+        c = '\f';
+        break;
+    case 't':
+        c = '\t';
+        break;
+    case 'u':
+        consume(parser);
+        return readUnicodeEscape(parser);
+    default:
+        return fail(parser, EZ_PE_INVALID_STRING);
+    }
+
+    consume(parser);
+    writeBuffer(parser, c);
+    return 0;
+}
+
+// Remember where a string cut short by the end of the fed input resumes:
+// at resume, with the text decoded so far kept in the value buffer
+static int suspendString(
+    struct EzJSONParser *parser,
+    int key,
+    unsigned utf8State,
+    uint32_t keyHash,
+    unsigned hashed,
+    const char *resume,
+    int resumeInCarry)
+{
+    struct EzJSONParserFeed *feed = &parser->feed;
+    feed->inString                = 1;
+    feed->key                     = (char)key;
+    feed->utf8State               = utf8State;
+    feed->keyHash                 = keyHash;
+    feed->hashedLength            = hashed - parser->bufferBase;
+    feed->stringBase              = parser->bufferBase;
+    feed->resume                  = resume;
+    feed->resumeInCarry           = (char)resumeInCarry;
+    feed->resumeOffset            = parser->offset;
+    feed->resumeLine              = parser->line;
+    feed->resumeLineStart         = parser->lineStart;
+    return -1;
+}
+
+// Read a string into the value buffer. For keys, hash is non-null and
+// receives the key hash, computed run by run while the bytes are in cache.
+// With EZJ_PARSE_FEED it may carry on with a string suspended before.
+static int readString(struct EzJSONParser *parser, uint32_t *hash)
+{
+    const int validate = (parser->settings.flags & EZJ_PARSE_VALIDATE_UTF8) != 0;
+    unsigned utf8State = UTF8_ACCEPT;
+    uint32_t keyHash   = KEY_HASH_SEED;
+    unsigned hashed; // End of the bytes in keyHash
 
-    int done = 0;
-    int verb = 0;
+    if (parser->feed.inString)
+    {
+        parser->feed.inString = 0;
+        utf8State             = parser->feed.utf8State;
+        keyHash               = parser->feed.keyHash;
+        hashed = parser->bufferBase + parser->feed.hashedLength;
+    }
+    else
+    {
+        resetValue(parser);
+        CHECKED(skip(parser, '"'));
+        hashed = parser->bufferPos;
+    }
 
-    while (peek(parser) == 0 && done == 0)
+    while (1)
     {
-        if (verb)
+        // Copy the run of plain characters available in the input window
+        const char *run = parser->input;
+        const unsigned count =
+            (unsigned)(scan_string(run, parser->inputEnd) - run);
+
+        if (count > 0)
         {
-            switch ((char)parser->peeked)
+            if (validate)
             {
-            case '\\':
-                writeBuffer(parser, '\\');
-                break;
-            case '"':
-                writeBuffer(parser, '"');
-                break;
-            case 'n':
-                writeBuffer(parser, '\n');
-                break;
-            case 'r':
-                writeBuffer(parser, '\r');
-                break;
-            case 'b':
-                writeBuffer(parser, '\b');
-                break;
-            case 'f':
-                writeBuffer(parser, '\f');
-                break;
-            case 't':
-                writeBuffer(parser, '\t');
-                break;
-            default:
-                return -1;
+                const unsigned valid = utf8_validate(&utf8State, run, count);
+                if (valid < count)
+                {
+                    advance(parser, valid);
+                    return fail(parser, EZ_PE_INVALID_UTF8);
+                }
+            }
+
+            appendBuffer(parser, run, count);
+            advance(parser, count);
+
+            if (hash)
+            {
+                keyHash = key_hash(
+                    keyHash,
+                    parser->buffer + hashed,
+                    parser->bufferPos - hashed);
+                hashed = parser->bufferPos;
             }
-            verb = 0;
         }
-        else
+
+        if (peek(parser) != 0)
         {
-            switch ((char)parser->peeked)
+            if (parser->feed.starved)
             {
-            case '"':
-                done = 1;
-                break;
-            case '\\':
-                verb = 1;
-                break;
-
-            default:
-                writeBuffer(parser, (char)parser->peeked);
+                return suspendString(
+                    parser,
+                    hash != NULL,
+                    utf8State,
+                    keyHash,
+                    hashed,
+                    parser->input,
+                    parser->feed.windowIsCarry);
             }
+            return fail(parser, EZ_PE_UNEXPECTED_EOF);
         }
 
-        if (done == 0)
-            parser->hasPeeked = 0;
-    }
+        switch ((char)parser->peeked)
+        {
+        case '"':
+            if (utf8State != UTF8_ACCEPT)
+            {
+                return fail(parser, EZ_PE_INVALID_UTF8);
+            }
+            consume(parser);
+            EZJSON_STAT(parser->stats.stringBytes += valueLength(parser));
+            if (hash)
+            {
+                *hash = key_hash(
+                    keyHash,
+                    parser->buffer + hashed,
+                    parser->bufferPos - hashed);
+            }
+            return 0;
 
-    CHECKED(skip(parser, '"'));
-    return 0;
+        case '\\':
+            if (utf8State != UTF8_ACCEPT)
+            {
+                return fail(parser, EZ_PE_INVALID_UTF8);
+            }
+            {
+                // An escape cut short is read again from the backslash
+                const char *escape         = parser->input;
+                const int escapeInCarry    = parser->feed.windowIsCarry;
+                const unsigned long offset = parser->offset;
+                const unsigned bufferPos   = parser->bufferPos;
+                consume(parser);
+                if (readEscape(parser) != 0)
+                {
+                    if (!parser->feed.starved)
+                    {
+                        return -1;
+                    }
+                    parser->bufferPos = bufferPos;
+                    parser->offset    = offset;
+                    return suspendString(
+                        parser,
+                        hash != NULL,
+                        utf8State,
+                        keyHash,
+                        hashed,
+                        escape,
+                        escapeInCarry);
+                }
+            }
+            break;
+
+        default:
+            // Raw control characters are tolerated and copied as they are.
+            // They end a run so that line breaks are counted.
+            if ((unsigned char)parser->peeked < 0x20)
+            {
+                if (utf8State != UTF8_ACCEPT)
+                {
+                    return fail(parser, EZ_PE_INVALID_UTF8);
+                }
+                writeBuffer(parser, parser->peeked);
+                consume(parser);
+            }
+            break;
+        }
+    }
 }
 
-int readValue(struct EzJSONParser *parser)
+static int readValue(struct EzJSONParser *parser)
 {
     if (peek(parser) != 0)
     {
@@ -430,33 +724,58 @@ int readValue(struct EzJSONParser *parser)
 
     if (parser->peeked == '"')
     {
-        if (readString(parser) != 0)
+        if (readString(parser, NULL) != 0)
         {
             return -1;
         }
 
         setTokenText(
-            parser, EZJ_TOKEN_STRING, parser->buffer, parser->bufferPos);
+            parser, EZJ_TOKEN_STRING, valueText(parser), valueLength(parser));
         return 0;
     }
 
-    return -1;
+    return fail(parser, EZ_PE_UNEXPECTED_CHAR);
 }
 
 // Interface
 
 void *EzJSONParserInit(struct EzJSONParser *parser)
 {
+    memset(&parser->feed, 0, sizeof(parser->feed));
+    if (parser->settings.flags & EZJ_PARSE_FIRST_KEY_WINS)
+    {
+        parser->settings.flags |= EZJ_PARSE_SKIP_SEPARATORS;
+    }
+    if (parser->settings.get_next_block || parser->settings.get_next_char
+        || (parser->settings.flags & EZJ_PARSE_FEED))
+    {
+        parser->input    = &parser->inputChar;
+        parser->inputEnd = parser->input;
+    }
+    else
+    {
+        parser->input    = parser->settings.input;
+        parser->inputEnd = parser->input + parser->settings.input_length;
+    }
+
     parser->buffer     = parser->inlineBuffer;
     parser->bufferSize = EZJSON_PARSER_INLINE_BUFFER;
     parser->bufferPos  = 0;
-    stack_init(&parser->stack);
+    parser->bufferBase = 0;
+    stack_init(&parser->stack, parser->settings.max_depth);
+    key_pool_init(&parser->keys);
+    key_set_init(&parser->seenKeys);
+    parser->dropDepth = 0;
+    parser->inBase64  = 0;
     parser->peeked    = '\0';
     parser->hasPeeked = 0;
     parser->hasToken  = 0;
     parser->state     = EZ_PS_EXPECT_VALUE;
     parser->line      = 1;
-    parser->pos       = 0;
+    parser->offset    = 0;
+    parser->lineStart = 0;
+    memset(&parser->error, 0, sizeof(parser->error));
+    EzJSONParserResetStats(parser);
     return parser;
 }
 
@@ -465,7 +784,7 @@ struct EzJSONToken *EzJSONParserToken(struct EzJSONParser *parser)
     return parser->hasToken ? &parser->token : NULL;
 }
 
-enum EzJSONParserState expectedAfterValue(struct EzJSONParser *parser)
+static enum EzJSONParserState expectedAfterValue(struct EzJSONParser *parser)
 {
     if (stack_empty(&parser->stack))
     {
@@ -484,7 +803,122 @@ enum EzJSONParserState expectedAfterValue(struct EzJSONParser *parser)
     }
 }
 
-void nextToken(struct EzJSONParser *parser)
+static int pushContainer(struct EzJSONParser *parser, int bit)
+{
+#if defined(EZJSON_STATS)
+    if (stack_full(&parser->stack))
+    {
+        parser->stats.stackGrowths++;
+    }
+    if (stack_depth(&parser->stack) + 1 > parser->stats.maxDepth)
+    {
+        parser->stats.maxDepth = stack_depth(&parser->stack) + 1;
+    }
+#endif
+
+    if (stack_push(
+            &parser->stack,
+            bit,
+            parser->settings.userdata,
+            parser->settings.allocate_memory,
+            parser->settings.free_memory)
+        != 0)
+    {
+        // Report the position of the opening bracket, which was consumed
+        parser->hasToken = 0;
+        parser->offset--;
+        fail(parser, EZ_PE_DEPTH_EXCEEDED);
+        parser->offset++;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Swap the text of the current key token for its interned copy
+static int internKey(struct EzJSONParser *parser)
+{
+    const uint32_t id = key_pool_intern(
+        &parser->keys,
+        stack_depth(&parser->stack),
+        parser->token.data_text,
+        parser->token.data_text_length,
+        parser->token.data_key_hash,
+        parser->settings.userdata,
+        parser->settings.allocate_memory,
+        parser->settings.free_memory);
+    if (id == KEY_NONE)
+    {
+        parser->hasToken = 0;
+        return fail(parser, EZ_PE_NO_MEMORY);
+    }
+
+    parser->token.data_text   = parser->keys.keys[id].text;
+    parser->token.data_key_id = id;
+    return 0;
+}
+
+// Look the current key token up among the keys of its object and apply the
+// duplicate key policy
+static int checkKey(struct EzJSONParser *parser)
+{
+    const int found = key_set_add(
+        &parser->seenKeys,
+        parser->token.data_text,
+        parser->token.data_text_length,
+        parser->token.data_key_hash,
+        parser->settings.userdata,
+        parser->settings.allocate_memory,
+        parser->settings.free_memory);
+    if (found < 0)
+    {
+        parser->hasToken = 0;
+        return fail(parser, EZ_PE_NO_MEMORY);
+    }
+
+    parser->token.data_key_duplicate = (EzJSONBool)found;
+    if (found && (parser->settings.flags & EZJ_PARSE_REJECT_DUPLICATE_KEYS))
+    {
+        // Report the position of the closing quote, which was consumed
+        parser->hasToken = 0;
+        parser->offset--;
+        fail(parser, EZ_PE_DUPLICATE_KEY);
+        parser->offset++;
+        return -1;
+    }
+    // Keys inside a member that is being dropped go with it
+    if (found && (parser->settings.flags & EZJ_PARSE_FIRST_KEY_WINS)
+        && parser->dropDepth == 0)
+    {
+        parser->dropDepth = stack_depth(&parser->stack);
+    }
+    return 0;
+}
+
+static void readKey(struct EzJSONParser *parser)
+{
+    uint32_t hash;
+    if (readString(parser, &hash) == 0)
+    {
+        setTokenText(
+            parser, EZJ_TOKEN_OBJ_KEY, valueText(parser), valueLength(parser));
+        parser->token.data_key_hash      = hash;
+        parser->token.data_key_duplicate = 0;
+        if ((parser->settings.flags & EZJ_PARSE_INTERN_KEYS)
+            && internKey(parser) != 0)
+        {
+            return;
+        }
+        if ((parser->settings.flags & DUPLICATE_KEY_FLAGS)
+            && checkKey(parser) != 0)
+        {
+            return;
+        }
+        parser->state = EZ_PS_EXPECT_KV_SEP;
+    }
+}
+
+static void nextToken(struct EzJSONParser *parser)
 {
     if (peek(parser) == 0)
     {
@@ -494,8 +928,8 @@ void nextToken(struct EzJSONParser *parser)
             {
                 skip(parser, ']');
                 setTokenSimple(parser, EZJ_TOKEN_ARR_END);
-                parser->state = expectedAfterValue(parser);
                 stack_pop(&parser->stack);
+                parser->state = expectedAfterValue(parser);
                 return;
             }
         }
@@ -505,8 +939,12 @@ void nextToken(struct EzJSONParser *parser)
             {
                 skip(parser, '}');
                 setTokenSimple(parser, EZJ_TOKEN_OBJ_END);
-                parser->state = expectedAfterValue(parser);
                 stack_pop(&parser->stack);
+                if (parser->settings.flags & DUPLICATE_KEY_FLAGS)
+                {
+                    key_set_end_object(&parser->seenKeys);
+                }
+                parser->state = expectedAfterValue(parser);
                 return;
             }
         }
@@ -515,11 +953,21 @@ void nextToken(struct EzJSONParser *parser)
             if (parser->peeked == ',')
             {
                 skip(parser, ',');
-                setTokenSimple(parser, EZJ_TOKEN_SEQ_SEP);
                 parser->state = (stack_top(&parser->stack) == STACK_BIT_ARRAY)
                                     ? EZ_PS_EXPECT_VALUE
                                     : EZ_PS_EXPECT_OBJ_KEY;
-                return;
+                if (!(parser->settings.flags & EZJ_PARSE_SKIP_SEPARATORS))
+                {
+                    setTokenSimple(parser, EZJ_TOKEN_SEQ_SEP);
+                    return;
+                }
+
+                // Continue with the key or value that must follow
+                skipWhitespace(parser);
+                if (peek(parser) != 0)
+                {
+                    return;
+                }
             }
         }
         if (parser->state & EZ_PS_EXPECT_KV_SEP)
@@ -527,23 +975,24 @@ void nextToken(struct EzJSONParser *parser)
             if (parser->peeked == ':')
             {
                 skip(parser, ':');
-                setTokenSimple(parser, EZJ_TOKEN_KV_SEP);
                 parser->state = EZ_PS_EXPECT_VALUE;
-                return;
+                if (!(parser->settings.flags & EZJ_PARSE_SKIP_SEPARATORS))
+                {
+                    setTokenSimple(parser, EZJ_TOKEN_KV_SEP);
+                    return;
+                }
+
+                skipWhitespace(parser);
+                if (peek(parser) != 0)
+                {
+                    return;
+                }
             }
         }
         if (parser->state & EZ_PS_EXPECT_OBJ_KEY)
         {
-            if (readString(parser) == 0)
-            {
-                setTokenText(
-                    parser,
-                    EZJ_TOKEN_OBJ_KEY,
-                    parser->buffer,
-                    parser->bufferPos);
-                parser->state = EZ_PS_EXPECT_KV_SEP;
-                return;
-            }
+            readKey(parser);
+            return;
         }
         if (parser->state & EZ_PS_EXPECT_VALUE)
         {
@@ -552,21 +1001,31 @@ void nextToken(struct EzJSONParser *parser)
                 switch (parser->token.type)
                 {
                 case EZJ_TOKEN_ARR_BEGIN:
-                    stack_push(
-                        &parser->stack,
-                        STACK_BIT_ARRAY,
-                        parser->settings.userdata,
-                        parser->settings.allocate_memory,
-                        parser->settings.free_memory);
-                    parser->state = EZ_PS_EXPECT_VALUE;
+                    if (pushContainer(parser, STACK_BIT_ARRAY) != 0)
+                    {
+                        return;
+                    }
+                    parser->state = EZ_PS_EXPECT_VALUE | EZ_PS_EXPECT_ARR_END;
                     return;
                 case EZJ_TOKEN_OBJ_BEGIN:
-                    stack_push(
-                        &parser->stack,
-                        STACK_BIT_OBJECT,
-                        parser->settings.userdata,
-                        parser->settings.allocate_memory,
-                        parser->settings.free_memory);
+                    if (pushContainer(parser, STACK_BIT_OBJECT) != 0)
+                    {
+                        return;
+                    }
+                    key_pool_begin_object(
+                        &parser->keys, stack_depth(&parser->stack));
+                    if ((parser->settings.flags & DUPLICATE_KEY_FLAGS)
+                        && key_set_begin_object(
+                               &parser->seenKeys,
+                               parser->settings.userdata,
+                               parser->settings.allocate_memory,
+                               parser->settings.free_memory)
+                               != 0)
+                    {
+                        parser->hasToken = 0;
+                        fail(parser, EZ_PE_NO_MEMORY);
+                        return;
+                    }
                     parser->state = EZ_PS_EXPECT_OBJ_KEY | EZ_PS_EXPECT_OBJ_END;
                     return;
                 default:
@@ -582,28 +1041,936 @@ void nextToken(struct EzJSONParser *parser)
     }
 }
 
-void EzJSONParserNext(struct EzJSONParser *parser)
+// Grow the carry to hold size bytes, keeping its contents
+static int growCarry(struct EzJSONParser *parser, unsigned long size)
 {
-    parser->hasToken = 0;
-    skipWhitespace(parser);
-    nextToken(parser);
-
-    if (!parser->hasToken && !(parser->state & EZ_PS_EXPECT_EOF))
+    struct EzJSONParserFeed *feed = &parser->feed;
+    unsigned long grown = feed->carrySize ? feed->carrySize : 64u;
+    while (grown < size)
     {
-        parser->state = EZ_PS_ERROR;
+        grown *= 2u;
     }
+    if (grown > 0xFFFFFFFFul)
+    {
+        return -1;
+    }
+
+    char *carry;
+    if (parser->settings.allocate_memory)
+    {
+        carry = parser->settings.allocate_memory(
+            parser->settings.userdata, (unsigned)grown);
+    }
+    else
+    {
+        carry = (char *)malloc(grown);
+    }
+    if (!carry)
+    {
+        return -1;
+    }
+
+    if (feed->carry)
+    {
+        memcpy(carry, feed->carry, feed->carryLength);
+        if (parser->settings.free_memory)
+        {
+            parser->settings.free_memory(
+                parser->settings.userdata, feed->carry, feed->carrySize);
+        }
+        else
+        {
+            free(feed->carry);
+        }
+    }
+    feed->carry     = carry;
+    feed->carrySize = (unsigned)grown;
+    return 0;
+}
+
+// The fed input ran out during a step: rewind to the resume point and move
+// the input from there on to the carry, so that the fed data can be reused
+static void suspend(struct EzJSONParser *parser)
+{
+    struct EzJSONParserFeed *feed = &parser->feed;
+
+    // The resume point is in the carry, or in the last fed data
+    unsigned long kept = 0;
+    const char *from   = feed->resume;
+    if (feed->resumeInCarry)
+    {
+        kept = feed->carryLength - (unsigned long)(from - feed->carry);
+        memmove(feed->carry, from, kept);
+        from = feed->windowIsCarry ? NULL : feed->chunk;
+    }
+    const unsigned long count =
+        from ? (unsigned long)(feed->chunk + feed->chunkLength - from) : 0;
+
+    feed->carryLength = (unsigned)kept;
+    if (kept + count > feed->carrySize && growCarry(parser, kept + count) != 0)
+    {
+        fail(parser, EZ_PE_NO_MEMORY);
+        parser->state = EZ_PS_ERROR;
+        return;
+    }
+    if (count > 0)
+    {
+        memcpy(feed->carry + kept, from, count);
+    }
+    feed->carryLength = (unsigned)(kept + count);
+
+    parser->input     = feed->carry;
+    parser->inputEnd  = feed->carry;
+    parser->hasPeeked = 0;
+    parser->hasToken  = 0;
+    parser->offset    = feed->resumeOffset;
+    parser->line      = feed->resumeLine;
+    parser->lineStart = feed->resumeLineStart;
+    if (!feed->inString)
+    {
+        parser->state = feed->resumeState;
+    }
+    feed->chunk         = NULL;
+    feed->chunkLength   = 0;
+    feed->windowIsCarry = 0;
+    feed->carried       = 1;
+
+    // Failures were caused by the missing input
+    memset(&parser->error, 0, sizeof(parser->error));
+}
+
+// Read the next token, whether it is returned or dropped
+static void readToken(struct EzJSONParser *parser)
+{
+    parser->hasToken = 0;
+    if (parser->state == EZ_PS_ERROR)
+    {
+        return;
+    }
+
+    if (parser->settings.flags & EZJ_PARSE_FEED)
+    {
+        struct EzJSONParserFeed *feed = &parser->feed;
+        if (parser->input == parser->inputEnd && !feed->pending
+            && !feed->ended)
+        {
+            // Nothing new was fed
+            feed->starved = 1;
+            return;
+        }
+
+        feed->starved = 0;
+        if (feed->inString)
+        {
+            // Carry on with the text, whatever the state expects next
+            if (feed->key)
+            {
+                readKey(parser);
+            }
+            else if (readString(parser, NULL) == 0)
+            {
+                setTokenText(
+                    parser,
+                    EZJ_TOKEN_STRING,
+                    valueText(parser),
+                    valueLength(parser));
+                parser->state = expectedAfterValue(parser);
+            }
+        }
+        else
+        {
+            skipWhitespace(parser);
+            feed->resume          = parser->input;
+            feed->resumeInCarry   = feed->windowIsCarry;
+            feed->resumeOffset    = parser->offset;
+            feed->resumeLine      = parser->line;
+            feed->resumeLineStart = parser->lineStart;
+            feed->resumeState     = parser->state;
+            nextToken(parser);
+        }
+
+        if (feed->starved)
+        {
+            suspend(parser);
+            return;
+        }
+    }
+    else
+    {
+        skipWhitespace(parser);
+        nextToken(parser);
+    }
+
+    if (!parser->hasToken)
+    {
+        // Either a token failed to parse, or there is input where none was
+        // expected, or the input ended early
+        if (peek(parser) == 0)
+        {
+            fail(parser, EZ_PE_UNEXPECTED_CHAR);
+            parser->state = EZ_PS_ERROR;
+        }
+        else if (!(parser->state & EZ_PS_EXPECT_EOF))
+        {
+            fail(parser, EZ_PE_UNEXPECTED_EOF);
+            parser->state = EZ_PS_ERROR;
+        }
+    }
+}
+
+// Produce the next token, shared by EzJSONParserNext and the batch loop
+static void step(struct EzJSONParser *parser)
+{
+    readToken(parser);
+
+    // With EZJ_PARSE_FIRST_KEY_WINS, a repeated key is dropped with its
+    // value, which ends back at the depth of its object
+    while (parser->dropDepth != 0 && parser->hasToken)
+    {
+        if (parser->token.type != EZJ_TOKEN_OBJ_KEY
+            && stack_depth(&parser->stack) == parser->dropDepth)
+        {
+            parser->dropDepth = 0;
+        }
+        readToken(parser);
+    }
+    EZJSON_STAT(parser->stats.tokens += parser->hasToken);
+}
+
+// A suspended string left by EzJSONParserNextBatch may not start at the
+// front of the buffer, move it there
+static void rebaseString(struct EzJSONParser *parser)
+{
+    const unsigned base = parser->feed.stringBase;
+    if (parser->feed.inString && base > 0)
+    {
+        memmove(
+            parser->buffer, parser->buffer + base, parser->bufferPos - base);
+        parser->bufferPos -= base;
+        parser->feed.stringBase = 0;
+    }
+}
+
+void EzJSONParserNext(struct EzJSONParser *parser)
+{
+    rebaseString(parser);
+    parser->bufferBase = 0;
+    step(parser);
+}
+
+// Interned keys point to the key pool rather than the value buffer
+static int
+textInBuffer(struct EzJSONParser *parser, const struct EzJSONToken *token)
+{
+    return token->type == EZJ_TOKEN_STRING
+           || (token->type == EZJ_TOKEN_OBJ_KEY
+               && !(parser->settings.flags & EZJ_PARSE_INTERN_KEYS));
+}
+
+unsigned EzJSONParserNextBatch(
+    struct EzJSONParser *parser, struct EzJSONToken *out, unsigned max)
+{
+    unsigned count = 0;
+
+    // Text of every token stays in the buffer until the batch ends, and is
+    // addressed by offset because the buffer may move as it grows
+    rebaseString(parser);
+    parser->bufferBase = 0;
+    while (count < max)
+    {
+        step(parser);
+        if (!parser->hasToken)
+        {
+            break;
+        }
+
+        out[count] = parser->token;
+        if (textInBuffer(parser, &parser->token))
+        {
+            out[count].data_text =
+                (const char *)(uintptr_t)(parser->token.data_text
+                                          - parser->buffer);
+            parser->bufferBase = parser->bufferPos;
+        }
+        count++;
+    }
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (textInBuffer(parser, &out[i]))
+        {
+            out[i].data_text = parser->buffer + (uintptr_t)out[i].data_text;
+        }
+    }
+
+    parser->bufferBase = 0;
+    return count;
+}
+
+// Typed number arrays. Numbers are converted straight from the input window
+// when they are complete in it, which is always the case for memory input.
+
+// Convert a scanned number, through strtod when the fast path is not exact
+static double numberToDouble(
+    struct EzJSONParser *parser,
+    const struct NumberParts *parts,
+    const char *text,
+    unsigned length)
+{
+    double value;
+    if (number_fast_double(parts, &value))
+    {
+        return value;
+    }
+
+    // Text from the value buffer is already terminated
+    if (text != valueText(parser))
+    {
+        resetValue(parser);
+        appendBuffer(parser, text, length);
+        writeBuffer(parser, '\x00');
+    }
+    return strtod(valueText(parser), NULL);
+}
+
+// Store the next array element, returns non-zero if it does not fit the type
+static int readArrayNumber(
+    struct EzJSONParser *parser,
+    enum NumberArrayType type,
+    void *out,
+    unsigned index)
+{
+    struct NumberParts parts;
+    const char *text = parser->input;
+    const char *end  = number_scan(text, parser->inputEnd, &parts);
+    unsigned length;
+
+    if (end && end < parser->inputEnd)
+    {
+        length = (unsigned)(end - text);
+    }
+    else
+    {
+        // Split across refills, or malformed. readNumber reports errors at
+        // the offending character and leaves the text in the value buffer.
+        EzJSONNumber unused;
+        end = NULL;
+        CHECKED(readNumber(parser, &unused));
+        text   = valueText(parser);
+        length = valueLength(parser);
+        number_scan(text, text + length, &parts);
+    }
+
+    switch (type)
+    {
+    case NUMBERS_DOUBLE:
+        ((double *)out)[index] = numberToDouble(parser, &parts, text, length);
+        break;
+    case NUMBERS_FLOAT:
+        ((float *)out)[index] =
+            (float)numberToDouble(parser, &parts, text, length);
+        break;
+    case NUMBERS_INT64:
+        if (!number_to_int64(&parts, (int64_t *)out + index))
+        {
+            return fail(parser, EZ_PE_INVALID_NUMBER);
+        }
+        break;
+    }
+
+    if (end)
+    {
+        advance(parser, length);
+    }
+    return 0;
+}
+
+static int readNumberArray(
+    struct EzJSONParser *parser,
+    enum NumberArrayType type,
+    void *out,
+    unsigned capacity,
+    unsigned *count)
+{
+    *count = 0;
+    if (parser->state == EZ_PS_ERROR
+        || (parser->settings.flags & EZJ_PARSE_FEED)
+        || stack_empty(&parser->stack)
+        || stack_top(&parser->stack) != STACK_BIT_ARRAY)
+    {
+        return -1;
+    }
+
+    parser->hasToken = 0;
+    while (1)
+    {
+        skipWhitespace(parser);
+        if (peek(parser) != 0)
+        {
+            fail(parser, EZ_PE_UNEXPECTED_EOF);
+            break;
+        }
+
+        const char c = parser->peeked;
+        if (c == ']' && (parser->state & EZ_PS_EXPECT_ARR_END))
+        {
+            consume(parser);
+            setTokenSimple(parser, EZJ_TOKEN_ARR_END);
+            stack_pop(&parser->stack);
+            parser->state = expectedAfterValue(parser);
+            EZJSON_STAT(parser->stats.tokens += *count + 1);
+            return 0;
+        }
+
+        if (parser->state & EZ_PS_EXPECT_SEQ_SEP)
+        {
+            if (c != ',')
+            {
+                fail(parser, EZ_PE_UNEXPECTED_CHAR);
+                break;
+            }
+            consume(parser);
+            parser->state = EZ_PS_EXPECT_VALUE;
+            continue;
+        }
+
+        // Leave anything else to EzJSONParserNext
+        if (*count == capacity || !(c == '-' || (c >= '0' && c <= '9')))
+        {
+            EZJSON_STAT(parser->stats.tokens += *count);
+            return 1;
+        }
+
+        if (readArrayNumber(parser, type, out, *count) != 0)
+        {
+            break;
+        }
+        (*count)++;
+        parser->state = EZ_PS_EXPECT_SEQ_SEP | EZ_PS_EXPECT_ARR_END;
+    }
+
+    parser->state = EZ_PS_ERROR;
+    return -1;
+}
+
+int EzJSONParserReadNumberArray(
+    struct EzJSONParser *parser,
+    double *out,
+    unsigned capacity,
+    unsigned *count)
+{
+    return readNumberArray(parser, NUMBERS_DOUBLE, out, capacity, count);
+}
+
+int EzJSONParserReadNumberArrayF(
+    struct EzJSONParser *parser, float *out, unsigned capacity, unsigned *count)
+{
+    return readNumberArray(parser, NUMBERS_FLOAT, out, capacity, count);
+}
+
+int EzJSONParserReadNumberArrayI64(
+    struct EzJSONParser *parser,
+    int64_t *out,
+    unsigned capacity,
+    unsigned *count)
+{
+    return readNumberArray(parser, NUMBERS_INT64, out, capacity, count);
+}
+
+// Base64 strings. Whole groups of 4 characters are decoded from the input
+// window in bulk, the scalar loop handles groups split across refills,
+// escapes, padding and the end of the string.
+
+// Consume the separator before the next value, if any, and the opening
+// quote. Returns 1 at the start of a string, 0 if the next value is not one
+// and -1 on error.
+static int openBase64(struct EzJSONParser *parser)
+{
+    skipWhitespace(parser);
+    if (parser->state & EZ_PS_EXPECT_KV_SEP)
+    {
+        CHECKED(skip(parser, ':'));
+        parser->state = EZ_PS_EXPECT_VALUE;
+        skipWhitespace(parser);
+    }
+    else if (
+        (parser->state & EZ_PS_EXPECT_SEQ_SEP)
+        && stack_top(&parser->stack) == STACK_BIT_ARRAY
+        && peekOptional(parser) == ',')
+    {
+        consume(parser);
+        parser->state = EZ_PS_EXPECT_VALUE;
+        skipWhitespace(parser);
+    }
+
+    if (!(parser->state & EZ_PS_EXPECT_VALUE) || peekOptional(parser) != '"')
+    {
+        return 0;
+    }
+
+    consume(parser);
+    parser->inBase64      = 1;
+    parser->base64Bits    = 0;
+    parser->base64Chars   = 0;
+    parser->base64Padding = 0;
+    return 1;
+}
+
+// Whether the bits of a partial group below its last byte are zero, so
+// that each byte string has a single encoding
+static int base64BitsUnused(const struct EzJSONParser *parser)
+{
+    const unsigned unused = 6u * parser->base64Chars % 8u;
+    return (parser->base64Bits & ((1u << unused) - 1u)) == 0;
+}
+
+// Store the bytes of a group of 2 to 4 characters
+static unsigned storeBase64(struct EzJSONParser *parser, unsigned char *out)
+{
+    const unsigned count = parser->base64Chars - 1u;
+    const uint32_t bits  = parser->base64Bits << (24 - 6 * parser->base64Chars);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        out[i] = (unsigned char)(bits >> (16 - 8 * i));
+    }
+    parser->base64Bits  = 0;
+    parser->base64Chars = 0;
+    return count;
+}
+
+int EzJSONParserReadBase64(
+    struct EzJSONParser *parser,
+    unsigned char *out,
+    unsigned capacity,
+    unsigned *count)
+{
+    *count = 0;
+    if (parser->state == EZ_PS_ERROR
+        || (parser->settings.flags & EZJ_PARSE_FEED))
+    {
+        return -1;
+    }
+
+    parser->hasToken = 0;
+    if (!parser->inBase64)
+    {
+        const int opened = openBase64(parser);
+        if (opened <= 0)
+        {
+            if (opened < 0)
+            {
+                parser->state = EZ_PS_ERROR;
+            }
+            return -1;
+        }
+    }
+
+    while (1)
+    {
+        if (parser->base64Chars == 0 && parser->base64Padding == 0)
+        {
+            const unsigned long window =
+                (unsigned long)(parser->inputEnd - parser->input) / 4;
+            unsigned long room = (capacity - *count) / 3;
+            room = room < window ? room : window;
+            room = room < 0x10000000ul ? room : 0x10000000ul;
+
+            const unsigned long groups =
+                base64_decode(parser->input, room, out + *count);
+            advance(parser, (unsigned)groups * 4);
+            *count += (unsigned)groups * 3;
+        }
+
+        if (peek(parser) != 0)
+        {
+            fail(parser, EZ_PE_UNEXPECTED_EOF);
+            break;
+        }
+
+        const char c = parser->peeked;
+        if (c == '"' && parser->base64Padding != 2
+            && parser->base64Chars != 1)
+        {
+            if (!base64BitsUnused(parser))
+            {
+                fail(parser, EZ_PE_INVALID_BASE64);
+                break;
+            }
+            if (parser->base64Chars > 0)
+            {
+                *count += storeBase64(parser, out + *count);
+            }
+            consume(parser);
+            parser->inBase64 = 0;
+            setTokenText(parser, EZJ_TOKEN_STRING, (char *)out, *count);
+            parser->state = expectedAfterValue(parser);
+            EZJSON_STAT(parser->stats.tokens++);
+            return 0;
+        }
+
+        // Room for a whole group is kept before starting one
+        if (parser->base64Chars == 0 && parser->base64Padding == 0
+            && capacity - *count < 3)
+        {
+            return 1;
+        }
+
+        if (c == '=')
+        {
+            // One '=' per missing character, then the string must end
+            if (parser->base64Padding == 2)
+            {
+                parser->base64Padding = 1;
+            }
+            else if (
+                parser->base64Padding == 0 && parser->base64Chars >= 2
+                && base64BitsUnused(parser))
+            {
+                parser->base64Padding = parser->base64Chars == 2 ? 2 : 1;
+                *count += storeBase64(parser, out + *count);
+            }
+            else
+            {
+                fail(parser, EZ_PE_INVALID_BASE64);
+                break;
+            }
+            consume(parser);
+            continue;
+        }
+
+        unsigned value = base64_value(c);
+        if (c == '\\')
+        {
+            consume(parser);
+            if (peek(parser) != 0)
+            {
+                fail(parser, EZ_PE_UNEXPECTED_EOF);
+                break;
+            }
+            value = parser->peeked == '/' ? 63u : BASE64_INVALID;
+        }
+        if (value == BASE64_INVALID || parser->base64Padding != 0)
+        {
+            fail(parser, EZ_PE_INVALID_BASE64);
+            break;
+        }
+
+        consume(parser);
+        parser->base64Bits = (parser->base64Bits << 6) | value;
+        if (++parser->base64Chars == 4)
+        {
+            *count += storeBase64(parser, out + *count);
+        }
+    }
+
+    parser->inBase64 = 0;
+    parser->state    = EZ_PS_ERROR;
+    return -1;
+}
+
+int EzJSONParserSkip(struct EzJSONParser *parser)
+{
+    if (!parser->hasToken || (parser->settings.flags & EZJ_PARSE_FEED)
+        || (parser->token.type != EZJ_TOKEN_OBJ_BEGIN
+            && parser->token.type != EZJ_TOKEN_ARR_BEGIN))
+    {
+        return -1;
+    }
+
+    const enum EzJSONTokenType endType =
+        parser->token.type == EZJ_TOKEN_OBJ_BEGIN ? EZJ_TOKEN_OBJ_END
+                                                  : EZJ_TOKEN_ARR_END;
+
+    if (parser->settings.get_next_block || parser->settings.get_next_char)
+    {
+        unsigned depth = 1;
+        while (depth > 0)
+        {
+            EzJSONParserNext(parser);
+            if (!parser->hasToken)
+            {
+                return -1;
+            }
+            depth += parser->token.type == EZJ_TOKEN_OBJ_BEGIN
+                     || parser->token.type == EZJ_TOKEN_ARR_BEGIN;
+            depth -= parser->token.type == EZJ_TOKEN_OBJ_END
+                     || parser->token.type == EZJ_TOKEN_ARR_END;
+        }
+        return 0;
+    }
+
+    // The window is the whole document
+    const char *end = scan_container(parser->input, parser->inputEnd);
+    if (!end)
+    {
+        fail(parser, EZ_PE_UNEXPECTED_EOF);
+        parser->state    = EZ_PS_ERROR;
+        parser->hasToken = 0;
+        return -1;
+    }
+
+    for (const char *p = parser->input;
+         (p = memchr(p, '\n', (size_t)(end - p))) != NULL;
+         ++p)
+    {
+        parser->line++;
+        parser->lineStart =
+            parser->offset + (unsigned long)(p + 1 - parser->input);
+    }
+    parser->hasPeeked = 0;
+    parser->offset += (unsigned long)(end - parser->input);
+    EZJSON_STAT(parser->stats.bytes += (unsigned long)(end - parser->input));
+    parser->input = end;
+
+    stack_pop(&parser->stack);
+    if (endType == EZJ_TOKEN_OBJ_END
+        && (parser->settings.flags & DUPLICATE_KEY_FLAGS))
+    {
+        key_set_end_object(&parser->seenKeys);
+    }
+    parser->state = expectedAfterValue(parser);
+    setTokenSimple(parser, endType);
+    return 0;
+}
+
+// The text of the last number is still in the value buffer, terminated
+static int tokenNumber(struct EzJSONParser *parser, struct NumberParts *parts)
+{
+    if (!parser->hasToken || parser->token.type != EZJ_TOKEN_NUMBER)
+    {
+        return -1;
+    }
+
+    const char *text = valueText(parser);
+    number_scan(text, text + valueLength(parser), parts);
+    return 0;
+}
+
+int EzJSONParserNumberDouble(struct EzJSONParser *parser, double *out)
+{
+    struct NumberParts parts;
+    if (tokenNumber(parser, &parts) != 0)
+    {
+        return -1;
+    }
+
+    *out = numberToDouble(
+        parser, &parts, valueText(parser), valueLength(parser));
+    return 0;
+}
+
+int EzJSONParserNumberI64(struct EzJSONParser *parser, int64_t *out)
+{
+    struct NumberParts parts;
+    if (tokenNumber(parser, &parts) != 0 || !number_to_int64(&parts, out))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int EzJSONParserNumberU64(struct EzJSONParser *parser, uint64_t *out)
+{
+    struct NumberParts parts;
+    if (tokenNumber(parser, &parts) != 0 || !number_to_uint64(&parts, out))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+const char *
+EzJSONParserNumberText(struct EzJSONParser *parser, unsigned *length)
+{
+    if (!parser->hasToken || parser->token.type != EZJ_TOKEN_NUMBER)
+    {
+        return NULL;
+    }
+
+    *length = valueLength(parser);
+    return valueText(parser);
 }
 
 void EzJSONParserDestroy(struct EzJSONParser *parser)
 {
     freeBuffer(parser);
+    if (parser->feed.carry)
+    {
+        if (parser->settings.free_memory)
+        {
+            parser->settings.free_memory(
+                parser->settings.userdata,
+                parser->feed.carry,
+                parser->feed.carrySize);
+        }
+        else
+        {
+            free(parser->feed.carry);
+        }
+        parser->feed.carry = NULL;
+    }
     stack_destroy(
         &parser->stack,
         parser->settings.userdata,
         parser->settings.free_memory);
+    key_pool_destroy(
+        &parser->keys, parser->settings.userdata, parser->settings.free_memory);
+    key_set_destroy(
+        &parser->seenKeys,
+        parser->settings.userdata,
+        parser->settings.free_memory);
+}
+
+int EzJSONParserInternKey(
+    struct EzJSONParser *parser, const char *key, unsigned length, uint32_t *id)
+{
+    // Past the prediction depth, so the prediction state is left alone
+    *id = key_pool_intern(
+        &parser->keys,
+        EZJSON_KEY_PREDICT_DEPTH,
+        key,
+        length,
+        key_hash(KEY_HASH_SEED, key, length),
+        parser->settings.userdata,
+        parser->settings.allocate_memory,
+        parser->settings.free_memory);
+    return *id == KEY_NONE ? -1 : 0;
+}
+
+unsigned EzJSONParserKeyCount(struct EzJSONParser *parser)
+{
+    return parser->keys.count;
+}
+
+const char *
+EzJSONParserKeyText(struct EzJSONParser *parser, uint32_t id, unsigned *length)
+{
+    if (id >= parser->keys.count)
+    {
+        return NULL;
+    }
+
+    if (length)
+    {
+        *length = parser->keys.keys[id].length;
+    }
+    return parser->keys.keys[id].text;
+}
+
+int EzJSONParserFeed(
+    struct EzJSONParser *parser, const char *data, unsigned long length)
+{
+    struct EzJSONParserFeed *feed = &parser->feed;
+    if (!(parser->settings.flags & EZJ_PARSE_FEED) || feed->ended
+        || feed->pending || parser->input != parser->inputEnd)
+    {
+        return -1;
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    feed->starved = 0;
+    if (feed->carried)
+    {
+        // The unfinished token is read first, then the new data
+        feed->carried       = 0;
+        feed->windowIsCarry = 1;
+        feed->pending       = data;
+        feed->pendingLength = length;
+        parser->input       = feed->carry;
+        parser->inputEnd    = feed->carry + feed->carryLength;
+    }
+    else
+    {
+        feed->windowIsCarry = 0;
+        feed->chunk         = data;
+        feed->chunkLength   = length;
+        parser->input       = data;
+        parser->inputEnd    = data + length;
+    }
+    return 0;
+}
+
+void EzJSONParserFeedEnd(struct EzJSONParser *parser)
+{
+    struct EzJSONParserFeed *feed = &parser->feed;
+    feed->ended                   = 1;
+    feed->starved                 = 0;
+    if (feed->carried && !feed->pending && parser->input == parser->inputEnd)
+    {
+        feed->carried       = 0;
+        feed->windowIsCarry = 1;
+        parser->input       = feed->carry;
+        parser->inputEnd    = feed->carry + feed->carryLength;
+    }
+}
+
+EzJSONBool EzJSONParserNeedsInput(struct EzJSONParser *parser)
+{
+    return parser->feed.starved && parser->state != EZ_PS_ERROR;
 }
 
 EzJSONBool EzJSONParserHasError(struct EzJSONParser *parser)
 {
-    return parser->state & EZ_PS_ERROR;
+    return parser->state == EZ_PS_ERROR;
+}
+
+const struct EzJSONError *EzJSONParserError(struct EzJSONParser *parser)
+{
+    return &parser->error;
+}
+
+uint32_t EzJSONKeyHash(const char *key, unsigned length)
+{
+    return key_hash(KEY_HASH_SEED, key, length);
+}
+
+const char *EzJSONErrorKindName(enum EzJSONErrorKind kind)
+{
+    switch (kind)
+    {
+    case EZ_PE_NONE:
+        return "no error";
+    case EZ_PE_UNEXPECTED_CHAR:
+        return "unexpected character";
+    case EZ_PE_UNEXPECTED_EOF:
+        return "unexpected end of input";
+    case EZ_PE_INVALID_LITERAL:
+        return "invalid literal";
+    case EZ_PE_INVALID_NUMBER:
+        return "invalid number";
+    case EZ_PE_INVALID_STRING:
+        return "invalid string";
+    case EZ_PE_DEPTH_EXCEEDED:
+        return "maximum nesting depth exceeded";
+    case EZ_PE_INVALID_UTF8:
+        return "invalid UTF-8";
+    case EZ_PE_NO_MEMORY:
+        return "out of memory";
+    case EZ_PE_DUPLICATE_KEY:
+        return "duplicate object key";
+    case EZ_PE_INVALID_BASE64:
+        return "invalid base64";
+    default:
+        return "unknown error";
+    }
+}
+
+EzJSONBool EzJSONParserGetStats(
+    struct EzJSONParser *parser, struct EzJSONStats *stats)
+{
+#if defined(EZJSON_STATS)
+    *stats = parser->stats;
+    return 1;
+#else
+    memset(stats, 0, sizeof(*stats));
+    return 0;
+#endif
+}
+
+void EzJSONParserResetStats(struct EzJSONParser *parser)
+{
+    memset(&parser->stats, 0, sizeof(parser->stats));
 }
@@ -16,13 +16,104 @@ extern "C"
     // error or EOF
     typedef int (*EzJSONGetChar)(void *, char *);
 
+    // Block should point to the next part of the input, which must stay
+    // valid until the next call. Return its size, 0 on error or EOF
+    typedef unsigned (*EzJSONGetBlock)(void *, const char **block);
+
+    enum EzJSONParserFlags
+    {
+        // Reject strings and keys that are not valid UTF-8
+        EZJ_PARSE_VALIDATE_UTF8 = (1 << 0),
+        // Check separators but do not return EZJ_TOKEN_SEQ_SEP and
+        // EZJ_TOKEN_KV_SEP tokens, only keys, values and containers
+        EZJ_PARSE_SKIP_SEPARATORS = (1 << 1),
+        // Intern object keys: every distinct key gets a small id, numbered
+        // from 0 in order of appearance, and its text is stored once. Key
+        // tokens carry the id in data_key_id and point to the stored text,
+        // which stays valid until the parser is destroyed.
+        EZJ_PARSE_INTERN_KEYS = (1 << 2),
+        // Input is passed with EzJSONParserFeed as it arrives, instead of
+        // through input or a callback. EzJSONParserNext returns without a
+        // token when the fed input runs out, see EzJSONParserNeedsInput.
+        // Only EzJSONParserNext and EzJSONParserNextBatch support it, not
+        // EzJSONParserSkip, the number array readers or the functions that
+        // read whole documents.
+        EZJ_PARSE_FEED = (1 << 3),
+        // Track the keys of every open object and set data_key_duplicate on
+        // a key the object already had. A consumer that stores members as
+        // they arrive ends up with the last value of each key. Keys are
+        // compared by hash, then text; objects with a few keys are searched
+        // linearly and larger ones through a hash table. The memory is
+        // sized by the nesting and reused from one object to the next.
+        EZJ_PARSE_MARK_DUPLICATE_KEYS = (1 << 4),
+        // Fail with EZ_PE_DUPLICATE_KEY on a key the object already had
+        EZJ_PARSE_REJECT_DUPLICATE_KEYS = (1 << 5),
+        // Drop a key the object already had together with its value, so
+        // each key is returned once, with its first value. Implies
+        // EZJ_PARSE_SKIP_SEPARATORS, a dropped member would leave a dangling
+        // separator token.
+        EZJ_PARSE_FIRST_KEY_WINS = (1 << 6),
+    };
+
+    // Zero the settings, e.g. with memset or a {0} initializer, before
+    // setting fields one by one. Fields added in later versions are optional
+    // and read as unset only when they are zero.
     struct EzJSONParserSettings
     {
         void *userdata;              // Optional, passed to all callbacks
-        EzJSONGetChar get_next_char; // Mandatory, retrieve next char, return 0
-                                     // on success, non-0 on EOF
+        EzJSONGetChar get_next_char; // Retrieve next char, return 0 on
+                                     // success, non-0 on EOF. Mandatory unless
+                                     // input or get_next_block is set
+        const char *input;           // Optional, parse this buffer instead of
+                                     // calling get_next_char. Must outlive the
+                                     // parser
+        unsigned long input_length;  // Size of input in bytes
+        unsigned flags;              // Optional, EzJSONParserFlags
         EzJSONAlloc allocate_memory; // Optional, uses malloc() if not set
         EzJSONFree free_memory;      // Optional, uses free() if not set
+        unsigned max_depth;          // Optional, maximum nesting of arrays and
+                                     // objects, 0 for unlimited
+        EzJSONGetBlock get_next_block; // Optional, retrieve input a block at a
+                                       // time. Takes precedence over
+                                       // get_next_char and input
+    };
+
+    enum EzJSONParserState
+    {
+        EZ_PS_ERROR = 0,
+
+        EZ_PS_EXPECT_VALUE   = (1 << 0),
+        EZ_PS_EXPECT_SEQ_SEP = (1 << 1),
+        EZ_PS_EXPECT_KV_SEP  = (1 << 2),
+        EZ_PS_EXPECT_OBJ_END = (1 << 3),
+        EZ_PS_EXPECT_ARR_END = (1 << 4),
+        EZ_PS_EXPECT_OBJ_KEY = (1 << 5),
+        EZ_PS_EXPECT_EOF     = (1 << 6),
+    };
+
+    enum EzJSONErrorKind
+    {
+        EZ_PE_NONE,
+        EZ_PE_UNEXPECTED_CHAR, // Character not allowed in the current state
+        EZ_PE_UNEXPECTED_EOF,  // Input ended inside a value or container
+        EZ_PE_INVALID_LITERAL, // Misspelled true, false or null
+        EZ_PE_INVALID_NUMBER,  // Number does not follow the JSON grammar
+        EZ_PE_INVALID_STRING,  // Invalid escape sequence
+        EZ_PE_DEPTH_EXCEEDED,  // Nesting deeper than settings.max_depth
+        EZ_PE_INVALID_UTF8,    // With EZJ_PARSE_VALIDATE_UTF8
+        EZ_PE_NO_MEMORY,       // Key pool or key set could not grow
+        EZ_PE_DUPLICATE_KEY,   // With EZJ_PARSE_REJECT_DUPLICATE_KEYS, at
+                               // the closing quote of the repeated key
+        EZ_PE_INVALID_BASE64,  // From EzJSONParserReadBase64
+    };
+
+    struct EzJSONError
+    {
+        enum EzJSONErrorKind kind;
+        unsigned long offset; // Byte offset of the offending character
+        unsigned line;        // 1-based line of the offending character
+        unsigned column;      // 1-based column, counted in bytes
+        unsigned expected;    // EzJSONParserState flags valid at that point
     };
 
     enum EzJSONTokenType
@@ -54,10 +145,55 @@ extern "C"
             {
                 const char *data_text;
                 unsigned data_text_length;
+                // EZJ_TOKEN_OBJ_KEY only, EzJSONKeyHash of the key
+                uint32_t data_key_hash;
+                // EZJ_TOKEN_OBJ_KEY with EZJ_PARSE_INTERN_KEYS only
+                uint32_t data_key_id;
+                // EZJ_TOKEN_OBJ_KEY only, the object already had the key.
+                // Only detected with the duplicate key flags.
+                EzJSONBool data_key_duplicate;
             };
         };
     };
 
+    // Input state with EZJ_PARSE_FEED. A token cut off by the end of the
+    // fed input is read again once more input arrives: its bytes are moved
+    // to the carry buffer and the parser rewinds to where it started.
+    // Strings are the exception, the text decoded so far is kept and
+    // decoding carries on, so long strings are not read again.
+    struct EzJSONParserFeed
+    {
+        const char *pending; // Fed after the carry, not in the window yet
+        unsigned long pendingLength;
+        const char *chunk; // Fed data in the window, or last in it
+        unsigned long chunkLength;
+
+        char *carry; // Start of an unfinished token
+        unsigned carryLength;
+        unsigned carrySize;
+
+        // Where reading resumes when the input runs out in this step
+        const char *resume;
+        unsigned long resumeOffset;
+        unsigned long resumeLineStart;
+        unsigned resumeLine;
+        enum EzJSONParserState resumeState;
+
+        // String decoding state, when the input ran out inside one
+        uint32_t keyHash;
+        unsigned hashedLength; // Bytes of the text in keyHash
+        unsigned utf8State;
+        unsigned stringBase; // bufferBase of the text
+
+        char inString;
+        char key;            // The string is an object key
+        char resumeInCarry;  // resume points into the carry
+        char windowIsCarry;  // The window is the carry
+        char carried;        // The carry waits to be read
+        char starved;        // Input ran out during the last step
+        char ended;          // EzJSONParserFeedEnd was called
+    };
+
     struct EzJSONParser
     {
         struct EzJSONParserSettings settings;
@@ -66,8 +202,24 @@ extern "C"
         unsigned bufferSize;
         char *buffer;
         unsigned bufferPos;
+        unsigned bufferBase; // Start of the current value, see resetValue
+
+        const char *input; // Unread part of the current input window
+        const char *inputEnd;
+        char inputChar; // Window storage when reading from get_next_char
 
         struct EzJSONBitStack stack;
+        struct EzJSONKeyPool keys; // With EZJ_PARSE_INTERN_KEYS
+        struct EzJSONKeySet seenKeys; // With the duplicate key flags
+        // With EZJ_PARSE_FIRST_KEY_WINS, depth of the object whose member is
+        // being dropped, 0 when none is
+        unsigned dropDepth;
+
+        // EzJSONParserReadBase64 state while inside a string
+        uint32_t base64Bits;
+        unsigned char base64Chars;   // Characters of the group in base64Bits
+        unsigned char base64Padding; // '=' read, the string must end
+        char inBase64;
 
         enum EzJSONParserState state;
 
@@ -79,27 +231,166 @@ extern "C"
         char hasToken;
 
         unsigned line;
-        unsigned pos;
+        unsigned long offset;    // Bytes consumed so far
+        unsigned long lineStart; // Offset of the first byte on the line
+
+        struct EzJSONError error;
+
+        struct EzJSONParserFeed feed; // With EZJ_PARSE_FEED
+
+        // Present whether or not EZJSON_STATS is defined, so that the layout
+        // does not depend on how the library was built
+        struct EzJSONStats stats;
     };
 
     /// Initialize a new parser from the provided settings. The settings will be
-    /// copied to internal memory.
+    /// copied to internal memory. Every settings field is read, so fields
+    /// the caller does not set must be zero.
     void *EzJSONParserInit(struct EzJSONParser *);
 
     /// Step the parser to the next token. Must be called once before the token
     /// becomes valid,
     void EzJSONParserNext(struct EzJSONParser *);
 
+    /// Step the parser up to max times, copying each token to out. Returns
+    /// the number of tokens stored, which is less than max only at the end of
+    /// the input or on error. Text of string and key tokens stays valid until
+    /// the next call to EzJSONParserNext or EzJSONParserNextBatch.
+    unsigned EzJSONParserNextBatch(
+        struct EzJSONParser *, struct EzJSONToken *out, unsigned max);
+
     /// Retrieve the current token. Will be null on error, EOF, or before the
     /// first call to EzJSONParserNext
     struct EzJSONToken *EzJSONParserToken(struct EzJSONParser *);
 
+    /// Read the elements of an array of numbers without producing tokens.
+    /// Call when the current token is EZJ_TOKEN_ARR_BEGIN, or after a
+    /// previous call returned 1. Stores up to capacity elements and sets
+    /// count to the number stored. Returns
+    ///   0  at the end of the array, the current token is EZJ_TOKEN_ARR_END
+    ///   1  when out is full or the next element is not a number. The
+    ///      remaining elements can be read with another call or with
+    ///      EzJSONParserNext.
+    ///  -1  on a parse error, or if the parser is not inside an array
+    /// The I64 variant fails with EZ_PE_INVALID_NUMBER on numbers that are
+    /// not integers or do not fit.
+    int EzJSONParserReadNumberArray(
+        struct EzJSONParser *,
+        double *out,
+        unsigned capacity,
+        unsigned *count);
+    int EzJSONParserReadNumberArrayF(
+        struct EzJSONParser *, float *out, unsigned capacity, unsigned *count);
+    int EzJSONParserReadNumberArrayI64(
+        struct EzJSONParser *,
+        int64_t *out,
+        unsigned capacity,
+        unsigned *count);
+
+    /// Decode the next value, a base64 string, from the input straight into
+    /// out, without copying its text. Call where a value comes next: after a
+    /// key, at the start of an array or after one of its elements, or after
+    /// a separator token. Stores up to capacity bytes and sets count to the
+    /// number stored. The standard alphabet is expected, "\/" is accepted
+    /// for '/' and the padding is optional, but the unused bits of a last
+    /// partial group must be zero. Returns
+    ///   0  at the end of the string, which becomes the current token as an
+    ///      EZJ_TOKEN_STRING whose text is the bytes stored by this call
+    ///   1  when out has no room for the next 3 bytes. Call again to read
+    ///      the rest, no other parser call may come in between.
+    ///  -1  on a parse error, EZ_PE_INVALID_BASE64 if the text is not base64,
+    ///      or without an error if the next value is not a string, which is
+    ///      left for EzJSONParserNext.
+    /// Not supported with EZJ_PARSE_FEED.
+    int EzJSONParserReadBase64(
+        struct EzJSONParser *,
+        unsigned char *out,
+        unsigned capacity,
+        unsigned *count);
+
+    /// Skip the rest of the array or object whose EZJ_TOKEN_OBJ_BEGIN or
+    /// EZJ_TOKEN_ARR_BEGIN is the current token. Its end token becomes the
+    /// current token. With memory input the skipped text is only scanned for
+    /// brackets, much faster than reading tokens but without validating it
+    /// or checking its keys for duplicates.
+    /// Returns -1 if the current token is not a container start, or on a
+    /// parse error.
+    int EzJSONParserSkip(struct EzJSONParser *);
+
+    /// Full precision value of the current EZJ_TOKEN_NUMBER token, which
+    /// data_number holds as an EzJSONNumber. Valid after EzJSONParserNext,
+    /// not after EzJSONParserNextBatch. Returns -1 if the current token is
+    /// not a number, and for the I64 and U64 variants if it is not an
+    /// integer that fits.
+    int EzJSONParserNumberDouble(struct EzJSONParser *, double *out);
+    int EzJSONParserNumberI64(struct EzJSONParser *, int64_t *out);
+    int EzJSONParserNumberU64(struct EzJSONParser *, uint64_t *out);
+
+    /// Pass the next part of the input, with EZJ_PARSE_FEED. Call before
+    /// the first EzJSONParserNext and whenever EzJSONParserNeedsInput is
+    /// true. data must stay valid until the parser needs input again or the
+    /// document ends, the parser copies what it still needs from it then.
+    /// Returns -1 if the previous input is not used up yet, or after
+    /// EzJSONParserFeedEnd.
+    int EzJSONParserFeed(
+        struct EzJSONParser *, const char *data, unsigned long length);
+
+    /// Mark the end of the fed input, so that a value cut short is reported
+    /// as an error and the end of the document can be recognised
+    void EzJSONParserFeedEnd(struct EzJSONParser *);
+
+    /// True when the last EzJSONParserNext returned no token because the fed
+    /// input ran out rather than because of an error or the end. Feed more,
+    /// or end the input, and step again.
+    EzJSONBool EzJSONParserNeedsInput(struct EzJSONParser *);
+
+    /// Text of the current EZJ_TOKEN_NUMBER token as it appeared in the
+    /// input, terminated, e.g. to pass numbers through unchanged. Valid
+    /// until the next call to EzJSONParserNext, not after
+    /// EzJSONParserNextBatch. Returns null if the current token is not a
+    /// number.
+    const char *
+    EzJSONParserNumberText(struct EzJSONParser *, unsigned *length);
+
+    /// Intern a key ahead of parsing, so that its id is known before it is
+    /// seen, e.g. to switch on ids. Call after EzJSONParserInit. Returns -1 if
+    /// memory ran out.
+    int EzJSONParserInternKey(
+        struct EzJSONParser *, const char *key, unsigned length, uint32_t *id);
+
+    /// Number of keys interned so far, ids are below it
+    unsigned EzJSONParserKeyCount(struct EzJSONParser *);
+
+    /// Text of an interned key, terminated, or null if id is out of range
+    const char *
+    EzJSONParserKeyText(struct EzJSONParser *, uint32_t id, unsigned *length);
+
     /// Shut down the parser and free all memory
     void EzJSONParserDestroy(struct EzJSONParser *);
 
     /// Returns true if the parser reached an error state
     EzJSONBool EzJSONParserHasError(struct EzJSONParser *);
 
+    /// Details of the first error encountered. kind is EZ_PE_NONE while the
+    /// parser is not in an error state.
+    const struct EzJSONError *EzJSONParserError(struct EzJSONParser *);
+
+    /// Hash of an object key, as delivered in data_key_hash. Intended for
+    /// dispatching keys to fields without string compares, see
+    /// ezjson_keys.hpp. Equal hashes do not guarantee equal keys.
+    uint32_t EzJSONKeyHash(const char *key, unsigned length);
+
+    /// Human readable description of an error kind
+    const char *EzJSONErrorKindName(enum EzJSONErrorKind);
+
+    /// Copy the instrumentation counters accumulated since Init or the last
+    /// reset. Returns false, and zeroes the output, when the library was built
+    /// without EZJSON_STATS.
+    EzJSONBool EzJSONParserGetStats(struct EzJSONParser *, struct EzJSONStats *);
+
+    /// Reset the instrumentation counters, e.g. between documents
+    void EzJSONParserResetStats(struct EzJSONParser *);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -1,4 +1,5 @@
 #include "ezjson_reader.h"
+#include "ezjson_tape.h"
 
 #define INVOKE_0(func)                                                         \
     {                                                                          \
@@ -18,51 +19,75 @@
             reader->func(reader->userdata, arg1, arg2);                        \
     }
 
+static void dispatch(struct EzJSONReader *reader, struct EzJSONToken *token)
+{
+    switch (token->type)
+    {
+    case EZJ_TOKEN_OBJ_BEGIN:
+        INVOKE_0(onObjectBegin);
+        break;
+
+    case EZJ_TOKEN_OBJ_END:
+        INVOKE_0(onObjectEnd);
+        break;
+
+    case EZJ_TOKEN_ARR_BEGIN:
+        INVOKE_0(onArrayBegin);
+        break;
+
+    case EZJ_TOKEN_ARR_END:
+        INVOKE_0(onArrayEnd);
+        break;
+
+    case EZJ_TOKEN_OBJ_KEY:
+        INVOKE_2(onKey, token->data_text, token->data_text_length);
+        break;
+
+    case EZJ_TOKEN_NULL:
+        INVOKE_0(onNull);
+        break;
+
+    case EZJ_TOKEN_BOOL:
+        INVOKE_1(onBool, token->data_bool);
+        break;
+
+    case EZJ_TOKEN_NUMBER:
+        INVOKE_1(onNumber, token->data_number);
+        break;
+
+    case EZJ_TOKEN_STRING:
+        INVOKE_2(onString, token->data_text, token->data_text_length);
+        break;
+
+    default:
+        break;
+    }
+}
+
 void EzJSONRead(struct EzJSONReader *reader, struct EzJSONParser *parser)
 {
     struct EzJSONToken *token;
     while (EzJSONParserNext(parser), token = EzJSONParserToken(parser))
     {
-        switch (token->type)
-        {
-        case EZJ_TOKEN_OBJ_BEGIN:
-            INVOKE_0(onObjectBegin);
-            break;
-
-        case EZJ_TOKEN_OBJ_END:
-            INVOKE_0(onObjectEnd);
-            break;
-
-        case EZJ_TOKEN_ARR_BEGIN:
-            INVOKE_0(onArrayBegin);
-            break;
-
-        case EZJ_TOKEN_ARR_END:
-            INVOKE_0(onArrayEnd);
-            break;
-
-        case EZJ_TOKEN_OBJ_KEY:
-            INVOKE_2(onKey, token->data_text, token->data_text_length);
-            break;
-
-        case EZJ_TOKEN_NULL:
-            INVOKE_0(onNull);
-            break;
-
-        case EZJ_TOKEN_BOOL:
-            INVOKE_1(onBool, token->data_bool);
-            break;
-
-        case EZJ_TOKEN_NUMBER:
-            INVOKE_1(onNumber, token->data_number);
-            break;
-
-        case EZJ_TOKEN_STRING:
-            INVOKE_2(onString, token->data_text, token->data_text_length);
-            break;
-
-        default:
-            break;
-        }
+        dispatch(reader, token);
+    }
+
+    if (EzJSONParserHasError(parser))
+    {
+        INVOKE_0(onError);
+    }
+}
+
+void EzJSONReadTape(struct EzJSONReader *reader, struct EzJSONTape *tape)
+{
+    struct EzJSONToken *token;
+    while (EzJSONTapeNext(tape), token = EzJSONTapeToken(tape))
+    {
+        dispatch(reader, token);
+    }
+
+    if (tape->error != EZ_TE_OK)
+    {
+        INVOKE_0(onError);
     }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define __EZJSON_READER_H_INCLUDED__
 
 #include "ezjson_parser.h"
+#include "ezjson_tape.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -21,13 +22,19 @@ extern "C"
         void (*onNumber)(void *, EzJSONNumber);
         void (*onBool)(void *, EzJSONBool);
         void (*onString)(void *, const char *, unsigned);
-        void (*onError)(void *);
+        void (*onError)(void *); // Details from EzJSONParserError
 
         void *userdata;
     };
 
+    /// Parse until the end of the document or the first error, invoking the
+    /// callbacks for every token. Callbacks may be null.
     void EzJSONRead(struct EzJSONReader *, struct EzJSONParser *);
 
+    /// Same as EzJSONRead, replaying a tape. onError is invoked if the tape
+    /// is damaged, details in tape->error.
+    void EzJSONReadTape(struct EzJSONReader *, struct EzJSONTape *);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
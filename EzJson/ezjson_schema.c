@@ -0,0 +1,1487 @@
+#include "ezjson_schema.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+#define TABLE_INITIAL_SIZE 16u
+#define TEXT_INITIAL_SIZE 256u
+
+// Keywords longer than this are not ours and are ignored
+#define KEYWORD_SPACE 32u
+
+// Nesting of schemas inside schemas
+#define MAX_SCHEMA_DEPTH 256u
+
+// Fixed nodes, the schemas true and false
+#define NODE_ANY 0u
+#define NODE_NONE 1u
+
+#define NOT_REQUIRED UINT_MAX
+
+enum Type
+{
+    TYPE_NULL    = (1 << 0),
+    TYPE_BOOLEAN = (1 << 1),
+    TYPE_INTEGER = (1 << 2),
+    TYPE_NUMBER  = (1 << 3), // Includes integers
+    TYPE_STRING  = (1 << 4),
+    TYPE_ARRAY   = (1 << 5),
+    TYPE_OBJECT  = (1 << 6),
+    TYPE_ALL     = 0x7f,
+};
+
+enum NodeFlags
+{
+    HAS_MINIMUM       = (1 << 0),
+    HAS_MAXIMUM       = (1 << 1),
+    MINIMUM_EXCLUSIVE = (1 << 2),
+    MAXIMUM_EXCLUSIVE = (1 << 3),
+    HAS_LENGTH        = (1 << 4), // minLength or maxLength
+    HAS_ENUM          = (1 << 5),
+    HAS_CONST         = (1 << 6),
+
+    // Draft 4 boolean exclusiveMinimum and exclusiveMaximum, applied to the
+    // bounds once all keywords of the node are compiled
+    MINIMUM_EXCLUSIVE_BOOL = (1 << 7),
+    MAXIMUM_EXCLUSIVE_BOOL = (1 << 8),
+};
+
+// A bound or a validated number. Integers keep their exact value, a double
+// cannot tell integers apart past 2^53.
+struct Number
+{
+    double value;
+    int64_t integer; // Set when isInteger
+    int isInteger;
+};
+
+struct EzJSONSchemaNode
+{
+    unsigned types; // Type
+    unsigned flags; // NodeFlags
+    struct Number minimum;
+    struct Number maximum;
+    unsigned minLength;
+    unsigned maxLength;
+    unsigned minItems;
+    unsigned maxItems;
+    unsigned minProperties;
+    unsigned maxProperties;
+    unsigned items;      // Node of array elements
+    unsigned additional; // Node of properties not listed
+    unsigned firstProperty;
+    unsigned propertyCount;
+    unsigned requiredCount; // Required properties, bits 0 to count - 1
+    unsigned firstConstant; // enum
+    unsigned constantCount;
+    unsigned constant; // const
+};
+
+struct EzJSONSchemaProperty
+{
+    uint32_t hash; // EzJSONKeyHash of the name
+    unsigned name; // Offset into the text, terminated
+    unsigned nameLength;
+    unsigned node;
+    unsigned required; // Bit in the seen set, or NOT_REQUIRED
+};
+
+struct EzJSONSchemaConstant
+{
+    unsigned type; // A single Type, integers are TYPE_NUMBER
+    double number;
+    unsigned text; // Offset into the text, strings only
+    unsigned textLength;
+    EzJSONBool flag;
+};
+
+struct EzJSONValidatorFrame
+{
+    unsigned node;
+    unsigned count;        // Elements or members so far
+    unsigned seenBase;     // First word of the object's seen set
+    unsigned seenRequired; // Distinct required properties seen
+    char object;
+};
+
+enum Keyword
+{
+    KW_IGNORED,
+    KW_UNSUPPORTED,
+    KW_TYPE,
+    KW_ENUM,
+    KW_CONST,
+    KW_MINIMUM,
+    KW_MAXIMUM,
+    KW_EXCLUSIVE_MINIMUM,
+    KW_EXCLUSIVE_MAXIMUM,
+    KW_MIN_LENGTH,
+    KW_MAX_LENGTH,
+    KW_ITEMS,
+    KW_MIN_ITEMS,
+    KW_MAX_ITEMS,
+    KW_PROPERTIES,
+    KW_REQUIRED,
+    KW_ADDITIONAL_PROPERTIES,
+    KW_MIN_PROPERTIES,
+    KW_MAX_PROPERTIES,
+};
+
+static const struct
+{
+    const char *name;
+    enum Keyword keyword;
+} keywords[] = {
+    {"type", KW_TYPE},
+    {"enum", KW_ENUM},
+    {"const", KW_CONST},
+    {"minimum", KW_MINIMUM},
+    {"maximum", KW_MAXIMUM},
+    {"exclusiveMinimum", KW_EXCLUSIVE_MINIMUM},
+    {"exclusiveMaximum", KW_EXCLUSIVE_MAXIMUM},
+    {"minLength", KW_MIN_LENGTH},
+    {"maxLength", KW_MAX_LENGTH},
+    {"items", KW_ITEMS},
+    {"minItems", KW_MIN_ITEMS},
+    {"maxItems", KW_MAX_ITEMS},
+    {"properties", KW_PROPERTIES},
+    {"required", KW_REQUIRED},
+    {"additionalProperties", KW_ADDITIONAL_PROPERTIES},
+    {"minProperties", KW_MIN_PROPERTIES},
+    {"maxProperties", KW_MAX_PROPERTIES},
+    // Validation keywords that would be silently skipped otherwise
+    {"$ref", KW_UNSUPPORTED},
+    {"$dynamicRef", KW_UNSUPPORTED},
+    {"allOf", KW_UNSUPPORTED},
+    {"anyOf", KW_UNSUPPORTED},
+    {"oneOf", KW_UNSUPPORTED},
+    {"not", KW_UNSUPPORTED},
+    {"if", KW_UNSUPPORTED},
+    {"multipleOf", KW_UNSUPPORTED},
+    {"pattern", KW_UNSUPPORTED},
+    {"patternProperties", KW_UNSUPPORTED},
+    {"propertyNames", KW_UNSUPPORTED},
+    {"dependencies", KW_UNSUPPORTED},
+    {"dependentRequired", KW_UNSUPPORTED},
+    {"dependentSchemas", KW_UNSUPPORTED},
+    {"prefixItems", KW_UNSUPPORTED},
+    {"additionalItems", KW_UNSUPPORTED},
+    {"contains", KW_UNSUPPORTED},
+    {"uniqueItems", KW_UNSUPPORTED},
+    {"unevaluatedItems", KW_UNSUPPORTED},
+    {"unevaluatedProperties", KW_UNSUPPORTED},
+};
+
+static const struct
+{
+    const char *name;
+    unsigned types;
+} typeNames[] = {
+    {"null", TYPE_NULL},
+    {"boolean", TYPE_BOOLEAN},
+    {"integer", TYPE_INTEGER},
+    {"number", TYPE_NUMBER | TYPE_INTEGER},
+    {"string", TYPE_STRING},
+    {"array", TYPE_ARRAY},
+    {"object", TYPE_OBJECT},
+};
+
+static void *allocate(
+    const struct EzJSONDocumentSettings *settings, unsigned long size)
+{
+    if (size > UINT_MAX)
+    {
+        return NULL;
+    }
+    if (settings->allocate_memory)
+    {
+        return settings->allocate_memory(settings->userdata, (unsigned)size);
+    }
+    return malloc(size);
+}
+
+static void release(
+    const struct EzJSONDocumentSettings *settings,
+    void *ptr,
+    unsigned long size)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (settings->free_memory)
+    {
+        settings->free_memory(settings->userdata, ptr, (unsigned)size);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+// Make room for needed elements of size bytes in a growable table
+static int reserve(
+    const struct EzJSONDocumentSettings *settings,
+    void **data,
+    unsigned *capacity,
+    unsigned long needed,
+    unsigned size,
+    unsigned initial)
+{
+    if (needed <= *capacity)
+    {
+        return 0;
+    }
+
+    unsigned long grown = *capacity ? *capacity : initial;
+    while (grown < needed)
+    {
+        grown *= 2u;
+    }
+    if (grown > UINT_MAX)
+    {
+        return -1;
+    }
+
+    void *bigger = allocate(settings, grown * size);
+    if (!bigger)
+    {
+        return -1;
+    }
+    if (*data)
+    {
+        memcpy(bigger, *data, (unsigned long)*capacity * size);
+        release(settings, *data, (unsigned long)*capacity * size);
+    }
+    *data     = bigger;
+    *capacity = (unsigned)grown;
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Compiler
+
+struct Compiler
+{
+    struct EzJSONSchema *schema;
+    unsigned depth;
+    enum EzJSONSchemaError error;
+};
+
+static int fail(struct Compiler *c, enum EzJSONSchemaError error)
+{
+    if (c->error == EZ_SE_OK)
+    {
+        c->error = error;
+    }
+    return -1;
+}
+
+static int addNode(struct Compiler *c, unsigned *index)
+{
+    struct EzJSONSchema *schema = c->schema;
+    if (reserve(
+            &schema->settings,
+            (void **)&schema->nodes,
+            &schema->nodeCapacity,
+            schema->nodeCount + 1ul,
+            (unsigned)sizeof(struct EzJSONSchemaNode),
+            TABLE_INITIAL_SIZE)
+        != 0)
+    {
+        return fail(c, EZ_SE_NO_MEMORY);
+    }
+
+    struct EzJSONSchemaNode *node = &schema->nodes[schema->nodeCount];
+    memset(node, 0, sizeof(*node));
+    node->types         = TYPE_ALL;
+    node->maxLength     = UINT_MAX;
+    node->maxItems      = UINT_MAX;
+    node->maxProperties = UINT_MAX;
+    node->items         = NODE_ANY;
+    node->additional    = NODE_ANY;
+
+    *index = schema->nodeCount++;
+    return 0;
+}
+
+// Decode a string value into the text, terminated. Sets offset and length.
+static int addText(
+    struct Compiler *c,
+    struct EzJSONValue value,
+    unsigned *offset,
+    unsigned *length)
+{
+    struct EzJSONSchema *schema = c->schema;
+    if (reserve(
+            &schema->settings,
+            (void **)&schema->text,
+            &schema->textCapacity,
+            schema->textLength + 1ul,
+            1u,
+            TEXT_INITIAL_SIZE)
+        != 0)
+    {
+        return fail(c, EZ_SE_NO_MEMORY);
+    }
+
+    const unsigned available = schema->textCapacity - schema->textLength;
+    const int result         = EzJSONValueGetString(
+        value, schema->text + schema->textLength, available, length);
+    if (result < 0)
+    {
+        return fail(c, EZ_SE_MALFORMED);
+    }
+    if (result > 0)
+    {
+        if (reserve(
+                &schema->settings,
+                (void **)&schema->text,
+                &schema->textCapacity,
+                (unsigned long)schema->textLength + *length + 1u,
+                1u,
+                TEXT_INITIAL_SIZE)
+            != 0)
+        {
+            return fail(c, EZ_SE_NO_MEMORY);
+        }
+        EzJSONValueGetString(
+            value, schema->text + schema->textLength, *length + 1u, length);
+    }
+
+    *offset = schema->textLength;
+    schema->textLength += *length + 1u;
+    return 0;
+}
+
+static enum Keyword findKeyword(struct EzJSONValue key)
+{
+    char name[KEYWORD_SPACE];
+    unsigned length;
+    if (EzJSONValueGetString(key, name, sizeof(name), &length) != 0)
+    {
+        return KW_IGNORED;
+    }
+
+    for (unsigned i = 0; i < sizeof(keywords) / sizeof(keywords[0]); ++i)
+    {
+        if (strcmp(keywords[i].name, name) == 0)
+        {
+            return keywords[i].keyword;
+        }
+    }
+    return KW_IGNORED;
+}
+
+static int compileType(
+    struct Compiler *c, unsigned index, struct EzJSONValue value)
+{
+    struct EzJSONIterator iterator;
+    struct EzJSONValue name = value;
+    const int list          = EzJSONValueGetType(value) == EZJ_VALUE_ARRAY;
+    unsigned types          = 0;
+
+    if (list)
+    {
+        EzJSONIteratorInit(value, &iterator);
+    }
+    for (;;)
+    {
+        if (list)
+        {
+            const int more = EzJSONIteratorNext(&iterator, NULL, &name);
+            if (more <= 0)
+            {
+                if (more < 0)
+                {
+                    return fail(c, EZ_SE_MALFORMED);
+                }
+                break;
+            }
+        }
+
+        char text[KEYWORD_SPACE];
+        unsigned length;
+        unsigned i = 0;
+        if (EzJSONValueGetString(name, text, sizeof(text), &length) == 0)
+        {
+            while (i < sizeof(typeNames) / sizeof(typeNames[0])
+                   && strcmp(typeNames[i].name, text) != 0)
+            {
+                ++i;
+            }
+        }
+        else
+        {
+            i = sizeof(typeNames) / sizeof(typeNames[0]);
+        }
+        if (i == sizeof(typeNames) / sizeof(typeNames[0]))
+        {
+            return fail(c, EZ_SE_MALFORMED);
+        }
+        types |= typeNames[i].types;
+
+        if (!list)
+        {
+            break;
+        }
+    }
+
+    c->schema->nodes[index].types &= types;
+    return 0;
+}
+
+// Append a value to the constants, sets index to its position
+static int addConstant(
+    struct Compiler *c, struct EzJSONValue value, unsigned *index)
+{
+    struct EzJSONSchema *schema = c->schema;
+    if (reserve(
+            &schema->settings,
+            (void **)&schema->constants,
+            &schema->constantCapacity,
+            schema->constantCount + 1ul,
+            (unsigned)sizeof(struct EzJSONSchemaConstant),
+            TABLE_INITIAL_SIZE)
+        != 0)
+    {
+        return fail(c, EZ_SE_NO_MEMORY);
+    }
+
+    struct EzJSONSchemaConstant constant;
+    memset(&constant, 0, sizeof(constant));
+    switch (EzJSONValueGetType(value))
+    {
+    case EZJ_VALUE_NULL:
+        constant.type = TYPE_NULL;
+        break;
+    case EZJ_VALUE_BOOL:
+        constant.type = TYPE_BOOLEAN;
+        if (EzJSONValueGetBool(value, &constant.flag) != 0)
+        {
+            return fail(c, EZ_SE_MALFORMED);
+        }
+        break;
+    case EZJ_VALUE_NUMBER:
+        constant.type = TYPE_NUMBER;
+        if (EzJSONValueGetNumber(value, &constant.number) != 0)
+        {
+            return fail(c, EZ_SE_MALFORMED);
+        }
+        break;
+    case EZJ_VALUE_STRING:
+        constant.type = TYPE_STRING;
+        if (addText(c, value, &constant.text, &constant.textLength) != 0)
+        {
+            return -1;
+        }
+        break;
+    case EZJ_VALUE_OBJECT:
+    case EZJ_VALUE_ARRAY:
+        return fail(c, EZ_SE_UNSUPPORTED);
+    default:
+        return fail(c, EZ_SE_MALFORMED);
+    }
+
+    *index                                     = schema->constantCount;
+    schema->constants[schema->constantCount++] = constant;
+    return 0;
+}
+
+static int compileEnum(
+    struct Compiler *c, unsigned index, struct EzJSONValue value)
+{
+    struct EzJSONIterator iterator;
+    struct EzJSONValue element;
+    unsigned constant;
+    int more;
+
+    if (EzJSONIteratorInit(value, &iterator) != 0
+        || EzJSONValueGetType(value) != EZJ_VALUE_ARRAY)
+    {
+        return fail(c, EZ_SE_MALFORMED);
+    }
+    while ((more = EzJSONIteratorNext(&iterator, NULL, &element)) > 0)
+    {
+        if (addConstant(c, element, &constant) != 0)
+        {
+            return -1;
+        }
+
+        // Nothing else adds constants meanwhile, the range is contiguous
+        struct EzJSONSchemaNode *node = &c->schema->nodes[index];
+        if (node->constantCount++ == 0)
+        {
+            node->firstConstant = constant;
+        }
+    }
+    if (more < 0)
+    {
+        return fail(c, EZ_SE_MALFORMED);
+    }
+
+    // An empty enum allows nothing
+    c->schema->nodes[index].flags |= HAS_ENUM;
+    return 0;
+}
+
+static int getCount(
+    struct Compiler *c, struct EzJSONValue value, unsigned *out)
+{
+    double number;
+    if (EzJSONValueGetNumber(value, &number) != 0 || !(number >= 0.0))
+    {
+        return fail(c, EZ_SE_MALFORMED);
+    }
+    *out = number < (double)UINT_MAX ? (unsigned)number : UINT_MAX;
+    return 0;
+}
+
+static int compileNode(
+    struct Compiler *c, struct EzJSONValue value, unsigned *index);
+
+static int findProperty(
+    struct EzJSONSchema *schema,
+    const struct EzJSONSchemaNode *node,
+    const char *name,
+    unsigned length)
+{
+    for (unsigned i = 0; i < node->propertyCount; ++i)
+    {
+        const struct EzJSONSchemaProperty *property =
+            &schema->properties[node->firstProperty + i];
+        if (property->nameLength == length
+            && memcmp(schema->text + property->name, name, length) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int compareProperties(const void *a, const void *b)
+{
+    const uint32_t x = ((const struct EzJSONSchemaProperty *)a)->hash;
+    const uint32_t y = ((const struct EzJSONSchemaProperty *)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+// Fill the property range of a node from properties and required, either
+// of which may be missing. Names only listed as required validate their
+// value with additionalProperties.
+static int compileProperties(
+    struct Compiler *c,
+    unsigned index,
+    const struct EzJSONValue *properties,
+    const struct EzJSONValue *required)
+{
+    struct EzJSONSchema *schema = c->schema;
+    struct EzJSONIterator iterator;
+    struct EzJSONValue key;
+    struct EzJSONValue value;
+    unsigned count = 0;
+    int more;
+
+    // Reserve the whole range first, property schemas add their own ranges
+    // after it
+    if (properties)
+    {
+        if (EzJSONIteratorInit(*properties, &iterator) != 0
+            || EzJSONValueGetType(*properties) != EZJ_VALUE_OBJECT)
+        {
+            return fail(c, EZ_SE_MALFORMED);
+        }
+        while ((more = EzJSONIteratorNext(&iterator, NULL, &value)) > 0)
+        {
+            ++count;
+        }
+        if (more < 0)
+        {
+            return fail(c, EZ_SE_MALFORMED);
+        }
+    }
+    if (required)
+    {
+        if (EzJSONIteratorInit(*required, &iterator) != 0
+            || EzJSONValueGetType(*required) != EZJ_VALUE_ARRAY)
+        {
+            return fail(c, EZ_SE_MALFORMED);
+        }
+        while ((more = EzJSONIteratorNext(&iterator, NULL, &value)) > 0)
+        {
+            ++count;
+        }
+        if (more < 0)
+        {
+            return fail(c, EZ_SE_MALFORMED);
+        }
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (reserve(
+            &schema->settings,
+            (void **)&schema->properties,
+            &schema->propertyCapacity,
+            (unsigned long)schema->propertyCount + count,
+            (unsigned)sizeof(struct EzJSONSchemaProperty),
+            TABLE_INITIAL_SIZE)
+        != 0)
+    {
+        return fail(c, EZ_SE_NO_MEMORY);
+    }
+    const unsigned first = schema->propertyCount;
+    schema->propertyCount += count;
+    schema->nodes[index].firstProperty = first;
+
+    if (properties)
+    {
+        EzJSONIteratorInit(*properties, &iterator);
+        while ((more = EzJSONIteratorNext(&iterator, &key, &value)) > 0)
+        {
+            struct EzJSONSchemaProperty property;
+            unsigned node;
+            if (addText(c, key, &property.name, &property.nameLength) != 0
+                || compileNode(c, value, &node) != 0)
+            {
+                return -1;
+            }
+            property.hash     = EzJSONKeyHash(
+                schema->text + property.name, property.nameLength);
+            property.node     = node;
+            property.required = NOT_REQUIRED;
+
+            struct EzJSONSchemaNode *owner = &schema->nodes[index];
+            schema->properties[first + owner->propertyCount++] = property;
+        }
+    }
+    if (required)
+    {
+        EzJSONIteratorInit(*required, &iterator);
+        while ((more = EzJSONIteratorNext(&iterator, NULL, &value)) > 0)
+        {
+            struct EzJSONSchemaProperty property;
+            if (addText(c, value, &property.name, &property.nameLength) != 0)
+            {
+                return -1;
+            }
+
+            struct EzJSONSchemaNode *owner = &schema->nodes[index];
+            const int found                = findProperty(
+                schema,
+                owner,
+                schema->text + property.name,
+                property.nameLength);
+            if (found >= 0)
+            {
+                // The name is already in the text
+                schema->textLength -= property.nameLength + 1u;
+                struct EzJSONSchemaProperty *existing =
+                    &schema->properties[first + (unsigned)found];
+                if (existing->required == NOT_REQUIRED)
+                {
+                    existing->required = owner->requiredCount++;
+                }
+                continue;
+            }
+
+            property.hash     = EzJSONKeyHash(
+                schema->text + property.name, property.nameLength);
+            property.node     = owner->additional;
+            property.required = owner->requiredCount++;
+            schema->properties[first + owner->propertyCount++] = property;
+        }
+    }
+
+    qsort(
+        schema->properties + first,
+        schema->nodes[index].propertyCount,
+        sizeof(struct EzJSONSchemaProperty),
+        &compareProperties);
+    return 0;
+}
+
+// Exactly when both numbers are int64 integers
+static int compareNumbers(const struct Number *a, const struct Number *b)
+{
+    if (a->isInteger && b->isInteger)
+    {
+        return (a->integer > b->integer) - (a->integer < b->integer);
+    }
+    return (a->value > b->value) - (a->value < b->value);
+}
+
+static int
+getBound(struct Compiler *c, struct EzJSONValue value, struct Number *out)
+{
+    if (EzJSONValueGetNumber(value, &out->value) != 0)
+    {
+        return fail(c, EZ_SE_MALFORMED);
+    }
+    out->isInteger = EzJSONValueGetInt64(value, &out->integer) == 0;
+    return 0;
+}
+
+static int compileKeyword(
+    struct Compiler *c,
+    unsigned index,
+    enum Keyword keyword,
+    struct EzJSONValue value)
+{
+    struct EzJSONSchemaNode *node = &c->schema->nodes[index];
+    EzJSONBool flag;
+    unsigned child;
+
+    switch (keyword)
+    {
+    case KW_IGNORED:
+    case KW_PROPERTIES:
+    case KW_REQUIRED:
+        return 0;
+    case KW_UNSUPPORTED:
+        return fail(c, EZ_SE_UNSUPPORTED);
+    case KW_TYPE:
+        return compileType(c, index, value);
+    case KW_ENUM:
+        return compileEnum(c, index, value);
+    case KW_CONST:
+        node->flags |= HAS_CONST;
+        return addConstant(c, value, &node->constant);
+    case KW_MINIMUM:
+    case KW_EXCLUSIVE_MINIMUM:
+        // Draft 4 spells the exclusive bounds as booleans
+        if (keyword == KW_EXCLUSIVE_MINIMUM
+            && EzJSONValueGetBool(value, &flag) == 0)
+        {
+            node->flags |= flag ? MINIMUM_EXCLUSIVE_BOOL : 0;
+            return 0;
+        }
+        {
+            struct Number bound;
+            if (getBound(c, value, &bound) != 0)
+            {
+                return -1;
+            }
+            // With both, the tighter bound applies
+            const int order = compareNumbers(&bound, &node->minimum);
+            if (!(node->flags & HAS_MINIMUM) || order > 0
+                || (order == 0 && keyword == KW_EXCLUSIVE_MINIMUM))
+            {
+                node->minimum = bound;
+                node->flags &= ~(unsigned)MINIMUM_EXCLUSIVE;
+                node->flags |= keyword == KW_EXCLUSIVE_MINIMUM
+                                   ? MINIMUM_EXCLUSIVE
+                                   : 0;
+            }
+            node->flags |= HAS_MINIMUM;
+        }
+        return 0;
+    case KW_MAXIMUM:
+    case KW_EXCLUSIVE_MAXIMUM:
+        if (keyword == KW_EXCLUSIVE_MAXIMUM
+            && EzJSONValueGetBool(value, &flag) == 0)
+        {
+            node->flags |= flag ? MAXIMUM_EXCLUSIVE_BOOL : 0;
+            return 0;
+        }
+        {
+            struct Number bound;
+            if (getBound(c, value, &bound) != 0)
+            {
+                return -1;
+            }
+            const int order = compareNumbers(&bound, &node->maximum);
+            if (!(node->flags & HAS_MAXIMUM) || order < 0
+                || (order == 0 && keyword == KW_EXCLUSIVE_MAXIMUM))
+            {
+                node->maximum = bound;
+                node->flags &= ~(unsigned)MAXIMUM_EXCLUSIVE;
+                node->flags |= keyword == KW_EXCLUSIVE_MAXIMUM
+                                   ? MAXIMUM_EXCLUSIVE
+                                   : 0;
+            }
+            node->flags |= HAS_MAXIMUM;
+        }
+        return 0;
+    case KW_MIN_LENGTH:
+        node->flags |= HAS_LENGTH;
+        return getCount(c, value, &node->minLength);
+    case KW_MAX_LENGTH:
+        node->flags |= HAS_LENGTH;
+        return getCount(c, value, &node->maxLength);
+    case KW_ITEMS:
+        if (EzJSONValueGetType(value) == EZJ_VALUE_ARRAY)
+        {
+            // Tuple validation
+            return fail(c, EZ_SE_UNSUPPORTED);
+        }
+        if (compileNode(c, value, &child) != 0)
+        {
+            return -1;
+        }
+        c->schema->nodes[index].items = child;
+        return 0;
+    case KW_MIN_ITEMS:
+        return getCount(c, value, &node->minItems);
+    case KW_MAX_ITEMS:
+        return getCount(c, value, &node->maxItems);
+    case KW_ADDITIONAL_PROPERTIES:
+        if (compileNode(c, value, &child) != 0)
+        {
+            return -1;
+        }
+        c->schema->nodes[index].additional = child;
+        return 0;
+    case KW_MIN_PROPERTIES:
+        return getCount(c, value, &node->minProperties);
+    case KW_MAX_PROPERTIES:
+        return getCount(c, value, &node->maxProperties);
+    }
+    return 0;
+}
+
+static int compileNode(
+    struct Compiler *c, struct EzJSONValue value, unsigned *index)
+{
+    struct EzJSONIterator iterator;
+    struct EzJSONValue key;
+    struct EzJSONValue member;
+    struct EzJSONValue properties;
+    struct EzJSONValue required;
+    int hasProperties = 0;
+    int hasRequired   = 0;
+    int more;
+
+    if (EzJSONValueGetType(value) == EZJ_VALUE_BOOL)
+    {
+        EzJSONBool flag;
+        if (EzJSONValueGetBool(value, &flag) != 0)
+        {
+            return fail(c, EZ_SE_MALFORMED);
+        }
+        *index = flag ? NODE_ANY : NODE_NONE;
+        return 0;
+    }
+    if (EzJSONValueGetType(value) != EZJ_VALUE_OBJECT
+        || c->depth == MAX_SCHEMA_DEPTH)
+    {
+        return fail(c, EZ_SE_MALFORMED);
+    }
+    if (addNode(c, index) != 0)
+    {
+        return -1;
+    }
+
+    ++c->depth;
+    EzJSONIteratorInit(value, &iterator);
+    while ((more = EzJSONIteratorNext(&iterator, &key, &member)) > 0)
+    {
+        const enum Keyword keyword = findKeyword(key);
+        if (keyword == KW_PROPERTIES)
+        {
+            properties    = member;
+            hasProperties = 1;
+        }
+        else if (keyword == KW_REQUIRED)
+        {
+            required    = member;
+            hasRequired = 1;
+        }
+        else if (compileKeyword(c, *index, keyword, member) != 0)
+        {
+            return -1;
+        }
+    }
+    if (more < 0)
+    {
+        return fail(c, EZ_SE_MALFORMED);
+    }
+
+    // The boolean forms make the tighter bound exclusive whichever keyword
+    // it came from: a bound from the numeric form already is
+    struct EzJSONSchemaNode *node = &c->schema->nodes[*index];
+    if (node->flags & MINIMUM_EXCLUSIVE_BOOL)
+    {
+        node->flags |= MINIMUM_EXCLUSIVE;
+    }
+    if (node->flags & MAXIMUM_EXCLUSIVE_BOOL)
+    {
+        node->flags |= MAXIMUM_EXCLUSIVE;
+    }
+
+    // After additionalProperties, which names only listed as required use
+    if ((hasProperties || hasRequired)
+        && compileProperties(
+               c,
+               *index,
+               hasProperties ? &properties : NULL,
+               hasRequired ? &required : NULL)
+               != 0)
+    {
+        return -1;
+    }
+    --c->depth;
+    return 0;
+}
+
+enum EzJSONSchemaError
+EzJSONSchemaCompile(struct EzJSONSchema *schema, struct EzJSONValue value)
+{
+    struct Compiler c;
+    unsigned index;
+
+    memset(schema, 0, sizeof(*schema));
+    schema->settings = value.document->settings;
+
+    c.schema = schema;
+    c.depth  = 0;
+    c.error  = EZ_SE_OK;
+
+    // The schemas true and false
+    if (addNode(&c, &index) == 0 && addNode(&c, &index) == 0)
+    {
+        schema->nodes[NODE_NONE].types = 0;
+        compileNode(&c, value, &schema->root);
+    }
+
+    if (c.error != EZ_SE_OK)
+    {
+        EzJSONSchemaDestroy(schema);
+    }
+    return c.error;
+}
+
+void EzJSONSchemaDestroy(struct EzJSONSchema *schema)
+{
+    const struct EzJSONDocumentSettings settings = schema->settings;
+    release(
+        &settings,
+        schema->nodes,
+        (unsigned long)schema->nodeCapacity * sizeof(struct EzJSONSchemaNode));
+    release(
+        &settings,
+        schema->properties,
+        (unsigned long)schema->propertyCapacity
+            * sizeof(struct EzJSONSchemaProperty));
+    release(
+        &settings,
+        schema->constants,
+        (unsigned long)schema->constantCapacity
+            * sizeof(struct EzJSONSchemaConstant));
+    release(&settings, schema->text, schema->textCapacity);
+
+    memset(schema, 0, sizeof(*schema));
+    schema->settings = settings;
+}
+
+const char *EzJSONSchemaErrorName(enum EzJSONSchemaError error)
+{
+    switch (error)
+    {
+    case EZ_SE_OK:
+        return "no error";
+    case EZ_SE_MALFORMED:
+        return "malformed schema";
+    case EZ_SE_UNSUPPORTED:
+        return "unsupported schema keyword";
+    case EZ_SE_NO_MEMORY:
+        return "out of memory";
+    }
+    return "unknown error";
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Validator
+
+static int violate(
+    struct EzJSONValidator *v,
+    struct EzJSONParser *parser,
+    enum EzJSONSchemaViolation violation)
+{
+    v->violation = violation;
+    v->offset    = parser->offset;
+    return -1;
+}
+
+// Whether a finite double has no fraction
+static int isInteger(double number)
+{
+    if (number > -9007199254740992.0 && number < 9007199254740992.0)
+    {
+        return (double)(int64_t)number == number;
+    }
+    // Doubles this large are all integers, unless infinite
+    return number - number == 0.0;
+}
+
+// Length of UTF-8 text in code points
+static unsigned long codePoints(const char *text, unsigned length)
+{
+    unsigned long count = 0;
+    for (unsigned i = 0; i < length; ++i)
+    {
+        count += ((unsigned char)text[i] & 0xC0u) != 0x80u;
+    }
+    return count;
+}
+
+// Whether the value is one of count constants from first
+static int matchesConstant(
+    const struct EzJSONSchema *schema,
+    unsigned first,
+    unsigned count,
+    const struct EzJSONToken *token,
+    unsigned type,
+    double number)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const struct EzJSONSchemaConstant *constant =
+            &schema->constants[first + i];
+        if (constant->type != type)
+        {
+            continue;
+        }
+        switch (type)
+        {
+        case TYPE_NULL:
+            return 1;
+        case TYPE_BOOLEAN:
+            if (!constant->flag == !token->data_bool)
+            {
+                return 1;
+            }
+            break;
+        case TYPE_NUMBER:
+            if (constant->number == number)
+            {
+                return 1;
+            }
+            break;
+        case TYPE_STRING:
+            if (constant->textLength == token->data_text_length
+                && memcmp(
+                       schema->text + constant->text,
+                       token->data_text,
+                       token->data_text_length)
+                       == 0)
+            {
+                return 1;
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+static int pushFrame(
+    struct EzJSONValidator *v,
+    struct EzJSONParser *parser,
+    unsigned index,
+    char object)
+{
+    const struct EzJSONDocumentSettings *settings = &v->schema->settings;
+    const struct EzJSONSchemaNode *node = &v->schema->nodes[index];
+    const unsigned words = object ? (node->requiredCount + 63u) / 64u : 0;
+
+    if (reserve(
+            settings,
+            (void **)&v->frames,
+            &v->frameCapacity,
+            v->frameCount + 1ul,
+            (unsigned)sizeof(struct EzJSONValidatorFrame),
+            TABLE_INITIAL_SIZE)
+            != 0
+        || reserve(
+               settings,
+               (void **)&v->seen,
+               &v->seenCapacity,
+               (unsigned long)v->seenCount + words,
+               (unsigned)sizeof(uint64_t),
+               TABLE_INITIAL_SIZE)
+               != 0)
+    {
+        return violate(v, parser, EZ_SV_NO_MEMORY);
+    }
+
+    struct EzJSONValidatorFrame *frame = &v->frames[v->frameCount++];
+    frame->node         = index;
+    frame->count        = 0;
+    frame->seenBase     = v->seenCount;
+    frame->seenRequired = 0;
+    frame->object       = object;
+    if (words > 0)
+    {
+        memset(v->seen + v->seenCount, 0, words * sizeof(uint64_t));
+        v->seenCount += words;
+    }
+    return 0;
+}
+
+static int checkValue(
+    struct EzJSONValidator *v,
+    struct EzJSONParser *parser,
+    const struct EzJSONToken *token,
+    unsigned index)
+{
+    const struct EzJSONSchema *schema   = v->schema;
+    const struct EzJSONSchemaNode *node = &schema->nodes[index];
+    struct Number number                = {0.0, 0, 0};
+    unsigned type;
+
+    switch (token->type)
+    {
+    case EZJ_TOKEN_OBJ_BEGIN:
+        type = TYPE_OBJECT;
+        break;
+    case EZJ_TOKEN_ARR_BEGIN:
+        type = TYPE_ARRAY;
+        break;
+    case EZJ_TOKEN_STRING:
+        type = TYPE_STRING;
+        break;
+    case EZJ_TOKEN_NUMBER:
+        type = TYPE_NUMBER;
+        if ((node->types & TYPE_NUMBER)
+            && !(node->flags
+                 & (HAS_MINIMUM | HAS_MAXIMUM | HAS_ENUM | HAS_CONST)))
+        {
+            return 0;
+        }
+        EzJSONParserNumberDouble(parser, &number.value);
+        if (node->flags & (HAS_MINIMUM | HAS_MAXIMUM))
+        {
+            number.isInteger =
+                EzJSONParserNumberI64(parser, &number.integer) == 0;
+        }
+        if (!(node->types & TYPE_NUMBER) && isInteger(number.value))
+        {
+            type = TYPE_INTEGER;
+        }
+        break;
+    case EZJ_TOKEN_BOOL:
+        type = TYPE_BOOLEAN;
+        break;
+    default:
+        type = TYPE_NULL;
+        break;
+    }
+
+    if (!(node->types & type))
+    {
+        return violate(v, parser, EZ_SV_TYPE);
+    }
+    if (type == TYPE_INTEGER)
+    {
+        type = TYPE_NUMBER;
+    }
+    if (((node->flags & HAS_ENUM)
+         && !matchesConstant(
+             schema,
+             node->firstConstant,
+             node->constantCount,
+             token,
+             type,
+             number.value))
+        || ((node->flags & HAS_CONST)
+            && !matchesConstant(
+                schema, node->constant, 1u, token, type, number.value)))
+    {
+        return violate(v, parser, EZ_SV_ENUM);
+    }
+
+    switch (type)
+    {
+    case TYPE_NUMBER:
+        if (node->flags & HAS_MINIMUM)
+        {
+            const int order = compareNumbers(&number, &node->minimum);
+            if (order < 0 || (order == 0 && (node->flags & MINIMUM_EXCLUSIVE)))
+            {
+                return violate(v, parser, EZ_SV_MINIMUM);
+            }
+        }
+        if (node->flags & HAS_MAXIMUM)
+        {
+            const int order = compareNumbers(&number, &node->maximum);
+            if (order > 0 || (order == 0 && (node->flags & MAXIMUM_EXCLUSIVE)))
+            {
+                return violate(v, parser, EZ_SV_MAXIMUM);
+            }
+        }
+        break;
+    case TYPE_STRING:
+        if (node->flags & HAS_LENGTH)
+        {
+            const unsigned long length =
+                codePoints(token->data_text, token->data_text_length);
+            if (length < node->minLength)
+            {
+                return violate(v, parser, EZ_SV_MIN_LENGTH);
+            }
+            if (length > node->maxLength)
+            {
+                return violate(v, parser, EZ_SV_MAX_LENGTH);
+            }
+        }
+        break;
+    case TYPE_OBJECT:
+    case TYPE_ARRAY:
+        return pushFrame(v, parser, index, type == TYPE_OBJECT);
+    }
+    return 0;
+}
+
+static int checkKey(
+    struct EzJSONValidator *v,
+    struct EzJSONParser *parser,
+    const struct EzJSONToken *token)
+{
+    const struct EzJSONSchema *schema   = v->schema;
+    struct EzJSONValidatorFrame *frame  = &v->frames[v->frameCount - 1u];
+    const struct EzJSONSchemaNode *node = &schema->nodes[frame->node];
+
+    if (++frame->count > node->maxProperties)
+    {
+        return violate(v, parser, EZ_SV_MAX_PROPERTIES);
+    }
+
+    // Binary search for the first property with the hash
+    const struct EzJSONSchemaProperty *property =
+        schema->properties + node->firstProperty;
+    const struct EzJSONSchemaProperty *end = property + node->propertyCount;
+    unsigned count                         = node->propertyCount;
+    while (count > 0)
+    {
+        const unsigned half = count / 2u;
+        if (property[half].hash < token->data_key_hash)
+        {
+            property += half + 1u;
+            count -= half + 1u;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+    for (; property != end && property->hash == token->data_key_hash;
+         ++property)
+    {
+        if (property->nameLength == token->data_text_length
+            && memcmp(
+                   schema->text + property->name,
+                   token->data_text,
+                   token->data_text_length)
+                   == 0)
+        {
+            break;
+        }
+    }
+
+    if (property == end || property->hash != token->data_key_hash)
+    {
+        if (node->additional == NODE_NONE)
+        {
+            return violate(v, parser, EZ_SV_ADDITIONAL);
+        }
+        v->pending = node->additional;
+        return 0;
+    }
+
+    v->pending = property->node;
+    if (property->required != NOT_REQUIRED)
+    {
+        uint64_t *word =
+            &v->seen[frame->seenBase + property->required / 64u];
+        const uint64_t bit = (uint64_t)1 << (property->required % 64u);
+        if (!(*word & bit))
+        {
+            *word |= bit;
+            frame->seenRequired++;
+        }
+    }
+    return 0;
+}
+
+static int closeContainer(
+    struct EzJSONValidator *v, struct EzJSONParser *parser)
+{
+    const struct EzJSONSchema *schema        = v->schema;
+    const struct EzJSONValidatorFrame *frame = &v->frames[v->frameCount - 1u];
+    const struct EzJSONSchemaNode *node      = &schema->nodes[frame->node];
+
+    if (!frame->object)
+    {
+        if (frame->count < node->minItems)
+        {
+            return violate(v, parser, EZ_SV_MIN_ITEMS);
+        }
+    }
+    else if (frame->count < node->minProperties)
+    {
+        return violate(v, parser, EZ_SV_MIN_PROPERTIES);
+    }
+    else if (frame->seenRequired < node->requiredCount)
+    {
+        for (unsigned i = 0; i < node->propertyCount; ++i)
+        {
+            const struct EzJSONSchemaProperty *property =
+                &schema->properties[node->firstProperty + i];
+            const unsigned bit = property->required;
+            if (bit != NOT_REQUIRED
+                && !(v->seen[frame->seenBase + bit / 64u]
+                     & ((uint64_t)1 << (bit % 64u))))
+            {
+                v->missing       = schema->text + property->name;
+                v->missingLength = property->nameLength;
+                break;
+            }
+        }
+        return violate(v, parser, EZ_SV_REQUIRED);
+    }
+
+    v->seenCount = frame->seenBase;
+    v->frameCount--;
+    return 0;
+}
+
+void EzJSONValidatorInit(
+    struct EzJSONValidator *v, const struct EzJSONSchema *schema)
+{
+    memset(v, 0, sizeof(*v));
+    v->schema = schema;
+}
+
+void EzJSONValidatorDestroy(struct EzJSONValidator *v)
+{
+    const struct EzJSONDocumentSettings *settings = &v->schema->settings;
+    release(
+        settings,
+        v->frames,
+        (unsigned long)v->frameCapacity * sizeof(struct EzJSONValidatorFrame));
+    release(
+        settings,
+        v->seen,
+        (unsigned long)v->seenCapacity * sizeof(uint64_t));
+    v->frames        = NULL;
+    v->frameCapacity = 0;
+    v->seen          = NULL;
+    v->seenCapacity  = 0;
+}
+
+int EzJSONValidatorStep(
+    struct EzJSONValidator *v, struct EzJSONParser *parser)
+{
+    const struct EzJSONToken *token = EzJSONParserToken(parser);
+    unsigned index;
+
+    if (v->violation != EZ_SV_NONE)
+    {
+        return -1;
+    }
+    if (!token)
+    {
+        return 0;
+    }
+
+    switch (token->type)
+    {
+    case EZJ_TOKEN_SEQ_SEP:
+    case EZJ_TOKEN_KV_SEP:
+        return 0;
+    case EZJ_TOKEN_OBJ_KEY:
+        return checkKey(v, parser, token);
+    case EZJ_TOKEN_OBJ_END:
+    case EZJ_TOKEN_ARR_END:
+        return closeContainer(v, parser);
+    default:
+        break;
+    }
+
+    if (v->frameCount == 0)
+    {
+        index = v->schema->root;
+    }
+    else
+    {
+        struct EzJSONValidatorFrame *frame = &v->frames[v->frameCount - 1u];
+        if (frame->object)
+        {
+            index = v->pending;
+        }
+        else
+        {
+            const struct EzJSONSchemaNode *node =
+                &v->schema->nodes[frame->node];
+            if (++frame->count > node->maxItems)
+            {
+                return violate(v, parser, EZ_SV_MAX_ITEMS);
+            }
+            index = node->items;
+        }
+    }
+    return checkValue(v, parser, token, index);
+}
+
+enum EzJSONSchemaViolation
+EzJSONValidatorRun(struct EzJSONValidator *v, struct EzJSONParser *parser)
+{
+    while (v->violation == EZ_SV_NONE)
+    {
+        EzJSONParserNext(parser);
+        if (EzJSONParserHasError(parser))
+        {
+            v->violation = EZ_SV_PARSE;
+            v->offset    = EzJSONParserError(parser)->offset;
+            break;
+        }
+        if (!EzJSONParserToken(parser))
+        {
+            break;
+        }
+        EzJSONValidatorStep(v, parser);
+    }
+    return v->violation;
+}
+
+const char *EzJSONSchemaViolationName(enum EzJSONSchemaViolation violation)
+{
+    switch (violation)
+    {
+    case EZ_SV_NONE:
+        return "valid";
+    case EZ_SV_TYPE:
+        return "type not allowed";
+    case EZ_SV_ENUM:
+        return "value not in enum";
+    case EZ_SV_MINIMUM:
+        return "number below minimum";
+    case EZ_SV_MAXIMUM:
+        return "number above maximum";
+    case EZ_SV_MIN_LENGTH:
+        return "string shorter than minLength";
+    case EZ_SV_MAX_LENGTH:
+        return "string longer than maxLength";
+    case EZ_SV_MIN_ITEMS:
+        return "fewer items than minItems";
+    case EZ_SV_MAX_ITEMS:
+        return "more items than maxItems";
+    case EZ_SV_MIN_PROPERTIES:
+        return "fewer properties than minProperties";
+    case EZ_SV_MAX_PROPERTIES:
+        return "more properties than maxProperties";
+    case EZ_SV_REQUIRED:
+        return "required property missing";
+    case EZ_SV_ADDITIONAL:
+        return "additional property not allowed";
+    case EZ_SV_PARSE:
+        return "document is malformed";
+    case EZ_SV_NO_MEMORY:
+        return "out of memory";
+    }
+    return "unknown violation";
+}
@@ -0,0 +1,157 @@
+#ifndef __EZJSON_SCHEMA_H_INCLUDED__
+#define __EZJSON_SCHEMA_H_INCLUDED__
+
+#include "ezjson_common.h"
+#include "ezjson_document.h"
+#include "ezjson_parser.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    // JSON Schema validation on the token stream. A schema is compiled once
+    // into a flat table of nodes, then documents are checked token by token
+    // as the parser produces them: no tree is built, and validation stops at
+    // the first violation, usually long before the end of a bad document.
+    //
+    // The supported subset is
+    //   type, enum, const
+    //   minimum, maximum, exclusiveMinimum, exclusiveMaximum (numbers, or
+    //   booleans as in draft 4)
+    //   minLength, maxLength, counted in code points
+    //   items (a single schema), minItems, maxItems
+    //   properties, required, additionalProperties, minProperties,
+    //   maxProperties
+    // and the boolean schemas true and false. enum and const only take
+    // strings, numbers, booleans and null. Compiling a schema that uses
+    // other validation keywords, such as $ref, anyOf or pattern, fails
+    // rather than accepting documents those keywords would reject. Unknown
+    // keywords and annotations such as title or format are ignored.
+    //
+    // Object members are looked up by the key hash the parser computes.
+    // With duplicate keys, each occurrence is validated.
+
+    enum EzJSONSchemaError
+    {
+        EZ_SE_OK,
+        EZ_SE_MALFORMED,   // Not a schema, or a keyword has the wrong type
+        EZ_SE_UNSUPPORTED, // A keyword outside the supported subset
+        EZ_SE_NO_MEMORY,   // Allocation through the settings failed
+    };
+
+    enum EzJSONSchemaViolation
+    {
+        EZ_SV_NONE,
+        EZ_SV_TYPE,       // Type not allowed, or a false schema
+        EZ_SV_ENUM,       // Not one of enum, or not const
+        EZ_SV_MINIMUM,    // Below minimum or exclusiveMinimum
+        EZ_SV_MAXIMUM,    // Above maximum or exclusiveMaximum
+        EZ_SV_MIN_LENGTH, // String too short
+        EZ_SV_MAX_LENGTH, // String too long
+        EZ_SV_MIN_ITEMS,
+        EZ_SV_MAX_ITEMS,
+        EZ_SV_MIN_PROPERTIES,
+        EZ_SV_MAX_PROPERTIES,
+        EZ_SV_REQUIRED,   // A required property is missing
+        EZ_SV_ADDITIONAL, // Property rejected by additionalProperties
+        EZ_SV_PARSE,      // The document failed to parse
+        EZ_SV_NO_MEMORY,  // Allocation through the schema settings failed
+    };
+
+    struct EzJSONSchemaNode;
+    struct EzJSONSchemaProperty;
+    struct EzJSONSchemaConstant;
+
+    struct EzJSONSchema
+    {
+        // Copied from the document the schema was compiled from, and used
+        // by its validators too
+        struct EzJSONDocumentSettings settings;
+
+        struct EzJSONSchemaNode *nodes;
+        unsigned nodeCount;
+        unsigned nodeCapacity;
+        unsigned root;
+
+        // Properties of each object schema, a range per node sorted by hash
+        struct EzJSONSchemaProperty *properties;
+        unsigned propertyCount;
+        unsigned propertyCapacity;
+
+        // enum and const values, a range per node
+        struct EzJSONSchemaConstant *constants;
+        unsigned constantCount;
+        unsigned constantCapacity;
+
+        // Property names and string constants, decoded
+        char *text;
+        unsigned textLength;
+        unsigned textCapacity;
+    };
+
+    struct EzJSONValidatorFrame;
+
+    struct EzJSONValidator
+    {
+        const struct EzJSONSchema *schema;
+
+        // One frame per open container
+        struct EzJSONValidatorFrame *frames;
+        unsigned frameCount;
+        unsigned frameCapacity;
+
+        // Required properties seen, a bit set per open object
+        uint64_t *seen;
+        unsigned seenCount;
+        unsigned seenCapacity;
+
+        unsigned pending; // Node of the value after the current key
+
+        enum EzJSONSchemaViolation violation;
+        unsigned long offset; // Parser offset when the violation was found
+        // With EZ_SV_REQUIRED, the name of a missing property, held by the
+        // schema
+        const char *missing;
+        unsigned missingLength;
+    };
+
+    /// Compile schema. Memory is allocated through the settings of its
+    /// document, which can be destroyed afterwards. On error the schema is
+    /// left empty and only needs EzJSONSchemaDestroy.
+    enum EzJSONSchemaError
+    EzJSONSchemaCompile(struct EzJSONSchema *, struct EzJSONValue schema);
+
+    void EzJSONSchemaDestroy(struct EzJSONSchema *);
+
+    /// Human readable description of an error
+    const char *EzJSONSchemaErrorName(enum EzJSONSchemaError);
+
+    /// Set up a validator for one document. The schema must outlive it.
+    void EzJSONValidatorInit(
+        struct EzJSONValidator *, const struct EzJSONSchema *);
+
+    /// Free the validator's stacks
+    void EzJSONValidatorDestroy(struct EzJSONValidator *);
+
+    /// Check the current token of parser, to be called after every
+    /// EzJSONParserNext, not after EzJSONParserNextBatch. Returns 0 while
+    /// the document is valid so far and -1 once a violation was found,
+    /// after which the validator stays in that state. Does not check that
+    /// the document is complete or well formed, the parser does.
+    int EzJSONValidatorStep(struct EzJSONValidator *, struct EzJSONParser *);
+
+    /// Read the document from parser, which must not have been stepped yet,
+    /// validating as it goes. Stops at the first violation or parse error
+    /// and returns it, EZ_SV_NONE if the whole document is valid.
+    enum EzJSONSchemaViolation
+    EzJSONValidatorRun(struct EzJSONValidator *, struct EzJSONParser *);
+
+    /// Human readable description of a violation
+    const char *EzJSONSchemaViolationName(enum EzJSONSchemaViolation);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //!__EZJSON_SCHEMA_H_INCLUDED__
@@ -0,0 +1,468 @@
+#include "ezjson_tape.h"
+#include "ezjson_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define EZJSON_TAPE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Header: magic, version and a byte order mark, both stored natively so a
+// tape from a machine of the other byte order fails the check
+#define TAPE_MAGIC "EZJTAPE"
+#define TAPE_VERSION 1u
+#define TAPE_BYTE_ORDER 0x01020304u
+#define TAPE_HEADER_SIZE 16u
+
+// Word tags, in the low byte of every word. The remaining 56 bits hold the
+// payload: the bool value, or the byte length of a string or key. Numbers
+// are followed by one word holding the value, keys by one holding the hash,
+// strings and keys by their text, terminated and padded to whole words.
+enum
+{
+    TAPE_OBJ_BEGIN = '{',
+    TAPE_OBJ_END   = '}',
+    TAPE_ARR_BEGIN = '[',
+    TAPE_ARR_END   = ']',
+    TAPE_KEY       = 'k',
+    TAPE_STRING    = 's',
+    TAPE_INT64     = 'l',
+    TAPE_DOUBLE    = 'd',
+    TAPE_BOOL      = 'b',
+    TAPE_NULL      = 'n',
+    TAPE_END       = 'e',
+};
+
+static uint64_t tapeWord(unsigned tag, uint64_t payload)
+{
+    return (payload << 8) | tag;
+}
+
+// Words of text, including the terminator
+static uint64_t textWords(uint64_t length)
+{
+    return length / 8 + 1;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Writing
+
+struct TapeOutput
+{
+    void (*writeBuffer)(void *, const char *, unsigned);
+    void *userdata;
+    char buffer[EZJSON_WRITE_BUFFER_SIZE];
+    unsigned bufferPos;
+};
+
+static void flushOutput(struct TapeOutput *out)
+{
+    if (out->bufferPos > 0)
+    {
+        out->writeBuffer(out->userdata, out->buffer, out->bufferPos);
+        out->bufferPos = 0;
+    }
+}
+
+static void
+putBytes(struct TapeOutput *out, const void *data, unsigned count)
+{
+    if (count > EZJSON_WRITE_BUFFER_SIZE)
+    {
+        flushOutput(out);
+        out->writeBuffer(out->userdata, (const char *)data, count);
+        return;
+    }
+
+    if (EZJSON_WRITE_BUFFER_SIZE - out->bufferPos < count)
+    {
+        flushOutput(out);
+    }
+    memcpy(out->buffer + out->bufferPos, data, count);
+    out->bufferPos += count;
+}
+
+static void putWord(struct TapeOutput *out, uint64_t word)
+{
+    putBytes(out, &word, sizeof(word));
+}
+
+static void putText(struct TapeOutput *out, const char *text, unsigned length)
+{
+    static const char padding[8] = {0};
+
+    putBytes(out, text, length);
+    putBytes(out, padding, 8 - length % 8);
+}
+
+int EzJSONTapeWrite(
+    struct EzJSONParser *parser,
+    void (*writeBuffer)(void *, const char *, unsigned),
+    void *userdata)
+{
+    struct TapeOutput out;
+    const struct EzJSONToken *token;
+    char header[TAPE_HEADER_SIZE];
+    const uint32_t version   = TAPE_VERSION;
+    const uint32_t byteOrder = TAPE_BYTE_ORDER;
+    int64_t integer;
+    double real;
+
+    out.writeBuffer = writeBuffer;
+    out.userdata    = userdata;
+    out.bufferPos   = 0;
+
+    memcpy(header, TAPE_MAGIC, 8);
+    memcpy(header + 8, &version, 4);
+    memcpy(header + 12, &byteOrder, 4);
+    putBytes(&out, header, sizeof(header));
+
+    while (EzJSONParserNext(parser), token = EzJSONParserToken(parser))
+    {
+        switch (token->type)
+        {
+        case EZJ_TOKEN_OBJ_BEGIN:
+            putWord(&out, tapeWord(TAPE_OBJ_BEGIN, 0));
+            break;
+        case EZJ_TOKEN_OBJ_END:
+            putWord(&out, tapeWord(TAPE_OBJ_END, 0));
+            break;
+        case EZJ_TOKEN_ARR_BEGIN:
+            putWord(&out, tapeWord(TAPE_ARR_BEGIN, 0));
+            break;
+        case EZJ_TOKEN_ARR_END:
+            putWord(&out, tapeWord(TAPE_ARR_END, 0));
+            break;
+        case EZJ_TOKEN_OBJ_KEY:
+            putWord(&out, tapeWord(TAPE_KEY, token->data_text_length));
+            putWord(&out, token->data_key_hash);
+            putText(&out, token->data_text, token->data_text_length);
+            break;
+        case EZJ_TOKEN_STRING:
+            putWord(&out, tapeWord(TAPE_STRING, token->data_text_length));
+            putText(&out, token->data_text, token->data_text_length);
+            break;
+        case EZJ_TOKEN_NUMBER:
+            if (EzJSONParserNumberI64(parser, &integer) == 0)
+            {
+                putWord(&out, tapeWord(TAPE_INT64, 0));
+                putBytes(&out, &integer, sizeof(integer));
+            }
+            else
+            {
+                EzJSONParserNumberDouble(parser, &real);
+                putWord(&out, tapeWord(TAPE_DOUBLE, 0));
+                putBytes(&out, &real, sizeof(real));
+            }
+            break;
+        case EZJ_TOKEN_BOOL:
+            putWord(&out, tapeWord(TAPE_BOOL, token->data_bool != 0));
+            break;
+        case EZJ_TOKEN_NULL:
+            putWord(&out, tapeWord(TAPE_NULL, 0));
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (EzJSONParserHasError(parser))
+    {
+        flushOutput(&out);
+        return -1;
+    }
+
+    putWord(&out, tapeWord(TAPE_END, 0));
+    flushOutput(&out);
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Replay
+
+static void failTape(struct EzJSONTape *tape, enum EzJSONTapeError error)
+{
+    tape->error    = error;
+    tape->hasToken = 0;
+    tape->done     = 1;
+}
+
+// Read the word at pos and advance. Returns zero at the end of the data.
+static int readWord(struct EzJSONTape *tape, uint64_t *out)
+{
+    if (tape->length - tape->pos < 8)
+    {
+        failTape(tape, EZ_TE_TRUNCATED);
+        return 0;
+    }
+
+    memcpy(out, tape->data + tape->pos, 8);
+    tape->pos += 8;
+    return 1;
+}
+
+// Point the token at the text at pos and step over it
+static int readText(struct EzJSONTape *tape, uint64_t length)
+{
+    const uint64_t words = textWords(length);
+    if ((tape->length - tape->pos) / 8 < words)
+    {
+        failTape(tape, EZ_TE_TRUNCATED);
+        return 0;
+    }
+
+    const char *text = tape->data + tape->pos;
+    if (length > 0xFFFFFFFFu || text[length] != '\0')
+    {
+        failTape(tape, EZ_TE_CORRUPT);
+        return 0;
+    }
+
+    tape->token.data_text        = text;
+    tape->token.data_text_length = (unsigned)length;
+    tape->pos += words * 8;
+    return 1;
+}
+
+int EzJSONTapeInit(
+    struct EzJSONTape *tape, const char *data, unsigned long length)
+{
+    uint32_t version;
+    uint32_t byteOrder;
+
+    tape->data          = data;
+    tape->length        = length;
+    tape->mapping       = NULL;
+    tape->mappingLength = 0;
+    tape->error         = EZ_TE_OK;
+    EzJSONTapeRewind(tape);
+
+    if (length < TAPE_HEADER_SIZE || memcmp(data, TAPE_MAGIC, 8) != 0)
+    {
+        failTape(tape, EZ_TE_BAD_HEADER);
+        return -1;
+    }
+
+    memcpy(&version, data + 8, 4);
+    memcpy(&byteOrder, data + 12, 4);
+    if (version != TAPE_VERSION || byteOrder != TAPE_BYTE_ORDER)
+    {
+        failTape(tape, EZ_TE_BAD_HEADER);
+        return -1;
+    }
+
+    return 0;
+}
+
+int EzJSONTapeOpen(struct EzJSONTape *tape, const char *path)
+{
+    memset(tape, 0, sizeof(*tape));
+
+#if defined(EZJSON_TAPE_MMAP)
+    const int fd = open(path, O_RDONLY);
+    struct stat info;
+    void *data = MAP_FAILED;
+
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (data == MAP_FAILED)
+    {
+        failTape(tape, EZ_TE_IO);
+        return -1;
+    }
+    const unsigned long length = (unsigned long)info.st_size;
+#else
+    FILE *file = fopen(path, "rb");
+    char *data = NULL;
+    long size  = -1;
+
+    if (file && fseek(file, 0, SEEK_END) == 0)
+    {
+        size = ftell(file);
+    }
+    if (size > 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        data = (char *)malloc((size_t)size);
+    }
+    if (data && fread(data, 1, (size_t)size, file) != (size_t)size)
+    {
+        free(data);
+        data = NULL;
+    }
+    if (file)
+    {
+        fclose(file);
+    }
+    if (!data)
+    {
+        failTape(tape, EZ_TE_IO);
+        return -1;
+    }
+    const unsigned long length = (unsigned long)size;
+#endif
+
+    const int result    = EzJSONTapeInit(tape, (const char *)data, length);
+    tape->mapping       = data;
+    tape->mappingLength = length;
+    return result;
+}
+
+void EzJSONTapeClose(struct EzJSONTape *tape)
+{
+    if (tape->mapping)
+    {
+#if defined(EZJSON_TAPE_MMAP)
+        munmap(tape->mapping, (size_t)tape->mappingLength);
+#else
+        free(tape->mapping);
+#endif
+    }
+    memset(tape, 0, sizeof(*tape));
+}
+
+void EzJSONTapeNext(struct EzJSONTape *tape)
+{
+    uint64_t word;
+
+    tape->hasToken  = 0;
+    tape->isInteger = 0;
+    if (tape->done || !readWord(tape, &word))
+    {
+        return;
+    }
+
+    const uint64_t payload = word >> 8;
+    switch ((unsigned)(word & 0xFF))
+    {
+    case TAPE_OBJ_BEGIN:
+        tape->token.type = EZJ_TOKEN_OBJ_BEGIN;
+        tape->depth++;
+        break;
+    case TAPE_ARR_BEGIN:
+        tape->token.type = EZJ_TOKEN_ARR_BEGIN;
+        tape->depth++;
+        break;
+    case TAPE_OBJ_END:
+    case TAPE_ARR_END:
+        if (tape->depth == 0)
+        {
+            failTape(tape, EZ_TE_CORRUPT);
+            return;
+        }
+        tape->token.type = (word & 0xFF) == TAPE_OBJ_END ? EZJ_TOKEN_OBJ_END
+                                                         : EZJ_TOKEN_ARR_END;
+        tape->depth--;
+        break;
+    case TAPE_KEY:
+        if (!readWord(tape, &word))
+        {
+            return;
+        }
+        tape->token.type          = EZJ_TOKEN_OBJ_KEY;
+        tape->token.data_key_hash = (uint32_t)word;
+        if (!readText(tape, payload))
+        {
+            return;
+        }
+        break;
+    case TAPE_STRING:
+        tape->token.type = EZJ_TOKEN_STRING;
+        if (!readText(tape, payload))
+        {
+            return;
+        }
+        break;
+    case TAPE_INT64:
+        if (!readWord(tape, &word))
+        {
+            return;
+        }
+        memcpy(&tape->integer, &word, 8);
+        tape->number            = (double)tape->integer;
+        tape->isInteger         = 1;
+        tape->token.type        = EZJ_TOKEN_NUMBER;
+        tape->token.data_number = (EzJSONNumber)tape->integer;
+        break;
+    case TAPE_DOUBLE:
+        if (!readWord(tape, &word))
+        {
+            return;
+        }
+        memcpy(&tape->number, &word, 8);
+        tape->token.type        = EZJ_TOKEN_NUMBER;
+        tape->token.data_number = (EzJSONNumber)tape->number;
+        break;
+    case TAPE_BOOL:
+        tape->token.type      = EZJ_TOKEN_BOOL;
+        tape->token.data_bool = (EzJSONBool)(payload != 0);
+        break;
+    case TAPE_NULL:
+        tape->token.type = EZJ_TOKEN_NULL;
+        break;
+    case TAPE_END:
+        if (tape->depth != 0)
+        {
+            failTape(tape, EZ_TE_CORRUPT);
+            return;
+        }
+        tape->done = 1;
+        return;
+    default:
+        failTape(tape, EZ_TE_CORRUPT);
+        return;
+    }
+
+    tape->hasToken = 1;
+}
+
+struct EzJSONToken *EzJSONTapeToken(struct EzJSONTape *tape)
+{
+    return tape->hasToken ? &tape->token : NULL;
+}
+
+void EzJSONTapeRewind(struct EzJSONTape *tape)
+{
+    if (tape->error == EZ_TE_BAD_HEADER || tape->error == EZ_TE_IO)
+    {
+        return;
+    }
+
+    tape->pos       = TAPE_HEADER_SIZE;
+    tape->hasToken  = 0;
+    tape->done      = 0;
+    tape->depth     = 0;
+    tape->number    = 0;
+    tape->integer   = 0;
+    tape->isInteger = 0;
+    tape->error     = EZ_TE_OK;
+}
+
+const char *EzJSONTapeErrorName(enum EzJSONTapeError error)
+{
+    switch (error)
+    {
+    case EZ_TE_OK:
+        return "no error";
+    case EZ_TE_BAD_HEADER:
+        return "not a tape of this version and byte order";
+    case EZ_TE_TRUNCATED:
+        return "tape is truncated";
+    case EZ_TE_CORRUPT:
+        return "tape is corrupt";
+    case EZ_TE_IO:
+        return "could not read the tape file";
+    }
+    return "unknown error";
+}
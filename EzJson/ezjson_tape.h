@@ -0,0 +1,97 @@
+#ifndef __EZJSON_TAPE_H_INCLUDED__
+#define __EZJSON_TAPE_H_INCLUDED__
+
+#include "ezjson_common.h"
+#include "ezjson_parser.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    // A tape is a parsed document saved in a form that can be replayed
+    // without scanning text: a 16 byte header followed by 8 byte words, one
+    // per token, in native byte order. Numbers are stored decoded, strings
+    // and keys unescaped and terminated, keys with their hash. Write one
+    // with EzJSONTapeWrite, then replay it from memory or from a mapped file
+    // through the same EzJSONToken interface as the parser, or with
+    // EzJSONReadTape.
+    //
+    // Tapes are bounds checked while replaying, but the nesting of
+    // containers is only counted, not matched. They are not portable
+    // between machines of different byte order.
+
+    enum EzJSONTapeError
+    {
+        EZ_TE_OK,
+        EZ_TE_BAD_HEADER, // Not a tape, another version or byte order
+        EZ_TE_TRUNCATED,  // Data ends before the end of the tape
+        EZ_TE_CORRUPT,    // Unknown word or unbalanced containers
+        EZ_TE_IO,         // EzJSONTapeOpen could not read the file
+    };
+
+    struct EzJSONTape
+    {
+        const char *data; // Header and words
+        unsigned long length;
+        unsigned long pos; // Offset of the next word
+
+        struct EzJSONToken token;
+        char hasToken;
+        char done;
+        unsigned depth;
+
+        // Full precision value of the current EZJ_TOKEN_NUMBER token
+        double number;
+        int64_t integer; // Set when isInteger
+        char isInteger;
+
+        enum EzJSONTapeError error;
+
+        // Set by EzJSONTapeOpen, released by EzJSONTapeClose
+        void *mapping;
+        unsigned long mappingLength;
+    };
+
+    /// Write the document read by parser as a tape. Output is passed to
+    /// writeBuffer in chunks of at most EZJSON_WRITE_BUFFER_SIZE bytes,
+    /// except for long strings. Returns 0 on success and -1 on a parse
+    /// error, see EzJSONParserError. The output is not a valid tape then.
+    int EzJSONTapeWrite(
+        struct EzJSONParser *,
+        void (*writeBuffer)(void *, const char *, unsigned),
+        void *userdata);
+
+    /// Replay a tape of length bytes, which must stay valid and unchanged
+    /// while the tape is used. Returns -1, with error set, if the header
+    /// is not valid.
+    int EzJSONTapeInit(
+        struct EzJSONTape *, const char *data, unsigned long length);
+
+    /// Map a tape file into memory (read into allocated memory where
+    /// mapping is not available) and replay it. Returns -1, with error set,
+    /// if it cannot be read or the header is not valid. Release with
+    /// EzJSONTapeClose.
+    int EzJSONTapeOpen(struct EzJSONTape *, const char *path);
+    void EzJSONTapeClose(struct EzJSONTape *);
+
+    /// Step to the next token, as EzJSONParserNext with
+    /// EZJ_PARSE_SKIP_SEPARATORS. Text of string and key tokens points into
+    /// the tape and is terminated.
+    void EzJSONTapeNext(struct EzJSONTape *);
+
+    /// The current token, null on error, at the end, or before the first call
+    /// to EzJSONTapeNext
+    struct EzJSONToken *EzJSONTapeToken(struct EzJSONTape *);
+
+    /// Go back to the first token
+    void EzJSONTapeRewind(struct EzJSONTape *);
+
+    /// Human readable description of an error
+    const char *EzJSONTapeErrorName(enum EzJSONTapeError);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //!__EZJSON_TAPE_H_INCLUDED__
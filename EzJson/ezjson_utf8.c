@@ -0,0 +1,453 @@
+#include "ezjson_internal.h"
+
+#if defined(__SSE2__) || defined(_M_X64)                                       \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EZJSON_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define EZJSON_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Scalar validator states. Non-zero states are inside a multi-byte sequence,
+// and encode which continuation bytes are acceptable next.
+enum
+{
+    UTF8_NEED_1 = 1,  // 80..BF, then done
+    UTF8_NEED_2 = 2,  // 80..BF, then UTF8_NEED_1
+    UTF8_NEED_3 = 3,  // 80..BF, then UTF8_NEED_2
+    UTF8_AFTER_E0 = 4, // A0..BF, no overlong 3-byte forms
+    UTF8_AFTER_ED = 5, // 80..9F, no surrogates
+    UTF8_AFTER_F0 = 6, // 90..BF, no overlong 4-byte forms
+    UTF8_AFTER_F4 = 7, // 80..8F, nothing above U+10FFFF
+};
+
+static unsigned utf8_step(unsigned state, unsigned char c)
+{
+    switch (state)
+    {
+    case UTF8_ACCEPT:
+        if (c < 0x80)
+            return UTF8_ACCEPT;
+        if (c < 0xC2)
+            return UTF8_REJECT;
+        if (c < 0xE0)
+            return UTF8_NEED_1;
+        if (c == 0xE0)
+            return UTF8_AFTER_E0;
+        if (c == 0xED)
+            return UTF8_AFTER_ED;
+        if (c < 0xF0)
+            return UTF8_NEED_2;
+        if (c == 0xF0)
+            return UTF8_AFTER_F0;
+        if (c < 0xF4)
+            return UTF8_NEED_3;
+        if (c == 0xF4)
+            return UTF8_AFTER_F4;
+        return UTF8_REJECT;
+    case UTF8_NEED_1:
+    case UTF8_NEED_2:
+    case UTF8_NEED_3:
+        return (c >= 0x80 && c <= 0xBF) ? state - 1 : UTF8_REJECT;
+    case UTF8_AFTER_E0:
+        return (c >= 0xA0 && c <= 0xBF) ? UTF8_NEED_1 : UTF8_REJECT;
+    case UTF8_AFTER_ED:
+        return (c >= 0x80 && c <= 0x9F) ? UTF8_NEED_1 : UTF8_REJECT;
+    case UTF8_AFTER_F0:
+        return (c >= 0x90 && c <= 0xBF) ? UTF8_NEED_2 : UTF8_REJECT;
+    case UTF8_AFTER_F4:
+        return (c >= 0x80 && c <= 0x8F) ? UTF8_NEED_2 : UTF8_REJECT;
+    default:
+        return UTF8_REJECT;
+    }
+}
+
+static unsigned first_bit(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+#if defined(EZJSON_SSSE3)
+// Block validator after Keiser and Lemire, "Validating UTF-8 In Less Than One
+// Instruction Per Byte". Each error class gets a bit, and three nibble lookups
+// (high and low nibble of the previous byte, high nibble of the current byte)
+// must agree for the byte pair to be valid.
+#define TOO_SHORT (1 << 0)
+#define TOO_LONG (1 << 1)
+#define OVERLONG_3 (1 << 2)
+#define TOO_LARGE (1 << 3)
+#define SURROGATE (1 << 4)
+#define OVERLONG_2 (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4 (1 << 6)
+#define TWO_CONTS (1 << 7)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+static __m128i utf8_block_errors(__m128i input, __m128i prev)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    const __m128i byte1HighTable = _mm_setr_epi8(
+        TOO_LONG,
+        TOO_LONG,
+        TOO_LONG,
+        TOO_LONG,
+        TOO_LONG,
+        TOO_LONG,
+        TOO_LONG,
+        TOO_LONG,
+        TWO_CONTS,
+        TWO_CONTS,
+        TWO_CONTS,
+        TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+
+    const __m128i byte1LowTable = _mm_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000);
+
+    const __m128i byte2HighTable = _mm_setr_epi8(
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000
+            | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT);
+
+    const __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+    const __m128i byte1High = _mm_shuffle_epi8(
+        byte1HighTable, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+    const __m128i byte1Low =
+        _mm_shuffle_epi8(byte1LowTable, _mm_and_si128(prev1, nibble));
+    const __m128i byte2High = _mm_shuffle_epi8(
+        byte2HighTable, _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+    const __m128i special =
+        _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+
+    // Third and fourth bytes of 3 and 4 byte sequences must be continuations
+    const __m128i prev2 = _mm_alignr_epi8(input, prev, 14);
+    const __m128i prev3 = _mm_alignr_epi8(input, prev, 13);
+    const __m128i isThird =
+        _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 1)));
+    const __m128i isFourth =
+        _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 1)));
+    const __m128i must23 = _mm_and_si128(
+        _mm_cmpgt_epi8(_mm_or_si128(isThird, isFourth), _mm_setzero_si128()),
+        _mm_set1_epi8((char)0x80));
+
+    return _mm_xor_si128(must23, special);
+}
+
+// Non-zero if the block ends inside a multi-byte sequence
+static int utf8_block_incomplete(__m128i input)
+{
+    const __m128i maxValue = _mm_setr_epi8(
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)0xFF,
+        (char)(0xF0 - 1),
+        (char)(0xE0 - 1),
+        (char)(0xC0 - 1));
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(
+               _mm_subs_epu8(input, maxValue), _mm_setzero_si128()))
+           != 0xFFFF;
+}
+#endif
+
+unsigned utf8_validate(unsigned *state, const char *data, unsigned count)
+{
+    unsigned pos = 0;
+
+#if defined(EZJSON_SSE2)
+    // Whole blocks are only handled here when starting on a sequence
+    // boundary. On error, or after the last whole block, the scalar loop
+    // continues from the start of the sequence in progress, so it can report
+    // the exact offending byte and carry state across calls.
+    if (*state == UTF8_ACCEPT)
+    {
+#if defined(EZJSON_SSSE3)
+        __m128i prev       = _mm_setzero_si128();
+        int prevIncomplete = 0;
+#endif
+        while (count - pos >= 16)
+        {
+            const __m128i block =
+                _mm_loadu_si128((const __m128i *)(data + pos));
+
+#if defined(EZJSON_SSSE3)
+            if (_mm_movemask_epi8(block) != 0 || prevIncomplete)
+            {
+                const __m128i errors = utf8_block_errors(block, prev);
+                if (_mm_movemask_epi8(
+                        _mm_cmpeq_epi8(errors, _mm_setzero_si128()))
+                    != 0xFFFF)
+                {
+                    break;
+                }
+                prevIncomplete = utf8_block_incomplete(block);
+            }
+            prev = block;
+#else
+            if (_mm_movemask_epi8(block) != 0)
+            {
+                break;
+            }
+#endif
+            pos += 16;
+        }
+
+#if defined(EZJSON_SSSE3)
+        if (prevIncomplete)
+        {
+            // Back up to the lead byte of the unfinished sequence
+            while ((unsigned char)data[pos - 1] < 0xC0)
+            {
+                --pos;
+            }
+            --pos;
+        }
+#endif
+    }
+#endif
+
+    unsigned s = *state;
+    for (; pos < count; ++pos)
+    {
+        s = utf8_step(s, (unsigned char)data[pos]);
+        if (s == UTF8_REJECT)
+        {
+            break;
+        }
+    }
+
+    *state = s;
+    return pos;
+}
+
+unsigned utf8_encode(uint32_t codepoint, char *out)
+{
+    if (codepoint < 0x80)
+    {
+        out[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800)
+    {
+        out[0] = (char)(0xC0 | (codepoint >> 6));
+        out[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (codepoint >> 12));
+        out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+
+    out[0] = (char)(0xF0 | (codepoint >> 18));
+    out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+const char *scan_string(const char *data, const char *end)
+{
+#if defined(EZJSON_SSE2)
+    const __m128i quote     = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control   = _mm_set1_epi8(0x1F);
+
+    while (end - data >= 16)
+    {
+        const __m128i block = _mm_loadu_si128((const __m128i *)data);
+        const __m128i stop  = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+
+        const unsigned mask = (unsigned)_mm_movemask_epi8(stop);
+        if (mask != 0)
+        {
+            return data + first_bit(mask);
+        }
+        data += 16;
+    }
+#endif
+
+    while (data < end && *data != '"' && *data != '\\'
+           && (unsigned char)*data >= 0x20)
+    {
+        ++data;
+    }
+
+    return data;
+}
+
+const char *scan_string_end(const char *data, const char *end)
+{
+#if defined(EZJSON_SSE2)
+    const __m128i quote     = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    while (end - data >= 16)
+    {
+        const __m128i block = _mm_loadu_si128((const __m128i *)data);
+        const __m128i stop  = _mm_or_si128(
+            _mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash));
+
+        const unsigned mask = (unsigned)_mm_movemask_epi8(stop);
+        if (mask != 0)
+        {
+            return data + first_bit(mask);
+        }
+        data += 16;
+    }
+#endif
+
+    while (data < end && *data != '"' && *data != '\\')
+    {
+        ++data;
+    }
+
+    return data;
+}
+
+const char *scan_structural(const char *data, const char *end)
+{
+#if defined(EZJSON_SSE2)
+    const __m128i quote       = _mm_set1_epi8('"');
+    const __m128i arrayBegin  = _mm_set1_epi8('[');
+    const __m128i arrayEnd    = _mm_set1_epi8(']');
+    const __m128i objectBegin = _mm_set1_epi8('{');
+    const __m128i objectEnd   = _mm_set1_epi8('}');
+
+    while (end - data >= 16)
+    {
+        const __m128i block = _mm_loadu_si128((const __m128i *)data);
+        const __m128i stop  = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(block, quote),
+                _mm_or_si128(
+                    _mm_cmpeq_epi8(block, arrayBegin),
+                    _mm_cmpeq_epi8(block, arrayEnd))),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(block, objectBegin),
+                _mm_cmpeq_epi8(block, objectEnd)));
+
+        const unsigned mask = (unsigned)_mm_movemask_epi8(stop);
+        if (mask != 0)
+        {
+            return data + first_bit(mask);
+        }
+        data += 16;
+    }
+#endif
+
+    while (data < end && *data != '"' && *data != '[' && *data != ']'
+           && *data != '{' && *data != '}')
+    {
+        ++data;
+    }
+
+    return data;
+}
+
+const char *scan_container(const char *data, const char *end)
+{
+    unsigned long depth = 1;
+
+    for (;;)
+    {
+        data = scan_structural(data, end);
+        if (data == end)
+        {
+            return NULL;
+        }
+
+        switch (*data)
+        {
+        case '"':
+            // Skip the string, escapes included, so its brackets do not count
+            for (++data;; data += 2)
+            {
+                data = scan_string_end(data, end);
+                if (data == end || *data != '\\' || end - data < 2)
+                {
+                    break;
+                }
+            }
+            if (data == end || *data != '"')
+            {
+                return NULL;
+            }
+            break;
+
+        case '[':
+        case '{':
+            depth++;
+            break;
+
+        default:
+            if (--depth == 0)
+            {
+                return data + 1;
+            }
+            break;
+        }
+        data++;
+    }
+}
@@ -1,6 +1,7 @@
 #include "ezjson_writer.h"
 #include "ezjson_internal.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,6 +13,8 @@
 
 void flushBuffer(struct EzJSONWriter *writer)
 {
+    EZJSON_STAT(writer->stats.bytes += writer->bufferPos);
+    EZJSON_STAT(writer->stats.flushes++);
     writer->writeBuffer(
         writer->settings.userdata, writer->buffer, writer->bufferPos);
     writer->bufferPos = 0u;
@@ -39,43 +42,89 @@ void writeData(struct EzJSONWriter *writer, const char *data, unsigned count)
     }
 }
 
-#if defined(EZJSON_CHECKED_WRITE)
-void stackId(int *idx, int *bit, int position)
+// Checked mode. Each check returns non-zero and reports the error if the
+// call would break the document structure. Unchecked writers never reach
+// these functions.
+void onError(
+    struct EzJSONWriter *writer,
+    enum EzJSONWriteError errorCode,
+    enum EzJSONWriteCall call)
 {
-    *idx = position / 8;
-    *bit = position % 8;
+    writer->error          = errorCode;
+    writer->errorCall      = call;
+    writer->errorCallIndex = writer->callCount;
+    if (writer->writeError)
+    {
+        writer->writeError(writer);
+    }
 }
 
-int popArray(struct EzJSONWriter *writer)
+int checkValue(struct EzJSONWriter *writer, enum EzJSONWriteCall call)
 {
-    if (stack_empty(&writer->stack))
+    writer->callCount++;
+
+    if (!stack_empty(&writer->stack)
+        && stack_top(&writer->stack) == STACK_BIT_OBJECT
+        && (writer->writestate & WS_CLOSE) > 0)
     {
-        // ERROR
+        onError(writer, EZ_WE_KEY_EXPECTED, call);
         return -1;
     }
 
-    if (stack_top(&writer->stack) != STACK_BIT_ARRAY)
+    return 0;
+}
+
+int checkBegin(
+    struct EzJSONWriter *writer, unsigned bit, enum EzJSONWriteCall call)
+{
+    if (checkValue(writer, call) != 0)
     {
-        // ERROR
         return -1;
     }
 
-    stack_pop(&writer->stack);
+#if defined(EZJSON_STATS)
+    const unsigned stackSize = writer->stack.size;
+#endif
+    if (stack_push(
+            &writer->stack,
+            bit,
+            writer->settings.userdata,
+            writer->settings.allocate_memory,
+            writer->settings.free_memory)
+        != 0)
+    {
+        onError(writer, EZ_WE_TOO_DEEP, call);
+        return -1;
+    }
+    EZJSON_STAT(writer->stats.stackGrowths += writer->stack.size != stackSize);
 
     return 0;
 }
 
-int popObject(struct EzJSONWriter *writer)
+int checkEnd(
+    struct EzJSONWriter *writer, unsigned bit, enum EzJSONWriteCall call)
 {
+    writer->callCount++;
+
     if (stack_empty(&writer->stack))
     {
-        // ERROR
+        onError(writer, EZ_WE_NOT_OPEN, call);
         return -1;
     }
 
-    if (stack_top(&writer->stack) != STACK_BIT_OBJECT)
+    if (stack_top(&writer->stack) != bit)
     {
-        // ERROR
+        onError(
+            writer,
+            bit == STACK_BIT_OBJECT ? EZ_WE_WAS_ARRAY : EZ_WE_WAS_OBJECT,
+            call);
+        return -1;
+    }
+
+    if ((writer->writestate & WS_CLOSE) == 0)
+    {
+        // Closing an object directly after a key
+        onError(writer, EZ_WE_VALUE_EXPECTED, call);
         return -1;
     }
 
@@ -84,15 +133,26 @@ int popObject(struct EzJSONWriter *writer)
     return 0;
 }
 
-void onError(struct EzJSONWriter *writer, enum EzJSONWriteError errorCode)
+int checkKey(struct EzJSONWriter *writer)
 {
-    writer->error = errorCode;
-    if (writer->writeError)
+    writer->callCount++;
+
+    if (stack_empty(&writer->stack)
+        || stack_top(&writer->stack) != STACK_BIT_OBJECT
+        || (writer->writestate & WS_CLOSE) == 0)
     {
-        writer->writeError(writer);
+        onError(writer, EZ_WE_VALUE_EXPECTED, EZ_WC_KEY);
+        return -1;
     }
+
+    return 0;
 }
-#endif
+
+#define CHECK(expr)                                                            \
+    if (writer->settings.checked && (expr) != 0)                               \
+    {                                                                          \
+        return;                                                                \
+    }
 
 #if defined(EZJSON_PRETTY)
 void indent(struct EzJSONWriter *writer)
@@ -120,18 +180,6 @@ void newLine(struct EzJSONWriter *writer)
 
 void newValue(struct EzJSONWriter *writer)
 {
-#if defined(EZJSON_CHECKED_WRITE)
-    if (!stack_empty(&writer->stack))
-    {
-        if (stack_top(&writer->stack) == STACK_BIT_OBJECT
-            && (writer->writestate & WS_CLOSE) > 0)
-        {
-            onError(writer, EZ_WE_KEY_EXPECTED);
-            return;
-        }
-    }
-#endif
-
     if ((writer->writestate & WS_COMMA) > 0)
     {
         writeData(writer, ",", 1u);
@@ -143,17 +191,42 @@ void newValue(struct EzJSONWriter *writer)
 #endif
     }
     writer->writestate = WS_COMMA | WS_CLOSE;
+    EZJSON_STAT(writer->stats.tokens++);
+}
+
+#if defined(EZJSON_STATS)
+// Called once the container is accepted
+void statsBegin(struct EzJSONWriter *writer)
+{
+    writer->statsDepth++;
+    if (writer->statsDepth > writer->stats.maxDepth)
+    {
+        writer->stats.maxDepth = writer->statsDepth;
+    }
 }
 
+void statsEnd(struct EzJSONWriter *writer)
+{
+    writer->stats.tokens++;
+    if (writer->statsDepth > 0)
+    {
+        writer->statsDepth--;
+    }
+}
+#endif
+
 void EzJSONWriterInit(struct EzJSONWriter *writer)
 {
     writer->writestate = 0;
     writer->bufferPos  = 0;
-    writer->error      = 0;
+    writer->error      = EZ_WE_OK;
     writer->writeError = 0;
-#if defined(EZJSON_CHECKED_WRITE)
-    stack_init(&writer->stack);
-#endif
+
+    writer->errorCall      = EZ_WC_NONE;
+    writer->errorCallIndex = 0;
+    writer->callCount      = 0;
+    stack_init(&writer->stack, writer->settings.max_depth);
+    EzJSONWriterResetStats(writer);
 #if defined(EZJSON_PRETTY)
     writer->indentChar    = ' ';
     writer->indentCount   = 2;
@@ -162,6 +235,14 @@ void EzJSONWriterInit(struct EzJSONWriter *writer)
 #endif
 }
 
+void EzJSONWriterFlush(struct EzJSONWriter *writer)
+{
+    if (writer->bufferPos > 0)
+    {
+        flushBuffer(writer);
+    }
+}
+
 void EzJSONWriterDestroy(struct EzJSONWriter *writer)
 {
     stack_destroy(
@@ -170,6 +251,57 @@ void EzJSONWriterDestroy(struct EzJSONWriter *writer)
         writer->settings.free_memory);
 }
 
+const char *EzJSONWriteCallName(enum EzJSONWriteCall call)
+{
+    switch (call)
+    {
+    case EZ_WC_OBJECT_BEGIN:
+        return "EzJSONWriteObjectBegin";
+    case EZ_WC_OBJECT_END:
+        return "EzJSONWriteObjectEnd";
+    case EZ_WC_ARRAY_BEGIN:
+        return "EzJSONWriteArrayBegin";
+    case EZ_WC_ARRAY_END:
+        return "EzJSONWriteArrayEnd";
+    case EZ_WC_KEY:
+        return "EzJSONWriteKey";
+    case EZ_WC_STRING:
+        return "EzJSONWriteString";
+    case EZ_WC_BOOL:
+        return "EzJSONWriteBool";
+    case EZ_WC_NULL:
+        return "EzJSONWriteNull";
+    case EZ_WC_NUMBER:
+        return "EzJSONWriteNumber";
+    case EZ_WC_NUMBER_ARRAY:
+        return "EzJSONWriteNumberArray";
+    case EZ_WC_RAW:
+        return "EzJSONWriteRaw";
+    case EZ_WC_BASE64:
+        return "EzJSONWriteBase64";
+    default:
+        return "";
+    }
+}
+
+EzJSONBool
+EzJSONWriterGetStats(struct EzJSONWriter *writer, struct EzJSONStats *stats)
+{
+#if defined(EZJSON_STATS)
+    *stats = writer->stats;
+    return 1;
+#else
+    memset(stats, 0, sizeof(*stats));
+    return 0;
+#endif
+}
+
+void EzJSONWriterResetStats(struct EzJSONWriter *writer)
+{
+    memset(&writer->stats, 0, sizeof(writer->stats));
+    writer->statsDepth = 0;
+}
+
 void EzJSONEnablePrettyPrinting(struct EzJSONWriter *writer, EzJSONBool enabled)
 {
 #if defined(EZJSON_PRETTY)
@@ -179,15 +311,9 @@ void EzJSONEnablePrettyPrinting(struct EzJSONWriter *writer, EzJSONBool enabled)
 
 void EzJSONWriteObjectBegin(struct EzJSONWriter *writer)
 {
+    CHECK(checkBegin(writer, STACK_BIT_OBJECT, EZ_WC_OBJECT_BEGIN));
+    EZJSON_STAT(statsBegin(writer));
     newValue(writer);
-#if defined(EZJSON_CHECKED_WRITE)
-    stack_push(
-        &writer->stack,
-        STACK_BIT_OBJECT,
-        writer->settings.userdata,
-        writer->settings.allocate_memory,
-        writer->settings.free_memory);
-#endif
     writeData(writer, "{", 1u);
 #if defined(EZJSON_PRETTY)
     indent(writer);
@@ -201,13 +327,8 @@ void EzJSONWriteObjectBegin(struct EzJSONWriter *writer)
 
 void EzJSONWriteObjectEnd(struct EzJSONWriter *writer)
 {
-#if defined(EZJSON_CHECKED_WRITE)
-    if (popObject(writer) != 0 || (writer->writestate & WS_CLOSE) == 0)
-    {
-        onError(writer, EZ_WE_WAS_ARRAY);
-        return;
-    }
-#endif
+    CHECK(checkEnd(writer, STACK_BIT_OBJECT, EZ_WC_OBJECT_END));
+    EZJSON_STAT(statsEnd(writer));
 #if defined(EZJSON_PRETTY)
     dedent(writer);
     if (writer->prettyEnabled)
@@ -222,15 +343,9 @@ void EzJSONWriteObjectEnd(struct EzJSONWriter *writer)
 
 void EzJSONWriteArrayBegin(struct EzJSONWriter *writer)
 {
+    CHECK(checkBegin(writer, STACK_BIT_ARRAY, EZ_WC_ARRAY_BEGIN));
+    EZJSON_STAT(statsBegin(writer));
     newValue(writer);
-#if defined(EZJSON_CHECKED_WRITE)
-    stack_push(
-        &writer->stack,
-        STACK_BIT_ARRAY,
-        writer->settings.userdata,
-        writer->settings.allocate_memory,
-        writer->settings.free_memory);
-#endif
     writeData(writer, "[", 1u);
 #if defined(EZJSON_PRETTY)
     indent(writer);
@@ -244,13 +359,8 @@ void EzJSONWriteArrayBegin(struct EzJSONWriter *writer)
 
 void EzJSONWriteArrayEnd(struct EzJSONWriter *writer)
 {
-#if defined(EZJSON_CHECKED_WRITE)
-    if (popArray(writer) != 0)
-    {
-        onError(writer, EZ_WE_WAS_OBJECT);
-        return;
-    }
-#endif
+    CHECK(checkEnd(writer, STACK_BIT_ARRAY, EZ_WC_ARRAY_END));
+    EZJSON_STAT(statsEnd(writer));
 #if defined(EZJSON_PRETTY)
     dedent(writer);
     if (writer->prettyEnabled)
@@ -266,18 +376,10 @@ void EzJSONWriteArrayEnd(struct EzJSONWriter *writer)
 void EzJSONWriteKey(
     struct EzJSONWriter *writer, const char *str, unsigned count)
 {
-#if defined(EZJSON_CHECKED_WRITE)
-    if (stack_empty(&writer->stack)
-        || stack_top(&writer->stack) != STACK_BIT_OBJECT
-        || (writer->writestate & WS_CLOSE) == 0)
-    {
-        onError(writer, EZ_WE_VALUE_EXPECTED);
-        return;
-    }
-    writer->writestate &= ~WS_CLOSE;
-#endif
+    CHECK(checkKey(writer));
     newValue(writer);
     writer->writestate = 0;
+    EZJSON_STAT(writer->stats.stringBytes += count);
     writeData(writer, "\"", 1u);
     writeData(writer, str, count);
     writeData(writer, "\":", 2u);
@@ -292,7 +394,9 @@ void EzJSONWriteKey(
 void EzJSONWriteString(
     struct EzJSONWriter *writer, const char *str, unsigned count)
 {
+    CHECK(checkValue(writer, EZ_WC_STRING));
     newValue(writer);
+    EZJSON_STAT(writer->stats.stringBytes += count);
     writeData(writer, "\"", 1u);
     writeData(writer, str, count);
     writeData(writer, "\"", 1u);
@@ -300,12 +404,13 @@ void EzJSONWriteString(
 
 void EzJSONWriteBool(struct EzJSONWriter *writer, EzJSONBool val)
 {
+    CHECK(checkValue(writer, EZ_WC_BOOL));
     newValue(writer);
     if (val)
     {
         writeData(writer, "true", 4u);
     }
-    else if (val)
+    else
     {
         writeData(writer, "false", 5u);
     }
@@ -313,6 +418,7 @@ void EzJSONWriteBool(struct EzJSONWriter *writer, EzJSONBool val)
 
 void EzJSONWriteNull(struct EzJSONWriter *writer)
 {
+    CHECK(checkValue(writer, EZ_WC_NULL));
     newValue(writer);
     writeData(writer, "null", 4u);
 }
@@ -320,6 +426,7 @@ void EzJSONWriteNull(struct EzJSONWriter *writer)
 void EzJSONWriteNumber(struct EzJSONWriter *writer, EzJSONNumber val)
 {
     char buffer[64];
+    CHECK(checkValue(writer, EZ_WC_NUMBER));
     snprintf(buffer, 64, "%g", val);
 
     newValue(writer);
@@ -329,8 +436,345 @@ void EzJSONWriteNumber(struct EzJSONWriter *writer, EzJSONNumber val)
 void EzJSONWriteNumberL(struct EzJSONWriter *writer, int val)
 {
     char buffer[64];
+    CHECK(checkValue(writer, EZ_WC_NUMBER));
     snprintf(buffer, 64, "%d", val);
 
     newValue(writer);
     writeData(writer, buffer, strlen(buffer));
 }
+
+// Space reserved in the output buffer for one formatted number
+#define NUMBER_SPACE 32u
+
+static unsigned formatInt64(char *out, int64_t value)
+{
+    char digits[20];
+    unsigned count     = 0;
+    unsigned length    = 0;
+    uint64_t magnitude = value < 0 ? 0u - (uint64_t)value : (uint64_t)value;
+
+    do
+    {
+        digits[count++] = (char)('0' + magnitude % 10u);
+        magnitude /= 10u;
+    } while (magnitude > 0);
+
+    if (value < 0)
+    {
+        out[length++] = '-';
+    }
+    while (count > 0)
+    {
+        out[length++] = digits[--count];
+    }
+    return length;
+}
+
+// Use the shorter format when it reads back exactly. Values JSON cannot
+// represent become null.
+static unsigned formatDouble(char *out, double value)
+{
+    if (!isfinite(value))
+    {
+        memcpy(out, "null", 4u);
+        return 4u;
+    }
+
+    int length = snprintf(out, NUMBER_SPACE, "%.15g", value);
+    if (strtod(out, NULL) != value)
+    {
+        length = snprintf(out, NUMBER_SPACE, "%.17g", value);
+    }
+    return (unsigned)length;
+}
+
+static unsigned formatFloat(char *out, float value)
+{
+    if (!isfinite(value))
+    {
+        memcpy(out, "null", 4u);
+        return 4u;
+    }
+
+    int length = snprintf(out, NUMBER_SPACE, "%.6g", value);
+    if ((float)strtod(out, NULL) != value)
+    {
+        length = snprintf(out, NUMBER_SPACE, "%.9g", value);
+    }
+    return (unsigned)length;
+}
+
+// Returns non-zero and reports the error if a value is NaN or infinite
+static int checkFinite(
+    struct EzJSONWriter *writer,
+    enum NumberArrayType type,
+    const void *values,
+    unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if ((type == NUMBERS_DOUBLE && !isfinite(((const double *)values)[i]))
+            || (type == NUMBERS_FLOAT && !isfinite(((const float *)values)[i])))
+        {
+            onError(writer, EZ_WE_NOT_FINITE, EZ_WC_NUMBER_ARRAY);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Formats straight into the output buffer. The layout matches writing the
+// array element by element.
+static void writeNumberArray(
+    struct EzJSONWriter *writer,
+    enum NumberArrayType type,
+    const void *values,
+    unsigned count)
+{
+    if (writer->settings.checked)
+    {
+        if (checkBegin(writer, STACK_BIT_ARRAY, EZ_WC_NUMBER_ARRAY) != 0)
+        {
+            return;
+        }
+        stack_pop(&writer->stack);
+        if (type != NUMBERS_INT64
+            && checkFinite(writer, type, values, count) != 0)
+        {
+            return;
+        }
+    }
+    EZJSON_STAT(statsBegin(writer));
+
+    newValue(writer);
+    writeData(writer, "[", 1u);
+#if defined(EZJSON_PRETTY)
+    indent(writer);
+    if (writer->prettyEnabled)
+    {
+        newLine(writer);
+    }
+#endif
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (i > 0)
+        {
+            writeData(writer, ",", 1u);
+#if defined(EZJSON_PRETTY)
+            if (writer->prettyEnabled)
+            {
+                newLine(writer);
+            }
+#endif
+        }
+
+        if (EZJSON_WRITE_BUFFER_SIZE - writer->bufferPos < NUMBER_SPACE)
+        {
+            flushBuffer(writer);
+        }
+
+        char *out = writer->buffer + writer->bufferPos;
+        switch (type)
+        {
+        case NUMBERS_DOUBLE:
+            writer->bufferPos += formatDouble(out, ((const double *)values)[i]);
+            break;
+        case NUMBERS_FLOAT:
+            writer->bufferPos += formatFloat(out, ((const float *)values)[i]);
+            break;
+        case NUMBERS_INT64:
+            writer->bufferPos += formatInt64(out, ((const int64_t *)values)[i]);
+            break;
+        }
+    }
+
+#if defined(EZJSON_PRETTY)
+    dedent(writer);
+    if (writer->prettyEnabled)
+    {
+        newLine(writer);
+    }
+#endif
+    writeData(writer, "]", 1u);
+    flushBuffer(writer);
+    writer->writestate = WS_COMMA | WS_CLOSE;
+    EZJSON_STAT(writer->stats.tokens += count);
+    EZJSON_STAT(statsEnd(writer));
+}
+
+void EzJSONWriteNumberArray(
+    struct EzJSONWriter *writer, const double *values, unsigned count)
+{
+    writeNumberArray(writer, NUMBERS_DOUBLE, values, count);
+}
+
+void EzJSONWriteNumberArrayF(
+    struct EzJSONWriter *writer, const float *values, unsigned count)
+{
+    writeNumberArray(writer, NUMBERS_FLOAT, values, count);
+}
+
+void EzJSONWriteNumberArrayI64(
+    struct EzJSONWriter *writer, const int64_t *values, unsigned count)
+{
+    writeNumberArray(writer, NUMBERS_INT64, values, count);
+}
+
+void EzJSONWriteNumberD(struct EzJSONWriter *writer, double val)
+{
+    char buffer[NUMBER_SPACE];
+    CHECK(checkValue(writer, EZ_WC_NUMBER));
+    if (writer->settings.checked && !isfinite(val))
+    {
+        onError(writer, EZ_WE_NOT_FINITE, EZ_WC_NUMBER);
+        return;
+    }
+
+    newValue(writer);
+    writeData(writer, buffer, formatDouble(buffer, val));
+}
+
+void EzJSONWriteNumberI64(struct EzJSONWriter *writer, int64_t val)
+{
+    char buffer[NUMBER_SPACE];
+    CHECK(checkValue(writer, EZ_WC_NUMBER));
+
+    newValue(writer);
+    writeData(writer, buffer, formatInt64(buffer, val));
+}
+
+// Write str between quotes, escaping quotes, backslashes and control
+// characters
+static void writeEscaped(
+    struct EzJSONWriter *writer, const char *str, unsigned count)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *end         = str + count;
+
+    writeData(writer, "\"", 1u);
+    for (;;)
+    {
+        const char *stop = scan_string(str, end);
+        writeData(writer, str, (unsigned)(stop - str));
+        if (stop == end)
+        {
+            break;
+        }
+
+        switch (*stop)
+        {
+        case '"':
+            writeData(writer, "\\\"", 2u);
+            break;
+        case '\\':
+            writeData(writer, "\\\\", 2u);
+            break;
+        case '\n':
+            writeData(writer, "\\n", 2u);
+            break;
+        case '\r':
+            writeData(writer, "\\r", 2u);
+            break;
+        case '\t':
+            writeData(writer, "\\t", 2u);
+            break;
+        case '\b':
+            writeData(writer, "\\b", 2u);
+            break;
+        case '\f':
+            writeData(writer, "\\f", 2u);
+            break;
+        default:
+        {
+            const unsigned char c = (unsigned char)*stop;
+            const char escape[6]  = {
+                '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            writeData(writer, escape, 6u);
+            break;
+        }
+        }
+        str = stop + 1;
+    }
+    writeData(writer, "\"", 1u);
+}
+
+void EzJSONWriteEscapedKey(
+    struct EzJSONWriter *writer, const char *str, unsigned count)
+{
+    CHECK(checkKey(writer));
+    newValue(writer);
+    writer->writestate = 0;
+    EZJSON_STAT(writer->stats.stringBytes += count);
+    writeEscaped(writer, str, count);
+    writeData(writer, ":", 1u);
+#if defined(EZJSON_PRETTY)
+    if (writer->prettyEnabled)
+    {
+        writeData(writer, " ", 1u);
+    }
+#endif
+}
+
+void EzJSONWriteEscapedString(
+    struct EzJSONWriter *writer, const char *str, unsigned count)
+{
+    CHECK(checkValue(writer, EZ_WC_STRING));
+    newValue(writer);
+    EZJSON_STAT(writer->stats.stringBytes += count);
+    writeEscaped(writer, str, count);
+}
+
+void EzJSONWriteBase64(
+    struct EzJSONWriter *writer, const void *data, unsigned long count)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    CHECK(checkValue(writer, EZ_WC_BASE64));
+    newValue(writer);
+    EZJSON_STAT(writer->stats.stringBytes += count);
+    writeData(writer, "\"", 1u);
+
+    // Whole groups of 3 bytes go straight into the buffer, 4 characters each
+    unsigned long groups = count / 3;
+    while (groups > 0)
+    {
+        unsigned long room =
+            (EZJSON_WRITE_BUFFER_SIZE - writer->bufferPos) / 4u;
+        if (room == 0)
+        {
+            flushBuffer(writer);
+            continue;
+        }
+
+        room = room < groups ? room : groups;
+        base64_encode(bytes, room, writer->buffer + writer->bufferPos);
+        writer->bufferPos += (unsigned)room * 4u;
+        bytes += room * 3;
+        groups -= room;
+    }
+
+    if (count % 3 != 0)
+    {
+        char tail[4];
+        base64_encode_tail(bytes, (unsigned)(count % 3), tail);
+        writeData(writer, tail, 4u);
+    }
+    writeData(writer, "\"", 1u);
+}
+
+void EzJSONWriteRaw(
+    struct EzJSONWriter *writer, const char *json, unsigned long count)
+{
+    CHECK(checkValue(writer, EZ_WC_RAW));
+    newValue(writer);
+
+    // writeData takes an unsigned count
+    while (count > 0)
+    {
+        const unsigned chunk = count > 0x40000000ul ? 0x40000000u
+                                                    : (unsigned)count;
+        writeData(writer, json, chunk);
+        json += chunk;
+        count -= chunk;
+    }
+}
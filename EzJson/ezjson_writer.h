@@ -16,11 +16,48 @@ extern "C"
 {
 #endif // __cplusplus
 
+    // Zero-initialize before use: checked and max_depth are read by
+    // EzJSONWriterInit whether or not the caller sets them
     struct EzJsonWriterSettings
     {
         void *userdata;
         EzJSONAlloc allocate_memory; // Optional, uses malloc() if not set.
         EzJSONFree free_memory;      // Optional, uses free() if not set
+        EzJSONBool checked;          // Optional, validate structure of every
+                                     // write call and report violations
+                                     // through writeError
+        unsigned max_depth;          // Optional, checked mode only. Maximum
+                                     // nesting, 0 for unlimited
+    };
+
+    enum EzJSONWriteError
+    {
+        EZ_WE_OK,             // Ok
+        EZ_WE_KEY_EXPECTED,   // Expected key, got value
+        EZ_WE_VALUE_EXPECTED, // Expected value, got key
+        EZ_WE_WAS_ARRAY,      // Got EndObject while writing array
+        EZ_WE_WAS_OBJECT,     // Got EndArray while writing object
+        EZ_WE_NOT_OPEN,       // Got EndObject/EndArray at top level
+        EZ_WE_TOO_DEEP,       // Nesting deeper than settings.max_depth
+        EZ_WE_NOT_FINITE,     // NaN or infinity, which JSON cannot represent
+    };
+
+    // Identifies the write call that caused an error in checked mode
+    enum EzJSONWriteCall
+    {
+        EZ_WC_NONE,
+        EZ_WC_OBJECT_BEGIN,
+        EZ_WC_OBJECT_END,
+        EZ_WC_ARRAY_BEGIN,
+        EZ_WC_ARRAY_END,
+        EZ_WC_KEY,
+        EZ_WC_STRING,
+        EZ_WC_BOOL,
+        EZ_WC_NULL,
+        EZ_WC_NUMBER,
+        EZ_WC_NUMBER_ARRAY,
+        EZ_WC_RAW,
+        EZ_WC_BASE64,
     };
 
     struct EzJSONWriter
@@ -32,13 +69,21 @@ extern "C"
 
         enum EzJSONWriteError error;
 
+        // Checked mode only. The call that caused the last error, and its
+        // 1-based position among all write calls made on this writer.
+        enum EzJSONWriteCall errorCall;
+        unsigned long errorCallIndex;
+        unsigned long callCount;
+
         int writestate;
         char buffer[EZJSON_WRITE_BUFFER_SIZE];
         unsigned bufferPos;
 
-#if defined(EZJSON_CHECKED_WRITE)
         struct EzJSONBitStack stack;
-#endif
+
+        // Always present, see EzJSONParser
+        struct EzJSONStats stats;
+        unsigned statsDepth;
 
 #if defined(EZJSON_PRETTY)
         char indentChar;
@@ -48,21 +93,27 @@ extern "C"
 #endif
     };
 
-    enum EzJSONWriteError
-    {
-        EZ_WE_OK,             // Ok
-        EZ_WE_KEY_EXPECTED,   // Expected key, got value
-        EZ_WE_VALUE_EXPECTED, // Expected value, got key
-        EZ_WE_WAS_ARRAY,      // Got EndObject while writing array
-        EZ_WE_WAS_OBJECT,     // Got EndArray while writing object
-    };
-
+    /// Initialize a writer. settings must be zeroed and set before calling,
+    /// writeBuffer and writeError after. Structural checking is enabled per
+    /// writer through settings.checked; when disabled no nesting state is
+    /// tracked at all.
     void EzJSONWriterInit(struct EzJSONWriter *);
     void EzJSONWriterDestroy(struct EzJSONWriter *);
 
+    /// Pass buffered output to writeBuffer. Closing a container flushes, so
+    /// this is only needed after a scalar at the top level.
+    void EzJSONWriterFlush(struct EzJSONWriter *);
+
+    /// Name of a write call, for error reporting
+    const char *EzJSONWriteCallName(enum EzJSONWriteCall call);
+
     void
     EzJSONEnablePrettyPrinting(struct EzJSONWriter *writer, EzJSONBool enabled);
 
+    /// See EzJSONParserGetStats
+    EzJSONBool EzJSONWriterGetStats(struct EzJSONWriter *, struct EzJSONStats *);
+    void EzJSONWriterResetStats(struct EzJSONWriter *);
+
     void EzJSONWriteObjectBegin(struct EzJSONWriter *writer);
     void EzJSONWriteObjectEnd(struct EzJSONWriter *writer);
     void EzJSONWriteArrayBegin(struct EzJSONWriter *writer);
@@ -72,11 +123,46 @@ extern "C"
         struct EzJSONWriter *writer, const char *str, unsigned count);
     void EzJSONWriteString(
         struct EzJSONWriter *writer, const char *str, unsigned count);
+
+    /// EzJSONWriteKey and EzJSONWriteString write str as it is, which must
+    /// already be escaped. These escape quotes, backslashes and control
+    /// characters, e.g. for text decoded by the parser.
+    void EzJSONWriteEscapedKey(
+        struct EzJSONWriter *writer, const char *str, unsigned count);
+    void EzJSONWriteEscapedString(
+        struct EzJSONWriter *writer, const char *str, unsigned count);
+
     void EzJSONWriteBool(struct EzJSONWriter *writer, EzJSONBool val);
     void EzJSONWriteNull(struct EzJSONWriter *writer);
     void EzJSONWriteNumber(struct EzJSONWriter *writer, EzJSONNumber val);
     void EzJSONWriteNumberL(struct EzJSONWriter *writer, int val);
 
+    /// Full precision numbers, doubles with enough digits to read back the
+    /// same value. NaN and infinities are an error in checked mode and are
+    /// written as null otherwise, as are those in the arrays below.
+    void EzJSONWriteNumberD(struct EzJSONWriter *writer, double val);
+    void EzJSONWriteNumberI64(struct EzJSONWriter *writer, int64_t val);
+
+    /// Write a whole array of numbers as one value. Doubles and floats are
+    /// written with enough digits to read back the same value.
+    void EzJSONWriteNumberArray(
+        struct EzJSONWriter *writer, const double *values, unsigned count);
+    void EzJSONWriteNumberArrayF(
+        struct EzJSONWriter *writer, const float *values, unsigned count);
+    void EzJSONWriteNumberArrayI64(
+        struct EzJSONWriter *writer, const int64_t *values, unsigned count);
+
+    /// Write binary data as a base64 string, standard alphabet with
+    /// padding, encoded straight into the output buffer
+    void EzJSONWriteBase64(
+        struct EzJSONWriter *writer, const void *data, unsigned long count);
+
+    /// Write a complete JSON value copied from elsewhere, e.g. a subtree of
+    /// a document in memory. It is written as it is, formatting included,
+    /// and not validated.
+    void EzJSONWriteRaw(
+        struct EzJSONWriter *writer, const char *json, unsigned long count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,15 @@
+#include "ezjson_binary.h"
+#include "ezjson_canonical.h"
+#include "ezjson_compress.h"
+#include "ezjson_diff.h"
+#include "ezjson_document.h"
+#include "ezjson_merge.h"
+#include "ezjson_schema.h"
 #include "ezjson_parser.h"
+#include "ezjson_tape.h"
 #include "ezjson_writer.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -63,9 +72,615 @@ void dump(void *f, const char *d, unsigned c)
     fprintf((FILE *)f, "%.*s", c, d);
 }
 
+char captured[4096];
+unsigned capturedLength;
+
+void capture(void *f, const char *d, unsigned c)
+{
+    memcpy(captured + capturedLength, d, c);
+    capturedLength += c;
+}
+
+char binary[4096];
+unsigned binaryLength;
+
+void binaryWrite(void *f, const char *d, unsigned c)
+{
+    memcpy(binary + binaryLength, d, c);
+    binaryLength += c;
+}
+
+void binaryPatch(void *f, unsigned long offset, const char *d, unsigned c)
+{
+    memcpy(binary + offset, d, c);
+}
+
+void fileWrite(void *f, const char *d, unsigned c)
+{
+    fwrite(d, 1, c, (FILE *)f);
+}
+
+void writeTapeToken(struct EzJSONWriter *writer, struct EzJSONTape *tape)
+{
+    const struct EzJSONToken *token = EzJSONTapeToken(tape);
+    switch (token->type)
+    {
+    case EZJ_TOKEN_OBJ_BEGIN:
+        EzJSONWriteObjectBegin(writer);
+        break;
+    case EZJ_TOKEN_OBJ_END:
+        EzJSONWriteObjectEnd(writer);
+        break;
+    case EZJ_TOKEN_ARR_BEGIN:
+        EzJSONWriteArrayBegin(writer);
+        break;
+    case EZJ_TOKEN_ARR_END:
+        EzJSONWriteArrayEnd(writer);
+        break;
+    case EZJ_TOKEN_OBJ_KEY:
+        EzJSONWriteEscapedKey(
+            writer, token->data_text, token->data_text_length);
+        break;
+    case EZJ_TOKEN_STRING:
+        EzJSONWriteEscapedString(
+            writer, token->data_text, token->data_text_length);
+        break;
+    case EZJ_TOKEN_NUMBER:
+        if (tape->isInteger)
+        {
+            EzJSONWriteNumberI64(writer, tape->integer);
+        }
+        else
+        {
+            EzJSONWriteNumberD(writer, tape->number);
+        }
+        break;
+    case EZJ_TOKEN_BOOL:
+        EzJSONWriteBool(writer, token->data_bool);
+        break;
+    default:
+        EzJSONWriteNull(writer);
+        break;
+    }
+}
+
+// Hands out at most 7 bytes per read, so blocks end mid-token
+struct ChunkSource
+{
+    const char *data;
+    unsigned length;
+    unsigned pos;
+};
+
+unsigned chunkRead(void *d, char *out, unsigned capacity)
+{
+    struct ChunkSource *source = (struct ChunkSource *)d;
+    unsigned count             = source->length - source->pos;
+    count = count < 7 ? count : 7;
+    count = count < capacity ? count : capacity;
+    memcpy(out, source->data + source->pos, count);
+    source->pos += count;
+    return count;
+}
+
+unsigned long countTokens(struct EzJSONParser *parser)
+{
+    unsigned long count = 0;
+    while (EzJSONParserNext(parser), EzJSONParserToken(parser))
+    {
+        count++;
+    }
+    return EzJSONParserHasError(parser) ? 0 : count;
+}
+
+// Append a line describing the current token to a trace
+void traceToken(struct EzJSONParser *parser, char *trace, unsigned *length)
+{
+    const struct EzJSONToken *token = EzJSONParserToken(parser);
+    const char *text                = "";
+    unsigned textLength             = 0;
+    if (token->type == EZJ_TOKEN_STRING || token->type == EZJ_TOKEN_OBJ_KEY)
+    {
+        text       = token->data_text;
+        textLength = token->data_text_length;
+    }
+    else if (token->type == EZJ_TOKEN_NUMBER)
+    {
+        text = EzJSONParserNumberText(parser, &textLength);
+    }
+    else if (token->type == EZJ_TOKEN_BOOL)
+    {
+        text       = token->data_bool ? "t" : "f";
+        textLength = 1;
+    }
+    if (*length + textLength + 3 < 4096)
+    {
+        *length += (unsigned)sprintf(
+            trace + *length, "%d%.*s\n", token->type, textLength, text);
+    }
+}
+
+// Parse json fed chunk bytes at a time, through a scratch buffer that is
+// overwritten after every feed. Returns 0 if the tokens and the outcome
+// match parsing it from memory.
+int feedCase(const char *json, unsigned chunk, unsigned flags)
+{
+    static char expected[4096];
+    static char traced[4096];
+    unsigned expectedLength = 0;
+    unsigned tracedLength   = 0;
+    const unsigned long length = strlen(json);
+    struct EzJSONParser parser;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = json;
+    parser.settings.input_length = length;
+    parser.settings.flags        = flags;
+    EzJSONParserInit(&parser);
+    while (EzJSONParserNext(&parser), EzJSONParserToken(&parser))
+    {
+        traceToken(&parser, expected, &expectedLength);
+    }
+    const struct EzJSONError memoryError = *EzJSONParserError(&parser);
+    EzJSONParserDestroy(&parser);
+
+    char scratch[64];
+    unsigned long pos = 0;
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.flags = flags | EZJ_PARSE_FEED;
+    EzJSONParserInit(&parser);
+    while (1)
+    {
+        EzJSONParserNext(&parser);
+        if (EzJSONParserToken(&parser))
+        {
+            traceToken(&parser, traced, &tracedLength);
+            continue;
+        }
+        if (!EzJSONParserNeedsInput(&parser))
+        {
+            break;
+        }
+
+        memset(scratch, '?', sizeof(scratch));
+        if (pos == length)
+        {
+            EzJSONParserFeedEnd(&parser);
+            continue;
+        }
+        const unsigned count =
+            length - pos < chunk ? (unsigned)(length - pos) : chunk;
+        memcpy(scratch, json + pos, count);
+        EzJSONParserFeed(&parser, scratch, count);
+        pos += count;
+    }
+    const struct EzJSONError *feedError = EzJSONParserError(&parser);
+    const int same = expectedLength == tracedLength
+                     && memcmp(expected, traced, tracedLength) == 0
+                     && memoryError.kind == feedError->kind
+                     && memoryError.offset == feedError->offset
+                     && memoryError.line == feedError->line;
+    EzJSONParserDestroy(&parser);
+    return same ? 0 : -1;
+}
+
+// Read the base64 string in json from memory. Returns what
+// EzJSONParserReadBase64 did, and sets the error kind and bytes decoded.
+int base64String(
+    const char *json,
+    unsigned char *out,
+    unsigned *count,
+    enum EzJSONErrorKind *error)
+{
+    struct EzJSONParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = json;
+    parser.settings.input_length = strlen(json);
+    EzJSONParserInit(&parser);
+    const int result = EzJSONParserReadBase64(&parser, out, 16, count);
+    *error           = EzJSONParserError(&parser)->kind;
+    EzJSONParserDestroy(&parser);
+    return result;
+}
+
+// Write length bytes as base64, in a member and twice in an array, then read
+// them back with an out buffer of capacity bytes, from memory or a character
+// at a time. Returns 0 if the bytes and the tokens around them match.
+int base64Case(unsigned length, unsigned capacity, int streamed)
+{
+    static unsigned char data[3000];
+    static unsigned char decoded[3000];
+    const enum EzJSONTokenType after[] = {
+        EZJ_TOKEN_ARR_END,
+        EZJ_TOKEN_SEQ_SEP,
+        EZJ_TOKEN_OBJ_KEY,
+        EZJ_TOKEN_KV_SEP,
+        EZJ_TOKEN_BOOL,
+        EZJ_TOKEN_OBJ_END,
+    };
+    struct EzJSONWriter writer;
+    struct EzJSONParser parser;
+    struct JSONTester tester;
+    unsigned total = 0;
+    unsigned count;
+    int result;
+
+    for (unsigned i = 0; i < length; ++i)
+    {
+        data[i] = (unsigned char)(i * 131 + length);
+    }
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.checked = 1;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    capturedLength     = 0;
+    EzJSONWriteObjectBegin(&writer);
+    EzJSONWriteKey(&writer, "b", 1);
+    EzJSONWriteBase64(&writer, data, length);
+    EzJSONWriteKey(&writer, "a", 1);
+    EzJSONWriteArrayBegin(&writer);
+    EzJSONWriteBase64(&writer, data, length % 5);
+    EzJSONWriteBase64(&writer, data, length % 7);
+    EzJSONWriteArrayEnd(&writer);
+    EzJSONWriteKey(&writer, "t", 1);
+    EzJSONWriteBool(&writer, 1);
+    EzJSONWriteObjectEnd(&writer);
+    EzJSONWriterDestroy(&writer);
+    captured[capturedLength] = '\0';
+
+    memset(&parser, 0, sizeof(parser));
+    if (streamed)
+    {
+        tester.str                    = captured;
+        tester.pos                    = 0;
+        parser.settings.userdata      = &tester;
+        parser.settings.get_next_char = &testGetChar;
+    }
+    else
+    {
+        parser.settings.input        = captured;
+        parser.settings.input_length = capturedLength;
+    }
+    EzJSONParserInit(&parser);
+    EzJSONParserNext(&parser);
+    EzJSONParserNext(&parser);
+    while ((result = EzJSONParserReadBase64(
+                &parser, decoded + total, capacity, &count))
+           == 1)
+    {
+        total += count;
+    }
+    total += count;
+    int same = result == 0 && total == length
+               && memcmp(decoded, data, length) == 0;
+
+    // A container is left for EzJSONParserNext, the ':' before it is read
+    EzJSONParserNext(&parser);
+    EzJSONParserNext(&parser);
+    same = same && EzJSONParserReadBase64(&parser, decoded, 8, &count) == -1
+           && !EzJSONParserHasError(&parser);
+    EzJSONParserNext(&parser);
+    same = same && EzJSONParserToken(&parser)
+           && EzJSONParserToken(&parser)->type == EZJ_TOKEN_ARR_BEGIN
+           && EzJSONParserReadBase64(&parser, decoded, 8, &count) == 0
+           && count == length % 5
+           && EzJSONParserReadBase64(&parser, decoded, 8, &count) == 0
+           && count == length % 7
+           && memcmp(decoded, data, count) == 0
+           && EzJSONParserReadBase64(&parser, decoded, 8, &count) == -1
+           && !EzJSONParserHasError(&parser);
+    for (unsigned i = 0; same && i < sizeof(after) / sizeof(after[0]); ++i)
+    {
+        EzJSONParserNext(&parser);
+        same = EzJSONParserToken(&parser)
+               && EzJSONParserToken(&parser)->type == after[i];
+    }
+    EzJSONParserNext(&parser);
+    same = same && !EzJSONParserToken(&parser)
+           && !EzJSONParserHasError(&parser);
+    EzJSONParserDestroy(&parser);
+    return same ? 0 : -1;
+}
+
+// Parse json and compare a compact trace with expected: keys end with ':',
+// or with '!' when marked as duplicates, and an error adds '#' and its kind
+int duplicateCase(const char *json, unsigned flags, const char *expected)
+{
+    char trace[256];
+    unsigned length = 0;
+    struct EzJSONParser parser;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = json;
+    parser.settings.input_length = strlen(json);
+    parser.settings.flags        = flags | EZJ_PARSE_SKIP_SEPARATORS;
+    EzJSONParserInit(&parser);
+    while (EzJSONParserNext(&parser), EzJSONParserToken(&parser))
+    {
+        const struct EzJSONToken *token = EzJSONParserToken(&parser);
+        const char *text                = "{}[]";
+        unsigned textLength             = 1;
+        if (token->type == EZJ_TOKEN_OBJ_KEY)
+        {
+            length += (unsigned)snprintf(
+                trace + length,
+                sizeof(trace) - length,
+                "%.*s%c",
+                token->data_text_length,
+                token->data_text,
+                token->data_key_duplicate ? '!' : ':');
+            continue;
+        }
+        else if (token->type == EZJ_TOKEN_STRING)
+        {
+            text       = token->data_text;
+            textLength = token->data_text_length;
+        }
+        else if (token->type == EZJ_TOKEN_NUMBER)
+        {
+            text = EzJSONParserNumberText(&parser, &textLength);
+        }
+        else
+        {
+            text += token->type;
+        }
+        length += (unsigned)snprintf(
+            trace + length, sizeof(trace) - length, "%.*s", textLength, text);
+    }
+    if (EzJSONParserHasError(&parser))
+    {
+        length += (unsigned)snprintf(
+            trace + length,
+            sizeof(trace) - length,
+            "#%d@%lu",
+            EzJSONParserError(&parser)->kind,
+            EzJSONParserError(&parser)->offset);
+    }
+    EzJSONParserDestroy(&parser);
+    if (strcmp(trace, expected) != 0)
+    {
+        printf("Duplicate keys: %s\n", trace);
+        return -1;
+    }
+    return 0;
+}
+
+// Compress json, then decompress it into captured and parse it again.
+// Returns the token count, 0 on error.
+unsigned long
+compressRoundTrip(enum EzJSONCompression format, const char *json)
+{
+    struct EzJSONCompressor compressor;
+    memset(&compressor, 0, sizeof(compressor));
+    compressor.settings.format = format;
+    compressor.settings.write  = &binaryWrite;
+    binaryLength               = 0;
+    if (EzJSONCompressorInit(&compressor) != 0)
+    {
+        return 0;
+    }
+    for (unsigned i = 0; i < strlen(json); i += 100)
+    {
+        const unsigned rest = (unsigned)strlen(json) - i;
+        EzJSONCompressorWrite(&compressor, json + i, rest < 100 ? rest : 100);
+    }
+    const int finished = EzJSONCompressorFinish(&compressor);
+    EzJSONCompressorDestroy(&compressor);
+    if (finished != 0)
+    {
+        return 0;
+    }
+
+    struct ChunkSource source = {binary, binaryLength, 0};
+    struct EzJSONDecompressor decompressor;
+    memset(&decompressor, 0, sizeof(decompressor));
+    decompressor.settings.userdata = &source;
+    decompressor.settings.read     = &chunkRead;
+    EzJSONDecompressorInit(&decompressor);
+    const char *block;
+    unsigned count;
+    capturedLength = 0;
+    while ((count = EzJSONDecompressorNextBlock(&decompressor, &block)) > 0)
+    {
+        capture(NULL, block, count);
+    }
+    const int failed =
+        decompressor.error != EZ_CE_OK || decompressor.format != format;
+    EzJSONDecompressorDestroy(&decompressor);
+    if (failed)
+    {
+        return 0;
+    }
+
+    struct EzJSONParser parser;
+    memset(&parser, 0, sizeof(parser));
+    source.pos = 0;
+    EzJSONDecompressorInit(&decompressor);
+    parser.settings.userdata       = &decompressor;
+    parser.settings.get_next_block = &EzJSONDecompressorNextBlock;
+    EzJSONParserInit(&parser);
+    const unsigned long tokens = countTokens(&parser);
+    EzJSONParserDestroy(&parser);
+    EzJSONDecompressorDestroy(&decompressor);
+    return tokens;
+}
+
+// JSON to the binary format and back, into captured
+int binaryRoundTrip(enum EzJSONBinaryFormat format, const char *json)
+{
+    struct EzJSONParser parser;
+    struct EzJSONBinaryWriter binaryWriter;
+    struct EzJSONBinaryReader reader;
+    struct EzJSONWriter writer;
+    int result = 0;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = json;
+    parser.settings.input_length = strlen(json);
+    EzJSONParserInit(&parser);
+    memset(&binaryWriter, 0, sizeof(binaryWriter));
+    binaryWriter.settings.format = format;
+    EzJSONBinaryWriterInit(&binaryWriter);
+    binaryWriter.writeBuffer = &binaryWrite;
+    binaryWriter.patchBuffer = &binaryPatch;
+    binaryLength             = 0;
+    result |= EzJSONToBinary(&parser, &binaryWriter);
+    EzJSONBinaryWriterDestroy(&binaryWriter);
+    EzJSONParserDestroy(&parser);
+
+    memset(&reader, 0, sizeof(reader));
+    reader.settings.format       = format;
+    reader.settings.input        = binary;
+    reader.settings.input_length = binaryLength;
+    EzJSONBinaryReaderInit(&reader);
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.checked = 1;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    capturedLength     = 0;
+    result |= EzJSONFromBinary(&reader, &writer);
+    EzJSONWriterDestroy(&writer);
+    EzJSONBinaryReaderDestroy(&reader);
+
+    return result;
+}
+
+// Diff two documents into captured. Either is read a character at a time
+// when streamed.
+enum EzJSONDiffError diffCase(const char *from, const char *to, int streamed)
+{
+    struct JSONTester fromTester = {(char *)from, 0};
+    struct JSONTester toTester   = {(char *)to, 0};
+    struct EzJSONParser fromParser;
+    struct EzJSONParser toParser;
+    struct EzJSONWriter writer;
+
+    memset(&fromParser, 0, sizeof(fromParser));
+    memset(&toParser, 0, sizeof(toParser));
+    if (streamed)
+    {
+        fromParser.settings.userdata      = &fromTester;
+        fromParser.settings.get_next_char = &testGetChar;
+        toParser.settings.userdata        = &toTester;
+        toParser.settings.get_next_char   = &testGetChar;
+    }
+    else
+    {
+        fromParser.settings.input        = from;
+        fromParser.settings.input_length = strlen(from);
+        toParser.settings.input          = to;
+        toParser.settings.input_length   = strlen(to);
+    }
+    EzJSONParserInit(&fromParser);
+    EzJSONParserInit(&toParser);
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.checked = 1;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    capturedLength     = 0;
+
+    const enum EzJSONDiffError error =
+        EzJSONDiff(&fromParser, &toParser, &writer);
+
+    EzJSONWriterDestroy(&writer);
+    EzJSONParserDestroy(&toParser);
+    EzJSONParserDestroy(&fromParser);
+    return error;
+}
+
+// Merge patch into source, into captured. The source is read from memory,
+// or a character at a time when streamed.
+enum EzJSONMergeError
+mergeCase(const char *source, const char *patch, int streamed)
+{
+    struct JSONTester tester = {(char *)source, 0};
+    struct EzJSONParser parser;
+    struct EzJSONDocument document;
+    struct EzJSONWriter writer;
+
+    memset(&parser, 0, sizeof(parser));
+    if (streamed)
+    {
+        parser.settings.userdata      = &tester;
+        parser.settings.get_next_char = &testGetChar;
+    }
+    else
+    {
+        parser.settings.input        = source;
+        parser.settings.input_length = strlen(source);
+    }
+    EzJSONParserInit(&parser);
+    memset(&document, 0, sizeof(document));
+    EzJSONDocumentInit(&document, patch, strlen(patch));
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.checked = 1;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    capturedLength     = 0;
+
+    const enum EzJSONMergeError error =
+        EzJSONMergePatch(&parser, EzJSONDocumentRoot(&document), &writer);
+    if (writer.error != EZ_WE_OK)
+    {
+        printf("Merge produced invalid output\n");
+    }
+
+    EzJSONWriterDestroy(&writer);
+    EzJSONDocumentDestroy(&document);
+    EzJSONParserDestroy(&parser);
+    return error;
+}
+
+// Validate json against schema, read from memory or a character at a time
+// when streamed
+enum EzJSONSchemaViolation validateCase(
+    const struct EzJSONSchema *schema, const char *json, int streamed)
+{
+    struct JSONTester tester = {(char *)json, 0};
+    struct EzJSONParser parser;
+    struct EzJSONValidator validator;
+
+    memset(&parser, 0, sizeof(parser));
+    if (streamed)
+    {
+        parser.settings.userdata      = &tester;
+        parser.settings.get_next_char = &testGetChar;
+    }
+    else
+    {
+        parser.settings.input        = json;
+        parser.settings.input_length = strlen(json);
+    }
+    EzJSONParserInit(&parser);
+    EzJSONValidatorInit(&validator, schema);
+
+    const enum EzJSONSchemaViolation violation =
+        EzJSONValidatorRun(&validator, &parser);
+
+    EzJSONValidatorDestroy(&validator);
+    EzJSONParserDestroy(&parser);
+    return violation;
+}
+
+// Compile a schema from text, returns the error
+enum EzJSONSchemaError
+compileCase(struct EzJSONSchema *schema, const char *text)
+{
+    struct EzJSONDocument document;
+    memset(&document, 0, sizeof(document));
+    EzJSONDocumentInit(&document, text, strlen(text));
+    const enum EzJSONSchemaError error =
+        EzJSONSchemaCompile(schema, EzJSONDocumentRoot(&document));
+    EzJSONDocumentDestroy(&document);
+    return error;
+}
+
 void writeError(struct EzJSONWriter *writer)
 {
-    printf("Error while writing checked data\n");
+    printf(
+        "Error while writing checked data: %s (call %lu)\n",
+        EzJSONWriteCallName(writer->errorCall),
+        writer->errorCallIndex);
 }
 
 int main()
@@ -78,6 +693,7 @@ int main()
                "}";
 
     struct EzJSONParser parser;
+    memset(&parser, 0, sizeof(parser));
 
     parser.settings.allocate_memory = 0;
     parser.settings.free_memory     = 0;
@@ -88,7 +704,7 @@ int main()
     EzJSONParserNext(&parser);
 
     struct EzJSONToken *token;
-    while (token = EzJSONParserToken(&parser))
+    while ((token = EzJSONParserToken(&parser)))
     {
         switch (token->type)
         {
@@ -132,10 +748,1072 @@ int main()
 
     EzJSONParserDestroy(&parser);
 
+    if (EzJSONParserHasError(&parser))
+    {
+        printf("Unexpected parse error\n");
+        return 1;
+    }
+
+    // Error reporting
+    test.pos = 0;
+    test.str = "{\n"
+               "  \"a\": [1, 2,]\n"
+               "}";
+
+    EzJSONParserInit(&parser);
+    while (EzJSONParserNext(&parser), EzJSONParserToken(&parser))
+    {
+    }
+
+    const struct EzJSONError *parseError = EzJSONParserError(&parser);
+    printf(
+        "%s at line %u, column %u (offset %lu)\n",
+        EzJSONErrorKindName(parseError->kind),
+        parseError->line,
+        parseError->column,
+        parseError->offset);
+    if (parseError->kind != EZ_PE_UNEXPECTED_CHAR || parseError->line != 2
+        || parseError->column != 14)
+    {
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Nesting limit
+    test.pos                  = 0;
+    test.str                  = "[[{\"a\": [1]}]]";
+    parser.settings.max_depth = 3;
+
+    EzJSONParserInit(&parser);
+    while (EzJSONParserNext(&parser), EzJSONParserToken(&parser))
+    {
+    }
+
+    printf(
+        "%s at column %u\n",
+        EzJSONErrorKindName(parseError->kind),
+        parseError->column);
+    if (parseError->kind != EZ_PE_DEPTH_EXCEEDED || parseError->column != 9)
+    {
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+    parser.settings.max_depth = 0;
+
+    // Escapes and UTF-8 validation, parsing from memory
+    const char *unicode = "[\"caf\\u00e9 \\ud83d\\ude00\", \"\xc3\x28\"]";
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = unicode;
+    parser.settings.input_length = strlen(unicode);
+    parser.settings.flags        = EZJ_PARSE_VALIDATE_UTF8;
+
+    EzJSONParserInit(&parser);
+    EzJSONParserNext(&parser);
+    EzJSONParserNext(&parser);
+    token = EzJSONParserToken(&parser);
+    if (!token || token->data_text_length != 10
+        || memcmp(token->data_text, "caf\xc3\xa9 \xf0\x9f\x98\x80", 10) != 0)
+    {
+        printf("Unicode escapes not decoded\n");
+        return 1;
+    }
+
+    while (EzJSONParserNext(&parser), EzJSONParserToken(&parser))
+    {
+    }
+    printf(
+        "%s at column %u\n",
+        EzJSONErrorKindName(parseError->kind),
+        parseError->column);
+    if (parseError->kind != EZ_PE_INVALID_UTF8 || parseError->column != 30)
+    {
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Separators checked but not returned
+    const char *separated = "{\"a\": [1, {}], \"b\" : null}";
+    const enum EzJSONTokenType expectedTypes[] = {
+        EZJ_TOKEN_OBJ_BEGIN,
+        EZJ_TOKEN_OBJ_KEY,
+        EZJ_TOKEN_ARR_BEGIN,
+        EZJ_TOKEN_NUMBER,
+        EZJ_TOKEN_OBJ_BEGIN,
+        EZJ_TOKEN_OBJ_END,
+        EZJ_TOKEN_ARR_END,
+        EZJ_TOKEN_OBJ_KEY,
+        EZJ_TOKEN_NULL,
+        EZJ_TOKEN_OBJ_END,
+    };
+    unsigned tokenCount = 0;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = separated;
+    parser.settings.input_length = strlen(separated);
+    parser.settings.flags        = EZJ_PARSE_SKIP_SEPARATORS;
+    EzJSONParserInit(&parser);
+    while (EzJSONParserNext(&parser), (token = EzJSONParserToken(&parser)))
+    {
+        if (tokenCount == 10 || token->type != expectedTypes[tokenCount++])
+        {
+            printf("Unexpected token without separators\n");
+            return 1;
+        }
+    }
+    if (tokenCount != 10 || EzJSONParserHasError(&parser))
+    {
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Trailing separators are still errors
+    const char *trailing = "[1,]";
+    parser.settings.input        = trailing;
+    parser.settings.input_length = strlen(trailing);
+    EzJSONParserInit(&parser);
+    while (EzJSONParserNext(&parser), EzJSONParserToken(&parser))
+    {
+    }
+    if (parseError->kind != EZ_PE_UNEXPECTED_CHAR || parseError->column != 4)
+    {
+        printf("Trailing separator accepted\n");
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Batches keep every string of the batch, past buffer growth
+    const char *batched = "[\"first string in the batch\", 1,"
+                          " {\"a key long enough to grow the buffer\":"
+                          " \"and a value that is long enough as well\"},"
+                          " \"last\"]";
+    struct EzJSONToken batch[16];
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = batched;
+    parser.settings.input_length = strlen(batched);
+    parser.settings.flags        = EZJ_PARSE_SKIP_SEPARATORS;
+    EzJSONParserInit(&parser);
+    if (EzJSONParserNextBatch(&parser, batch, 6) != 6
+        || batch[1].data_text_length != 25
+        || memcmp(batch[1].data_text, "first string in the batch", 25) != 0
+        || batch[4].type != EZJ_TOKEN_OBJ_KEY
+        || memcmp(batch[4].data_text, "a key long", 10) != 0
+        || memcmp(batch[5].data_text, "and a value", 11) != 0
+        || EzJSONParserNextBatch(&parser, batch, 16) != 3
+        || memcmp(batch[1].data_text, "last", 4) != 0
+        || batch[2].type != EZJ_TOKEN_ARR_END)
+    {
+        printf("Batch tokens not preserved\n");
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Typed number arrays, read in two parts from memory
+    const char *numbers = "[1, -2.5, 3e2 ,0.1, 12345678901234567890e-3]";
+    double doubles[3];
+    unsigned count;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = numbers;
+    parser.settings.input_length = strlen(numbers);
+    EzJSONParserInit(&parser);
+    EzJSONParserNext(&parser);
+    if (EzJSONParserReadNumberArray(&parser, doubles, 3, &count) != 1
+        || count != 3 || doubles[1] != -2.5 || doubles[2] != 300.0
+        || EzJSONParserReadNumberArray(&parser, doubles, 3, &count) != 0
+        || count != 2 || doubles[0] != 0.1
+        || doubles[1] != 12345678901234567.890
+        || EzJSONParserToken(&parser)->type != EZJ_TOKEN_ARR_END)
+    {
+        printf("Number array not read\n");
+        return 1;
+    }
+    EzJSONParserNext(&parser);
+    if (EzJSONParserToken(&parser) || EzJSONParserHasError(&parser))
+    {
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Integers, from the character callback
+    int64_t integers[4];
+    test.pos = 0;
+    test.str = "[9223372036854775807, -9223372036854775808, 0, 1.5]";
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.get_next_char = &testGetChar;
+    parser.settings.userdata      = &test;
+    EzJSONParserInit(&parser);
+    EzJSONParserNext(&parser);
+    if (EzJSONParserReadNumberArrayI64(&parser, integers, 4, &count) != -1
+        || count != 3 || integers[0] != INT64_MAX || integers[1] != INT64_MIN
+        || parseError->kind != EZ_PE_INVALID_NUMBER)
+    {
+        printf("Integer array not read\n");
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Canonical form: sorted members, normalized numbers and escapes
+    const char *loose =
+        "{\"b\": [1.0, 1e2, -0, 0.1, 1e300, 1E-7, \"\\u00e9\\n\\u0001\\\"\","
+        " {\"b\":2,\"a\":1}], \"a\": {\"z\": null, \"y\": true}, \"\": 2.50}";
+    const char *canonical =
+        "{\"\":2.5,\"a\":{\"y\":true,\"z\":null},\"b\":[1,100,0,0.1,1e+300,"
+        "1e-7,\"\xc3\xa9\\n\\u0001\\\"\",{\"a\":1,\"b\":2}]}";
+    struct EzJSONHash hash;
+    for (int hashed = 0; hashed < 2; ++hashed)
+    {
+        memset(&parser, 0, sizeof(parser));
+        parser.settings.input        = loose;
+        parser.settings.input_length = strlen(loose);
+        EzJSONParserInit(&parser);
+        EzJSONHashInit(&hash, 0);
+        capturedLength = 0;
+        const enum EzJSONCanonicalError canonicalError = EzJSONCanonicalWrite(
+            &parser,
+            hashed ? &EzJSONHashUpdate : &capture,
+            hashed ? (void *)&hash : NULL);
+        EzJSONParserDestroy(&parser);
+        if (canonicalError != EZ_CN_OK
+            || (!hashed
+                && (capturedLength != strlen(canonical)
+                    || memcmp(captured, canonical, capturedLength) != 0))
+            || (hashed && EzJSONHashDigest(&hash) != 0x26d42a0750a2326bull))
+        {
+            printf("Canonical form failed: %.*s\n", capturedLength, captured);
+            return 1;
+        }
+    }
+
+    // Integers spelled with a fraction or exponent above 2^53 stay exact
+    const char *spellings[] = {
+        "[1e16,1.0e18,9007199254740993.0,-1.50e1,0.0e5,1e19]",
+        "[10000000000000000,1000000000000000000,9007199254740993,-15,0,"
+        "1e19]",
+    };
+    const char *canonicalIntegers = "[10000000000000000,1000000000000000000,"
+                                    "9007199254740993,-15,0,1e+19]";
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        memset(&parser, 0, sizeof(parser));
+        parser.settings.input        = spellings[i];
+        parser.settings.input_length = strlen(spellings[i]);
+        EzJSONParserInit(&parser);
+        capturedLength = 0;
+        const enum EzJSONCanonicalError canonicalError =
+            EzJSONCanonicalWrite(&parser, &capture, NULL);
+        EzJSONParserDestroy(&parser);
+        if (canonicalError != EZ_CN_OK
+            || capturedLength != strlen(canonicalIntegers)
+            || memcmp(captured, canonicalIntegers, capturedLength) != 0)
+        {
+            printf(
+                "Canonical integers failed: %.*s\n",
+                capturedLength,
+                captured);
+            return 1;
+        }
+    }
+
+    // XXH64 does not depend on how the input is split
+    char hashInput[100];
+    for (unsigned i = 0; i < sizeof(hashInput); ++i)
+    {
+        hashInput[i] = (char)i;
+    }
+    EzJSONHashInit(&hash, 7);
+    for (unsigned i = 0, step = 1; i < sizeof(hashInput); i += step++)
+    {
+        const unsigned left = (unsigned)sizeof(hashInput) - i;
+        EzJSONHashUpdate(&hash, hashInput + i, step < left ? step : left);
+    }
+    if (EzJSONHashDigest(&hash) != 0x80653e7e9b887cddull)
+    {
+        printf("Wrong XXH64 digest\n");
+        return 1;
+    }
+
+    // Diffs: arrays element by element, reordered members looked up by key
+    const char *diffs[][3] = {
+        {"{\"a\":1,\"b\":{\"c\":[1,2,3],\"d\":\"x\"},\"e\":true,"
+         "\"same\":{\"k\":[1,{\"z\":null}]}}",
+         "{\"a\":2.0,\"b\":{\"c\":[1,5],\"d\":\"x\",\"n\":null},"
+         "\"same\":{\"k\":[1,{\"z\":null}]},\"f\":[1]}",
+         "[{\"op\":\"replace\",\"path\":\"/a\",\"value\":2.0},"
+         "{\"op\":\"replace\",\"path\":\"/b/c/1\",\"value\":5},"
+         "{\"op\":\"remove\",\"path\":\"/b/c/2\"},"
+         "{\"op\":\"add\",\"path\":\"/b/n\",\"value\":null},"
+         "{\"op\":\"add\",\"path\":\"/f\",\"value\":[1]},"
+         "{\"op\":\"remove\",\"path\":\"/e\"}]"},
+        {"{\"a/b~\":[1],\"x\":1e2}", "{\"x\":100,\"a/b~\":[1,{}]}",
+         "[{\"op\":\"add\",\"path\":\"/a~1b~0/1\",\"value\":{}}]"},
+        {"[true]", "{\"a\":\"\\u0041\"}",
+         "[{\"op\":\"replace\",\"path\":\"\",\"value\":{\"a\":\"A\"}}]"},
+    };
+    for (unsigned i = 0; i < sizeof(diffs) / sizeof(diffs[0]); ++i)
+    {
+        for (int streamed = 0; streamed < 2; ++streamed)
+        {
+            // Containers are copied as they are from memory
+            const char *expected = diffs[i][2];
+            if (!streamed && i == 2)
+            {
+                expected = "[{\"op\":\"replace\",\"path\":\"\","
+                           "\"value\":{\"a\":\"\\u0041\"}}]";
+            }
+            if (diffCase(diffs[i][0], diffs[i][1], streamed) != EZ_DE_OK
+                || capturedLength != strlen(expected)
+                || memcmp(captured, expected, capturedLength) != 0)
+            {
+                printf("Diff %u failed: %.*s\n", i, capturedLength, captured);
+                return 1;
+            }
+        }
+    }
+    if (diffCase("[1,2", "[1,2]", 0) != EZ_DE_FROM
+        || diffCase("[1]", "[1] x", 1) != EZ_DE_TO
+        || diffCase("{\"a\":1}", "{\"a\":1,\"b\":[1,,2]}", 0) != EZ_DE_TO
+        || diffCase("{\"a\":1}", "{\"a\":1,\"b\":[1,,2]}", 1) != EZ_DE_TO)
+    {
+        printf("Diff errors not reported\n");
+        return 1;
+    }
+
+    // Containers are skipped whole over raw control characters in strings
+    const char *rawSkip = "[{\"k\":\"\x01}\"},2]";
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = rawSkip;
+    parser.settings.input_length = strlen(rawSkip);
+    parser.settings.flags        = EZJ_PARSE_SKIP_SEPARATORS;
+    EzJSONParserInit(&parser);
+    EzJSONParserNext(&parser);
+    EzJSONParserNext(&parser);
+    const int skipped = EzJSONParserSkip(&parser);
+    EzJSONParserNext(&parser);
+    if (skipped != 0 || !EzJSONParserToken(&parser)
+        || EzJSONParserToken(&parser)->type != EZJ_TOKEN_NUMBER)
+    {
+        printf("Raw control characters not skipped\n");
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Merge patches, from RFC 7386 and with subtrees passed through
+    const char *merges[][3] = {
+        {"{\"a\":\"b\",\"c\":{\"d\":\"e\",\"f\":\"g\"}}",
+         "{\"a\":\"z\",\"c\":{\"f\":null}}",
+         "{\"a\":\"z\",\"c\":{\"d\":\"e\"}}"},
+        {"{\"a\":[{\"b\":\"c\"}]}",
+         "{\"a\":[1]}",
+         "{\"a\":[1]}"},
+        {"[\"a\",\"b\"]", "[\"c\",\"d\"]", "[\"c\",\"d\"]"},
+        {"{\"a\":\"foo\"}", "null", "null"},
+        {"{\"e\":null}", "{\"a\":1}", "{\"e\":null,\"a\":1}"},
+        {"[1,2]", "{\"a\":\"b\",\"c\":null}", "{\"a\":\"b\"}"},
+        {"{}", "{\"a\":{\"bb\":{\"ccc\":null}}}",
+         "{\"a\":{\"bb\":{}}}"},
+        {"{\"keep\": [1.50, {\"x\": \"\\u0041\"}], \"n\": 1e3, \"t\": 1}",
+         "{\"t\":[true],\"n\":null,\"add\":{\"x\":null,\"y\":2}}",
+         "{\"keep\":[1.50, {\"x\": \"\\u0041\"}],\"t\":[true],"
+         "\"add\":{\"y\":2}}"},
+    };
+    for (unsigned i = 0; i < sizeof(merges) / sizeof(merges[0]); ++i)
+    {
+        for (int streamed = 0; streamed < 2; ++streamed)
+        {
+            const char *expected = merges[i][2];
+            // Streamed sources are written token by token
+            if (streamed && i == 7)
+            {
+                expected = "{\"keep\":[1.50,{\"x\":\"A\"}],\"t\":[true],"
+                           "\"add\":{\"y\":2}}";
+            }
+            if (mergeCase(merges[i][0], merges[i][1], streamed) != EZ_ME_OK
+                || capturedLength != strlen(expected)
+                || memcmp(captured, expected, capturedLength) != 0)
+            {
+                printf(
+                    "Merge patch %u failed: %.*s\n",
+                    i,
+                    capturedLength,
+                    captured);
+                return 1;
+            }
+        }
+    }
+    if (mergeCase("{\"a\":[1,}", "{\"b\":1}", 0) != EZ_ME_SOURCE
+        || mergeCase("{\"a\":1}", "{\"a\" 2}", 0) != EZ_ME_PATCH)
+    {
+        printf("Merge patch errors not reported\n");
+        return 1;
+    }
+
+    // Schema validation, stopping at the first violation
+    struct EzJSONSchema schema;
+    if (compileCase(
+            &schema,
+            "{\"type\":\"object\",\"required\":[\"id\",\"name\"],"
+            "\"additionalProperties\":false,\"title\":\"ignored\","
+            "\"properties\":{\"id\":{\"type\":\"integer\",\"minimum\":1},"
+            "\"name\":{\"type\":\"string\",\"minLength\":1,\"maxLength\":3},"
+            "\"tags\":{\"items\":{\"enum\":[\"a\",\"b\",null]},"
+            "\"type\":\"array\",\"maxItems\":2},"
+            "\"score\":{\"type\":[\"number\",\"null\"],"
+            "\"exclusiveMaximum\":10},\"extra\":true}}")
+        != EZ_SE_OK)
+    {
+        printf("Schema failed to compile\n");
+        return 1;
+    }
+    const struct
+    {
+        const char *json;
+        enum EzJSONSchemaViolation violation;
+    } validations[] = {
+        {"{\"id\":3,\"name\":\"\\u00e9t\\u00e9\",\"tags\":[\"a\",null],"
+         "\"score\":9.5,\"extra\":{\"x\":[]}}",
+         EZ_SV_NONE},
+        {"{\"name\":\"x\",\"id\":1.0,\"score\":null}", EZ_SV_NONE},
+        {"{\"id\":1.5,\"name\":\"x\"}", EZ_SV_TYPE},
+        {"{\"id\":0,\"name\":\"x\"}", EZ_SV_MINIMUM},
+        {"{\"id\":1,\"name\":\"\"}", EZ_SV_MIN_LENGTH},
+        {"{\"id\":1,\"name\":\"abcd\"}", EZ_SV_MAX_LENGTH},
+        {"{\"id\":1,\"name\":\"x\",\"tags\":[\"c\"]}", EZ_SV_ENUM},
+        {"{\"id\":1,\"name\":\"x\",\"tags\":[\"a\",\"b\",\"a\"]}",
+         EZ_SV_MAX_ITEMS},
+        {"{\"id\":1,\"name\":\"x\",\"score\":10}", EZ_SV_MAXIMUM},
+        {"{\"id\":1}", EZ_SV_REQUIRED},
+        {"[]", EZ_SV_TYPE},
+        // Rejected before the parse error is reached
+        {"{\"id\":1,\"other\":1 garbage", EZ_SV_ADDITIONAL},
+        {"{\"id\":1,\"name\":\"x\"", EZ_SV_PARSE},
+    };
+    for (unsigned i = 0; i < sizeof(validations) / sizeof(validations[0]);
+         ++i)
+    {
+        for (int streamed = 0; streamed < 2; ++streamed)
+        {
+            const enum EzJSONSchemaViolation violation =
+                validateCase(&schema, validations[i].json, streamed);
+            if (violation != validations[i].violation)
+            {
+                printf(
+                    "Validation %u: %s\n",
+                    i,
+                    EzJSONSchemaViolationName(violation));
+                return 1;
+            }
+        }
+    }
+    EzJSONSchemaDestroy(&schema);
+
+    // Draft 4 boolean exclusive bounds, in either member order
+    const char *exclusiveBounds[] = {
+        "{\"exclusiveMinimum\":true,\"minimum\":5}",
+        "{\"minimum\":5,\"exclusiveMinimum\":true}",
+        "{\"exclusiveMaximum\":true,\"maximum\":5}",
+        "{\"maximum\":5,\"exclusiveMaximum\":true}",
+    };
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        const enum EzJSONSchemaViolation bound =
+            i < 2 ? EZ_SV_MINIMUM : EZ_SV_MAXIMUM;
+        if (compileCase(&schema, exclusiveBounds[i]) != EZ_SE_OK
+            || validateCase(&schema, "5", 0) != bound
+            || validateCase(&schema, i < 2 ? "6" : "4", 0) != EZ_SV_NONE)
+        {
+            printf("Exclusive bound %u failed\n", i);
+            return 1;
+        }
+        EzJSONSchemaDestroy(&schema);
+    }
+
+    // Integer bounds and values beyond 2^53 are compared exactly
+    const struct
+    {
+        const char *schema;
+        const char *value;
+        enum EzJSONSchemaViolation violation;
+    } integerBounds[] = {
+        {"{\"maximum\":9007199254740992}",
+         "9007199254740993",
+         EZ_SV_MAXIMUM},
+        {"{\"maximum\":9007199254740992}", "9007199254740992", EZ_SV_NONE},
+        {"{\"maximum\":-9223372036854775808}",
+         "-9223372036854775807",
+         EZ_SV_MAXIMUM},
+        {"{\"exclusiveMinimum\":9007199254740992}",
+         "9007199254740993",
+         EZ_SV_NONE},
+        {"{\"minimum\":9007199254740993,"
+         "\"exclusiveMinimum\":9007199254740992}",
+         "9007199254740993",
+         EZ_SV_NONE},
+        {"{\"minimum\":0.5}", "1", EZ_SV_NONE},
+    };
+    for (unsigned i = 0; i < sizeof(integerBounds) / sizeof(integerBounds[0]);
+         ++i)
+    {
+        if (compileCase(&schema, integerBounds[i].schema) != EZ_SE_OK
+            || validateCase(&schema, integerBounds[i].value, 0)
+                   != integerBounds[i].violation)
+        {
+            printf("Integer bound %u failed\n", i);
+            return 1;
+        }
+        EzJSONSchemaDestroy(&schema);
+    }
+    if (compileCase(&schema, "{\"anyOf\":[]}") != EZ_SE_UNSUPPORTED
+        || compileCase(&schema, "{\"enum\":[[1]]}") != EZ_SE_UNSUPPORTED
+        || compileCase(&schema, "{\"type\":\"text\"}") != EZ_SE_MALFORMED
+        || compileCase(&schema, "{\"minItems\":-1}") != EZ_SE_MALFORMED)
+    {
+        printf("Schema errors not reported\n");
+        return 1;
+    }
+    EzJSONSchemaDestroy(&schema);
+
+    // Fed input, cut at every position
+    const char *feeds[] = {
+        "{\"key\\u00e9\": [1.5e3, -0, true, null, \"a\\\"b\\\\\\ud83d\\ude00"
+        "long enough to span several chunks\"],\n \"k2\" : {\"x\":false}} ",
+        "[1, 2, 3e]",
+        "[\"cut",
+        "{\"a\":1} x",
+        "{\"a\":{\"a\":[1,{\"a\":2,\"a\":3}],\"a\":\"dropped, long enough to"
+        " be cut\"},\"a\":3,\"b\":[], \"a\":{}}",
+    };
+    for (unsigned i = 0; i < sizeof(feeds) / sizeof(feeds[0]); ++i)
+    {
+        for (unsigned chunk = 1; chunk <= 17; ++chunk)
+        {
+            if (feedCase(feeds[i], chunk, 0) != 0
+                || feedCase(
+                       feeds[i],
+                       chunk,
+                       EZJ_PARSE_SKIP_SEPARATORS | EZJ_PARSE_INTERN_KEYS
+                           | EZJ_PARSE_VALIDATE_UTF8)
+                       != 0
+                || feedCase(feeds[i], chunk, EZJ_PARSE_FIRST_KEY_WINS) != 0)
+            {
+                printf("Feed %u in chunks of %u failed\n", i, chunk);
+                return 1;
+            }
+        }
+    }
+
+    // Base64 written and read back in place, whole and in small parts
+    const unsigned base64Lengths[] = {0, 1, 2, 3, 4, 5, 47, 48, 100, 2500};
+    for (unsigned i = 0; i < sizeof(base64Lengths) / sizeof(unsigned); ++i)
+    {
+        const unsigned length = base64Lengths[i];
+        if (base64Case(length, 3000, 0) != 0 || base64Case(length, 7, 0) != 0
+            || (length < 200 && base64Case(length, 3000, 1) != 0)
+            || (length < 200 && base64Case(length, 3, 1) != 0))
+        {
+            printf("Base64 of %u bytes\n", length);
+            return 1;
+        }
+    }
+    const char *base64Valid[] = {
+        "\"QUJD\"", "\"QUI=\"", "\"QQ==\"", "\"QUI\"", "\"P\\/8\""};
+    const char *base64Invalid[] = {
+        "\"QQ=\"", "\"Q\"", "\"QUJD=\"", "\"QQ==QQ\"", "\"QU J\"",
+        "\"QU\\nJ\"", "\"QUJ", "\"QUJ=\"", "\"QUJ\"", "\"QR==\""};
+    unsigned char bytes[16];
+    unsigned byteCount;
+    enum EzJSONErrorKind base64Error;
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        if (base64String(base64Valid[i], bytes, &byteCount, &base64Error) != 0
+            || byteCount != (i == 0 ? 3u : i == 2 ? 1u : 2u)
+            || memcmp(bytes, i == 4 ? "?\xFF" : "ABC", i == 4 ? 2 : byteCount)
+                   != 0)
+        {
+            printf("Base64 %s not decoded\n", base64Valid[i]);
+            return 1;
+        }
+    }
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        if (base64String(base64Invalid[i], bytes, &byteCount, &base64Error)
+                != -1
+            || base64Error
+                   != (i == 6 ? EZ_PE_UNEXPECTED_EOF : EZ_PE_INVALID_BASE64))
+        {
+            printf("Base64 %s not rejected\n", base64Invalid[i]);
+            return 1;
+        }
+    }
+
+    // Duplicate keys, per object, with each policy
+    const char *repeated = "{\"a\":1,\"b\":{\"a\":[{\"a\":0}],\"a\":2,\"b\":3},"
+                           "\"a\":{\"a\":4,\"a\":5},\"c\":6}";
+    if (duplicateCase(
+            repeated,
+            EZJ_PARSE_MARK_DUPLICATE_KEYS,
+            "{a:1b:{a:[{a:0}]a!2b:3}a!{a:4a!5}c:6}")
+            != 0
+        || duplicateCase(
+               repeated, EZJ_PARSE_FIRST_KEY_WINS, "{a:1b:{a:[{a:0}]b:3}c:6}")
+               != 0
+        || duplicateCase(
+               repeated,
+               EZJ_PARSE_REJECT_DUPLICATE_KEYS,
+               "{a:1b:{a:[{a:0}]#9@28")
+               != 0
+        || duplicateCase(repeated, 0, "{a:1b:{a:[{a:0}]a:2b:3}a:{a:4a:5}c:6}")
+               != 0)
+    {
+        return 1;
+    }
+
+    // Large objects switch to a hash table, then grow it
+    char wide[2048];
+    unsigned wideLength = (unsigned)sprintf(wide, "{");
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        wideLength += (unsigned)sprintf(wide + wideLength, "\"k%u\":%u,", i, i);
+    }
+    sprintf(wide + wideLength, "\"k97\":[{\"k97\":1}],\"k100\":0}");
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = wide;
+    parser.settings.input_length = strlen(wide);
+    parser.settings.flags        = EZJ_PARSE_FIRST_KEY_WINS;
+    EzJSONParserInit(&parser);
+    if (countTokens(&parser) != 204)
+    {
+        printf("Repeated key not dropped\n");
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = wide;
+    parser.settings.input_length = strlen(wide);
+    parser.settings.flags        = EZJ_PARSE_REJECT_DUPLICATE_KEYS;
+    EzJSONParserInit(&parser);
+    if (countTokens(&parser) != 0
+        || EzJSONParserError(&parser)->kind != EZ_PE_DUPLICATE_KEY
+        || EzJSONParserError(&parser)->offset != wideLength + 4
+        || duplicateCase(
+               "{\"\":1,\"\":2}", EZJ_PARSE_REJECT_DUPLICATE_KEYS, "{:1#9@7")
+               != 0)
+    {
+        printf("Repeated key not rejected\n");
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // Interned keys, one id and one copy per distinct key
+    const char *records = "[{\"id\":1,\"name\":\"a\"},"
+                          "{\"id\":2,\"name\":\"b\"},"
+                          "{\"name\":\"c\",\"id\":3}]";
+    const uint32_t expectedIds[] = {1, 0, 1, 0, 0, 1};
+    const char *keyTexts[2]      = {NULL, NULL};
+    uint32_t nameId;
+    unsigned keys = 0;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = records;
+    parser.settings.input_length = strlen(records);
+    parser.settings.flags = EZJ_PARSE_SKIP_SEPARATORS | EZJ_PARSE_INTERN_KEYS;
+    EzJSONParserInit(&parser);
+    if (EzJSONParserInternKey(&parser, "name", 4, &nameId) != 0 || nameId != 0)
+    {
+        return 1;
+    }
+    for (EzJSONParserNext(&parser); EzJSONParserToken(&parser);
+         EzJSONParserNext(&parser))
+    {
+        const struct EzJSONToken *token = EzJSONParserToken(&parser);
+        if (token->type != EZJ_TOKEN_OBJ_KEY)
+        {
+            continue;
+        }
+        const uint32_t id = token->data_key_id;
+        if (keys == 6 || id != expectedIds[keys++]
+            || (keyTexts[id] && keyTexts[id] != token->data_text))
+        {
+            printf("Wrong key id %u\n", (unsigned)id);
+            return 1;
+        }
+        keyTexts[id] = token->data_text;
+    }
+    if (keys != 6 || EzJSONParserHasError(&parser)
+        || EzJSONParserKeyCount(&parser) != 2
+        || strcmp(EzJSONParserKeyText(&parser, 1, NULL), "id") != 0)
+    {
+        printf("Keys not interned\n");
+        return 1;
+    }
+    EzJSONParserDestroy(&parser);
+
+    // On-demand access, later lookups come from the key cache
+    const char *lazy = "{\"skip\": {\"x\": [1, \"]}\", {}]}, \"n\\u0061me\": \"ez\","
+                       " \"id\": 12345678901234567890, \"list\": [true, -0.5],"
+                       " \"skip\": 0}";
+    struct EzJSONDocument document;
+    struct EzJSONValue value;
+    struct EzJSONValue element;
+    char name[8];
+    double real;
+    EzJSONBool flag;
+
+    memset(&document, 0, sizeof(document));
+    EzJSONDocumentInit(&document, lazy, strlen(lazy));
+    struct EzJSONValue root = EzJSONDocumentRoot(&document);
+    if (EzJSONValueFind(root, "list", 4, &value) != 0
+        || EzJSONValueAt(value, 1, &element) != 0
+        || EzJSONValueGetNumber(element, &real) != 0 || real != -0.5
+        || EzJSONValueAt(value, 2, &element) != 1
+        || EzJSONValueFind(root, "name", 4, &value) != 0
+        || EzJSONValueGetString(value, name, sizeof(name), &count) != 0
+        || strcmp(name, "ez") != 0
+        || EzJSONValueFind(root, "skip", 4, &value) != 0
+        || EzJSONValueGetType(value) != EZJ_VALUE_OBJECT
+        || EzJSONValueFind(root, "missing", 7, &value) != 1
+        || EzJSONValueFind(root, "id", 2, &value) != 0
+        || EzJSONValueGetNumber(value, &real) != 0
+        || real != 12345678901234567890.0
+        || EzJSONValueFind(root, "list", 4, &value) != 0
+        || EzJSONValueAt(value, 0, &element) != 0
+        || EzJSONValueGetBool(element, &flag) != 0 || !flag)
+    {
+        printf("On-demand lookup failed\n");
+        return 1;
+    }
+    EzJSONDocumentDestroy(&document);
+
+    // A malformed member leaves the previous one in place
+    const char *brokenMember = "{\"a\":1,\"b\" 2}";
+    struct EzJSONIterator iterator;
+    struct EzJSONValue key;
+    memset(&document, 0, sizeof(document));
+    EzJSONDocumentInit(&document, brokenMember, strlen(brokenMember));
+    EzJSONIteratorInit(EzJSONDocumentRoot(&document), &iterator);
+    if (EzJSONIteratorNext(&iterator, &key, &value) != 1
+        || EzJSONIteratorNext(&iterator, &key, &value) != -1
+        || key.offset != 1 || value.offset != 5)
+    {
+        printf("Malformed member not reported\n");
+        return 1;
+    }
+    EzJSONDocumentDestroy(&document);
+
+    // Raw control characters are skipped over as the parser reads them
+    const char *rawControl = "{\"a\x01\":\"x\ny\",\"b\":[\"\x1f]\"],\"c\":1}";
+    memset(&document, 0, sizeof(document));
+    EzJSONDocumentInit(&document, rawControl, strlen(rawControl));
+    root = EzJSONDocumentRoot(&document);
+    if (EzJSONValueFind(root, "a\x01", 2, &value) != 0
+        || EzJSONValueGetString(value, name, sizeof(name), &count) != 0
+        || strcmp(name, "x\ny") != 0
+        || EzJSONValueFind(root, "c", 1, &value) != 0)
+    {
+        printf("Raw control characters not skipped\n");
+        return 1;
+    }
+    EzJSONDocumentDestroy(&document);
+
     struct EzJSONWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.checked = 1;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    capturedLength     = 0;
+
+    const double writeDoubles[] = {0.1, -2.5, 1e300, 1.0 / 3.0};
+    const int64_t writeIntegers[] = {INT64_MIN, 0, 42};
+    EzJSONWriteArrayBegin(&writer);
+    EzJSONWriteNumberArray(&writer, writeDoubles, 4);
+    EzJSONWriteNumberArrayI64(&writer, writeIntegers, 3);
+    EzJSONWriteNumberArrayF(&writer, NULL, 0);
+    EzJSONWriteArrayEnd(&writer);
+    EzJSONWriterDestroy(&writer);
+
+    const char *expected = "[[0.1,-2.5,1e+300,0.33333333333333331],"
+                           "[-9223372036854775808,0,42],[]]";
+    printf("%.*s\n", capturedLength, captured);
+    if (writer.error != EZ_WE_OK || capturedLength != strlen(expected)
+        || memcmp(captured, expected, capturedLength) != 0)
+    {
+        return 1;
+    }
+
+    // NaN and infinities are rejected when checked and written as null
+    // otherwise
+    const double notFinite[] = {1.0, NAN, -INFINITY};
+    for (int checked = 0; checked < 2; ++checked)
+    {
+        memset(&writer, 0, sizeof(writer));
+        writer.settings.checked = (EzJSONBool)checked;
+        EzJSONWriterInit(&writer);
+        writer.writeBuffer = &capture;
+        capturedLength     = 0;
+        EzJSONWriteArrayBegin(&writer);
+        EzJSONWriteNumberD(&writer, INFINITY);
+        EzJSONWriteNumberArray(&writer, notFinite, 3);
+        EzJSONWriteNumberD(&writer, 2.0);
+        EzJSONWriteArrayEnd(&writer);
+        EzJSONWriterDestroy(&writer);
+
+        expected = checked ? "[2]" : "[null,[1,null,null],2]";
+        if (writer.error != (checked ? EZ_WE_NOT_FINITE : EZ_WE_OK)
+            || capturedLength != strlen(expected)
+            || memcmp(captured, expected, capturedLength) != 0)
+        {
+            printf("Non-finite numbers: %.*s\n", capturedLength, captured);
+            return 1;
+        }
+    }
+
+    // Instrumentation counters, only available with EZJSON_STATS
+    struct EzJSONStats stats;
+    const char *statsJson = "[1,[2,{\"a\":\"xyz\"}]]";
+    struct EzJSONParser statsParser;
+    memset(&statsParser, 0, sizeof(statsParser));
+    statsParser.settings.input        = statsJson;
+    statsParser.settings.input_length = strlen(statsJson);
+    EzJSONParserInit(&statsParser);
+    const unsigned long statsTokens = countTokens(&statsParser);
+    const EzJSONBool parserStats = EzJSONParserGetStats(&statsParser, &stats);
+#if defined(EZJSON_STATS)
+    if (!parserStats || statsTokens != 13 || stats.tokens != statsTokens
+        || stats.bytes != strlen(statsJson) || stats.maxDepth != 3)
+#else
+    if (parserStats || statsTokens != 13 || stats.tokens != 0
+        || stats.maxDepth != 0)
+#endif
+    {
+        printf("Parser stats: %lu tokens, %lu bytes, depth %u\n",
+               stats.tokens,
+               stats.bytes,
+               stats.maxDepth);
+        return 1;
+    }
+    EzJSONParserResetStats(&statsParser);
+    EzJSONParserGetStats(&statsParser, &stats);
+    EzJSONParserDestroy(&statsParser);
+    if (stats.tokens != 0 || stats.bytes != 0 || stats.maxDepth != 0)
+    {
+        printf("Parser stats not reset\n");
+        return 1;
+    }
+
+    // Calls rejected by the checked mode are not counted
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.checked = 1;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    capturedLength     = 0;
+    EzJSONWriteObjectBegin(&writer);
+    EzJSONWriteArrayBegin(&writer);
+    EzJSONWriteNumberArray(&writer, writeDoubles, 4);
+    const EzJSONBool writerStats = EzJSONWriterGetStats(&writer, &stats);
+#if defined(EZJSON_STATS)
+    if (!writerStats || writer.error != EZ_WE_KEY_EXPECTED
+        || stats.tokens != 1 || stats.maxDepth != 1 || writer.statsDepth != 1)
+#else
+    if (writerStats || writer.error != EZ_WE_KEY_EXPECTED
+        || stats.tokens != 0 || stats.maxDepth != 0)
+#endif
+    {
+        printf("Writer stats: %lu tokens, depth %u\n",
+               stats.tokens,
+               stats.maxDepth);
+        return 1;
+    }
+    EzJSONWriterResetStats(&writer);
+    EzJSONWriterGetStats(&writer, &stats);
+    EzJSONWriterDestroy(&writer);
+    if (stats.tokens != 0 || stats.maxDepth != 0)
+    {
+        printf("Writer stats not reset\n");
+        return 1;
+    }
+
+    // Binary round trips. The array is long enough to be flushed before its
+    // count is known.
+    char json[4096];
+    unsigned length = (unsigned)snprintf(
+        json,
+        sizeof(json),
+        "{\"text\":\"quote \\\" tab \\t\",\"big\":9007199254740993,"
+        "\"neg\":-129,\"real\":0.1,\"flag\":true,\"none\":null,"
+        "\"empty\":{},\"list\":[");
+    for (unsigned i = 0; i < 300; ++i)
+    {
+        length += (unsigned)snprintf(
+            json + length,
+            sizeof(json) - length,
+            "%s%u",
+            i ? "," : "",
+            i * 997);
+    }
+    strcpy(json + length, "]}");
+
+    for (int format = EZJ_BINARY_MSGPACK; format <= EZJ_BINARY_CBOR; ++format)
+    {
+        if (binaryRoundTrip((enum EzJSONBinaryFormat)format, json) != 0
+            || capturedLength != strlen(json)
+            || memcmp(captured, json, capturedLength) != 0)
+        {
+            printf(
+                "Binary round trip failed: %.*s\n", capturedLength, captured);
+            return 1;
+        }
+    }
+
+    // Integers above INT64_MAX are encoded as uint64, not as floats
+    const char *unsigned64 = "[18446744073709551615,9223372036854775808]";
+    const char msgpackU64[] = "\x92\xCF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF"
+                              "\xCF\x80\x00\x00\x00\x00\x00\x00\x00";
+    const char cborU64[] = "\x9F\x1B\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF"
+                           "\x1B\x80\x00\x00\x00\x00\x00\x00\x00\xFF";
+    for (int format = EZJ_BINARY_MSGPACK; format <= EZJ_BINARY_CBOR; ++format)
+    {
+        const int isCbor    = format == EZJ_BINARY_CBOR;
+        const char *encoded = isCbor ? cborU64 : msgpackU64;
+        const unsigned size = isCbor ? sizeof(cborU64) : sizeof(msgpackU64);
+        if (binaryRoundTrip((enum EzJSONBinaryFormat)format, unsigned64) != 0
+            || binaryLength != size - 1
+            || memcmp(binary, encoded, binaryLength) != 0)
+        {
+            printf("uint64 not encoded in format %d\n", format);
+            return 1;
+        }
+    }
+
+    // CBOR chunked string behind a tag
+    const char cbor[] = "\xBF\x61\x61\xC1\x7F\x62\x62\x63\x61\x64\xFF\xFF";
+    struct EzJSONBinaryReader reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.settings.format       = EZJ_BINARY_CBOR;
+    reader.settings.input        = cbor;
+    reader.settings.input_length = sizeof(cbor) - 1;
+    EzJSONBinaryReaderInit(&reader);
+    memset(&writer, 0, sizeof(writer));
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    capturedLength     = 0;
+    if (EzJSONFromBinary(&reader, &writer) != 0 || capturedLength != 11
+        || memcmp(captured, "{\"a\":\"bcd\"}", 11) != 0)
+    {
+        printf("CBOR chunks not joined\n");
+        return 1;
+    }
+    EzJSONWriterDestroy(&writer);
+    EzJSONBinaryReaderDestroy(&reader);
+
+    // Tape written to a file, mapped and replayed
+    struct EzJSONParser tapeParser;
+    memset(&tapeParser, 0, sizeof(tapeParser));
+    tapeParser.settings.input        = json;
+    tapeParser.settings.input_length = strlen(json);
+    EzJSONParserInit(&tapeParser);
+    FILE *tapeFile = fopen("ezjson_test.tape", "wb");
+    if (!tapeFile || EzJSONTapeWrite(&tapeParser, &fileWrite, tapeFile) != 0)
+    {
+        printf("Tape not written\n");
+        return 1;
+    }
+    fclose(tapeFile);
+    EzJSONParserDestroy(&tapeParser);
+
+    struct EzJSONTape tape;
+    if (EzJSONTapeOpen(&tape, "ezjson_test.tape") != 0)
+    {
+        printf("Tape not opened: %s\n", EzJSONTapeErrorName(tape.error));
+        return 1;
+    }
+    memset(&writer, 0, sizeof(writer));
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    capturedLength     = 0;
+    for (EzJSONTapeNext(&tape); EzJSONTapeToken(&tape); EzJSONTapeNext(&tape))
+    {
+        writeTapeToken(&writer, &tape);
+    }
+    EzJSONWriterDestroy(&writer);
+    if (tape.error != EZ_TE_OK || capturedLength != strlen(json)
+        || memcmp(captured, json, capturedLength) != 0)
+    {
+        printf("Tape replay failed: %.*s\n", capturedLength, captured);
+        return 1;
+    }
+
+    // Truncation is caught
+    struct EzJSONTape truncated;
+    EzJSONTapeInit(&truncated, tape.data, tape.length - 8);
+    do
+    {
+        EzJSONTapeNext(&truncated);
+    } while (EzJSONTapeToken(&truncated));
+    EzJSONTapeClose(&tape);
+    remove("ezjson_test.tape");
+    if (truncated.error != EZ_TE_TRUNCATED)
+    {
+        printf("Truncated tape not detected\n");
+        return 1;
+    }
+
+    // Compressed input and output, block wise
+    struct EzJSONParser memoryParser;
+    memset(&memoryParser, 0, sizeof(memoryParser));
+    memoryParser.settings.input        = json;
+    memoryParser.settings.input_length = strlen(json);
+    EzJSONParserInit(&memoryParser);
+    const unsigned long jsonTokens = countTokens(&memoryParser);
+    EzJSONParserDestroy(&memoryParser);
+
+    const enum EzJSONCompression formats[] = {
+        EZJ_COMPRESS_NONE,
+#if defined(EZJSON_ZLIB)
+        EZJ_COMPRESS_GZIP,
+#endif
+#if defined(EZJSON_ZSTD)
+        EZJ_COMPRESS_ZSTD,
+#endif
+    };
+    for (unsigned i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+    {
+        if (compressRoundTrip(formats[i], json) != jsonTokens
+            || capturedLength != strlen(json)
+            || memcmp(captured, json, capturedLength) != 0)
+        {
+            printf("Compression round trip %u failed\n", (unsigned)formats[i]);
+            return 1;
+        }
+    }
+
+#if defined(EZJSON_ZLIB)
+    // A gzip stream without its trailer
+    compressRoundTrip(EZJ_COMPRESS_GZIP, json);
+    struct ChunkSource cut = {binary, binaryLength - 4, 0};
+    struct EzJSONDecompressor decompressor;
+    memset(&decompressor, 0, sizeof(decompressor));
+    decompressor.settings.userdata = &cut;
+    decompressor.settings.read     = &chunkRead;
+    EzJSONDecompressorInit(&decompressor);
+    const char *block;
+    while (EzJSONDecompressorNextBlock(&decompressor, &block) > 0)
+    {
+    }
+    EzJSONDecompressorDestroy(&decompressor);
+    if (decompressor.error != EZ_CE_TRUNCATED)
+    {
+        printf("Truncated gzip stream not detected\n");
+        return 1;
+    }
+#endif
+
+    memset(&writer, 0, sizeof(writer));
     writer.settings.allocate_memory = 0;
     writer.settings.free_memory     = 0;
     writer.settings.userdata        = stdout;
+    writer.settings.checked         = 1;
     EzJSONWriterInit(&writer);
 
     writer.writeBuffer = &dump;
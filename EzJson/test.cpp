@@ -0,0 +1,199 @@
+#include "ezjson.hpp"
+#include "ezjson_keys.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+
+// Handles every token
+struct Counter
+{
+    int containers = 0;
+    int keys       = 0;
+    int values     = 0;
+    bool failed    = false;
+
+    void onObjectBegin()
+    {
+        containers++;
+    }
+    void onObjectEnd()
+    {
+    }
+    void onArrayBegin()
+    {
+        containers++;
+    }
+    void onArrayEnd()
+    {
+    }
+    void onKey(const char *, unsigned)
+    {
+        keys++;
+    }
+    void onNull()
+    {
+        values++;
+    }
+    void onNumber(EzJSONNumber)
+    {
+        values++;
+    }
+    void onBool(bool)
+    {
+        values++;
+    }
+    void onString(const char *, unsigned)
+    {
+        values++;
+    }
+    void onError(const EzJSONError &)
+    {
+        failed = true;
+    }
+};
+
+// Only interested in numbers, everything else is compiled out
+struct Sum
+{
+    EzJSONNumber total = 0;
+
+    void onNumber(EzJSONNumber val)
+    {
+        total += val;
+    }
+};
+
+// Maps keys to fields through the parser computed key hash
+enum Field
+{
+    FIELD_A,
+    FIELD_B,
+    FIELD_E,
+};
+
+constexpr auto fields = ezjson::makeKeySet("a", "b", "e");
+
+struct Fields
+{
+    int found   = 0;
+    int unknown = 0;
+    EzJSONParser *parser;
+
+    void onKey(const char *key, unsigned length)
+    {
+        const int field = fields.find(*EzJSONParserToken(parser));
+        if (field != fields.find(key, length))
+        {
+            unknown += 100;
+        }
+
+        switch (field)
+        {
+        case FIELD_A:
+        case FIELD_B:
+        case FIELD_E:
+            found++;
+            break;
+        default:
+            unknown++;
+            break;
+        }
+    }
+};
+
+static_assert(
+    ezjson::keyHash("name", 4) == 0x8d39bde6u, "keyHash is 32-bit FNV-1a");
+
+struct StringSink
+{
+    std::string out;
+
+    void operator()(const char *data, unsigned count)
+    {
+        out.append(data, count);
+    }
+};
+
+int main()
+{
+    const char *doc = "{\"a\": [1, 2, 3], \"b\": {\"c\": null, \"d\": true},"
+                      " \"e\": \"text\"}";
+
+    ezjson::Parser parser(doc, std::strlen(doc));
+    Counter counter;
+    if (!ezjson::read(parser, counter) || counter.failed
+        || counter.containers != 3 || counter.keys != 5 || counter.values != 6)
+    {
+        std::printf("Counter handler failed\n");
+        return 1;
+    }
+
+    ezjson::Parser moved(doc, std::strlen(doc));
+    ezjson::Parser target = std::move(moved);
+    Sum sum;
+    if (!ezjson::read(target, sum) || sum.total != 6)
+    {
+        std::printf("Sum handler failed\n");
+        return 1;
+    }
+
+    ezjson::Parser keyed(doc, std::strlen(doc));
+    Fields keys;
+    keys.parser = keyed.get();
+    if (!ezjson::read(keyed, keys) || keys.found != 3 || keys.unknown != 2
+        || EzJSONKeyHash("name", 4) != ezjson::keyHash("name", 4))
+    {
+        std::printf("Key set lookup failed\n");
+        return 1;
+    }
+
+    // Escaped keys are hashed after decoding
+    const char *escaped = "{\"\\u0062\": 1}";
+    ezjson::Parser escapedParser(escaped, std::strlen(escaped));
+    escapedParser.next();
+    if (!escapedParser.next()
+        || fields.find(*escapedParser.token()) != FIELD_B)
+    {
+        std::printf("Escaped key lookup failed\n");
+        return 1;
+    }
+
+    const char *bad = "[1, 2,]";
+    ezjson::Parser badParser(bad, std::strlen(bad));
+    Counter badCounter;
+    if (ezjson::read(badParser, badCounter) || !badCounter.failed
+        || badParser.error().kind != EZ_PE_UNEXPECTED_CHAR)
+    {
+        std::printf("Error not reported\n");
+        return 1;
+    }
+
+    StringSink sink;
+    {
+        ezjson::Writer writer(sink, true);
+        writer.objectBegin();
+        writer.key("a", 1);
+        writer.arrayBegin();
+        writer.number(1);
+        writer.boolean(false);
+        writer.null();
+        writer.string("x", 1);
+        writer.arrayEnd();
+        writer.objectEnd();
+        if (writer.error() != EZ_WE_OK)
+        {
+            std::printf("Unexpected write error\n");
+            return 1;
+        }
+    }
+
+    std::printf("%s\n", sink.out.c_str());
+    if (sink.out != "{\"a\":[1,false,null,\"x\"]}")
+    {
+        return 1;
+    }
+
+    return 0;
+}
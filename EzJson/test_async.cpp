@@ -0,0 +1,164 @@
+#include "ezjson_async.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+
+// Minimal fire and forget coroutine type
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object()
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend()
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void()
+        {
+        }
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+void trace(const EzJSONToken &token, std::string &out)
+{
+    out += static_cast<char>('a' + token.type);
+    if (token.type == EZJ_TOKEN_STRING || token.type == EZJ_TOKEN_OBJ_KEY)
+    {
+        out.append(token.data_text, token.data_text_length);
+    }
+    else if (token.type == EZJ_TOKEN_NUMBER)
+    {
+        out += std::to_string(token.data_number);
+    }
+    out += ' ';
+}
+
+// Record every token, then how the document ended
+Task consume(ezjson::AsyncParser &parser, std::string &out, bool &done)
+{
+    while (const EzJSONToken *token = co_await parser.next())
+    {
+        trace(*token, out);
+    }
+    out += parser.hasError() ? "error" : "end";
+    done = true;
+}
+
+std::string traceInMemory(const char *doc)
+{
+    ezjson::Parser parser(doc, std::strlen(doc));
+    std::string out;
+    while (const EzJSONToken *token = parser.next())
+    {
+        trace(*token, out);
+    }
+    out += parser.hasError() ? "error" : "end";
+    return out;
+}
+
+int main()
+{
+    const char *docs[] = {
+        "{\"name\": \"a string longer than a chunk, with \\u00e9scapes\","
+        " \"list\": [1, 22.5, -3e2, true, null], \"nested\": {\"k\": []}}",
+        "[\"short\", 12345678, {\"x\": false}]",
+        "{\"cut\": [1, 2",
+    };
+    const unsigned count = sizeof(docs) / sizeof(docs[0]);
+
+    // One thread drives every document, fed a few bytes at a time in turn
+    // through a single buffer that is overwritten after each feed
+    for (std::size_t chunk = 1; chunk <= 9; ++chunk)
+    {
+        ezjson::AsyncParser first;
+        ezjson::AsyncParser second(EZJ_PARSE_SKIP_SEPARATORS);
+        ezjson::AsyncParser third;
+        ezjson::AsyncParser *parsers[] = {&first, &second, &third};
+        std::string traces[count];
+        bool done[count]        = {};
+        std::size_t pos[count]  = {};
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            consume(*parsers[i], traces[i], done[i]);
+        }
+
+        char buffer[16];
+        bool fed = true;
+        while (fed)
+        {
+            fed = false;
+            for (unsigned i = 0; i < count; ++i)
+            {
+                const std::size_t length = std::strlen(docs[i]);
+                if (done[i] || !parsers[i]->waiting())
+                {
+                    continue;
+                }
+                fed = true;
+                if (pos[i] == length)
+                {
+                    parsers[i]->finish();
+                    continue;
+                }
+
+                const std::size_t n =
+                    length - pos[i] < chunk ? length - pos[i] : chunk;
+                std::memcpy(buffer, docs[i] + pos[i], n);
+                if (!parsers[i]->feed(buffer, n))
+                {
+                    std::printf("Feed refused\n");
+                    return 1;
+                }
+                std::memset(buffer, '?', sizeof(buffer));
+                pos[i] += n;
+            }
+        }
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            std::string expected = traceInMemory(docs[i]);
+            if (i == 1)
+            {
+                // Without separator tokens
+                std::string filtered;
+                for (std::size_t at = 0; at < expected.size(); ++at)
+                {
+                    if ((expected[at] == 'e' || expected[at] == 'f')
+                        && expected[at + 1] == ' '
+                        && (at == 0 || expected[at - 1] == ' '))
+                    {
+                        ++at;
+                        continue;
+                    }
+                    filtered += expected[at];
+                }
+                expected = filtered;
+            }
+            if (!done[i] || traces[i] != expected)
+            {
+                std::printf(
+                    "Document %u in chunks of %zu: %s\n",
+                    i,
+                    chunk,
+                    traces[i].c_str());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "test_schema.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+// Exercises code generated by ezjson_bindgen from test_schema.json
+
+static char output[1024];
+static unsigned outputLength;
+
+static void capture(void *userdata, const char *data, unsigned count)
+{
+    memcpy(output + outputLength, data, count);
+    outputLength += count;
+}
+
+static int parse(const char *json, struct User *user)
+{
+    struct EzJSONParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.settings.input        = json;
+    parser.settings.input_length = strlen(json);
+    EzJSONParserInit(&parser);
+
+    memset(user, 0, sizeof(*user));
+    const int result = UserParse(user, &parser);
+    EzJSONParserDestroy(&parser);
+    return result;
+}
+
+int main()
+{
+    const char *json = "{\"id\": 42, \"name\": \"ada\","
+                       " \"unknown\": {\"a\": [1]}, \"active\": true,"
+                       " \"home\": {\"y\": 2, \"x\": 1}, \"scores\": [1, 2.5],"
+                       " \"tags\": [\"a\", \"bc\"],"
+                       " \"visits\": [{\"x\": 3, \"y\": 4}]}";
+
+    struct User user;
+    if (parse(json, &user) != 0 || user.id != 42
+        || strcmp(user.name, "ada") != 0 || !user.active || user.home.x != 1
+        || user.home.y != 2 || user.scores_count != 2 || user.scores[1] != 2.5f
+        || user.tags_count != 2 || strcmp(user.tags[1], "bc") != 0
+        || user.visits_count != 1 || user.visits[0].y != 4)
+    {
+        printf("Generated parser failed\n");
+        return 1;
+    }
+
+    struct EzJSONWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.settings.checked = 1;
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+
+    UserWrite(&user, &writer);
+    EzJSONWriterDestroy(&writer);
+    printf("%.*s\n", outputLength, output);
+
+    const char *expected =
+        "{\"id\":42,\"name\":\"ada\",\"active\":true,"
+        "\"home\":{\"x\":1,\"y\":2},\"scores\":[1,2.5],\"tags\":[\"a\",\"bc\"],"
+        "\"visits\":[{\"x\":3,\"y\":4}]}";
+    if (writer.error != EZ_WE_OK || outputLength != strlen(expected)
+        || memcmp(output, expected, outputLength) != 0)
+    {
+        printf("Generated writer failed\n");
+        return 1;
+    }
+
+    // Strings are stored decoded and escaped again when written
+    memset(&writer, 0, sizeof(writer));
+    EzJSONWriterInit(&writer);
+    writer.writeBuffer = &capture;
+    outputLength       = 0;
+    if (parse("{\"name\": \"a\\\"b\\\\c\"}", &user) != 0
+        || strcmp(user.name, "a\"b\\c") != 0)
+    {
+        printf("Generated parser failed on escapes\n");
+        return 1;
+    }
+    UserWrite(&user, &writer);
+    EzJSONWriterDestroy(&writer);
+    const char *escaped = "{\"id\":0,\"name\":\"a\\\"b\\\\c\",";
+    if (outputLength < strlen(escaped)
+        || memcmp(output, escaped, strlen(escaped)) != 0)
+    {
+        printf("Generated writer failed on escapes\n");
+        return 1;
+    }
+
+    // Integers are read exactly, beyond the precision of EzJSONNumber
+    if (parse("{\"id\": 16777217}", &user) != 0 || user.id != 16777217
+        || parse("{\"id\": -2147483648}", &user) != 0 || user.id != INT_MIN)
+    {
+        printf("Generated parser lost integer precision\n");
+        return 1;
+    }
+
+    // Type mismatch, string overflow, array overflow, fractions and
+    // integers out of range
+    if (parse("{\"id\": \"42\"}", &user) == 0
+        || parse("{\"name\": \"much too long for the field\"}", &user) == 0
+        || parse("{\"scores\": [1, 2, 3, 4, 5]}", &user) == 0
+        || parse("{\"id\": 1.9}", &user) == 0
+        || parse("{\"id\": 3000000000}", &user) == 0)
+    {
+        printf("Generated parser accepted invalid input\n");
+        return 1;
+    }
+
+    return 0;
+}